@@ -12,20 +12,20 @@ using float4 = math::Vector4<float>;
 #define	ATM_TOP_HEIGHT 260.f // [km]
 #define	ATM_TOP_RADIUS	(EARTH_RADIUS + ATM_TOP_HEIGHT)
 #define	INSCATTER_INTEGRAL_STEPS 512
+#define	NUM_RANDOMDIR_SAMPLES 128	// directions of the gather pass with hashed random directions
 #define	EARTH_CENTER	float3(0,-EARTH_RADIUS,0)
 #define	LUT_HEIGHT_MARGIN 0.004 // [km]
 
-#if 0
-// Low quality
-#define	TEX4D_U	4
-#define	TEX4D_V	64
-#define	TEX4D_W	8
-#else
-// High quality
+// Default resolution of the inscatter look-up tables. The resolution in use is a runtime property
+// (PrecomputedAtmosphericScattering::Desc, CpuPrecomputedAtmosphericScattering::Desc), 4 x 64 x 8 is a low quality setting.
 #define	TEX4D_U	12	// height
-#define	TEX4D_V	96	// view zenith
+#define	TEX4D_V	96	// view zenith, even : the horizon splits it in half
 #define	TEX4D_W	24	// sun zenith
-#endif
+
+// Default resolution of the sky irradiance look-up table, a runtime property as well
+#define	IRRADIANCE_U	16	// height
+#define	IRRADIANCE_V	64	// sun zenith
+#define	NUM_IRRADIANCE_SAMPLES	128	// spherical Fibonacci directions over the upper hemisphere
 
 struct PrecomputedSctrParams
 {
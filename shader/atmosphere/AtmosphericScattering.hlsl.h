@@ -9,6 +9,8 @@
 //		[Elek09]		Elek, O. "Rendering Parametrizable Planetary Atmosphere with Multiple Scattering in Real-Time", CESCG 2009. (2009)
 //		[Yusov13]		Yusov, E. "Outdoor Light Scattering Sample Update", https://software.intel.com/en-us/blogs/2013/09/19/otdoor-light-scattering-sample-update, (2013)
 //		[Hillaire16]	Hillaire, S. "Physically Based Sky, Atmosphere and Cloud Rendering in Frostbite", SIGGRAPH 2016. (2016)
+//		[Borjesson79]	Borjesson, P., Sundberg, C. "Simple Approximations of the Error Function Q(x) for Communications Applications", IEEE Trans. Commun. 27(3), pp. 639--643 (1979)
+//		[Marques13]		Marques, R., Bouville, C., Ribardiere, M., Santos, L. P., Bouatouch, K. "Spherical Fibonacci Point Sets for Illumination Integrals", Computer Graphics Forum 32(8), pp. 134--143 (2013)
 //------------------------------------------------------
 
 //------------------------------------------------------
@@ -54,7 +56,20 @@ float4 PackInscatter(float3 inRayleigh, float3 inMie)
 //------------------------------------------------------
 //	 3d LookUpTable parametrization [Yusov13]
 //------------------------------------------------------
+// The resolution is a shader parameter : a pixel shader defines LUT_RESOLUTION_PARAM, the index of the float4 whose xyz hold it
+// (see PrecomputedAtmosphericScattering::UpdateShaderParameters()). The default resolution otherwise.
+#ifdef LUT_RESOLUTION_PARAM
+#define LUT_RESOLUTION	GetParam(LUT_RESOLUTION_PARAM).xyz
+#else
 #define LUT_RESOLUTION	float3(TEX4D_U, TEX4D_V, TEX4D_W)
+#endif
+
+// The same for the 2d sunlight / skylight tables : IRRADIANCE_RESOLUTION_PARAM, the index of the float4 whose xy hold it
+#ifdef IRRADIANCE_RESOLUTION_PARAM
+#define IRRADIANCE_RESOLUTION	GetParam(IRRADIANCE_RESOLUTION_PARAM).xy
+#else
+#define IRRADIANCE_RESOLUTION	float2(IRRADIANCE_U, IRRADIANCE_V)
+#endif
 
 float3 ComputeViewDir(in float cosViewZenith)
 {
@@ -234,12 +249,13 @@ void LookUpPrecomputedScatteringSeparated(
 }
 
 //------------------------------------------------------
-//	 3d LookUpTable parametrization for sunlight and skylight
+//	 2d LookUpTable parametrization for sunlight and skylight
+//		- u : height, v : sun zenith, the same mappings as w and u of the 3d tables
 //------------------------------------------------------
 void SunlightLUTCoordToWorldCoord(float2 inUV, out float outHeight, out float outSunZenith)
 {
 	// Rescale to exactly 0,1 range
-	inUV.xy		= saturate((inUV * LUT_RESOLUTION.xz - 0.5) / (LUT_RESOLUTION.xz - 1.0));
+	inUV.xy		= saturate((inUV * IRRADIANCE_RESOLUTION - 0.5) / (IRRADIANCE_RESOLUTION - 1.0));
 	outHeight		= inUV.x * inUV.x * (ATM_TOP_HEIGHT - 2.0 * LUT_HEIGHT_MARGIN) + LUT_HEIGHT_MARGIN;
 	outSunZenith	= tan((2.0 * inUV.y - 1.0 + 0.26) * 1.1) / tan(1.26 * 1.1); // Bruneton's formula [Bruneton09]
 }
@@ -251,7 +267,7 @@ float2 WorldCoordToSunlightLUTCoord(float inHeight, float inSunZenith)
 	outUV.x		= saturate((height - LUT_HEIGHT_MARGIN) / (ATM_TOP_HEIGHT - 2.0 * LUT_HEIGHT_MARGIN));
 	outUV.x		= sqrt(outUV.x);
 	outUV.y		= (atan(max(inSunZenith, -0.1975) * tan(1.26 * 1.1)) / 1.1 + (1.0 - 0.26)) * 0.5; // Bruneton's formula [Bruneton09]
-	outUV		= ((outUV * (LUT_RESOLUTION.xz - 1.0) + 0.5) / LUT_RESOLUTION.xz);
+	outUV		= ((outUV * (IRRADIANCE_RESOLUTION - 1.0) + 0.5) / IRRADIANCE_RESOLUTION);
 	return outUV;
 }
 
@@ -338,6 +354,63 @@ float2 CalculateNaiveOpticalDepthAlongRay(
 	return CalulateNaiveOpticalDepth(inWorldPos, intersection_pos, inScaleHeights, inNumSteps);
 }
 
+//------------------------------------------------------
+//	Analytic optical depth
+//		- Optical depth to the top of the atmosphere in closed form, replaces the optical depth texture
+//		- Chapman function Ch(x, mu) ~ sqrt(pi x / 2) erfcx(mu sqrt(x / 2)), x = r / H (second order in the curvature of the ray)
+//		- Rays below the horizontal use Ch(x, -mu) = 2 exp(x - x0) Ch(x0, 0) - Ch(x, mu), x0 = x sin(zenith)
+//		- The atmosphere is assumed to extend to infinity, exp(-ATM_TOP_HEIGHT / H) is negligible
+//------------------------------------------------------
+
+// exp(y^2) erfc(y) for y >= 0, relative error < 0.3% [Borjesson79]
+float ErfcxApprox(float y)
+{
+	const float a = 0.339;
+	const float b = 5.510;
+	return 0.7978845608 / ((1.0 - a) * 1.4142135624 * y + a * sqrt(2.0 * y * y + b));
+}
+
+// Ch(x, mu) for mu >= 0
+float ChapmanUpper(float x, float mu)
+{
+	return sqrt(0.5 * M_PI * x) * ErfcxApprox(mu * sqrt(0.5 * x));
+}
+
+float AnalyticOpticalDepth(float inHeight, float inCosZenith, float inScaleHeight)
+{
+	const float r = EARTH_RADIUS + inHeight;
+	const float x = r / inScaleHeight;
+	const float upper = inScaleHeight * exp(-inHeight / inScaleHeight) * ChapmanUpper(x, abs(inCosZenith));
+	if (inCosZenith >= 0.0)
+		return upper;
+
+	// Twice the optical depth of the whole horizontal ray through the periapsis, minus the opposite direction
+	const float r0 = r * sqrt(saturate(1.0 - inCosZenith * inCosZenith));
+	return inScaleHeight * 2.0 * exp(-(r0 - EARTH_RADIUS) / inScaleHeight) * sqrt(0.5 * M_PI * r0 / inScaleHeight) - upper;
+}
+
+float2 CalculateAnalyticOpticalDepthToTop(float inHeight, float inCosZenith, float2 inScaleHeights)
+{
+	const float height = max(inHeight, 0.0);
+	if (inCosZenith < GetCosHorizonAngle(height))
+		return float2(1e20, 1e20); // huge optical depth, same as CalculateNaiveOpticalDepthAlongRay()
+	return float2(AnalyticOpticalDepth(height, inCosZenith, inScaleHeights.x), AnalyticOpticalDepth(height, inCosZenith, inScaleHeights.y));
+}
+
+// Optical depth from a point to the top of the atmosphere, from the optical depth texture or in closed form
+float2 GetOpticalDepthToTop(
+	float inHeight,
+	float inCosZenith,
+	float2 inScaleHeights,
+	bool inAnalytic,
+	in Texture2D<float2> inOpticalDepthTexture,
+	in SamplerState inOpticalDepthSampler)
+{
+	[branch] if (inAnalytic)
+		return CalculateAnalyticOpticalDepthToTop(inHeight, inCosZenith, inScaleHeights);
+	return inOpticalDepthTexture.SampleLevel(inOpticalDepthSampler, float2(inHeight / ATM_TOP_HEIGHT, inCosZenith*0.5 + 0.5), 0).xy;
+}
+
 //------------------------------------------------------
 //	 Single scattering
 //------------------------------------------------------
@@ -348,6 +421,7 @@ void SingleScattering(
 	in PrecomputedSctrParams	inParams,
 	in Texture2D<float2>		inOpticalDepthTexture,
 	in SamplerState				inOpticalDepthSampler,
+	bool						inAnalyticOpticalDepth,
 	out float3 outInscatterR,
 	out float3 outInscatterM,
 	out float3 outTransmittance,
@@ -377,9 +451,9 @@ void SingleScattering(
 		float height = (length(sample_pos - EARTH_CENTER) - EARTH_RADIUS);
 		float2 optdepth_from_cam_integrand = exp(-height / scale_height);
 
-		// optdepth_to_top is precalculated in the texture
+		// optdepth_to_top is precalculated in the texture, or computed in closed form
 		float	cos_light_zenith = dot(normalize(sample_pos - EARTH_CENTER), inLightDir);
-		float2	optdepth_to_top = inOpticalDepthTexture.SampleLevel(inOpticalDepthSampler, float2(height / ATM_TOP_HEIGHT, cos_light_zenith*0.5 + 0.5), 0).xy;
+		float2	optdepth_to_top = GetOpticalDepthToTop(height, cos_light_zenith, scale_height, inAnalyticOpticalDepth, inOpticalDepthTexture, inOpticalDepthSampler);
 
 		float3 trans_from_cam	= exp(-betaR * optdepth_from_cam.x - betaM * optdepth_from_cam.y);
 		float3 trans_to_top		= exp(-betaR * optdepth_to_top.x - betaM * optdepth_to_top.y);
@@ -459,4 +533,48 @@ void MultipleScattering(
 	outInscatterM *= inParams.mMieSctrCoeff.xyz;
 }
 
+//------------------------------------------------------
+//	Gather quadrature
+//		- Spherical Fibonacci set [Marques13], deterministic and nearly uniform, every direction has the weight 4 pi / N
+//		- Its axis is the zenith, so that the rings of the set follow the horizon
+//------------------------------------------------------
+float3 SphericalFibonacci(int inIndex, int inNumSamples)
+{
+	const float golden_angle = 2.39996323; // pi * (3 - sqrt(5))
+	float cos_zenith = 1.0 - (2.0 * float(inIndex) + 1.0) / float(inNumSamples);
+	float sin_zenith = sqrt(saturate(1.0 - cos_zenith * cos_zenith));
+	float phi = golden_angle * float(inIndex);
+	return float3(sin_zenith * cos(phi), cos_zenith, sin_zenith * sin(phi));
+}
+
+//------------------------------------------------------
+//	Sky irradiance [Bruneton08]
+//		- Irradiance of a horizontal surface from the inscatter of one scattering order, for a sun of 1
+//		- The first half of 2 * NUM_IRRADIANCE_SAMPLES spherical Fibonacci directions is the upper hemisphere
+//		- The phase functions take mie_g = 0 as the gather [Elek09]. The ground does not reflect.
+//------------------------------------------------------
+float3 IntegrateSkyIrradiance(
+	float inHeight,
+	float inCosSunZenith,
+	in Texture3D<float4> inInscatterTextureR,
+	in Texture3D<float4> inInscatterTextureM,
+	in SamplerState		inSampler)
+{
+	float3 start_pos = float3(0.0, inHeight, 0.0);
+	float3 light_dir = float3(sqrt(saturate(1.0 - inCosSunZenith * inCosSunZenith)), inCosSunZenith, 0.0);
+
+	float3 irradiance = float3(0.0, 0.0, 0.0);
+	for (int i = 0; i < NUM_IRRADIANCE_SAMPLES; ++i)
+	{
+		float3 dir = SphericalFibonacci(i, 2 * NUM_IRRADIANCE_SAMPLES);
+		float3 inscatter_r, inscatter_m;
+		LookUpPrecomputedScatteringSeparated(start_pos, dir, light_dir, inInscatterTextureR, inInscatterTextureM, inSampler, inscatter_r, inscatter_m);
+
+		float mu = dot(dir, light_dir);
+		float mie_g = 0.0; // [Elek09]
+		irradiance += (inscatter_r * RayleighPhase(mu) + inscatter_m * CornetteShanksPhaseFunc(mu, mie_g)) * dir.y;
+	}
+	return irradiance * (2.0 * M_PI / float(NUM_IRRADIANCE_SAMPLES));
+}
+
 #endif // ATMOSPHERIC_SCATTERING_H
@@ -1,3 +1,4 @@
+#define LUT_RESOLUTION_PARAM 11
 #include "Atmosphere.h"
 #include "AtmosphereConstants.h"
 #include "AtmosphericScattering.hlsl.h"
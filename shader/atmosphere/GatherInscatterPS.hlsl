@@ -1,3 +1,4 @@
+#define LUT_RESOLUTION_PARAM 3
 #include "Atmosphere.h"
 #include "AtmosphereConstants.h"
 #include "AtmosphericScattering.hlsl.h"
@@ -33,12 +34,16 @@ PSOutput Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Tar
 	float2 scale_height		= float2(params.mRayleighScaleHeight, params.mMieScaleHeight);
 	float2 height_factor	= exp(-height / scale_height);
 
-#define NUM_RANDOMDIR_SAMPLES	128
+	// GetParam(2).z : number of spherical Fibonacci directions, 0 = hashed random directions
+	const int num_fibonacci_samples = int(GetParam(2).z);
+	const int num_samples = (num_fibonacci_samples > 0) ? num_fibonacci_samples : NUM_RANDOMDIR_SAMPLES;
 	float3 inscatter_sum_r = float3(0, 0, 0);
 	float3 inscatter_sum_m = float3(0, 0, 0);
-	for (int i = 0; i < NUM_RANDOMDIR_SAMPLES; ++i)
+	for (int i = 0; i < num_samples; ++i)
 	{
-		float3 rand_dir = normalize(RandomUnitVector(uvw.xy * Hash21(float(i) + uvw.z * 2236.20679) * 1414.24356));
+		float3 rand_dir = (num_fibonacci_samples > 0)
+			? SphericalFibonacci(i, num_fibonacci_samples)
+			: normalize(RandomUnitVector(uvw.xy * Hash21(float(i) + uvw.z * 2236.20679) * 1414.24356));
 		float mu = dot(view_dir, rand_dir);
 
 		float3	inscatter_r, inscatter_m;
@@ -56,8 +61,8 @@ PSOutput Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Tar
 		inscatter_sum_m += inscatter_m;
 	}
 
-	o.outColor0 = float4(inscatter_sum_r * 4.0 * 3.14159265 / float(NUM_RANDOMDIR_SAMPLES), 0.0);
-	o.outColor1 = float4(inscatter_sum_m * 4.0 * 3.14159265 / float(NUM_RANDOMDIR_SAMPLES), 0.0);
+	o.outColor0 = float4(inscatter_sum_r * 4.0 * 3.14159265 / float(num_samples), 0.0);
+	o.outColor1 = float4(inscatter_sum_m * 4.0 * 3.14159265 / float(num_samples), 0.0);
 
 	return o;
 }
@@ -0,0 +1,16 @@
+#define LUT_RESOLUTION_PARAM 3
+#define IRRADIANCE_RESOLUTION_PARAM 4
+#include "Atmosphere.h"
+#include "AtmosphereConstants.h"
+#include "AtmosphericScattering.hlsl.h"
+
+Texture3D<float4> gTexture3Da : register(t4);
+Texture3D<float4> gTexture3Db : register(t5);
+
+// Sky irradiance of one scattering order, added to the irradiance of the previous orders by the blend state
+float4 Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Target
+{
+	float height, cos_sun_zenith;
+	SunlightLUTCoordToWorldCoord(inUV, height, cos_sun_zenith);
+	return float4(IntegrateSkyIrradiance(height, cos_sun_zenith, gTexture3Da, gTexture3Db, SamplerLinearClamp), 0.0);
+}
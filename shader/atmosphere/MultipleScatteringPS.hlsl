@@ -1,3 +1,4 @@
+#define LUT_RESOLUTION_PARAM 3
 #include "Atmosphere.h"
 #include "AtmosphereConstants.h"
 #include "AtmosphericScattering.hlsl.h"
@@ -7,10 +8,13 @@ Texture2D<float4> gTexture2Da : register(t0);
 Texture3D<float4> gTexture3Da : register(t4);
 Texture3D<float4> gTexture3Db : register(t5);
 
+// 0, 1 : the order, 2, 3 : the same, added to the total inscatter (independent blend)
 struct PSOutput
 {
 	float4 outColor0	: SV_Target0;
 	float4 outColor1	: SV_Target1;
+	float4 outColor2	: SV_Target2;
+	float4 outColor3	: SV_Target3;
 };
 
 PSOutput Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Target
@@ -18,6 +22,8 @@ PSOutput Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Tar
 	PSOutput o;
 	o.outColor0 = float4(0.0, 0.0, 0.0, 0.0);
 	o.outColor1 = float4(0.0, 0.0, 0.0, 0.0);
+	o.outColor2 = float4(0.0, 0.0, 0.0, 0.0);
+	o.outColor3 = float4(0.0, 0.0, 0.0, 0.0);
 	
 	const float3 uvw = float3(inUV.x, inUV.y, GetWQ().x);
 
@@ -66,6 +72,8 @@ PSOutput Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Tar
 
 	o.outColor0.xyz = inscatter_r;
 	o.outColor1.xyz = inscatter_m;
+	o.outColor2 = o.outColor0;
+	o.outColor3 = o.outColor1;
 
 	// (We ignored the reflection from the ground)
 
@@ -15,6 +15,11 @@ float2 Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Targe
 	float3 sample_pos = float3(0.0, height, 0.0);
 	float3 ray_dir = float3(0.0, costheta, sintheta);
 
+	// Closed form when SingleScattering does not read this texture (see GetOpticalDepthToTop())
+	const bool analytic_optical_depth = GetParam(2).y > 0.5;
+	[branch] if (analytic_optical_depth)
+		return CalculateAnalyticOpticalDepthToTop(height, costheta, scale_heights);
+
 	const int num_steps = 128;
 	return CalculateNaiveOpticalDepthAlongRay(sample_pos, ray_dir, scale_heights, num_steps);
 }
@@ -1,3 +1,4 @@
+#define LUT_RESOLUTION_PARAM 3
 #include "Atmosphere.h"
 #include "AtmosphereConstants.h"
 #include "AtmosphericScattering.hlsl.h"
@@ -47,6 +48,8 @@ PSOutput Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Tar
 	params.mMieSctrCoeff		= GetParam(1).xyz;
 	params.mMieScaleHeight		= GetParam(1).w;
 	params.mMieAbsorption		= GetParam(2).x;
+	const bool analytic_optical_depth = GetParam(2).y > 0.5;
+	const float2 scale_heights	= float2(params.mRayleighScaleHeight, params.mMieScaleHeight);
 
 	// Integrate single-scattering
 	float3 transmittance;
@@ -59,6 +62,7 @@ PSOutput Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Tar
 		params,
 		gTexture2Da,	// optical depth
 		SamplerLinearClamp,
+		analytic_optical_depth,
 		inscatterR,
 		inscatterM,
 		transmittance,
@@ -70,7 +74,7 @@ PSOutput Entry(float4 inPosition : SV_POSITION, float2 inUV : TexCoord) : SV_Tar
 		float3 ground_albedo = float3(0.45, 0.45, 0.45);
 		float height = (length(end_pos - EARTH_CENTER) - EARTH_RADIUS);
 		float cos_light_zenith = dot(normalize(end_pos - EARTH_CENTER), light_dir);
-		float2 optdepth_to_top = gTexture2Da.SampleLevel(SamplerLinearClamp, float2(height / ATM_TOP_HEIGHT, cos_light_zenith*0.5 + 0.5), 0).xy;
+		float2 optdepth_to_top = GetOpticalDepthToTop(height, cos_light_zenith, scale_heights, analytic_optical_depth, gTexture2Da, SamplerLinearClamp);
 		float3 trans_to_top		= exp(-params.mRayleighSctrCoeff * optdepth_to_top.x - params.mMieSctrCoeff * optdepth_to_top.y);
 		inscatterR += ground_albedo * saturate(cos_light_zenith) * transmittance * trans_to_top;
 		inscatterM += ground_albedo * saturate(cos_light_zenith) * transmittance * trans_to_top;
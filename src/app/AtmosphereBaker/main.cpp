@@ -0,0 +1,1607 @@
+//--------------------------------------------------------------------------------------
+// Headless baker for the precomputed atmospheric scattering look-up tables
+//	- Runs the CPU engine, no window nor GPU is required
+//
+//	Usage: AtmosphereBaker [--threads N] [--scattering N] [--tile WxHxD] [--simd auto|scalar|avx2|avx512] [--optical-depth table|analytic] [--tolerance T] [--convergence T [max|mean]] [--gather random|fibonacci [N]] [--resolution UxVxW] [--inscatter-4d UxVxWxQ] [--cache DIR] [--timings FILE]
+//	                      [--scaling] [--optical-depth-report] [--integration-report] [--gather-report] [--incremental-report] [--atlas-report] [--sky-query-benchmark] [--layout-benchmark] [--storage-report] [--resolution-ladder] [--azimuth-report] [--adaptive-report]
+//	                      [--render-sky DIR [WxH]] [--sequence DIR N [WxH]] [--reference DIR [SPP] [WxH]]
+//		--tolerance : adaptive inscatter integration with this relative tolerance instead of uniform steps
+//		--convergence : stops the scattering orders once one adds less than T (relative, max over the texels or share of the energy)
+//		--gather : directions of the gather pass, hashed random directions or N spherical Fibonacci directions
+//		--resolution : inscatter look-up table resolution, V even (default TEX4D_U x TEX4D_V x TEX4D_W)
+//		--inscatter-4d : also bakes the packed inscatter with Q view-sun azimuths (WorldCoordToLUTCoord4D())
+//		--cache : reuses the tables of a previous run with the same parameters
+//		--timings : writes the per-stage timings and throughputs of the bake as JSON (BakeTimings)
+//		--scaling : bakes with 1, 2, 4, ... up to N threads and reports the speedup against 1 thread
+//		--optical-depth-report : accuracy and cost of the analytic optical depth against the numeric integration
+//		--integration-report : samples, time and error of the adaptive inscatter integration for a few tolerances
+//		--gather-report : error and time of the gather quadratures against a dense Fibonacci set
+//		--incremental-report : stages that run again, and the time, after each kind of parameter edit
+//		--atlas-report : memory, build time and blending error of LookUpTableAtlas over the Mie coefficient and scale height
+//		--sky-query-benchmark : throughput of SkyRadianceBatch() and SkyIrradianceBatch() on one thread for every instruction set, and the error against scalar
+//		--layout-benchmark : random and coherent trilinear lookups of the packed inscatter in every LookUpTableLayout, also at 4x the resolution
+//		--storage-report : memory and per-texel error of the finished tables in the half and RGB9E5 formats, and the conversion throughput
+//		--resolution-ladder : bake time, memory and sky radiance error of a ladder of inscatter resolutions against twice the default
+//		--azimuth-report : bake time, memory and single scattering error of the 3d table and of 4d tables with a few azimuth resolutions,
+//		                   at low and at high sun, against SingleScattering() along the exact rays
+//		--adaptive-report : texels, memory and per-texel error of uniform inscatter tables and of adaptive ones built for a few
+//		                    maximum errors (BuildAdaptiveInscatterTable()), against a bake at twice the resolution
+//		--render-sky : renders a perspective frame (default 1280x720), an equirectangular panorama and a cubemap into DIR
+//		               with SkyRenderer, tone mapped .ppm and linear .pfm
+//		--sequence : renders N frames of a day (MakeDaySchedule()) into DIR, written in turn then through the writer queue,
+//		             and reports the frames per second of both
+//		--reference : path traces an equirectangular panorama (default 256 samples per pixel, 128x64) with PathTracedSky,
+//		              doubling the samples per pass, and reports the error of the look-up tables against it after each pass.
+//		              reference.pfm, lut.pfm and error.pfm (relative error per channel) are written into DIR.
+//--------------------------------------------------------------------------------------
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <src/lib/atmosphere/AdaptiveLookUpTable.hpp>
+#include <src/lib/atmosphere/AtmosphericScattering.hpp>
+#include <src/lib/atmosphere/CpuPrecomputedAtmosphericScattering.hpp>
+#include <src/lib/atmosphere/LookUpTableAtlas.hpp>
+#include <src/lib/atmosphere/LookUpTableEncoding.hpp>
+#include <src/lib/atmosphere/PathTracedSky.hpp>
+#include <src/lib/atmosphere/SkyRadianceBatch.hpp>
+#include <src/lib/atmosphere/SkyRenderer.hpp>
+#include <src/lib/atmosphere/SkySequence.hpp>
+
+using Atmosphere = atmosphere::CpuPrecomputedAtmosphericScattering;
+
+static bool ParseInstructionSet(const char* inName, atmosphere::SimdInstructionSet& outInstructionSet)
+{
+	for (auto instruction_set : { atmosphere::SimdInstructionSet::Auto, atmosphere::SimdInstructionSet::Scalar, atmosphere::SimdInstructionSet::AVX2, atmosphere::SimdInstructionSet::AVX512 })
+	{
+		if (!std::strcmp(inName, atmosphere::GetSimdInstructionSetName(instruction_set)))
+		{
+			outInstructionSet = instruction_set;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ParseOpticalDepthMode(const char* inName, atmosphere::OpticalDepthMode& outMode)
+{
+	if (!std::strcmp(inName, "table"))
+		outMode = atmosphere::OpticalDepthMode::Table;
+	else if (!std::strcmp(inName, "analytic"))
+		outMode = atmosphere::OpticalDepthMode::Analytic;
+	else
+		return false;
+	return true;
+}
+
+static bool ParseConvergenceMetric(const char* inName, Atmosphere::ConvergenceMetric& outMetric)
+{
+	if (!std::strcmp(inName, "max"))
+		outMetric = Atmosphere::ConvergenceMetric::Max;
+	else if (!std::strcmp(inName, "mean"))
+		outMetric = Atmosphere::ConvergenceMetric::Mean;
+	else
+		return false;
+	return true;
+}
+
+static bool ParseGatherQuadrature(const char* inName, atmosphere::GatherQuadrature& outQuadrature)
+{
+	if (!std::strcmp(inName, "random"))
+		outQuadrature = atmosphere::GatherQuadrature::Random;
+	else if (!std::strcmp(inName, "fibonacci"))
+		outQuadrature = atmosphere::GatherQuadrature::SphericalFibonacci;
+	else
+		return false;
+	return true;
+}
+
+static double Bake(Atmosphere& inAtmosphere)
+{
+	auto time_start = std::chrono::high_resolution_clock::now();
+	inAtmosphere.GeneratePrecomputedTexture();
+	auto time_end = std::chrono::high_resolution_clock::now();
+	return 1e-3 * std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_start).count();
+}
+
+static void RunScalingBenchmark(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	const std::uint32_t max_threads = inDesc.mNumThreads ? inDesc.mNumThreads : std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::vector<std::uint32_t> thread_counts;
+	for (std::uint32_t n = 1; n < max_threads; n *= 2)
+		thread_counts.push_back(n);
+	thread_counts.push_back(max_threads);
+
+	double base_ms = 0.0;
+	for (std::uint32_t num_threads : thread_counts)
+	{
+		etc::TaskScheduler scheduler(num_threads);
+		Atmosphere::Desc desc = inDesc;
+		desc.mScheduler = &scheduler;
+		Atmosphere atmosphere(desc);
+		atmosphere.SetNumScattering(inNumScattering);
+
+		const double elapsed_ms = Bake(atmosphere);
+		if (num_threads == 1)
+			base_ms = elapsed_ms;
+
+		std::uint64_t num_tasks = 0, num_stolen = 0;
+		for (const auto& stats : scheduler.GetStats())
+		{
+			num_tasks += stats.mNumExecutedTasks;
+			num_stolen += stats.mNumStolenTasks;
+		}
+
+		const double speedup = base_ms / elapsed_ms;
+		std::printf("%3u threads : %10.1f [ms], speedup %6.2fx, efficiency %5.1f%%, %llu tasks (%llu stolen)\n",
+			num_threads, elapsed_ms, speedup, 100.0 * speedup / num_threads,
+			static_cast<unsigned long long>(num_tasks), static_cast<unsigned long long>(num_stolen));
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Stage timings
+//--------------------------------------------------------------------------------------
+
+static void PrintBakeTimings(const Atmosphere& inAtmosphere)
+{
+	const atmosphere::BakeTimings& timings = inAtmosphere.GetBakeTimings();
+	std::printf("%-22s %5s %10s %10s %12s %12s\n", "stage", "runs", "wall [ms]", "busy [ms]", "texels/s", "samples/s");
+	for (size_t stage = 0; stage < Atmosphere::NUM_BUFFERS; ++stage)
+	{
+		const size_t num_runs = std::count_if(timings.mStages.begin(), timings.mStages.end(),
+			[stage](const atmosphere::BakeStageTiming& inTiming) { return inTiming.mStage == stage; });
+		if (num_runs == 0)
+			continue;
+		const atmosphere::BakeStageTiming total = timings.GetStageTotal(stage);
+		std::printf("%-22s %5zu %10.1f %10.1f %12.3e %12.3e\n", atmosphere::GetBakeStageName(stage), num_runs,
+			total.mWallMs, total.mBusyMs, total.GetTexelsPerSecond(), total.GetSamplesPerSecond());
+	}
+	std::printf("%-22s %5s %10.1f\n", "bake", "", timings.mTotalMs);
+}
+
+//--------------------------------------------------------------------------------------
+// Optical depth report
+//--------------------------------------------------------------------------------------
+
+// Optical depth to the top of the atmosphere, trapezoidal rule in double precision
+static double IntegrateOpticalDepth(double inHeight, double inCosZenith, double inScaleHeight)
+{
+	const double r = EARTH_RADIUS + inHeight;
+	const double top = ATM_TOP_RADIUS;
+	const double length = -r * inCosZenith + std::sqrt(r * r * inCosZenith * inCosZenith - (r * r - top * top));
+	const int num_steps = 16384;
+	const double dt = length / num_steps;
+	double sum = 0.0;
+	for (int i = 0; i <= num_steps; ++i)
+	{
+		const double t = dt * i;
+		const double radius = std::sqrt(r * r + t * t + 2.0 * r * t * inCosZenith);
+		sum += ((i == 0 || i == num_steps) ? 0.5 : 1.0) * std::exp(-(radius - EARTH_RADIUS) / inScaleHeight);
+	}
+	return sum * dt;
+}
+
+struct OpticalDepthError
+{
+	double	mMaxRelative = 0.0;			// where the optical depth is > 1e-3 [km]
+	double	mSumRelative = 0.0;
+	size_t	mNumRelative = 0;
+	double	mMaxTransmittance = 0.0;	// |exp(-beta tau) - exp(-beta tau_ref)| with the largest scattering coefficient
+	size_t	mNumGroundHits = 0;			// above the horizon but returned the ground-hit value, e.g. filtered with a texel below the horizon
+
+	void Add(double inValue, double inReference, double inExtinction)
+	{
+		if (inValue >= 1e10)
+		{
+			++mNumGroundHits;
+			return;
+		}
+		if (inReference > 1e-3)
+		{
+			const double relative = std::abs(inValue - inReference) / inReference;
+			mMaxRelative = std::max(mMaxRelative, relative);
+			mSumRelative += relative;
+			++mNumRelative;
+		}
+		mMaxTransmittance = std::max(mMaxTransmittance, std::abs(std::exp(-inExtinction * inValue) - std::exp(-inExtinction * inReference)));
+	}
+};
+
+static void RunOpticalDepthReport(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	using namespace atmosphere;
+
+	// End to end: the same bake with both providers
+	Atmosphere::Desc desc = inDesc;
+	desc.mCacheDirectory.clear();
+	desc.mOpticalDepthMode = OpticalDepthMode::Table;
+	Atmosphere table_atmosphere(desc);
+	desc.mOpticalDepthMode = OpticalDepthMode::Analytic;
+	Atmosphere analytic_atmosphere(desc);
+	table_atmosphere.SetNumScattering(inNumScattering);
+	analytic_atmosphere.SetNumScattering(inNumScattering);
+	const double table_ms = Bake(table_atmosphere);
+	const double analytic_ms = Bake(analytic_atmosphere);
+
+	const PrecomputedSctrParams params = table_atmosphere.GetKernelParameters();
+	const math::Float2 scale_heights(params.mRayleighScaleHeight, params.mMieScaleHeight);
+	const double extinction[2] = {
+		std::max(std::max(params.mRayleighSctrCoeff.x, params.mRayleighSctrCoeff.y), params.mRayleighSctrCoeff.z),
+		std::max(std::max(params.mMieSctrCoeff.x, params.mMieSctrCoeff.y), params.mMieSctrCoeff.z) * params.mMieAbsorption,
+	};
+	const Atmosphere::View2D optical_depth_table = table_atmosphere.GetOpticalDepthTexture();
+
+	// Accuracy against the reference integral, heights are denser near the ground
+	enum { ANALYTIC = 0, TABLE, NAIVE_128, NUM_PROVIDERS };
+	const char* provider_names[NUM_PROVIDERS] = { "analytic", "table (bilinear)", "128 steps" };
+	OpticalDepthError errors[NUM_PROVIDERS][2];
+	const int num_heights = 32;
+	const int num_angles = 129;
+	for (int ih = 0; ih < num_heights; ++ih)
+	{
+		const float t = float(ih) / float(num_heights - 1);
+		const float height = float(LUT_HEIGHT_MARGIN) + t * t * (ATM_TOP_HEIGHT - 2.0f * float(LUT_HEIGHT_MARGIN));
+		for (int ia = 0; ia < num_angles; ++ia)
+		{
+			const float cos_zenith = -1.0f + 2.0f * float(ia) / float(num_angles - 1);
+			if (cos_zenith < GetCosHorizonAngle(height))
+				continue; // hits the ground, all providers return a huge optical depth
+
+			const float sin_zenith = std::sqrt(Saturate(1.0f - cos_zenith * cos_zenith));
+			const math::Float2 values[NUM_PROVIDERS] = {
+				CalculateAnalyticOpticalDepthToTop(height, cos_zenith, scale_heights),
+				SampleOpticalDepth(optical_depth_table, height, cos_zenith),
+				CalculateNaiveOpticalDepthAlongRay(math::Float3(0.0f, height, 0.0f), math::Float3(0.0f, cos_zenith, sin_zenith), scale_heights, 128),
+			};
+			for (int i = 0; i < 2; ++i)
+			{
+				const double reference = IntegrateOpticalDepth(height, cos_zenith, scale_heights[i]);
+				for (int provider = 0; provider < NUM_PROVIDERS; ++provider)
+					errors[provider][i].Add(values[provider][i], reference, extinction[i]);
+			}
+		}
+	}
+
+	std::printf("Optical depth against a %d-step reference integral (%d heights x %d zenith angles above the horizon)\n", 16384, num_heights, num_angles);
+	std::printf("%-18s %-9s %14s %14s %18s %12s\n", "provider", "", "max rel err", "mean rel err", "max trans err", "ground hits");
+	for (int provider = 0; provider < NUM_PROVIDERS; ++provider)
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			const OpticalDepthError& error = errors[provider][i];
+			std::printf("%-18s %-9s %13.4f%% %13.4f%% %18.3e %12zu\n", provider_names[provider], i == 0 ? "rayleigh" : "mie",
+				100.0 * error.mMaxRelative, 100.0 * error.mSumRelative / std::max<size_t>(error.mNumRelative, 1), error.mMaxTransmittance, error.mNumGroundHits);
+		}
+	}
+
+	// Cost of a single evaluation
+	{
+		const int num_evaluations = 1 << 16;
+		volatile float sink = 0.0f;
+		auto measure = [&](auto inFunc)
+		{
+			auto time_start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < num_evaluations; ++i)
+			{
+				const float height = ATM_TOP_HEIGHT * float(i & 255) / 256.0f;
+				const float cos_zenith = float(i >> 8) / 128.0f - 1.0f;
+				sink = sink + inFunc(height, cos_zenith).x;
+			}
+			auto time_end = std::chrono::high_resolution_clock::now();
+			return double(std::chrono::duration_cast<std::chrono::nanoseconds>(time_end - time_start).count()) / num_evaluations;
+		};
+		const double analytic_ns = measure([&](float h, float c) { return CalculateAnalyticOpticalDepthToTop(h, c, scale_heights); });
+		const double table_ns = measure([&](float h, float c) { return SampleOpticalDepth(optical_depth_table, h, c); });
+		const double naive_ns = measure([&](float h, float c)
+		{
+			return CalculateNaiveOpticalDepthAlongRay(math::Float3(0.0f, h, 0.0f), math::Float3(0.0f, c, std::sqrt(Saturate(1.0f - c * c))), scale_heights, 128);
+		});
+		std::printf("Cost per evaluation : analytic %.1f [ns], table sample %.1f [ns], 128 steps %.1f [ns]\n", analytic_ns, table_ns, naive_ns);
+	}
+
+	// Difference of the final look-up table
+	const Atmosphere::View3D a = table_atmosphere.GetPackedTotalInscatterTexture();
+	const Atmosphere::View3D b = analytic_atmosphere.GetPackedTotalInscatterTexture();
+	double max_difference = 0.0, sum_difference = 0.0, max_value = 0.0;
+	for (size_t i = 0; i < a.GetNumTexels(); ++i)
+	{
+		for (size_t c = 0; c < 3; ++c)
+		{
+			const double difference = std::abs(double(a.GetData()[i][c]) - double(b.GetData()[i][c]));
+			max_difference = std::max(max_difference, difference);
+			sum_difference += difference;
+			max_value = std::max(max_value, double(a.GetData()[i][c]));
+		}
+	}
+	std::printf("Packed inscatter, %u scattering orders : table %.1f [ms], analytic %.1f [ms], max diff %.3e (%.4f%% of the max texel), mean diff %.3e\n",
+		inNumScattering, table_ms, analytic_ms, max_difference, 100.0 * max_difference / std::max(max_value, 1e-30), sum_difference / (3.0 * a.GetNumTexels()));
+}
+
+//--------------------------------------------------------------------------------------
+// Integration report
+//--------------------------------------------------------------------------------------
+
+static void PrintIntegrationStats(const Atmosphere& inAtmosphere)
+{
+	const Atmosphere::IntegrationStats stats = inAtmosphere.GetIntegrationStats();
+	std::printf("Inscatter integrals : %llu rays, %llu samples, %llu with uniform steps, %lld saved (%.1f%%)\n",
+		static_cast<unsigned long long>(stats.mNumRays), static_cast<unsigned long long>(stats.mNumSamples),
+		static_cast<unsigned long long>(stats.GetNumUniformSamples()), static_cast<long long>(stats.GetNumSamplesSaved()),
+		100.0 * double(stats.GetNumSamplesSaved()) / double(std::max<std::uint64_t>(stats.GetNumUniformSamples(), 1)));
+}
+
+// Relative error of an inscatter table, over the texels brighter than 1e-3 of the brightest one
+static void CompareInscatter(const Atmosphere::View3D& inTable, const Atmosphere::View3D& inReference, double& outMaxError, double& outMeanError)
+{
+	double max_value = 0.0;
+	for (size_t i = 0; i < inReference.GetNumTexels(); ++i)
+		for (size_t c = 0; c < 4; ++c)
+			max_value = std::max(max_value, double(inReference.GetData()[i][c]));
+
+	outMaxError = 0.0;
+	double sum_error = 0.0;
+	size_t num_errors = 0;
+	for (size_t i = 0; i < inReference.GetNumTexels(); ++i)
+	{
+		for (size_t c = 0; c < 4; ++c)
+		{
+			const double reference = inReference.GetData()[i][c];
+			if (reference <= 1e-3 * max_value)
+				continue;
+			const double error = std::abs(double(inTable.GetData()[i][c]) - reference) / reference;
+			outMaxError = std::max(outMaxError, error);
+			sum_error += error;
+			++num_errors;
+		}
+	}
+	outMeanError = sum_error / double(std::max<size_t>(num_errors, 1));
+}
+
+static void RunIntegrationReport(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	Atmosphere::Desc desc = inDesc;
+	desc.mCacheDirectory.clear();
+
+	// Reference: adaptive steps with a tolerance well below the ones compared
+	const float reference_tolerance = 1e-5f;
+	desc.mIntegrationTolerance = reference_tolerance;
+	Atmosphere reference(desc);
+	reference.SetNumScattering(inNumScattering);
+	const double reference_ms = Bake(reference);
+	std::printf("Reference : tolerance %.0e, %.1f [ms], %llu samples\n", reference_tolerance, reference_ms,
+		static_cast<unsigned long long>(reference.GetIntegrationStats().mNumSamples));
+
+	std::printf("%-12s %12s %12s %14s %14s %14s\n", "tolerance", "time [ms]", "samples", "saved", "max rel err", "mean rel err");
+	for (float tolerance : { 0.0f, 1e-2f, 3e-3f, 1e-3f, 1e-4f })
+	{
+		desc.mIntegrationTolerance = tolerance;
+		Atmosphere atmosphere(desc);
+		atmosphere.SetNumScattering(inNumScattering);
+		const double elapsed_ms = Bake(atmosphere);
+
+		double max_error, mean_error;
+		CompareInscatter(atmosphere.GetPackedTotalInscatterTexture(), reference.GetPackedTotalInscatterTexture(), max_error, mean_error);
+
+		const Atmosphere::IntegrationStats stats = atmosphere.GetIntegrationStats();
+		char name[32];
+		if (tolerance > 0.0f)
+			std::snprintf(name, sizeof(name), "%.0e", tolerance);
+		else
+			std::snprintf(name, sizeof(name), "uniform %d", INSCATTER_INTEGRAL_STEPS);
+		std::printf("%-12s %12.1f %12llu %13.1f%% %13.4f%% %13.4f%%\n", name, elapsed_ms,
+			static_cast<unsigned long long>(stats.mNumSamples),
+			100.0 * double(stats.GetNumSamplesSaved()) / double(std::max<std::uint64_t>(stats.GetNumUniformSamples(), 1)),
+			100.0 * max_error, 100.0 * mean_error);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Gather report
+//--------------------------------------------------------------------------------------
+
+static void RunGatherReport(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	using atmosphere::GatherQuadrature;
+	Atmosphere::Desc desc = inDesc;
+	desc.mCacheDirectory.clear();
+	const std::uint32_t num_scattering = std::max(inNumScattering, 2u);
+
+	// Reference: a dense Fibonacci set. The gather table holds the last order.
+	desc.mGatherQuadrature = GatherQuadrature::SphericalFibonacci;
+	desc.mNumGatherSamples = 2048;
+	Atmosphere reference(desc);
+	reference.SetNumScattering(num_scattering);
+	const double reference_ms = Bake(reference);
+	std::printf("Reference : %u Fibonacci directions, %u scattering orders, %.1f [ms]\n", desc.mNumGatherSamples, num_scattering, reference_ms);
+
+	struct Quadrature
+	{
+		GatherQuadrature	mQuadrature;
+		std::uint32_t		mNumSamples;
+	};
+	std::printf("%-16s %12s %18s %18s %18s %18s\n", "quadrature", "time [ms]", "gather max err", "gather mean err", "packed max err", "packed mean err");
+	for (const Quadrature& quadrature : {
+		Quadrature{ GatherQuadrature::Random, NUM_RANDOMDIR_SAMPLES },
+		Quadrature{ GatherQuadrature::SphericalFibonacci, 16 },
+		Quadrature{ GatherQuadrature::SphericalFibonacci, 32 },
+		Quadrature{ GatherQuadrature::SphericalFibonacci, 64 },
+		Quadrature{ GatherQuadrature::SphericalFibonacci, 128 } })
+	{
+		desc.mGatherQuadrature = quadrature.mQuadrature;
+		desc.mNumGatherSamples = quadrature.mNumSamples;
+		Atmosphere atmosphere(desc);
+		atmosphere.SetNumScattering(num_scattering);
+		const double elapsed_ms = Bake(atmosphere);
+
+		double gather_max = 0.0, gather_mean = 0.0;
+		for (auto i : { Atmosphere::RAYLEIGH, Atmosphere::MIE })
+		{
+			double max_error, mean_error;
+			CompareInscatter(atmosphere.GetInscatterGatherTexture(i), reference.GetInscatterGatherTexture(i), max_error, mean_error);
+			gather_max = std::max(gather_max, max_error);
+			gather_mean += 0.5 * mean_error;
+		}
+		double packed_max, packed_mean;
+		CompareInscatter(atmosphere.GetPackedTotalInscatterTexture(), reference.GetPackedTotalInscatterTexture(), packed_max, packed_mean);
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "%s %u", quadrature.mQuadrature == GatherQuadrature::Random ? "random" : "fibonacci", quadrature.mNumSamples);
+		std::printf("%-16s %12.1f %17.4f%% %17.4f%% %17.4f%% %17.4f%%\n", name, elapsed_ms,
+			100.0 * gather_max, 100.0 * gather_mean, 100.0 * packed_max, 100.0 * packed_mean);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Incremental report
+//--------------------------------------------------------------------------------------
+
+static void RunIncrementalReport(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	Atmosphere::Desc desc = inDesc;
+	desc.mCacheDirectory.clear();
+	Atmosphere atmosphere(desc);
+	atmosphere.SetNumScattering(std::max(inNumScattering, 3u) - 1);
+
+	struct Edit
+	{
+		const char*				mName;
+		std::function<void()>	mApply;
+	};
+	PrecomputedSctrParams& params = atmosphere.GetParam();
+	const Edit edits[] = {
+		{ "full bake",			[]() {} },
+		{ "no change",			[]() {} },
+		{ "mie absorption",		[&params]() { params.mMieAbsorption *= 1.1f; } },
+		{ "rayleigh coeff",		[&params]() { params.mRayleighSctrCoeff = params.mRayleighSctrCoeff * 1.1f; } },
+		{ "scattering + 1",		[&atmosphere]() { atmosphere.SetNumScattering(atmosphere.GetNumScattering() + 1); } },
+		{ "scattering - 1",		[&atmosphere]() { atmosphere.SetNumScattering(atmosphere.GetNumScattering() - 1); } },
+		{ "mie scale height",	[&params]() { params.mMieScaleHeight *= 1.1f; } },
+	};
+
+	static const char* sStageNames[Atmosphere::NUM_BUFFERS] = { "optdepth", "single", "multiple", "gather", "accum", "total", "pack", "irr", "4d" };
+	std::printf("%-18s %12s", "edit", "time [ms]");
+	for (const char* name : sStageNames)
+		std::printf(" %9s", name);
+	std::printf("\n");
+	for (const Edit& edit : edits)
+	{
+		edit.mApply();
+		const double elapsed_ms = Bake(atmosphere);
+		std::printf("%-18s %12.1f", edit.mName, elapsed_ms);
+		for (int stage = 0; stage < Atmosphere::NUM_BUFFERS; ++stage)
+			std::printf(" %9u", atmosphere.GetNumStageExecutions(Atmosphere::BufferType(stage)));
+		std::printf("\n");
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Atlas report
+//--------------------------------------------------------------------------------------
+
+static void RunAtlasReport(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	using atmosphere::AtlasParameter;
+	using atmosphere::LookUpTableAtlas;
+	Atmosphere::Desc desc = inDesc;
+	desc.mCacheDirectory.clear();
+
+	const PrecomputedSctrParams base_params;
+	LookUpTableAtlas::Axis mie_coeff;
+	mie_coeff.mParameter = AtlasParameter::MieSctrScale;
+	mie_coeff.mMin = 0.5f;
+	mie_coeff.mMax = 2.0f;
+	LookUpTableAtlas::Axis mie_scale_height;
+	mie_scale_height.mParameter = AtlasParameter::MieScaleHeight;
+	mie_scale_height.mMin = 2.0f;
+	mie_scale_height.mMax = 4.0f;
+
+	// Exact bakes away from the grid points of every density
+	struct Probe
+	{
+		float	mMieScale;
+		float	mMieScaleHeight;
+	};
+	const Probe probes[] = { { 0.8f, 2.4f }, { 1.3f, 3.3f }, { 1.7f, 2.8f }, { 0.6f, 3.8f } };
+	std::vector<std::unique_ptr<Atmosphere::Table3D>> references;
+	std::vector<PrecomputedSctrParams> probe_params;
+	{
+		Atmosphere reference(desc);
+		reference.SetNumScattering(inNumScattering);
+		for (const Probe& probe : probes)
+		{
+			PrecomputedSctrParams params = LookUpTableAtlas::SetParameter(base_params, base_params, AtlasParameter::MieSctrScale, probe.mMieScale);
+			params = LookUpTableAtlas::SetParameter(params, base_params, AtlasParameter::MieScaleHeight, probe.mMieScaleHeight);
+			reference.GetParam() = params;
+			Bake(reference);
+			references.push_back(std::make_unique<Atmosphere::Table3D>(reference.GetPackedTotalInscatterTexture()));
+			probe_params.push_back(params);
+		}
+	}
+
+	std::printf("Mie coefficient x [%.1f, %.1f], Mie scale height [%.1f, %.1f] km, %u scattering orders, %zu probes\n",
+		mie_coeff.mMin, mie_coeff.mMax, mie_scale_height.mMin, mie_scale_height.mMax, inNumScattering, probe_params.size());
+	std::printf("%-8s %8s %12s %14s %12s %16s %16s\n", "grid", "points", "memory [MB]", "build [ms]", "blend [ms]", "packed max err", "packed mean err");
+	for (std::uint32_t num_points : { 2u, 3u, 5u })
+	{
+		LookUpTableAtlas::Desc atlas_desc;
+		atlas_desc.mEngineDesc = desc;
+		atlas_desc.mBaseParams = base_params;
+		atlas_desc.mNumScattering = inNumScattering;
+		mie_coeff.mNumPoints = num_points;
+		mie_scale_height.mNumPoints = num_points;
+		atlas_desc.mAxes = { mie_coeff, mie_scale_height };
+		LookUpTableAtlas atlas(atlas_desc);
+
+		auto time_start = std::chrono::high_resolution_clock::now();
+		atlas.Build();
+		auto time_end = std::chrono::high_resolution_clock::now();
+		const double build_ms = 1e-3 * std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_start).count();
+
+		double max_error = 0.0, mean_error = 0.0, blend_ms = 0.0;
+		std::unique_ptr<LookUpTableAtlas::Tables> tables = atlas.Blend(base_params);
+		for (size_t i = 0; i < probe_params.size(); ++i)
+		{
+			time_start = std::chrono::high_resolution_clock::now();
+			atlas.Blend(probe_params[i], *tables);
+			time_end = std::chrono::high_resolution_clock::now();
+			blend_ms += 1e-3 * std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_start).count() / double(probe_params.size());
+
+			double probe_max, probe_mean;
+			CompareInscatter(tables->mPackInscatter, *references[i], probe_max, probe_mean);
+			max_error = std::max(max_error, probe_max);
+			mean_error += probe_mean / double(probe_params.size());
+		}
+
+		char grid[16];
+		std::snprintf(grid, sizeof(grid), "%ux%u", num_points, num_points);
+		std::printf("%-8s %8zu %12.1f %14.1f %12.2f %15.3f%% %15.3f%%\n", grid, atlas.GetNumPoints(), double(atlas.GetMemorySize()) / (1024.0 * 1024.0),
+			build_ms, blend_ms, 100.0 * max_error, 100.0 * mean_error);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Sky radiance query benchmark
+//--------------------------------------------------------------------------------------
+static void RunSkyQueryBenchmark(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	using atmosphere::SimdInstructionSet;
+	Atmosphere::Desc desc = inDesc;
+	Atmosphere atmosphere(desc);
+	atmosphere.SetNumScattering(inNumScattering);
+	Bake(atmosphere);
+
+	atmosphere::SkyRadianceTables tables;
+	tables.mPackedInscatter = atmosphere.GetPackedTotalInscatterTexture();
+	tables.mOpticalDepth = atmosphere.GetOpticalDepthTexture();
+	tables.mOpticalDepthMode = atmosphere.GetOpticalDepthMode();
+	tables.mParams = atmosphere.GetKernelParameters();
+
+	// Positions up to 20 km, directions over the sphere, the sun above the horizon
+	const size_t num_queries = size_t(1) << 20;
+	std::vector<float> inputs(9 * num_queries);
+	std::uint32_t seed = 12345;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1u << 24); };
+	for (size_t i = 0; i < num_queries; ++i)
+	{
+		const math::Float3 pos(100.0f * (random() - 0.5f), 20.0f * random(), 100.0f * (random() - 0.5f));
+		const math::Float3 view_dir = atmosphere::SphericalFibonacci(int(i % 4096), 4096);
+		const math::Float3 light_dir = math::L2Normalize(math::Float3(random() - 0.5f, random(), random() - 0.5f));
+		for (int c = 0; c < 3; ++c)
+		{
+			inputs[(0 + c) * num_queries + i] = pos[c];
+			inputs[(3 + c) * num_queries + i] = view_dir[c];
+			inputs[(6 + c) * num_queries + i] = light_dir[c];
+		}
+	}
+	atmosphere::SkyRadianceQueries queries;
+	queries.mNumQueries = num_queries;
+	for (int c = 0; c < 3; ++c)
+	{
+		queries.mPosition[c] = &inputs[(0 + c) * num_queries];
+		queries.mViewDir[c] = &inputs[(3 + c) * num_queries];
+		queries.mLightDir[c] = &inputs[(6 + c) * num_queries];
+	}
+
+	std::vector<float> reference(6 * num_queries), outputs(6 * num_queries);
+	auto get_results = [num_queries](std::vector<float>& inOutputs)
+	{
+		atmosphere::SkyRadianceResults results;
+		for (int c = 0; c < 3; ++c)
+		{
+			results.mRadiance[c] = &inOutputs[(0 + c) * num_queries];
+			results.mTransmittance[c] = &inOutputs[(3 + c) * num_queries];
+		}
+		return results;
+	};
+
+	std::printf("%zu queries, 1 thread\n", num_queries);
+	std::printf("%-8s %12s %16s %16s %18s\n", "simd", "time [ms]", "Mqueries/s", "radiance err", "transmittance err");
+	for (SimdInstructionSet instruction_set : { SimdInstructionSet::Scalar, SimdInstructionSet::AVX2, SimdInstructionSet::AVX512 })
+	{
+		if (!atmosphere::IsSimdInstructionSetSupported(instruction_set))
+			continue;
+		const bool is_reference = (instruction_set == SimdInstructionSet::Scalar);
+		std::vector<float>& results = is_reference ? reference : outputs;
+		auto time_start = std::chrono::high_resolution_clock::now();
+		atmosphere::SkyRadianceBatch(instruction_set, tables, queries, get_results(results));
+		auto time_end = std::chrono::high_resolution_clock::now();
+		const double elapsed_ms = 1e-3 * std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_start).count();
+
+		// Max relative error against scalar, over the values above 1e-6 of the brightest one
+		double max_error[2] = {};
+		for (int k = 0; k < 2; ++k)
+		{
+			const auto begin = reference.begin() + k * 3 * num_queries;
+			const double max_value = *std::max_element(begin, begin + 3 * num_queries);
+			for (size_t i = 0; i < 3 * num_queries; ++i)
+			{
+				const double value = reference[k * 3 * num_queries + i];
+				if (value > 1e-6 * max_value)
+					max_error[k] = std::max(max_error[k], std::abs(double(results[k * 3 * num_queries + i]) - value) / value);
+			}
+		}
+		std::printf("%-8s %12.1f %16.1f %15.2e %17.2e\n", atmosphere::GetSimdInstructionSetName(instruction_set), elapsed_ms,
+			double(num_queries) / (1e3 * elapsed_ms), max_error[0], max_error[1]);
+	}
+
+	// Sky irradiance of the same positions and suns, the view directions stand for the surface normals
+	atmosphere::SkyIrradianceTables irradiance_tables;
+	irradiance_tables.mIrradiance = atmosphere.GetIrradianceTexture();
+	atmosphere::SkyIrradianceQueries irradiance_queries;
+	irradiance_queries.mNumQueries = num_queries;
+	float* irradiance_reference[3];
+	float* irradiance_outputs[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		irradiance_queries.mPosition[c] = queries.mPosition[c];
+		irradiance_queries.mNormal[c] = queries.mViewDir[c];
+		irradiance_queries.mLightDir[c] = queries.mLightDir[c];
+		irradiance_reference[c] = &reference[c * num_queries];
+		irradiance_outputs[c] = &outputs[c * num_queries];
+	}
+
+	std::printf("%-8s %12s %16s %16s\n", "simd", "time [ms]", "Mqueries/s", "irradiance err");
+	for (SimdInstructionSet instruction_set : { SimdInstructionSet::Scalar, SimdInstructionSet::AVX2, SimdInstructionSet::AVX512 })
+	{
+		if (!atmosphere::IsSimdInstructionSetSupported(instruction_set))
+			continue;
+		const bool is_reference = (instruction_set == SimdInstructionSet::Scalar);
+		auto time_start = std::chrono::high_resolution_clock::now();
+		atmosphere::SkyIrradianceBatch(instruction_set, irradiance_tables, irradiance_queries, is_reference ? irradiance_reference : irradiance_outputs);
+		auto time_end = std::chrono::high_resolution_clock::now();
+		const double elapsed_ms = 1e-3 * std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_start).count();
+
+		const double max_value = *std::max_element(reference.begin(), reference.begin() + 3 * num_queries);
+		double max_error = 0.0;
+		for (size_t i = 0; i < 3 * num_queries && !is_reference; ++i)
+		{
+			const double value = reference[i];
+			if (value > 1e-6 * max_value)
+				max_error = std::max(max_error, std::abs(double(outputs[i]) - value) / value);
+		}
+		std::printf("%-8s %12.1f %16.1f %15.2e\n", atmosphere::GetSimdInstructionSetName(instruction_set), elapsed_ms,
+			double(num_queries) / (1e3 * elapsed_ms), max_error);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Sky render
+//--------------------------------------------------------------------------------------
+static bool RunSkyRender(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering, const std::string& inDirectory, size_t inWidth, size_t inHeight)
+{
+	Atmosphere atmosphere(inDesc);
+	atmosphere.SetNumScattering(inNumScattering);
+	Bake(atmosphere);
+
+	atmosphere::SkyRadianceTables tables;
+	tables.mPackedInscatter = atmosphere.GetPackedTotalInscatterTexture();
+	tables.mOpticalDepth = atmosphere.GetOpticalDepthTexture();
+	tables.mOpticalDepthMode = atmosphere.GetOpticalDepthMode();
+	tables.mParams = atmosphere.GetKernelParameters();
+
+	// The renderer shares the pool of the engine
+	atmosphere::SkyRenderer::Desc renderer_desc;
+	renderer_desc.mScheduler = &atmosphere.GetScheduler();
+	renderer_desc.mInstructionSet = inDesc.mInstructionSet;
+	atmosphere::SkyRenderer renderer(renderer_desc);
+
+	// The sun and the exposure of the viewer at start up, the camera looks at the horizon below the sun
+	const float theta = 89.0f * math::PI<float> / 180.0f;
+	const float phi = 120.0f * math::PI<float> / 180.0f;
+	atmosphere::SkyView view;
+	view.mLightDir = math::Float3(std::cos(phi) * std::sin(theta), std::cos(theta), std::sin(phi) * std::sin(theta));
+	const math::Float3 forward = math::L2Normalize(math::Float3(view.mLightDir.x, 0.0f, view.mLightDir.z));
+	const math::Float3 right = math::L2Normalize(math::Cross(forward, math::Float3(0.0f, 1.0f, 0.0f)));
+	const math::Float3 up = math::Cross(right, forward);
+	view.mCameraRotation = math::Float3x3(right.x, up.x, forward.x, right.y, up.y, forward.y, right.z, up.z, forward.z);
+
+	struct Output
+	{
+		const char*					mName;
+		atmosphere::SkyProjection	mProjection;
+		size_t						mWidth;
+		size_t						mHeight;
+	};
+	const Output outputs[] = {
+		{ "perspective",	atmosphere::SkyProjection::Perspective,		inWidth,		inHeight },
+		{ "equirect",		atmosphere::SkyProjection::Equirectangular,	2 * inWidth,	inWidth },
+		{ "cubemap",		atmosphere::SkyProjection::Cubemap,			inWidth / 2,	inWidth / 2 },
+	};
+
+	std::filesystem::create_directories(inDirectory);
+	std::printf("%u threads, %s\n", renderer.GetScheduler().GetNumThreads(), atmosphere::GetSimdInstructionSetName(atmosphere::ResolveSimdInstructionSet(inDesc.mInstructionSet)));
+	std::printf("%-12s %12s %12s %12s\n", "image", "pixels", "time [ms]", "Mpixels/s");
+	for (const Output& output : outputs)
+	{
+		view.mProjection = output.mProjection;
+		view.mWidth = output.mWidth;
+		view.mHeight = output.mHeight;
+		atmosphere::SkyImage tone_mapped, radiance;
+		view.mToneMap = true;
+		auto time_start = std::chrono::high_resolution_clock::now();
+		renderer.Render(tables, view, tone_mapped);
+		auto time_end = std::chrono::high_resolution_clock::now();
+		view.mToneMap = false;
+		renderer.Render(tables, view, radiance);
+
+		const double elapsed_ms = 1e-3 * std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_start).count();
+		std::printf("%-12s %12zu %12.1f %12.1f\n", output.mName, tone_mapped.mPixels.size(), elapsed_ms, double(tone_mapped.mPixels.size()) / (1e3 * elapsed_ms));
+
+		const std::string path = inDirectory + "/" + output.mName;
+		if (!atmosphere::WriteSkyImagePPM(path + ".ppm", tone_mapped) || !atmosphere::WriteSkyImagePFM(path + ".pfm", radiance))
+		{
+			std::cout << "Cannot write " << path << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Time-of-day sequence
+//--------------------------------------------------------------------------------------
+static bool RunSkySequence(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering, const std::string& inDirectory, size_t inNumFrames, size_t inWidth, size_t inHeight)
+{
+	Atmosphere atmosphere(inDesc);
+	atmosphere.SetNumScattering(inNumScattering);
+	Bake(atmosphere);
+
+	atmosphere::SkyRadianceTables tables;
+	tables.mPackedInscatter = atmosphere.GetPackedTotalInscatterTexture();
+	tables.mOpticalDepth = atmosphere.GetOpticalDepthTexture();
+	tables.mOpticalDepthMode = atmosphere.GetOpticalDepthMode();
+	tables.mParams = atmosphere.GetKernelParameters();
+
+	atmosphere::SkyRenderer::Desc renderer_desc;
+	renderer_desc.mScheduler = &atmosphere.GetScheduler();
+	renderer_desc.mInstructionSet = inDesc.mInstructionSet;
+	atmosphere::SkyRenderer renderer(renderer_desc);
+
+	// The camera faces the noon sun (azimuth 180), a little above the horizon
+	atmosphere::SkySequenceDesc sequence;
+	sequence.mSunAngles = atmosphere::MakeDaySchedule(inNumFrames);
+	sequence.mView.mWidth = inWidth;
+	sequence.mView.mHeight = inHeight;
+	const math::Float3 forward = math::L2Normalize(math::Float3(-1.0f, 0.3f, 0.0f));
+	const math::Float3 right = math::L2Normalize(math::Cross(forward, math::Float3(0.0f, 1.0f, 0.0f)));
+	const math::Float3 up = math::Cross(right, forward);
+	sequence.mView.mCameraRotation = math::Float3x3(right.x, up.x, forward.x, right.y, up.y, forward.y, right.z, up.z, forward.z);
+
+	std::filesystem::create_directories(inDirectory);
+	auto write_frame = [&inDirectory](size_t inFrame, const atmosphere::SkyImage& inImage)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "/frame_%04zu.ppm", inFrame);
+		return atmosphere::WriteSkyImagePPM(inDirectory + name, inImage);
+	};
+
+	std::printf("%zu frames %zux%zu, %u threads\n", inNumFrames, inWidth, inHeight, renderer.GetScheduler().GetNumThreads());
+	std::printf("%-8s %10s %8s %12s %12s %14s %14s\n", "queue", "time [ms]", "fps", "render [ms]", "write [ms]", "render stall", "writer stall");
+	for (size_t queue_depth : { size_t(0), size_t(2) })
+	{
+		sequence.mQueueDepth = queue_depth;
+		atmosphere::SkySequenceStats stats;
+		if (!atmosphere::RenderSkySequence(renderer, tables, sequence, write_frame, &stats))
+		{
+			std::cout << "Cannot write the frames to " << inDirectory << std::endl;
+			return false;
+		}
+		std::printf("%-8zu %10.1f %8.2f %12.1f %12.1f %14.1f %14.1f\n", queue_depth, stats.mTotalMs, stats.GetFramesPerSecond(),
+			stats.mRenderMs, stats.mWriteMs, stats.mRenderStallMs, stats.mWriterStallMs);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Path-traced reference
+//--------------------------------------------------------------------------------------
+static bool RunSkyReference(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering, const std::string& inDirectory, std::uint32_t inNumSamples, size_t inWidth, size_t inHeight)
+{
+	Atmosphere atmosphere(inDesc);
+	atmosphere.SetNumScattering(inNumScattering);
+	Bake(atmosphere);
+
+	atmosphere::SkyRadianceTables tables;
+	tables.mPackedInscatter = atmosphere.GetPackedTotalInscatterTexture();
+	tables.mOpticalDepth = atmosphere.GetOpticalDepthTexture();
+	tables.mOpticalDepthMode = atmosphere.GetOpticalDepthMode();
+	tables.mParams = atmosphere.GetKernelParameters();
+
+	// Linear radiance of a panorama, the sun 60 degrees from the zenith
+	atmosphere::SkyView view;
+	view.mProjection = atmosphere::SkyProjection::Equirectangular;
+	view.mWidth = inWidth;
+	view.mHeight = inHeight;
+	view.mLightDir = atmosphere::GetSunDirection(math::Float2(60.0f, 120.0f));
+	view.mExposureCompensation = 0.0f;
+	view.mToneMap = false;
+
+	atmosphere::SkyRenderer::Desc renderer_desc;
+	renderer_desc.mScheduler = &atmosphere.GetScheduler();
+	renderer_desc.mInstructionSet = inDesc.mInstructionSet;
+	atmosphere::SkyRenderer renderer(renderer_desc);
+	atmosphere::SkyImage lut;
+	renderer.Render(tables, view, lut);
+
+	atmosphere::PathTracerSettings settings;
+	settings.mParams = tables.mParams;
+	settings.mMieAsymmetry = tables.mMieAsymmetry;
+	settings.mSunIlluminance = tables.mSunIlluminance;
+	atmosphere::PathTracedSky::Desc tracer_desc;
+	tracer_desc.mScheduler = &atmosphere.GetScheduler();
+	atmosphere::PathTracedSky tracer(tracer_desc, settings, view);
+
+	std::filesystem::create_directories(inDirectory);
+	std::printf("%zux%zu, %u scattering orders in the tables, %u threads\n", inWidth, inHeight, inNumScattering, atmosphere.GetScheduler().GetNumThreads());
+	std::printf("%8s %10s %10s %10s %10s %10s %10s %12s %12s\n", "spp", "time [s]", "Mpaths/s", "sky mean", "sky rms", "sky max", "sky bias", "ground mean", "sky noise");
+
+	// The upper rows of the panorama see the sky, the lower ones the ground
+	auto crop_rows = [](const atmosphere::SkyImage& inImage, size_t inBegin, size_t inEnd)
+	{
+		atmosphere::SkyImage rows;
+		rows.mWidth = inImage.mWidth;
+		rows.mHeight = inEnd - inBegin;
+		rows.mPixels.assign(inImage.mPixels.begin() + inBegin * inImage.mWidth, inImage.mPixels.begin() + inEnd * inImage.mWidth);
+		return rows;
+	};
+	double elapsed_s = 0.0;
+	while (tracer.GetNumSamples() < inNumSamples)
+	{
+		// Doubles the samples per pass
+		const std::uint32_t pass_samples = std::min(std::max(std::uint32_t(tracer.GetNumSamples()), 1u), inNumSamples - std::uint32_t(tracer.GetNumSamples()));
+		auto time_start = std::chrono::high_resolution_clock::now();
+		tracer.Refine(pass_samples);
+		auto time_end = std::chrono::high_resolution_clock::now();
+		const double pass_s = 1e-6 * std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_start).count();
+		elapsed_s += pass_s;
+
+		atmosphere::SkyImage reference, standard_error, error_map;
+		tracer.GetImage(reference);
+		tracer.GetStandardError(standard_error);
+		atmosphere::CompareSkyImages(reference, lut, &error_map);
+		const atmosphere::SkyImageError sky = atmosphere::CompareSkyImages(crop_rows(reference, 0, inHeight / 2), crop_rows(lut, 0, inHeight / 2));
+		const atmosphere::SkyImageError ground = atmosphere::CompareSkyImages(crop_rows(reference, inHeight / 2, inHeight), crop_rows(lut, inHeight / 2, inHeight));
+
+		// Noise of the reference : standard error relative to the radiance of the sky
+		const atmosphere::SkyImageError noise = atmosphere::CompareSkyImages(crop_rows(reference, 0, inHeight / 2), crop_rows(standard_error, 0, inHeight / 2));
+		const double relative_noise = noise.mMeanRelativeBias + 1.0;
+
+		// 3 paths per sample, one per channel
+		const double num_paths = 3.0 * double(pass_samples) * double(reference.mPixels.size());
+		std::printf("%8llu %10.2f %10.3f %9.2f%% %9.2f%% %9.2f%% %9.2f%% %11.2f%% %11.2f%%\n", static_cast<unsigned long long>(tracer.GetNumSamples()), elapsed_s, 1e-6 * num_paths / pass_s,
+			100.0 * sky.mMeanRelativeError, 100.0 * sky.mRmsRelativeError, 100.0 * sky.mMaxRelativeError, 100.0 * sky.mMeanRelativeBias, 100.0 * ground.mMeanRelativeError, 100.0 * relative_noise);
+
+		if (!atmosphere::WriteSkyImagePFM(inDirectory + "/reference.pfm", reference)
+			|| !atmosphere::WriteSkyImagePFM(inDirectory + "/lut.pfm", lut)
+			|| !atmosphere::WriteSkyImagePFM(inDirectory + "/error.pfm", error_map))
+		{
+			std::cout << "Cannot write the images to " << inDirectory << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Layout benchmark
+//--------------------------------------------------------------------------------------
+static void RunLayoutBenchmark(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	using atmosphere::LookUpTableLayout;
+	using TiledTable = atmosphere::TiledLookUpTable3D<math::Float4>;
+	Atmosphere atmosphere(inDesc);
+	atmosphere.SetNumScattering(inNumScattering);
+	Bake(atmosphere);
+	const Atmosphere::View3D packed = atmosphere.GetPackedTotalInscatterTexture();
+
+	// The same table at 4x the resolution per axis, i.e. larger than the caches
+	const size_t scale = 4;
+	Atmosphere::Table3D upscaled(scale * packed.GetWidth(), scale * packed.GetHeight(), scale * packed.GetDepth());
+	for (size_t z = 0; z < upscaled.GetDepth(); ++z)
+		for (size_t y = 0; y < upscaled.GetHeight(); ++y)
+			for (size_t x = 0; x < upscaled.GetWidth(); ++x)
+				upscaled.At(x, y, z) = packed.Sample(math::Float3((x + 0.5f) / upscaled.GetWidth(), (y + 0.5f) / upscaled.GetHeight(), (z + 0.5f) / upscaled.GetDepth()));
+
+	// Random : positions up to 20 km, view and sun directions over the sphere.
+	// Coherent : the view directions of a 2048x2048 equirectangular image in scanline order, one position and sun direction.
+	const size_t image_size = 2048;
+	const size_t num_lookups = image_size * image_size;
+	std::vector<math::Float3> random_coords(num_lookups), coherent_coords(num_lookups);
+	std::uint32_t seed = 12345;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1u << 24); };
+	auto direction = [](float inCosTheta, float inPhi)
+	{
+		const float sin_theta = std::sqrt(std::max(1.0f - inCosTheta * inCosTheta, 0.0f));
+		return math::Float3(sin_theta * std::cos(inPhi), inCosTheta, sin_theta * std::sin(inPhi));
+	};
+	const math::Float3 sun_dir = math::L2Normalize(math::Float3(0.3f, 0.4f, 0.2f));
+	const math::Float3 resolution = atmosphere.GetInscatterResolution();
+	for (size_t i = 0; i < num_lookups; ++i)
+	{
+		const math::Float3 pos(0.0f, 20.0f * random(), 0.0f);
+		const math::Float3 view_dir = direction(2.0f * random() - 1.0f, 2.0f * math::PI<float> * random());
+		random_coords[i] = atmosphere::ComputeLUTCoord(pos, view_dir, direction(2.0f * random() - 1.0f, 2.0f * math::PI<float> * random()), resolution);
+
+		const float cos_theta = std::cos(math::PI<float> * ((i / image_size) + 0.5f) / float(image_size));
+		const float phi = 2.0f * math::PI<float> * ((i % image_size) + 0.5f) / float(image_size);
+		coherent_coords[i] = atmosphere::ComputeLUTCoord(math::Float3(0.0f, 1.0f, 0.0f), direction(cos_theta, phi), sun_dir, resolution);
+	}
+
+	std::printf("%zu lookups per pattern, 1 thread\n", num_lookups);
+	std::printf("%-14s %-8s %12s %20s %20s\n", "table", "layout", "memory [KB]", "random [ns/lookup]", "coherent [ns/lookup]");
+	for (const Atmosphere::View3D& table : { packed, upscaled.GetView() })
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%zux%zux%zu", table.GetWidth(), table.GetHeight(), table.GetDepth());
+		math::Float4 linear_sum(0.0f);
+		for (LookUpTableLayout layout : { LookUpTableLayout::Linear, LookUpTableLayout::Morton, LookUpTableLayout::Brick })
+		{
+			const TiledTable tiled(table, layout);
+			double elapsed_ns[2];
+			math::Float4 sum(0.0f);
+			for (int pattern = 0; pattern < 2; ++pattern)
+			{
+				const std::vector<math::Float3>& coords = pattern ? coherent_coords : random_coords;
+				auto time_start = std::chrono::high_resolution_clock::now();
+				for (const math::Float3& uvw : coords)
+					sum = sum + tiled.Sample(uvw);
+				auto time_end = std::chrono::high_resolution_clock::now();
+				elapsed_ns[pattern] = 1e3 * std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_start).count() / double(num_lookups);
+			}
+			if (layout == LookUpTableLayout::Linear)
+				linear_sum = sum;
+
+			const char* layout_name = (layout == LookUpTableLayout::Linear) ? "linear" : (layout == LookUpTableLayout::Morton) ? "morton" : "brick";
+			std::printf("%-14s %-8s %12.1f %20.2f %20.2f%s\n", name, layout_name, double(tiled.GetMemorySize()) / 1024.0, elapsed_ns[0], elapsed_ns[1],
+				(sum.x == linear_sum.x && sum.w == linear_sum.w) ? "" : " (mismatch)");
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Storage report
+//--------------------------------------------------------------------------------------
+static void RunStorageReport(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	using atmosphere::EncodedLookUpTable;
+	using atmosphere::LookUpTableEncodingError;
+	using etc::TextureFormat;
+	Atmosphere atmosphere(inDesc);
+	atmosphere.SetNumScattering(inNumScattering);
+	Bake(atmosphere);
+
+	auto print = [](const char* inTable, const char* inFormat, const EncodedLookUpTable& inEncoded, size_t inFloatSize, const LookUpTableEncodingError& inError)
+	{
+		std::printf("%-14s %-10s %12.1f %7.2f %14.2e %14.2e %14.2e %10zu   (%zu, %zu, %zu)\n", inTable, inFormat,
+			double(inEncoded.GetMemorySize()) / 1024.0, double(inFloatSize) / double(inEncoded.GetMemorySize()),
+			inError.mMaxRelativeError, inError.mMeanRelativeError, inError.mMaxAbsoluteError, inError.mNumOverflows,
+			inError.mMaxRelativeErrorTexel[0], inError.mMaxRelativeErrorTexel[1], inError.mMaxRelativeErrorTexel[2]);
+	};
+
+	// Relative errors over the channels >= 1e-3 of the largest one of the table
+	// Overflows : channels beyond the range of the format (the 1e20 optical depth of the rays hitting the ground), stored as inf
+	std::printf("%-14s %-10s %12s %7s %14s %14s %14s %10s   %s\n", "table", "format", "memory [KB]", "ratio", "max rel error", "mean rel error", "max abs error", "overflows", "worst texel");
+	const Atmosphere::View2D optical_depth = atmosphere.GetOpticalDepthTexture();
+	for (TextureFormat format : { TextureFormat::R32G32, TextureFormat::R16G16_FLOAT })
+	{
+		const EncodedLookUpTable encoded = atmosphere::EncodeLookUpTable(optical_depth, format);
+		print("optical depth", format == TextureFormat::R32G32 ? "R32G32" : "R16G16F", encoded, optical_depth.GetNumTexels() * sizeof(math::Float2),
+			atmosphere::MeasureEncodingError(optical_depth, encoded));
+	}
+	const Atmosphere::View3D tables[3] = { atmosphere.GetTotalInscatterTexture(Atmosphere::RAYLEIGH), atmosphere.GetTotalInscatterTexture(Atmosphere::MIE), atmosphere.GetPackedTotalInscatterTexture() };
+	const char* table_names[3] = { "total R", "total M", "packed" };
+	for (int i = 0; i < 3; ++i)
+	{
+		for (TextureFormat format : { TextureFormat::R16G16B16A16_FLOAT, TextureFormat::R9G9B9E5 })
+		{
+			// The packed table keeps Mie R in alpha
+			if (i == 2 && format == TextureFormat::R9G9B9E5)
+				continue;
+			const EncodedLookUpTable encoded = atmosphere::EncodeLookUpTable(tables[i], format);
+			print(table_names[i], format == TextureFormat::R9G9B9E5 ? "RGB9E5" : "RGBA16F", encoded, tables[i].GetNumTexels() * sizeof(math::Float4),
+				atmosphere::MeasureEncodingError(tables[i], encoded));
+		}
+	}
+
+	// Conversion of the packed table, repeated to get a measurable time
+	const Atmosphere::View3D packed = atmosphere.GetPackedTotalInscatterTexture();
+	const int num_repeats = 200;
+	const double num_values = double(num_repeats) * double(packed.GetNumTexels()) * 4.0;
+	std::printf("\n%-10s %22s %22s\n", "simd", "encode [Mvalues/s]", "decode [Mvalues/s]");
+	for (auto instruction_set : { atmosphere::SimdInstructionSet::Scalar, atmosphere::SimdInstructionSet::AVX2 })
+	{
+		if (!atmosphere::IsSimdInstructionSetSupported(instruction_set))
+			continue;
+		EncodedLookUpTable encoded;
+		auto time_start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < num_repeats; ++i)
+			encoded = atmosphere::EncodeLookUpTable(packed, TextureFormat::R16G16B16A16_FLOAT, instruction_set);
+		auto time_middle = std::chrono::high_resolution_clock::now();
+		Atmosphere::Table3D decoded(packed.GetWidth(), packed.GetHeight(), packed.GetDepth());
+		for (int i = 0; i < num_repeats; ++i)
+			atmosphere::DecodeLookUpTable(encoded, decoded, instruction_set);
+		auto time_end = std::chrono::high_resolution_clock::now();
+		const double encode_s = 1e-6 * std::chrono::duration_cast<std::chrono::microseconds>(time_middle - time_start).count();
+		const double decode_s = 1e-6 * std::chrono::duration_cast<std::chrono::microseconds>(time_end - time_middle).count();
+		std::printf("%-10s %22.1f %22.1f\n", instruction_set == atmosphere::SimdInstructionSet::Scalar ? "scalar" : "f16c",
+			1e-6 * num_values / encode_s, 1e-6 * num_values / decode_s);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Resolution ladder
+//--------------------------------------------------------------------------------------
+static void RunResolutionLadder(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	struct Resolution { size_t mWidth, mHeight, mDepth; };
+	auto bake = [&inDesc, inNumScattering](const Resolution& inResolution, double& outElapsedMs)
+	{
+		Atmosphere::Desc desc = inDesc;
+		desc.mCacheDirectory.clear();
+		desc.mInscatterWidth = inResolution.mWidth;
+		desc.mInscatterHeight = inResolution.mHeight;
+		desc.mInscatterDepth = inResolution.mDepth;
+		auto atmosphere = std::make_unique<Atmosphere>(desc);
+		atmosphere->SetNumScattering(inNumScattering);
+		outElapsedMs = Bake(*atmosphere);
+		return atmosphere;
+	};
+	auto get_tables = [](const Atmosphere& inAtmosphere)
+	{
+		atmosphere::SkyRadianceTables tables;
+		tables.mPackedInscatter = inAtmosphere.GetPackedTotalInscatterTexture();
+		tables.mOpticalDepth = inAtmosphere.GetOpticalDepthTexture();
+		tables.mOpticalDepthMode = inAtmosphere.GetOpticalDepthMode();
+		tables.mParams = inAtmosphere.GetKernelParameters();
+		return tables;
+	};
+
+	// The error is the one of the sky the tables render, not of the texels : each table is sampled at its own coordinates
+	// for positions up to 20 km, view directions over the sphere and the sun above the horizon
+	const size_t num_queries = size_t(1) << 16;
+	std::vector<math::Float3> positions(num_queries), view_dirs(num_queries), light_dirs(num_queries);
+	std::uint32_t seed = 12345;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1u << 24); };
+	for (size_t i = 0; i < num_queries; ++i)
+	{
+		positions[i] = math::Float3(0.0f, 20.0f * random(), 0.0f);
+		view_dirs[i] = atmosphere::SphericalFibonacci(int(i % 4096), 4096);
+		light_dirs[i] = math::L2Normalize(math::Float3(random() - 0.5f, random(), random() - 0.5f));
+	}
+	auto render = [&](const Atmosphere& inAtmosphere)
+	{
+		const atmosphere::SkyRadianceTables tables = get_tables(inAtmosphere);
+		std::vector<math::Float3> radiance(num_queries);
+		math::Float3 transmittance;
+		for (size_t i = 0; i < num_queries; ++i)
+			atmosphere::SkyRadiance(tables, positions[i], view_dirs[i], light_dirs[i], radiance[i], transmittance);
+		return radiance;
+	};
+
+	// Reference at twice the default resolution per axis
+	const Resolution reference_resolution = { 2 * TEX4D_U, 2 * TEX4D_V, 2 * TEX4D_W };
+	double reference_ms = 0.0;
+	const std::vector<math::Float3> reference = render(*bake(reference_resolution, reference_ms));
+	double max_value = 0.0;
+	for (const math::Float3& radiance : reference)
+		for (int c = 0; c < 3; ++c)
+			max_value = std::max(max_value, double(radiance[c]));
+
+	std::printf("%zu sky queries, reference %zux%zux%zu baked in %.1f [ms]\n", num_queries,
+		reference_resolution.mWidth, reference_resolution.mHeight, reference_resolution.mDepth, reference_ms);
+	std::printf("%-12s %12s %12s %15s %16s\n", "resolution", "bake [ms]", "memory [KB]", "max rel error", "mean rel error");
+	const Resolution ladder[] = { { 4, 32, 8 }, { 6, 48, 12 }, { 8, 64, 16 }, { TEX4D_U, TEX4D_V, TEX4D_W }, { 16, 128, 32 } };
+	for (const Resolution& resolution : ladder)
+	{
+		double elapsed_ms = 0.0;
+		const std::unique_ptr<Atmosphere> atmosphere = bake(resolution, elapsed_ms);
+		const std::vector<math::Float3> radiance = render(*atmosphere);
+
+		// Relative error over the radiances brighter than 1e-3 of the brightest one, as CompareInscatter()
+		double max_error = 0.0, sum_error = 0.0;
+		size_t num_errors = 0;
+		for (size_t i = 0; i < num_queries; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				const double value = reference[i][c];
+				if (value <= 1e-3 * max_value)
+					continue;
+				const double error = std::abs(double(radiance[i][c]) - value) / value;
+				max_error = std::max(max_error, error);
+				sum_error += error;
+				++num_errors;
+			}
+		}
+
+		// Packed table and total inscatter tables, the ones the renderer keeps
+		const size_t memory = 3 * atmosphere->GetPackedTotalInscatterTexture().GetNumTexels() * sizeof(math::Float4);
+		char name[32];
+		std::snprintf(name, sizeof(name), "%zux%zux%zu", resolution.mWidth, resolution.mHeight, resolution.mDepth);
+		std::printf("%-12s %12.1f %12.1f %14.3f%% %15.3f%%\n", name, elapsed_ms, double(memory) / 1024.0,
+			100.0 * max_error, 100.0 * sum_error / double(std::max<size_t>(num_errors, 1)));
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// 4d inscatter with the view-sun azimuth
+//--------------------------------------------------------------------------------------
+static void RunAzimuthReport(const Atmosphere::Desc& inDesc)
+{
+	// The 4d table only changes the single scattering, the higher orders come from the 3d tables : the bakes stop at the
+	// single scattering and both tables are compared with SingleScattering() along the exact rays, with the sun direction
+	// of every sample. Sky directions only, the ground reflection of the 3d and 4d tables is left out.
+	const size_t num_queries = size_t(1) << 14;
+	struct Query { math::Float3 mPosition, mViewDir, mLightDir; };
+	auto make_queries = [num_queries](float inMinCosSunZenith, float inMaxCosSunZenith)
+	{
+		std::vector<Query> queries;
+		std::uint32_t seed = 12345;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1u << 24); };
+		for (size_t attempt = 0; queries.size() < num_queries; ++attempt)
+		{
+			Query query;
+			query.mPosition = math::Float3(0.0f, 10.0f * random(), 0.0f);
+			query.mViewDir = atmosphere::SphericalFibonacci(int(attempt % 4096), 4096);
+			const float cos_sun_zenith = inMinCosSunZenith + (inMaxCosSunZenith - inMinCosSunZenith) * random();
+			const float sun_azimuth = 2.0f * math::PI<float> * random();
+			const float sin_sun_zenith = std::sqrt(1.0f - cos_sun_zenith * cos_sun_zenith);
+			query.mLightDir = math::Float3(sin_sun_zenith * std::cos(sun_azimuth), cos_sun_zenith, sin_sun_zenith * std::sin(sun_azimuth));
+			const math::Float4 distances = atmosphere::RayDoubleSphereIntersect(query.mPosition - atmosphere::EarthCenter(), query.mViewDir,
+				math::Float2(EARTH_RADIUS, ATM_TOP_RADIUS));
+			if (distances.x <= 0.0f && distances.w > 0.0f)
+				queries.push_back(query);
+		}
+		return queries;
+	};
+
+	struct Band { const char* mName; std::vector<Query> mQueries; std::vector<math::Float3> mReference[2]; };
+	Band bands[] = { { "low sun : zenith 78..94 deg", make_queries(-0.07f, 0.2f) }, { "high sun : zenith 0..60 deg", make_queries(0.5f, 1.0f) } };
+
+	Atmosphere::Desc desc = inDesc;
+	desc.mCacheDirectory.clear();
+	desc.mInscatter4dSlices = 0;
+	Atmosphere atmosphere_3d(desc);
+	atmosphere_3d.SetNumScattering(1);
+	const double bake_3d_ms = Bake(atmosphere_3d);
+	const PrecomputedSctrParams params = atmosphere_3d.GetKernelParameters();
+	for (Band& band : bands)
+	{
+		for (auto& reference : band.mReference)
+			reference.resize(band.mQueries.size());
+		for (size_t i = 0; i < band.mQueries.size(); ++i)
+		{
+			const Query& query = band.mQueries[i];
+			const math::Float4 distances = atmosphere::RayDoubleSphereIntersect(query.mPosition - atmosphere::EarthCenter(), query.mViewDir,
+				math::Float2(EARTH_RADIUS, ATM_TOP_RADIUS));
+			math::Float3 transmittance;
+			atmosphere::SingleScattering(query.mPosition, query.mPosition + query.mViewDir * distances.w, query.mLightDir, params,
+				atmosphere_3d.GetOpticalDepthTexture(), atmosphere_3d.GetOpticalDepthMode(), band.mReference[0][i], band.mReference[1][i], transmittance, INSCATTER_INTEGRAL_STEPS);
+		}
+	}
+
+	// Relative error of the channels the packed tables hold exactly, Rayleigh rgb or Mie red,
+	// over the values brighter than 1e-3 of the brightest one
+	using LookUp = std::function<void(const Query&, math::Float3&, math::Float3&)>;
+	auto measure = [&](const Band& inBand, const LookUp& inLookUp, int inTable, double& outMeanError, double& outP95Error)
+	{
+		const int num_channels = (inTable == 0) ? 3 : 1;
+		double max_value = 0.0;
+		for (const math::Float3& value : inBand.mReference[inTable])
+			for (int c = 0; c < num_channels; ++c)
+				max_value = std::max(max_value, double(value[c]));
+		std::vector<double> errors;
+		for (size_t i = 0; i < inBand.mQueries.size(); ++i)
+		{
+			math::Float3 inscatter[2];
+			inLookUp(inBand.mQueries[i], inscatter[0], inscatter[1]);
+			for (int c = 0; c < num_channels; ++c)
+			{
+				const double value = inBand.mReference[inTable][i][c];
+				if (value > 1e-3 * max_value)
+					errors.push_back(std::abs(double(inscatter[inTable][c]) - value) / value);
+			}
+		}
+		std::sort(errors.begin(), errors.end());
+		double sum = 0.0;
+		for (double error : errors)
+			sum += error;
+		outMeanError = errors.empty() ? 0.0 : sum / double(errors.size());
+		outP95Error = errors.empty() ? 0.0 : errors[errors.size() * 95 / 100];
+	};
+
+	std::printf("%zu sky queries per band, single scattering, mean / 95th percentile relative error\n", num_queries);
+	for (const Band& band : bands)
+		std::printf("\t%s\n", band.mName);
+	std::printf("%-14s %10s %12s %20s %20s %20s %20s\n", "table", "bake [ms]", "memory [KB]", "low sun rayleigh", "low sun mie", "high sun rayleigh", "high sun mie");
+	auto print = [&](const char* inName, double inBakeMs, size_t inMemory, const LookUp& inLookUp)
+	{
+		std::printf("%-14s %10.1f %12.1f", inName, inBakeMs, double(inMemory) / 1024.0);
+		for (const Band& band : bands)
+		{
+			for (int table = 0; table < 2; ++table)
+			{
+				double mean_error, p95_error;
+				measure(band, inLookUp, table, mean_error, p95_error);
+				std::printf(" %9.3f%% / %6.2f%%", 100.0 * mean_error, 100.0 * p95_error);
+			}
+		}
+		std::printf("\n");
+	};
+
+	const Atmosphere::View3D packed_3d = atmosphere_3d.GetPackedTotalInscatterTexture();
+	char name_3d[32];
+	std::snprintf(name_3d, sizeof(name_3d), "%zux%zux%zu", desc.mInscatterWidth, desc.mInscatterHeight, desc.mInscatterDepth);
+	print(name_3d, bake_3d_ms, packed_3d.GetNumTexels() * sizeof(math::Float4), [&](const Query& inQuery, math::Float3& outInscatterR, math::Float3& outInscatterM)
+	{
+		atmosphere::LookUpPrecomputedScatteringPacked(inQuery.mPosition, inQuery.mViewDir, inQuery.mLightDir, params.mRayleighSctrCoeff, packed_3d, outInscatterR, outInscatterM);
+	});
+
+	// The azimuth slices, then twice the sun zenith resolution : what is left of the error at low sun is not in the azimuth
+	struct Resolution { size_t mWidth, mHeight, mDepth, mSlices; };
+	const Resolution resolutions[] = {
+		{ desc.mInscatterWidth, desc.mInscatterHeight, desc.mInscatterDepth, 4 },
+		{ desc.mInscatterWidth, desc.mInscatterHeight, desc.mInscatterDepth, 8 },
+		{ desc.mInscatterWidth, desc.mInscatterHeight, desc.mInscatterDepth, 16 },
+		{ 2 * desc.mInscatterWidth, desc.mInscatterHeight, desc.mInscatterDepth, 8 } };
+	for (const Resolution& resolution : resolutions)
+	{
+		desc.mInscatter4dWidth = resolution.mWidth;
+		desc.mInscatter4dHeight = resolution.mHeight;
+		desc.mInscatter4dDepth = resolution.mDepth;
+		desc.mInscatter4dSlices = resolution.mSlices;
+		Atmosphere atmosphere_4d(desc);
+		atmosphere_4d.SetNumScattering(1);
+		const double bake_ms = Bake(atmosphere_4d);
+		const atmosphere::LookUpTableView4D<math::Float4> packed_4d = atmosphere_4d.GetPackedInscatter4dTexture();
+		char name[32];
+		std::snprintf(name, sizeof(name), "%zux%zux%zux%zu", packed_4d.GetWidth(), packed_4d.GetHeight(), packed_4d.GetDepth(), packed_4d.GetNumSlices());
+		print(name, bake_ms, packed_4d.GetNumTexels() * sizeof(math::Float4), [&](const Query& inQuery, math::Float3& outInscatterR, math::Float3& outInscatterM)
+		{
+			atmosphere::LookUpPrecomputedScatteringPacked4D(inQuery.mPosition, inQuery.mViewDir, inQuery.mLightDir, params.mRayleighSctrCoeff, packed_4d, outInscatterR, outInscatterM);
+		});
+	}
+}
+
+static void RunAdaptiveReport(const Atmosphere::Desc& inDesc, std::uint32_t inNumScattering)
+{
+	// Both kinds of tables are resampled from the same dense bake and measured at its texels : the error is the one of
+	// the grid alone, not of the bake
+	Atmosphere::Desc desc = inDesc;
+	desc.mCacheDirectory.clear();
+	desc.mInscatterWidth *= 2;
+	desc.mInscatterHeight *= 2;
+	desc.mInscatterDepth *= 2;
+	Atmosphere dense(desc);
+	dense.SetNumScattering(inNumScattering);
+	const double bake_ms = Bake(dense);
+	const Atmosphere::View3D reference = dense.GetPackedTotalInscatterTexture();
+	std::printf("reference %zux%zux%zu, %u scattering orders, baked in %.1f ms\n", reference.GetWidth(), reference.GetHeight(), reference.GetDepth(), inNumScattering, bake_ms);
+	std::printf("max / mean relative error over the reference texels, worst of the 4 packed channels, floor 1e-3 of the largest value\n");
+	std::printf("%-22s %10s %12s %10s %12s %12s\n", "table", "texels", "memory [KB]", "build [ms]", "max error", "mean error");
+	auto print = [&reference](const char* inName, const atmosphere::AdaptiveInscatterTable& inTable, double inBuildMs)
+	{
+		const atmosphere::AdaptiveInscatterError error = atmosphere::MeasureAdaptiveInscatterError(inTable, reference);
+		std::printf("%-22s %10zu %12.1f %10.1f %11.3f%% %11.3f%%\n", inName, inTable.GetNumTexels(), double(inTable.GetMemorySize()) / 1024.0, inBuildMs,
+			100.0 * error.mMaxRelativeError, 100.0 * error.mMeanRelativeError);
+	};
+
+	// Uniform grids from half to all of the reference resolution
+	for (size_t scale : { 2, 3, 4, 6, 8 })
+	{
+		const size_t width = std::max(inDesc.mInscatterWidth * scale / 4, size_t(2));
+		const size_t height = std::max(inDesc.mInscatterHeight * scale / 8 * 2, size_t(4));
+		const size_t depth = std::max(inDesc.mInscatterDepth * scale / 4, size_t(2));
+		char name[80];	// three size_t of 20 digits
+		std::snprintf(name, sizeof(name), "uniform %zux%zux%zu", width, height, depth);
+		print(name, atmosphere::MakeUniformInscatterTable(reference, width, height, depth), 0.0);
+	}
+
+	for (float max_error : { 0.1f, 0.05f, 0.02f, 0.01f })
+	{
+		atmosphere::AdaptiveInscatterSettings settings;
+		settings.mMaxRelativeError = max_error;
+		const auto start = std::chrono::high_resolution_clock::now();
+		const atmosphere::AdaptiveInscatterTable table = atmosphere::BuildAdaptiveInscatterTable(reference, settings);
+		const double build_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		char name[32];
+		std::snprintf(name, sizeof(name), "adaptive %g%%", 100.0 * max_error);
+		print(name, table, build_ms);
+		const size_t num_axes = atmosphere::AdaptiveInscatterTable::NUM_SLICE_AXES;
+		size_t min_knots[num_axes] = { SIZE_MAX, SIZE_MAX, SIZE_MAX }, max_knots[num_axes] = {};
+		for (size_t slice = 0; slice < table.GetNumSlices(); ++slice)
+		{
+			for (size_t axis = 0; axis < num_axes; ++axis)
+			{
+				const size_t num_knots = table.GetSliceAxis(slice, atmosphere::AdaptiveInscatterTable::SliceAxis(axis)).GetNumKnots();
+				min_knots[axis] = std::min(min_knots[axis], num_knots);
+				max_knots[axis] = std::max(max_knots[axis], num_knots);
+			}
+		}
+		std::printf("%-22s %zu sun zenith slices, knots per slice : view %zu..%zu below + %zu..%zu above, height %zu..%zu\n", "", table.GetNumSlices(),
+			min_knots[0], max_knots[0], min_knots[1], max_knots[1], min_knots[2], max_knots[2]);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Atmosphere::Desc desc;
+	std::uint32_t num_scattering = 6;
+	bool run_scaling = false;
+	bool run_optical_depth_report = false;
+	bool run_integration_report = false;
+	bool run_gather_report = false;
+	bool run_incremental_report = false;
+	bool run_atlas_report = false;
+	bool run_sky_query_benchmark = false;
+	bool run_layout_benchmark = false;
+	bool run_storage_report = false;
+	bool run_resolution_ladder = false;
+	bool run_azimuth_report = false;
+	bool run_adaptive_report = false;
+	const char* timings_path = nullptr;
+	const char* render_sky_directory = nullptr;
+	const char* sequence_directory = nullptr;
+	size_t num_sequence_frames = 0;
+	const char* reference_directory = nullptr;
+	std::uint32_t num_reference_samples = 256;
+	size_t reference_size[2] = { 128, 64 };
+	size_t render_size[2] = { 1280, 720 };
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+			desc.mNumThreads = static_cast<std::uint32_t>(std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--scattering") && i + 1 < argc)
+			num_scattering = static_cast<std::uint32_t>(std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--tile") && i + 1 < argc
+			&& std::sscanf(argv[++i], "%zux%zux%zu", &desc.mTileWidth, &desc.mTileHeight, &desc.mTileDepth) == 3)
+			continue;
+		else if (!std::strcmp(argv[i], "--simd") && i + 1 < argc && ParseInstructionSet(argv[++i], desc.mInstructionSet))
+			continue;
+		else if (!std::strcmp(argv[i], "--optical-depth") && i + 1 < argc && ParseOpticalDepthMode(argv[++i], desc.mOpticalDepthMode))
+			continue;
+		else if (!std::strcmp(argv[i], "--tolerance") && i + 1 < argc)
+			desc.mIntegrationTolerance = static_cast<float>(std::atof(argv[++i]));
+		else if (!std::strcmp(argv[i], "--convergence") && i + 1 < argc)
+		{
+			desc.mConvergenceThreshold = static_cast<float>(std::atof(argv[++i]));
+			if (i + 1 < argc && ParseConvergenceMetric(argv[i + 1], desc.mConvergenceMetric))
+				++i;
+		}
+		else if (!std::strcmp(argv[i], "--gather") && i + 1 < argc && ParseGatherQuadrature(argv[++i], desc.mGatherQuadrature))
+		{
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+				desc.mNumGatherSamples = static_cast<std::uint32_t>(std::atoi(argv[++i]));
+		}
+		else if (!std::strcmp(argv[i], "--resolution") && i + 1 < argc
+			&& std::sscanf(argv[++i], "%zux%zux%zu", &desc.mInscatterWidth, &desc.mInscatterHeight, &desc.mInscatterDepth) == 3
+			&& desc.mInscatterWidth >= 2 && desc.mInscatterHeight >= 4 && desc.mInscatterHeight % 2 == 0 && desc.mInscatterDepth >= 2)
+			;
+		else if (!std::strcmp(argv[i], "--inscatter-4d") && i + 1 < argc
+			&& std::sscanf(argv[++i], "%zux%zux%zux%zu", &desc.mInscatter4dWidth, &desc.mInscatter4dHeight, &desc.mInscatter4dDepth, &desc.mInscatter4dSlices) == 4
+			&& desc.mInscatter4dWidth >= 2 && desc.mInscatter4dHeight >= 4 && desc.mInscatter4dHeight % 2 == 0 && desc.mInscatter4dDepth >= 2 && desc.mInscatter4dSlices >= 2)
+			;
+		else if (!std::strcmp(argv[i], "--cache") && i + 1 < argc)
+			desc.mCacheDirectory = argv[++i];
+		else if (!std::strcmp(argv[i], "--timings") && i + 1 < argc)
+			timings_path = argv[++i];
+		else if (!std::strcmp(argv[i], "--scaling"))
+			run_scaling = true;
+		else if (!std::strcmp(argv[i], "--optical-depth-report"))
+			run_optical_depth_report = true;
+		else if (!std::strcmp(argv[i], "--integration-report"))
+			run_integration_report = true;
+		else if (!std::strcmp(argv[i], "--gather-report"))
+			run_gather_report = true;
+		else if (!std::strcmp(argv[i], "--incremental-report"))
+			run_incremental_report = true;
+		else if (!std::strcmp(argv[i], "--atlas-report"))
+			run_atlas_report = true;
+		else if (!std::strcmp(argv[i], "--sky-query-benchmark"))
+			run_sky_query_benchmark = true;
+		else if (!std::strcmp(argv[i], "--layout-benchmark"))
+			run_layout_benchmark = true;
+		else if (!std::strcmp(argv[i], "--storage-report"))
+			run_storage_report = true;
+		else if (!std::strcmp(argv[i], "--resolution-ladder"))
+			run_resolution_ladder = true;
+		else if (!std::strcmp(argv[i], "--azimuth-report"))
+			run_azimuth_report = true;
+		else if (!std::strcmp(argv[i], "--adaptive-report"))
+			run_adaptive_report = true;
+		else if (!std::strcmp(argv[i], "--render-sky") && i + 1 < argc)
+		{
+			render_sky_directory = argv[++i];
+			if (i + 1 < argc && std::sscanf(argv[i + 1], "%zux%zu", &render_size[0], &render_size[1]) == 2)
+				++i;
+		}
+		else if (!std::strcmp(argv[i], "--sequence") && i + 2 < argc && std::atoi(argv[i + 2]) > 0)
+		{
+			sequence_directory = argv[++i];
+			num_sequence_frames = static_cast<size_t>(std::atoi(argv[++i]));
+			if (i + 1 < argc && std::sscanf(argv[i + 1], "%zux%zu", &render_size[0], &render_size[1]) == 2)
+				++i;
+		}
+		else if (!std::strcmp(argv[i], "--reference") && i + 1 < argc)
+		{
+			reference_directory = argv[++i];
+			if (i + 1 < argc && !std::strchr(argv[i + 1], 'x') && std::atoi(argv[i + 1]) > 0)
+				num_reference_samples = static_cast<std::uint32_t>(std::atoi(argv[++i]));
+			if (i + 1 < argc && std::sscanf(argv[i + 1], "%zux%zu", &reference_size[0], &reference_size[1]) == 2)
+				++i;
+		}
+		else
+		{
+			std::cout << "Usage: " << argv[0] << " [--threads N] [--scattering N] [--tile WxHxD] [--simd auto|scalar|avx2|avx512] [--optical-depth table|analytic] [--tolerance T] [--convergence T [max|mean]] [--gather random|fibonacci [N]] [--resolution UxVxW] [--inscatter-4d UxVxWxQ] [--cache DIR] [--timings FILE]"
+				<< " [--scaling] [--optical-depth-report] [--integration-report] [--gather-report] [--incremental-report] [--atlas-report] [--sky-query-benchmark] [--layout-benchmark] [--storage-report] [--resolution-ladder] [--azimuth-report] [--adaptive-report]"
+				<< " [--render-sky DIR [WxH]] [--sequence DIR N [WxH]] [--reference DIR [SPP] [WxH]]" << std::endl;
+			return -1;
+		}
+	}
+
+	if (run_scaling)
+	{
+		RunScalingBenchmark(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_optical_depth_report)
+	{
+		RunOpticalDepthReport(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_integration_report)
+	{
+		RunIntegrationReport(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_gather_report)
+	{
+		RunGatherReport(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_incremental_report)
+	{
+		RunIncrementalReport(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_atlas_report)
+	{
+		RunAtlasReport(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_sky_query_benchmark)
+	{
+		RunSkyQueryBenchmark(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_layout_benchmark)
+	{
+		RunLayoutBenchmark(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_storage_report)
+	{
+		RunStorageReport(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_resolution_ladder)
+	{
+		RunResolutionLadder(desc, num_scattering);
+		return 0;
+	}
+
+	if (run_azimuth_report)
+	{
+		RunAzimuthReport(desc);
+		return 0;
+	}
+
+	if (run_adaptive_report)
+	{
+		RunAdaptiveReport(desc, num_scattering);
+		return 0;
+	}
+
+	if (render_sky_directory)
+		return RunSkyRender(desc, num_scattering, render_sky_directory, render_size[0], render_size[1]) ? 0 : -1;
+
+	if (sequence_directory)
+		return RunSkySequence(desc, num_scattering, sequence_directory, num_sequence_frames, render_size[0], render_size[1]) ? 0 : -1;
+
+	if (reference_directory)
+		return RunSkyReference(desc, num_scattering, reference_directory, num_reference_samples, reference_size[0], reference_size[1]) ? 0 : -1;
+
+	Atmosphere atmosphere(desc);
+	atmosphere.SetNumScattering(num_scattering);
+	const double elapsed_ms = Bake(atmosphere);
+
+	const Atmosphere::View3D packed = atmosphere.GetPackedTotalInscatterTexture();
+	std::cout << "LUT " << packed.GetWidth() << "x" << packed.GetHeight() << "x" << packed.GetDepth()
+		<< ", " << atmosphere.GetNumScattering() << " scattering orders, "
+		<< atmosphere.GetNumThreads() << " threads, " << atmosphere::GetSimdInstructionSetName(atmosphere.GetInstructionSet()) << " : " << elapsed_ms << " [ms]"
+		<< (atmosphere.IsLoadedFromCache() ? " (cache hit)" : "") << std::endl;
+	if (atmosphere.HasInscatter4d())
+	{
+		const atmosphere::LookUpTableView4D<math::Float4> packed_4d = atmosphere.GetPackedInscatter4dTexture();
+		std::printf("4d LUT %zux%zux%zux%zu : %.1f [KB]\n", packed_4d.GetWidth(), packed_4d.GetHeight(), packed_4d.GetDepth(), packed_4d.GetNumSlices(),
+			double(packed_4d.GetNumTexels() * sizeof(math::Float4)) / 1024.0);
+	}
+	if (!atmosphere.IsLoadedFromCache())
+	{
+		PrintIntegrationStats(atmosphere);
+		PrintBakeTimings(atmosphere);
+	}
+
+	std::printf("Scattering orders : %u of %u computed", atmosphere.GetNumScatteringComputed(), atmosphere.GetNumScattering());
+	const std::vector<float>& increments = atmosphere.GetScatteringIncrements();
+	for (size_t i = 0; i < increments.size(); ++i)
+		std::printf("%s order %zu +%.2e", (i == 0) ? ", increments :" : ",", i + 2, increments[i]);
+	std::printf("\n");
+
+	if (timings_path && !atmosphere::WriteJson(timings_path, atmosphere.GetBakeTimings()))
+	{
+		std::cout << "Cannot write " << timings_path << std::endl;
+		return -1;
+	}
+	return 0;
+}
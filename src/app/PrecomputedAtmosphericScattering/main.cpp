@@ -3,63 +3,29 @@
 //--------------------------------------------------------------------------------------
 #include <iostream>
 #include <memory>
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <thread>
 #include <src/lib/math/Math.hpp>
 #include <src/lib/window/Window.hpp>
 #include <src/lib/window/Log.hpp>
 #include <src/lib/etc/EventHandler.hpp>
 #include <src/lib/gpu/Render.hpp>
 #include <src/lib/gpu/FullScreenTriangle.hpp>
+#include <src/lib/gpu/TextureIO.hpp>
 #include <src/thirdparty/imgui/imgui/imgui.h>
 #include <src/thirdparty/imgui/imgui/examples/directx11_example/imgui_impl_dx11.h>
+#include <src/lib/atmosphere/AsyncPrecomputedAtmosphericScattering.hpp>
+#include <src/lib/atmosphere/BakeTimings.hpp>
+#include <src/lib/atmosphere/LookUpTableAtlas.hpp>
+#include <src/lib/atmosphere/LookUpTableCache.hpp>
+#include <src/lib/atmosphere/LookUpTableEncoding.hpp>
+#include <src/lib/atmosphere/Planet.hpp>
 #include <shader/atmosphere/AtmosphereConstants.h>
 #include "InputEvent.h"
 #include "Camera.h"
 
-/*
-	Calculate the scattering coefficients[Yusov13]
-	@return scattering coefficients (R, G, B)  [10^{-6}/m]
-*/
-math::Float3 ComputeRayleighScatteringCoefficients()
-{
-	// For details, see "A practical Analytic Model for Daylight" by Preetham & Hoffman, p.23
-
-	// Wave lengths
-	// [BN08] follows [REK04] and gives the following values for Rayleigh scattering coefficients:
-	// RayleighBeta(lambda = (680nm, 550nm, 440nm) ) = (5.8, 13.5, 33.1)e-6
-	static const double dWaveLengths[] =
-	{
-		680e-9,     // red
-		550e-9,     // green
-		440e-9      // blue
-	};
-
-	math::Float3 out_coeff;
-
-	// Calculate angular and total scattering coefficients for Rayleigh scattering:
-	{
-		double n = 1.0003;    // - Refractive index of air in the visible spectrum
-		double N = 2.545e+25; // - Number of molecules per unit volume
-		double Pn = 0.035;    // - Depolarization factor for air which expresses corrections 
-							  //   due to anisotropy of air molecules
-
-		double dRayleighConst = 8.0*math::PI<double>*math::PI<double>*math::PI<double> * (n*n - 1.0) * (n*n - 1.0) / (3.0 * N) * (6.0 + 3.0*Pn) / (6.0 - 7.0*Pn);
-		for (int i = 0; i < 3; ++i)
-		{
-			double dSctrCoeff;
-			{
-				double Lambda2 = dWaveLengths[i] * dWaveLengths[i];
-				double Lambda4 = Lambda2 * Lambda2;
-				dSctrCoeff = dRayleighConst / Lambda4;
-				// Total Rayleigh scattering coefficient is the integral of angular scattering coefficient in all directions
-				out_coeff[i] = static_cast<float>(dSctrCoeff);
-			}
-		}
-		// Air molecules do not absorb light, so extinction coefficient is only caused by out-scattering
-	}
-	return out_coeff;
-}
-
 //--------------------------------------------------------------------------------------------
 // Utility class for full screen triangle
 //--------------------------------------------------------------------------------------------
@@ -120,6 +86,7 @@ struct PrecomputedAtmosphericScattering
 		BUF_ACCUMULATE_INSCATTER,
 		BUF_TOTAL_INSCATTER,
 		BUF_PACK_INSCATTER,
+		BUF_IRRADIANCE,
 		NUM_BUFFERS,
 	};
 
@@ -134,40 +101,47 @@ struct PrecomputedAtmosphericScattering
 		SamplerDesc mSamplerLinearClampDesc;
 		BlendStateDesc	mNoBlendDesc;
 		BlendStateDesc	mAddBlendDesc;
+		BlendStateDesc	mAddIrradianceBlendDesc;
+		std::string	mCacheDirectory = "cache/atmosphere";	// Empty = always bake on the GPU
+		atmosphere::OpticalDepthMode	mOpticalDepthMode = atmosphere::OpticalDepthMode::Table;	// Analytic = Chapman function instead of the optical depth texture
+		atmosphere::GatherQuadrature	mGatherQuadrature = atmosphere::GatherQuadrature::Random;	// SphericalFibonacci = mNumGatherSamples fixed directions
+		std::uint32_t	mNumGatherSamples = 64;
 		Desc()
 		{
 			mSamplerLinearClampDesc.mBoundaryCondition = SamplerBoundaryCondition::CLAMP;
 			mAddBlendDesc.mBlendType = BlendType::ADDITIVE;
+			mAddBlendDesc.mFirstBlendedTarget = 2;	// MultipleScatteringPS.hlsl : order n, then added to the totals
+			mAddIrradianceBlendDesc.mBlendType = BlendType::ADDITIVE;	// IrradiancePS.hlsl : order n added to the previous orders
 			mNoBlendDesc.mBlendType = BlendType::NONE;
 
 			mTextureDesc[BUF_OPTICAL_DEPTH].mHeight = 512;
 			mTextureDesc[BUF_OPTICAL_DEPTH].mWidth = 512;
 			mTextureDesc[BUF_OPTICAL_DEPTH].mFormat = TextureFormat::R32G32;
 
-			mTextureDesc[BUF_SINGLE_SCATTERING].mWidth = TEX4D_U;
-			mTextureDesc[BUF_SINGLE_SCATTERING].mHeight = TEX4D_V;
-			mTextureDesc[BUF_SINGLE_SCATTERING].mDepth = TEX4D_W;
+			mTextureDesc[BUF_IRRADIANCE].mWidth = IRRADIANCE_U;
+			mTextureDesc[BUF_IRRADIANCE].mHeight = IRRADIANCE_V;
+			mTextureDesc[BUF_IRRADIANCE].mFormat = TextureFormat::R32G32B32A32;
 
-			mTextureDesc[BUF_GATHER_INSCATTER].mWidth = TEX4D_U;
-			mTextureDesc[BUF_GATHER_INSCATTER].mHeight = TEX4D_V;
-			mTextureDesc[BUF_GATHER_INSCATTER].mDepth = TEX4D_W;
+			SetInscatterResolution(TEX4D_U, TEX4D_V, TEX4D_W);
 
-			mTextureDesc[BUF_MULTIPLE_SCATTERING].mWidth = TEX4D_U;
-			mTextureDesc[BUF_MULTIPLE_SCATTERING].mHeight = TEX4D_V;
-			mTextureDesc[BUF_MULTIPLE_SCATTERING].mDepth = TEX4D_W;
-
-			mTextureDesc[BUF_ACCUMULATE_INSCATTER].mWidth = TEX4D_U;
-			mTextureDesc[BUF_ACCUMULATE_INSCATTER].mHeight = TEX4D_V;
-			mTextureDesc[BUF_ACCUMULATE_INSCATTER].mDepth = TEX4D_W;
-
-			mTextureDesc[BUF_TOTAL_INSCATTER].mWidth = TEX4D_U;
-			mTextureDesc[BUF_TOTAL_INSCATTER].mHeight = TEX4D_V;
-			mTextureDesc[BUF_TOTAL_INSCATTER].mDepth = TEX4D_W;
+			// The finished tables may be stored in R16G16B16A16_FLOAT (half the memory, ~5e-4 relative error, see LookUpTableEncoding.hpp).
+			// The optical depth stays R32G32 : its 1e20 for the rays hitting the ground overflows a half.
+		}
 
-			mTextureDesc[BUF_PACK_INSCATTER].mWidth = TEX4D_U;
-			mTextureDesc[BUF_PACK_INSCATTER].mHeight = TEX4D_V;
-			mTextureDesc[BUF_PACK_INSCATTER].mDepth = TEX4D_W;
+		// Resolution of every 3d table : height, view zenith (even, the horizon splits it in half), sun zenith.
+		// The shaders read it from their parameters, see UpdateShaderParameters().
+		void SetInscatterResolution(size_t inWidth, size_t inHeight, size_t inDepth)
+		{
+			assert(inWidth >= 2 && inHeight >= 4 && inHeight % 2 == 0 && inDepth >= 2);
+			for (BufferType buffer : { BUF_SINGLE_SCATTERING, BUF_GATHER_INSCATTER, BUF_MULTIPLE_SCATTERING, BUF_ACCUMULATE_INSCATTER, BUF_TOTAL_INSCATTER, BUF_PACK_INSCATTER })
+			{
+				mTextureDesc[buffer].mWidth = inWidth;
+				mTextureDesc[buffer].mHeight = inHeight;
+				mTextureDesc[buffer].mDepth = inDepth;
+			}
 		}
+
+		const TextureDesc& GetInscatterTextureDesc() const { return mTextureDesc[BUF_PACK_INSCATTER]; }
 	};
 
 	PrecomputedAtmosphericScattering(Device& inDevice, const Desc& inDesc)
@@ -175,12 +149,15 @@ struct PrecomputedAtmosphericScattering
 		, mDesc(inDesc)
 		, mTotalInscatter(inDevice, inDesc.mTextureDesc[BUF_TOTAL_INSCATTER])
 		, mPackInscatter(inDevice, inDesc.mTextureDesc[BUF_PACK_INSCATTER])
+		, mIrradiance(inDevice, inDesc.mTextureDesc[BUF_IRRADIANCE])
 		, mSamplerLinearClamp(inDevice, inDesc.mSamplerLinearClampDesc)
 		, mNoBlend(inDevice, inDesc.mNoBlendDesc)
 		, mAddBlend(inDevice, inDesc.mAddBlendDesc)
+		, mAddIrradianceBlend(inDevice, inDesc.mAddIrradianceBlendDesc)
+		, mGpuTimer(inDevice)
 	{
 		{
-			// single scattering + multiple scattering		
+			// single scattering, the start of the accumulation of the orders
 			ScreenUpdateContext& ctx = mTotalInscatter.GetUpdateContext();
 			ctx.mPixelShader = &mPixelShaders[BUF_TOTAL_INSCATTER];
 			ctx.mVertexShader = &mVertexShader;
@@ -189,7 +166,7 @@ struct PrecomputedAtmosphericScattering
 		}
 
 		{
-			// single scattering + multiple scattering with packing into a single texture
+			// total inscatter packed into a single texture
 			ScreenUpdateContext& ctx = mPackInscatter.GetUpdateContext();
 			ctx.mPixelShader = &mPixelShaders[BUF_PACK_INSCATTER];
 			ctx.mVertexShader = &mVertexShader;
@@ -197,6 +174,18 @@ struct PrecomputedAtmosphericScattering
 			ctx.mTextureSamplers[0] = &mSamplerLinearClamp;
 		}
 
+		{
+			// sky irradiance of an order, the single scattering overwrites the table and the next orders are added
+			ScreenUpdateContext& ctx = mIrradiance.GetUpdateContext();
+			ctx.mPixelShader = &mPixelShaders[BUF_IRRADIANCE];
+			ctx.mVertexShader = &mVertexShader;
+			ctx.mBlendState = &mNoBlend;
+			ctx.mTextureSamplers[0] = &mSamplerLinearClamp;
+		}
+
+		if (!inDesc.mCacheDirectory.empty())
+			mCache = std::make_unique<atmosphere::LookUpTableCache>(inDesc.mCacheDirectory);
+
 		ResetScatteringParameters(Planet::Earth);
 		CompileShaders();
 		CreateBuffers();
@@ -207,8 +196,8 @@ struct PrecomputedAtmosphericScattering
 		mOpticalDepth = nullptr;
 		mSingleScattering = nullptr;
 		mInscatterGathering = nullptr;
-		mMultipleScattering = nullptr;
 		mAccumulateInscatter = nullptr;
+		mMultipleScattering = nullptr;
 	}
 
 	void CreateBuffers()
@@ -247,48 +236,61 @@ struct PrecomputedAtmosphericScattering
 			ctx.mTextureSamplers[0] = &mSamplerLinearClamp;
 		}
 		{
-			// multiple scattering
+			// multiple scattering of an order, written over the previous order and added to the totals in the same pass
 			mMultipleScattering = std::make_unique< ScreenBuffer3D<2> >(mDevice, mDesc.mTextureDesc[BUF_MULTIPLE_SCATTERING]);
-			ScreenUpdateContext& ctx = mMultipleScattering->GetUpdateContext();
-			ctx.mPixelShader = &mPixelShaders[BUF_MULTIPLE_SCATTERING];
-			ctx.mVertexShader = &mVertexShader;
-			ctx.mBlendState = &mNoBlend;
-			ctx.mTextureSamplers[0] = &mSamplerLinearClamp;
-		}
-		{
-			// accumulate multiple scattering
-			mAccumulateInscatter = std::make_unique< ScreenBuffer3D<2> >(mDevice, mDesc.mTextureDesc[BUF_ACCUMULATE_INSCATTER]);
+			mAccumulateInscatter = std::make_unique< ScreenBuffer3D<4> >(mDevice, std::array<const Texture3D*, 4>{
+				&mMultipleScattering->GetTexture(RAYLEIGH), &mMultipleScattering->GetTexture(MIE), &mTotalInscatter.GetTexture(RAYLEIGH), &mTotalInscatter.GetTexture(MIE) });
 			ScreenUpdateContext& ctx = mAccumulateInscatter->GetUpdateContext();
-			ctx.mPixelShader = &mPixelShaders[BUF_ACCUMULATE_INSCATTER];
+			ctx.mPixelShader = &mPixelShaders[BUF_MULTIPLE_SCATTERING];
 			ctx.mVertexShader = &mVertexShader;
 			ctx.mBlendState = &mAddBlend;
 			ctx.mTextureSamplers[0] = &mSamplerLinearClamp;
 		}
+		InvalidateStages();
+	}
+
+	// The totals accumulate the orders, starting from the single scattering
+	void ResetAccumulation()
+	{
+		ScreenUpdateContext& ctx = mTotalInscatter.GetUpdateContext();
+		ctx.mInputTexture3Ds[RAYLEIGH] = &mSingleScattering->GetTexture(RAYLEIGH);
+		ctx.mInputTexture3Ds[MIE] = &mSingleScattering->GetTexture(MIE);
+		mTotalInscatter.Update();
+		mNumScatteringAccumulated = 1;
+	}
+
+	// Sky irradiance of the order in inInscatter, written over the table or added to it
+	void UpdateIrradiance(const ScreenBuffer3D<2>& inInscatter, bool inAccumulate)
+	{
+		ScreenUpdateContext& ctx = mIrradiance.GetUpdateContext();
+		ctx.mInputTexture3Ds[RAYLEIGH] = &inInscatter.GetTexture(RAYLEIGH);
+		ctx.mInputTexture3Ds[MIE] = &inInscatter.GetTexture(MIE);
+		ctx.mBlendState = inAccumulate ? &mAddIrradianceBlend : &mNoBlend;
+		mIrradiance.Update();
+	}
+
+	// The next GeneratePrecomputedTexture() renders every stage, e.g. after the shaders are recompiled
+	void InvalidateStages()
+	{
+		mStageFingerprints.fill(0);
 	}
 
-	enum class Planet { Earth = 0, Mars };
+	using Planet = atmosphere::Planet;
 	void ResetScatteringParameters(Planet inPlanet)
 	{
-		// ToDo: scattering coeff. calculation (https://www.cs.utah.edu/~shirley/papers/sunsky/sunsky.pdf, Appendix 3)
-		auto& param = mPrecomputedParam;
-		switch (inPlanet)
-		{
-		case PrecomputedAtmosphericScattering::Planet::Earth:
-			param.mRayleighSctrCoeff = 1e6f * ComputeRayleighScatteringCoefficients();
-			param.mRayleighScaleHeight = 7.997f;
-			param.mMieSctrCoeff = math::Float3(20.0f, 20.0f, 20.0f);
-			param.mMieScaleHeight = 1.2f;
-			param.mMieAbsorption = 1.11f;
-			break;
-		default:
-			assert(false);
-		}
+		mPrecomputedParam = atmosphere::GetScatteringParameters(inPlanet);
 	}
 
 	void UpdateShaderParameters(ScreenUpdateContext::ShaderParam& inParam, size_t inStartIndex = 0)
 	{
-		assert(inStartIndex + 2 < inParam.mFloat4.size());
-		const auto& param = mPrecomputedParam;
+		UpdateShaderParameters(inParam, inStartIndex, mPrecomputedParam);
+	}
+
+	// inPrecomputedParam : the parameters the bound look-up tables were baked with
+	void UpdateShaderParameters(ScreenUpdateContext::ShaderParam& inParam, size_t inStartIndex, const PrecomputedSctrParams& inPrecomputedParam)
+	{
+		assert(inStartIndex + 3 < inParam.mFloat4.size());
+		const auto& param = inPrecomputedParam;
 		inParam.mFloat4.at(inStartIndex + 0).x = param.mRayleighSctrCoeff.x * 1e-3f;
 		inParam.mFloat4.at(inStartIndex + 0).y = param.mRayleighSctrCoeff.y * 1e-3f;
 		inParam.mFloat4.at(inStartIndex + 0).z = param.mRayleighSctrCoeff.z * 1e-3f;
@@ -298,6 +300,13 @@ struct PrecomputedAtmosphericScattering
 		inParam.mFloat4.at(inStartIndex + 1).z = param.mMieSctrCoeff.z * 1e-3f;
 		inParam.mFloat4.at(inStartIndex + 1).w = param.mMieScaleHeight;
 		inParam.mFloat4.at(inStartIndex + 2).x = param.mMieAbsorption;
+		inParam.mFloat4.at(inStartIndex + 2).y = (mDesc.mOpticalDepthMode == atmosphere::OpticalDepthMode::Analytic) ? 1.0f : 0.0f;
+		inParam.mFloat4.at(inStartIndex + 2).z = float(GetNumFibonacciGatherSamples());
+		// LUT_RESOLUTION_PARAM of the shaders
+		const TextureDesc& inscatter_desc = mDesc.GetInscatterTextureDesc();
+		inParam.mFloat4.at(inStartIndex + 3).x = float(inscatter_desc.mWidth);
+		inParam.mFloat4.at(inStartIndex + 3).y = float(inscatter_desc.mHeight);
+		inParam.mFloat4.at(inStartIndex + 3).z = float(inscatter_desc.mDepth);
 	}
 
 	void UpdateShaderParameters()
@@ -305,143 +314,316 @@ struct PrecomputedAtmosphericScattering
 		UpdateShaderParameters(mOpticalDepth->GetUpdateContext().mShaderParam);
 		UpdateShaderParameters(mSingleScattering->GetUpdateContext().mShaderParam);
 		UpdateShaderParameters(mInscatterGathering->GetUpdateContext().mShaderParam);
-		UpdateShaderParameters(mMultipleScattering->GetUpdateContext().mShaderParam);
+		UpdateShaderParameters(mAccumulateInscatter->GetUpdateContext().mShaderParam);
+
+		// IRRADIANCE_RESOLUTION_PARAM of IrradiancePS.hlsl
+		ScreenUpdateContext::ShaderParam& irradiance_param = mIrradiance.GetUpdateContext().mShaderParam;
+		UpdateShaderParameters(irradiance_param);
+		irradiance_param.mFloat4.at(4).x = float(mDesc.mTextureDesc[BUF_IRRADIANCE].mWidth);
+		irradiance_param.mFloat4.at(4).y = float(mDesc.mTextureDesc[BUF_IRRADIANCE].mHeight);
 	}
 
 	void CompileShaders()
 	{
 		std::string error_message;
-		for (auto& ps : mPixelShaders)
-			if (!ps.Compile(mDevice, error_message))
+		for (size_t i = 0; i < mPixelShaders.size(); ++i)
+			if (i != BUF_ACCUMULATE_INSCATTER && !mPixelShaders[i].Compile(mDevice, error_message))
 				std::cout << error_message << std::endl;
 		if (!mVertexShader.Compile(mDevice, error_message))
 			std::cout << error_message << std::endl;
 	}
 
+	// Only the stages whose inputs changed since the last call are rendered again (atmosphere::ComputeLookUpTableStageFingerprints())
 	void GeneratePrecomputedTexture()
 	{
-
-		ReleaseBuffers();
-		CreateBuffers();
 		UpdateShaderParameters();
 
+		// On a cache hit only the optical depth, total inscatter, packed inscatter and irradiance textures are filled
+		// The shaders march uniform steps and run every scattering order
+		const TextureDesc& optical_depth_desc = mDesc.mTextureDesc[BUF_OPTICAL_DEPTH];
+		atmosphere::LookUpTableCacheKeyDesc key_desc;
+		key_desc.mNumScattering = mNumScattering;
+		key_desc.mOpticalDepthWidth = optical_depth_desc.mWidth;
+		key_desc.mOpticalDepthHeight = optical_depth_desc.mHeight;
+		key_desc.mOpticalDepthMode = mDesc.mOpticalDepthMode;
+		key_desc.mInscatterWidth = mDesc.GetInscatterTextureDesc().mWidth;
+		key_desc.mInscatterHeight = mDesc.GetInscatterTextureDesc().mHeight;
+		key_desc.mInscatterDepth = mDesc.GetInscatterTextureDesc().mDepth;
+		key_desc.mIrradianceWidth = mDesc.mTextureDesc[BUF_IRRADIANCE].mWidth;
+		key_desc.mIrradianceHeight = mDesc.mTextureDesc[BUF_IRRADIANCE].mHeight;
+		key_desc.mGatherQuadrature = std::uint32_t(mDesc.mGatherQuadrature);
+		key_desc.mNumGatherSamples = GetNumFibonacciGatherSamples() ? GetNumFibonacciGatherSamples() : NUM_RANDOMDIR_SAMPLES;
+		const atmosphere::LookUpTableStageFingerprints fingerprints = atmosphere::ComputeLookUpTableStageFingerprints(mPrecomputedParam, key_desc);
+		mBakeTimings.Clear();
+		if (mStageFingerprints[BUF_OPTICAL_DEPTH] == fingerprints.mStages[BUF_OPTICAL_DEPTH]
+			&& mStageFingerprints[BUF_TOTAL_INSCATTER] == fingerprints.mStages[BUF_TOTAL_INSCATTER]
+			&& mStageFingerprints[BUF_PACK_INSCATTER] == fingerprints.mStages[BUF_PACK_INSCATTER]
+			&& mStageFingerprints[BUF_IRRADIANCE] == fingerprints.mStages[BUF_IRRADIANCE])
+			return; // Up to date
+
+		const std::uint64_t cache_key = atmosphere::ComputeLookUpTableCacheKey(mPrecomputedParam, key_desc);
+		mIsLoadedFromCache = mCache && LoadFromCache(cache_key);
+		if (mIsLoadedFromCache)
+		{
+			for (BufferType loaded : { BUF_OPTICAL_DEPTH, BUF_TOTAL_INSCATTER, BUF_PACK_INSCATTER, BUF_IRRADIANCE })
+				mStageFingerprints[loaded] = fingerprints.mStages[loaded];
+			return;
+		}
+
+		RenderPrecomputedTexture(fingerprints);
+
+		if (mCache)
+			StoreToCache(cache_key);
+	}
+
+	bool IsLoadedFromCache() const { return mIsLoadedFromCache; }
+	// GPU time of every pass rendered by the last bake (timestamp queries), empty when it was up to date or loaded from the cache
+	const atmosphere::BakeTimings& GetBakeTimings() const { return mBakeTimings; }
+
+	const Texture3D& GetSingleScatteringTexture(TextureIndex index) const { return mSingleScattering->GetTexture(index); }
+	const Texture3D& GetMultipleScatteringTexture(TextureIndex index) const { return mMultipleScattering->GetTexture(index); }
+	const Texture2D& GetOpticalDepthTexture() const { return mOpticalDepth->GetTexture(0); }
+	const Texture3D& GetInscatterGatherTexture(TextureIndex index) const { return mInscatterGathering->GetTexture(index); }
+	const Texture3D& GetTotalInscatterTexture(TextureIndex index) const { return mTotalInscatter.GetTexture(index); }
+	const Texture3D& GetPackedTotalInscatterTexture() const { return mPackInscatter.GetTexture(0); }
+	const Texture2D& GetIrradianceTexture() const { return mIrradiance.GetTexture(0); }
+
+	PrecomputedSctrParams& GetParam() { return mPrecomputedParam; }
+	const Desc& GetDesc() const { return mDesc; }
+
+	void SetNumScattering(std::uint32_t n) { mNumScattering = n; }
+	std::uint32_t GetNumScattering() const { return mNumScattering; }
+
+protected:
+	// 0 = hashed random directions
+	std::uint32_t GetNumFibonacciGatherSamples() const
+	{
+		if (mDesc.mGatherQuadrature != atmosphere::GatherQuadrature::SphericalFibonacci)
+			return 0;
+		return std::max<std::uint32_t>(mDesc.mNumGatherSamples, 1);
+	}
+
+	// Pass of inStage that was just issued, its time is resolved after the bake
+	void MarkStage(BufferType inStage, std::uint32_t inOrder, std::vector<atmosphere::BakeStageTiming>& ioStages)
+	{
+		mGpuTimer.Mark(mDevice);
+
+		const TextureDesc& desc = mDesc.mTextureDesc[inStage];
+		atmosphere::BakeStageTiming timing;
+		timing.mStage = size_t(inStage);
+		timing.mOrder = inOrder;
+		timing.mNumTexels = std::uint64_t(desc.mWidth) * desc.mHeight * std::max<std::uint64_t>(desc.mDepth, 1);
+		// The shaders march uniform steps : 128 for the optical depth, INSCATTER_INTEGRAL_STEPS for the inscatter
+		switch (inStage)
+		{
+		case BUF_OPTICAL_DEPTH:
+			timing.mNumSamples = timing.mNumTexels * ((mDesc.mOpticalDepthMode == atmosphere::OpticalDepthMode::Analytic) ? 1 : 128);
+			break;
+		case BUF_SINGLE_SCATTERING:
+		case BUF_MULTIPLE_SCATTERING:
+			timing.mNumSamples = timing.mNumTexels * (INSCATTER_INTEGRAL_STEPS + 1);
+			break;
+		case BUF_GATHER_INSCATTER:
+			timing.mNumSamples = timing.mNumTexels * (GetNumFibonacciGatherSamples() ? GetNumFibonacciGatherSamples() : NUM_RANDOMDIR_SAMPLES);
+			break;
+		case BUF_IRRADIANCE:
+			timing.mNumSamples = timing.mNumTexels * NUM_IRRADIANCE_SAMPLES;
+			break;
+		default:
+			timing.mNumSamples = timing.mNumTexels;
+			break;
+		}
+		ioStages.push_back(timing);
+	}
+
+	// Renders the stages whose fingerprint changed
+	void RenderPrecomputedTexture(const atmosphere::LookUpTableStageFingerprints& inFingerprints)
+	{
+		const auto time_start = std::chrono::steady_clock::now();
+		std::vector<atmosphere::BakeStageTiming> timings;
+		mGpuTimer.Begin(mDevice);
+
+		const std::uint64_t* stage = inFingerprints.mStages;
+		if (mStageFingerprints[BUF_OPTICAL_DEPTH] != stage[BUF_OPTICAL_DEPTH])
 		{
 			// optical depth
 			mOpticalDepth->Update();
+			MarkStage(BUF_OPTICAL_DEPTH, 0, timings);
+			mStageFingerprints[BUF_OPTICAL_DEPTH] = stage[BUF_OPTICAL_DEPTH];
 		}
+		if (mStageFingerprints[BUF_SINGLE_SCATTERING] != stage[BUF_SINGLE_SCATTERING])
 		{
 			// single scattering
 			ScreenUpdateContext& ctx = mSingleScattering->GetUpdateContext();
 			ctx.mInputTexture2Ds[0] = &mOpticalDepth->GetTexture(0);
 			mSingleScattering->Update();
+			MarkStage(BUF_SINGLE_SCATTERING, 0, timings);
+			mStageFingerprints[BUF_SINGLE_SCATTERING] = stage[BUF_SINGLE_SCATTERING];
 		}
 
 		//
 		// Multiple scattering
+		//	The loop resumes from the orders accumulated so far unless its inputs changed or fewer orders are requested.
+		//	The gathered and the order textures ping-pong : the gather reads order n - 1, order n reads the gathered
+		//	textures and overwrites order n - 1. Order n is added to the totals in the same pass, its sky irradiance
+		//	to the irradiance table right after.
 		//
-		if(mNumScattering > 1)
+		if (mStageFingerprints[BUF_ACCUMULATE_INSCATTER] != stage[BUF_ACCUMULATE_INSCATTER] || mNumScatteringAccumulated > mNumScattering)
 		{
-			{
-				// gather inscatter
-				ScreenUpdateContext& ctx = mInscatterGathering->GetUpdateContext();
-				ctx.mInputTexture3Ds[RAYLEIGH] = &mSingleScattering->GetTexture(RAYLEIGH);
-				ctx.mInputTexture3Ds[MIE] = &mSingleScattering->GetTexture(MIE);
-				mInscatterGathering->Update();
-			}
-			{
-				// multiple scattering
-				ScreenUpdateContext& ctx = mMultipleScattering->GetUpdateContext();
-				ctx.mInputTexture2Ds[0] = &mOpticalDepth->GetTexture(0);
-				ctx.mInputTexture3Ds[RAYLEIGH] = &mInscatterGathering->GetTexture(RAYLEIGH);
-				ctx.mInputTexture3Ds[MIE] = &mInscatterGathering->GetTexture(MIE);
-				mMultipleScattering->Update();
-			}
-			{
-				// accumulate multiple scattering
-				ScreenUpdateContext& ctx = mAccumulateInscatter->GetUpdateContext();
-				ctx.mInputTexture3Ds[RAYLEIGH] = &mMultipleScattering->GetTexture(RAYLEIGH);
-				ctx.mInputTexture3Ds[MIE] = &mMultipleScattering->GetTexture(MIE);
-				mAccumulateInscatter->Update();
-			}
+			ResetAccumulation();
+			MarkStage(BUF_TOTAL_INSCATTER, 1, timings);
+			mStageFingerprints[BUF_TOTAL_INSCATTER] = 0;
+			UpdateIrradiance(*mSingleScattering, false);
+			MarkStage(BUF_IRRADIANCE, 1, timings);
+			mStageFingerprints[BUF_IRRADIANCE] = 0;
 		}
 
-		for (std::uint32_t i = 2; i < mNumScattering; ++i)
+		for (std::uint32_t order = mNumScatteringAccumulated + 1; order <= mNumScattering; ++order)
 		{
+			// The 2nd order gathers the single scattering, the next ones the previous order
+			const ScreenBuffer3D<2>& previous = (order == 2) ? *mSingleScattering : *mMultipleScattering;
 			{
 				// gather inscattering
 				ScreenUpdateContext& ctx = mInscatterGathering->GetUpdateContext();
-				ctx.mInputTexture3Ds[RAYLEIGH] = &mMultipleScattering->GetTexture(RAYLEIGH);
-				ctx.mInputTexture3Ds[MIE] = &mMultipleScattering->GetTexture(MIE);
+				ctx.mInputTexture3Ds[RAYLEIGH] = &previous.GetTexture(RAYLEIGH);
+				ctx.mInputTexture3Ds[MIE] = &previous.GetTexture(MIE);
 				mInscatterGathering->Update();
+				MarkStage(BUF_GATHER_INSCATTER, order, timings);
 			}
 			{
-				// multiple scattering
-				ScreenUpdateContext& ctx = mMultipleScattering->GetUpdateContext();
+				// multiple scattering, accumulated into the totals
+				ScreenUpdateContext& ctx = mAccumulateInscatter->GetUpdateContext();
 				ctx.mInputTexture2Ds[0] = &mOpticalDepth->GetTexture(0);
 				ctx.mInputTexture3Ds[RAYLEIGH] = &mInscatterGathering->GetTexture(RAYLEIGH);
 				ctx.mInputTexture3Ds[MIE] = &mInscatterGathering->GetTexture(MIE);
-				mMultipleScattering->Update();
-			}
-			{
-				// accumulate multiple scattering
-				ScreenUpdateContext& ctx = mAccumulateInscatter->GetUpdateContext();
-				ctx.mInputTexture3Ds[RAYLEIGH] = &mMultipleScattering->GetTexture(RAYLEIGH);
-				ctx.mInputTexture3Ds[MIE] = &mMultipleScattering->GetTexture(MIE);
 				mAccumulateInscatter->Update();
+				MarkStage(BUF_MULTIPLE_SCATTERING, order, timings);
 			}
+			UpdateIrradiance(*mMultipleScattering, true);
+			MarkStage(BUF_IRRADIANCE, order, timings);
+			mNumScatteringAccumulated = order;
+			mStageFingerprints[BUF_TOTAL_INSCATTER] = 0;
+			mStageFingerprints[BUF_IRRADIANCE] = 0;
 		}
+		for (BufferType loop_stage : { BUF_GATHER_INSCATTER, BUF_MULTIPLE_SCATTERING, BUF_ACCUMULATE_INSCATTER })
+			mStageFingerprints[loop_stage] = stage[loop_stage];
 
 		//
 		// Result
+		//	The totals and the irradiance are complete once the loop is
 		//
+		mStageFingerprints[BUF_IRRADIANCE] = stage[BUF_IRRADIANCE];
+		if (mStageFingerprints[BUF_TOTAL_INSCATTER] != stage[BUF_TOTAL_INSCATTER] || mStageFingerprints[BUF_PACK_INSCATTER] != stage[BUF_PACK_INSCATTER])
 		{
-			// single scattering + multiple scattering
-			ScreenUpdateContext& ctx = mTotalInscatter.GetUpdateContext();
-			ctx.mInputTexture3Ds[RAYLEIGH] = &mSingleScattering->GetTexture(RAYLEIGH);
-			ctx.mInputTexture3Ds[MIE] = &mSingleScattering->GetTexture(MIE);
-			ctx.mInputTexture3Ds[RAYLEIGH + 2] = &mAccumulateInscatter->GetTexture(RAYLEIGH);
-			ctx.mInputTexture3Ds[MIE + 2] = &mAccumulateInscatter->GetTexture(MIE);
-			mTotalInscatter.Update();
-		}
-
-		{
-			// single scattering + multiple scattering with packing into a single texture
+			// total inscatter packed into a single texture
 			ScreenUpdateContext& ctx = mPackInscatter.GetUpdateContext();
-			ctx.mInputTexture3Ds[RAYLEIGH] = &mSingleScattering->GetTexture(RAYLEIGH);
-			ctx.mInputTexture3Ds[MIE] = &mSingleScattering->GetTexture(MIE);
-			ctx.mInputTexture3Ds[RAYLEIGH + 2] = &mAccumulateInscatter->GetTexture(RAYLEIGH);
-			ctx.mInputTexture3Ds[MIE + 2] = &mAccumulateInscatter->GetTexture(MIE);
+			ctx.mInputTexture3Ds[RAYLEIGH] = &mTotalInscatter.GetTexture(RAYLEIGH);
+			ctx.mInputTexture3Ds[MIE] = &mTotalInscatter.GetTexture(MIE);
 			mPackInscatter.Update();
+			MarkStage(BUF_PACK_INSCATTER, 0, timings);
+			mStageFingerprints[BUF_TOTAL_INSCATTER] = stage[BUF_TOTAL_INSCATTER];
+			mStageFingerprints[BUF_PACK_INSCATTER] = stage[BUF_PACK_INSCATTER];
 		}
+
+		// Waits for the GPU, the bake is about to be used anyway. A disjoint clock leaves the stage times at 0.
+		mGpuTimer.End(mDevice);
+		std::vector<double> intervals_ms;
+		if (mGpuTimer.Resolve(mDevice, intervals_ms))
+			for (size_t i = 0; i < std::min(intervals_ms.size(), timings.size()); ++i)
+				timings[i].mWallMs = intervals_ms[i];
+
+		const TextureDesc& optical_depth_desc = mDesc.mTextureDesc[BUF_OPTICAL_DEPTH];
+		const TextureDesc& inscatter_desc = mDesc.GetInscatterTextureDesc();
+		mBakeTimings.mBackend = "gpu";
+		mBakeTimings.mNumScattering = mNumScatteringAccumulated;
+		mBakeTimings.mInscatterResolution[0] = inscatter_desc.mWidth;
+		mBakeTimings.mInscatterResolution[1] = inscatter_desc.mHeight;
+		mBakeTimings.mInscatterResolution[2] = inscatter_desc.mDepth;
+		mBakeTimings.mOpticalDepthResolution[0] = optical_depth_desc.mWidth;
+		mBakeTimings.mOpticalDepthResolution[1] = optical_depth_desc.mHeight;
+		mBakeTimings.mStages = std::move(timings);
+		mBakeTimings.mTotalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
 	}
 
-	const Texture3D& GetSingleScatteringTexture(TextureIndex index) const { return mSingleScattering->GetTexture(index); }
-	const Texture3D& GetMultipleScatteringTexture(TextureIndex index) const { return mMultipleScattering->GetTexture(index); }
-	const Texture2D& GetOpticalDepthTexture() const { return mOpticalDepth->GetTexture(0); }
-	const Texture3D& GetInscatterGatherTexture(TextureIndex index) const { return mInscatterGathering->GetTexture(index); }
-	const Texture3D& GetAccumulateInscatterTexture(TextureIndex index) const { return mAccumulateInscatter->GetTexture(index); }
-	const Texture3D& GetTotalInscatterTexture(TextureIndex index) const { return mTotalInscatter.GetTexture(index); }
-	const Texture3D& GetPackedTotalInscatterTexture() const { return mPackInscatter.GetTexture(0); }
+	bool LoadFromCache(std::uint64_t inKey)
+	{
+		std::unique_ptr<atmosphere::LookUpTableFile> file = mCache->Load(inKey);
+		if (!file || file->GetNumScattering() != mNumScattering)
+			return false;
 
-	PrecomputedSctrParams& GetParam() { return mPrecomputedParam; }
+		// The uploads replace what the fingerprints describe, the totals are also the state of the loop
+		for (BufferType loaded : { BUF_OPTICAL_DEPTH, BUF_TOTAL_INSCATTER, BUF_PACK_INSCATTER, BUF_IRRADIANCE, BUF_ACCUMULATE_INSCATTER })
+			mStageFingerprints[loaded] = 0;
 
-	void SetNumScattering(std::uint32_t n) { mNumScattering = n; }
-	std::uint32_t GetNumScattering() const { return mNumScattering; }
+		auto upload = [this, &file](atmosphere::LookUpTableCache::TableId inId, const auto& inTexture)
+		{
+			const TextureDesc& desc = inTexture.GetTextureDesc();
+			const atmosphere::LookUpTableFile::Table* table = file->FindTable(inId);
+			if (!table || table->mFormat != desc.mFormat
+				|| table->mWidth != desc.mWidth || table->mHeight != desc.mHeight || table->mDepth != desc.mDepth)
+				return false;
+			UploadTexture(mDevice, inTexture, table->mTexels);
+			return true;
+		};
+
+		return upload(atmosphere::LookUpTableCache::OPTICAL_DEPTH, mOpticalDepth->GetTexture(0))
+			&& upload(atmosphere::LookUpTableCache::TOTAL_INSCATTER_RAYLEIGH, mTotalInscatter.GetTexture(RAYLEIGH))
+			&& upload(atmosphere::LookUpTableCache::TOTAL_INSCATTER_MIE, mTotalInscatter.GetTexture(MIE))
+			&& upload(atmosphere::LookUpTableCache::PACK_INSCATTER, mPackInscatter.GetTexture(0))
+			&& upload(atmosphere::LookUpTableCache::IRRADIANCE, mIrradiance.GetTexture(0));
+	}
+
+	void StoreToCache(std::uint64_t inKey)
+	{
+		// The images must outlive Store()
+		std::vector<std::unique_ptr<Image>> images;
+		std::vector<atmosphere::LookUpTableFile::Table> tables;
+		auto capture = [this, &images, &tables](atmosphere::LookUpTableCache::TableId inId, const auto& inTexture)
+		{
+			images.push_back(CaptureTexture(mDevice, inTexture));
+			if (!images.back())
+				return false;
+			const ImageMetaData& meta_data = images.back()->GetMetaData();
+			atmosphere::LookUpTableFile::Table table;
+			table.mId = inId;
+			table.mFormat = meta_data.format;
+			table.mWidth = meta_data.width;
+			table.mHeight = meta_data.height;
+			table.mDepth = meta_data.depth;
+			table.mTexels = images.back()->GetPixels();
+			tables.push_back(table);
+			return true;
+		};
+
+		if (capture(atmosphere::LookUpTableCache::OPTICAL_DEPTH, mOpticalDepth->GetTexture(0))
+			&& capture(atmosphere::LookUpTableCache::TOTAL_INSCATTER_RAYLEIGH, mTotalInscatter.GetTexture(RAYLEIGH))
+			&& capture(atmosphere::LookUpTableCache::TOTAL_INSCATTER_MIE, mTotalInscatter.GetTexture(MIE))
+			&& capture(atmosphere::LookUpTableCache::PACK_INSCATTER, mPackInscatter.GetTexture(0))
+			&& capture(atmosphere::LookUpTableCache::IRRADIANCE, mIrradiance.GetTexture(0)))
+			mCache->Store(inKey, mNumScattering, tables);
+	}
 
-protected:
 	Device&		mDevice;
 	const Desc&	mDesc;
 	PrecomputedSctrParams	mPrecomputedParam;
 	std::uint32_t	mNumScattering = 6;
+	bool			mIsLoadedFromCache = false;
+	std::unique_ptr<atmosphere::LookUpTableCache>	mCache = nullptr;
+
+	// Inputs the textures were rendered with (atmosphere::LookUpTableStageFingerprints), 0 = stale
+	std::array<std::uint64_t, NUM_BUFFERS>	mStageFingerprints = {};
+	// Orders added to mTotalInscatter (1 = none), the last one is in mMultipleScattering
+	std::uint32_t	mNumScatteringAccumulated = 1;
 
 	std::array<PixelShader, NUM_BUFFERS>	mPixelShaders = {
 		"shader/atmosphere/OpticalDepthPS.hlsl",
 		"shader/atmosphere/SingleScatteringPS.hlsl",
 		"shader/atmosphere/MultipleScatteringPS.hlsl",
 		"shader/atmosphere/GatherInscatterPS.hlsl",
-		"shader/atmosphere/AddScatteringPS.hlsl",
-		"shader/atmosphere/TotalInscatterPS.hlsl",
+		"",	// BUF_ACCUMULATE_INSCATTER is written by the pass of BUF_MULTIPLE_SCATTERING
+		"shader/atmosphere/AddScatteringPS.hlsl",	// copies the single scattering, the start of the accumulation
 		"shader/atmosphere/PackInscatterPS.hlsl",
+		"shader/atmosphere/IrradiancePS.hlsl",
 	};
 	VertexShader							mVertexShader = {
 		"shader/ScreenVS.hlsl"
@@ -449,16 +631,87 @@ protected:
 	Sampler				mSamplerLinearClamp;
 	BlendState			mNoBlend;
 	BlendState			mAddBlend;
+	BlendState			mAddIrradianceBlend;
+	GpuTimer			mGpuTimer;
+	atmosphere::BakeTimings	mBakeTimings;
 
 	std::unique_ptr< ScreenBuffer2D<1> >	mOpticalDepth		= nullptr;
 	std::unique_ptr< ScreenBuffer3D<2> >	mSingleScattering	= nullptr;
 	std::unique_ptr< ScreenBuffer3D<2> >	mInscatterGathering	= nullptr;
 	std::unique_ptr< ScreenBuffer3D<2> >	mMultipleScattering	= nullptr;
-	std::unique_ptr< ScreenBuffer3D<2> >	mAccumulateInscatter= nullptr;
+	std::unique_ptr< ScreenBuffer3D<4> >	mAccumulateInscatter= nullptr;	// renders into the textures of mMultipleScattering and mTotalInscatter
 	ScreenBuffer3D<2>	mTotalInscatter;
 	ScreenBuffer3D<1>	mPackInscatter;
+	ScreenBuffer2D<1>	mIrradiance;
 };
 
+//--------------------------------------------------------------------------------------------
+// Look-up tables baked in the background
+//		- Two sets are double buffered : a finished bake, or a blend of the atlas, is uploaded into the set that is not bound,
+//		  then the sets swap
+//		- The D3D11 immediate context is not thread safe, the bake runs on the CPU and only the upload is on the render thread
+//--------------------------------------------------------------------------------------------
+struct LookUpTableSet
+{
+	using Engine = atmosphere::CpuPrecomputedAtmosphericScattering;
+
+	LookUpTableSet(Device& inDevice, const PrecomputedAtmosphericScattering::Desc& inDesc)
+		: mOpticalDepth(inDevice, inDesc.mTextureDesc[PrecomputedAtmosphericScattering::BUF_OPTICAL_DEPTH])
+		, mTotalInscatterRayleigh(inDevice, inDesc.mTextureDesc[PrecomputedAtmosphericScattering::BUF_TOTAL_INSCATTER])
+		, mTotalInscatterMie(inDevice, inDesc.mTextureDesc[PrecomputedAtmosphericScattering::BUF_TOTAL_INSCATTER])
+		, mPackInscatter(inDevice, inDesc.mTextureDesc[PrecomputedAtmosphericScattering::BUF_PACK_INSCATTER])
+	{}
+
+	void Upload(const Device& inDevice, const atmosphere::AsyncPrecomputedAtmosphericScattering::Result& inResult)
+	{
+		Upload(inDevice, inResult.mOpticalDepth, inResult.mTotalInscatter[Engine::RAYLEIGH], inResult.mTotalInscatter[Engine::MIE],
+			inResult.mPackInscatter, inResult.mParams);
+	}
+
+	void Upload(const Device& inDevice, const atmosphere::LookUpTableAtlas::Tables& inTables)
+	{
+		Upload(inDevice, inTables.mOpticalDepth, inTables.mTotalInscatter[Engine::RAYLEIGH], inTables.mTotalInscatter[Engine::MIE],
+			inTables.mPackInscatter, inTables.mParams);
+	}
+
+	void Upload(const Device& inDevice, const Engine::View2D& inOpticalDepth, const Engine::View3D& inTotalRayleigh, const Engine::View3D& inTotalMie,
+		const Engine::View3D& inPackInscatter, const PrecomputedSctrParams& inParams)
+	{
+		UploadTable(inDevice, mOpticalDepth, inOpticalDepth);
+		UploadTable(inDevice, mTotalInscatterRayleigh, inTotalRayleigh);
+		UploadTable(inDevice, mTotalInscatterMie, inTotalMie);
+		UploadTable(inDevice, mPackInscatter, inPackInscatter);
+		mParams = inParams;
+	}
+
+	// The CPU tables are float, they are converted when the texture has a compact format
+	template<typename Texture, typename View>
+	static void UploadTable(const Device& inDevice, const Texture& inTexture, const View& inTable)
+	{
+		const TextureFormat format = inTexture.GetTextureDesc().mFormat;
+		if (format == TextureFormat::R32G32 || format == TextureFormat::R32G32B32A32)
+		{
+			UploadTexture(inDevice, inTexture, inTable.GetData());
+			return;
+		}
+		const atmosphere::EncodedLookUpTable encoded = atmosphere::EncodeLookUpTable(inTable, format);
+		UploadTexture(inDevice, inTexture, encoded.GetData());
+	}
+
+	void Bind(ScreenUpdateContext& ctx) const
+	{
+		ctx.mInputTexture3Ds[0] = &mPackInscatter;
+		ctx.mInputTexture3Ds[1] = &mTotalInscatterRayleigh;
+		ctx.mInputTexture3Ds[2] = &mTotalInscatterMie;
+		ctx.mInputTexture2Ds[0] = &mOpticalDepth;
+	}
+
+	Texture2D				mOpticalDepth;
+	Texture3D				mTotalInscatterRayleigh;
+	Texture3D				mTotalInscatterMie;
+	Texture3D				mPackInscatter;
+	PrecomputedSctrParams	mParams;
+};
 
 //--------------------------------------------------------------------------------------------
 // Main
@@ -532,6 +785,51 @@ int main()
 		ctx.mBlendState = &blend_state_none;
 	}
 
+	// background precomputation, the CPU engine bakes the same tables
+	std::unique_ptr<atmosphere::AsyncPrecomputedAtmosphericScattering> background_atmosphere = nullptr;
+	std::array<std::unique_ptr<LookUpTableSet>, 2> lut_sets;
+	int front_lut_set = -1;	// -1 = the textures of atmosphere
+	auto create_engine_desc = [&atmosphere_desc]()
+	{
+		const TextureDesc& optical_depth_desc = atmosphere_desc.mTextureDesc[PrecomputedAtmosphericScattering::BUF_OPTICAL_DEPTH];
+		atmosphere::CpuPrecomputedAtmosphericScattering::Desc desc;
+		desc.mOpticalDepthWidth = optical_depth_desc.mWidth;
+		desc.mOpticalDepthHeight = optical_depth_desc.mHeight;
+		desc.mInscatterWidth = atmosphere_desc.GetInscatterTextureDesc().mWidth;
+		desc.mInscatterHeight = atmosphere_desc.GetInscatterTextureDesc().mHeight;
+		desc.mInscatterDepth = atmosphere_desc.GetInscatterTextureDesc().mDepth;
+		desc.mNumThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;	// leave a core to the render thread
+		desc.mOpticalDepthMode = atmosphere_desc.mOpticalDepthMode;
+		desc.mGatherQuadrature = atmosphere_desc.mGatherQuadrature;
+		desc.mNumGatherSamples = atmosphere_desc.mNumGatherSamples;
+		desc.mCacheDirectory = atmosphere_desc.mCacheDirectory;
+		return desc;
+	};
+	auto swap_in = [&](const auto& inTables)
+	{
+		const int back_lut_set = (front_lut_set + 1) % 2;
+		if (!lut_sets[back_lut_set])
+			lut_sets[back_lut_set] = std::make_unique<LookUpTableSet>(device, atmosphere_desc);
+		lut_sets[back_lut_set]->Upload(device, inTables);
+		lut_sets[back_lut_set]->Bind(primary_screen.GetUpdateContext());
+		front_lut_set = back_lut_set;
+	};
+
+	// parameter-space atlas over the Mie coefficient and scale height, built on a worker thread.
+	// While the sliders move it is blended at once, a background bake (if enabled) refines.
+	std::unique_ptr<atmosphere::LookUpTableAtlas> atlas = nullptr;
+	std::unique_ptr<atmosphere::LookUpTableAtlas::Tables> atlas_tables = nullptr;
+	std::thread			atlas_thread;
+	std::atomic<bool>	atlas_cancel{ false };
+	std::atomic<bool>	atlas_ready{ false };
+	auto stop_atlas_build = [&]()
+	{
+		atlas_cancel = true;
+		if (atlas_thread.joinable())
+			atlas_thread.join();
+		atlas_cancel = false;
+	};
+
 	const wnd::Info& window_info = window->GetInfo();
 	const float window_size[2] = { float(window_info.mWindowSize[0]), float(window_info.mWindowSize[1]) };
 
@@ -543,6 +841,11 @@ int main()
 	bool	ui_compilation_requested = false;
 	bool	ui_precomputation_requested = false;
 	bool	ui_use_vsync = true;
+	bool	ui_background_precomputation = false;
+	int		ui_atlas_num_points = 3;
+	float	ui_atlas_mie_scale = 1.0f;
+	PrecomputedSctrParams	requested_params = precomp_params;
+	std::uint32_t			requested_num_scattering = atmosphere.GetNumScattering();
 	float	ui_exposure_compensation = -13.5f;
 	math::Float2 ui_light_angle(89.0f, 120.0f);
 	while (true)
@@ -600,7 +903,10 @@ int main()
 			ctx.mShaderParam.mFloat4[6].y = runtime_params.mMieAsymmetry;
 			ctx.mShaderParam.mFloat4[6].z = ui_exposure_compensation;
 			
-			atmosphere.UpdateShaderParameters(ctx.mShaderParam, 8);
+			if (front_lut_set < 0)
+				atmosphere.UpdateShaderParameters(ctx.mShaderParam, 8);
+			else
+				atmosphere.UpdateShaderParameters(ctx.mShaderParam, 8, lut_sets[front_lut_set]->mParams);
 		}
 
 		switch (result.mState)
@@ -614,9 +920,35 @@ int main()
 				if (!default_vs.Compile(device, error_message))
 					std::cout << error_message << std::endl;
 				atmosphere.CompileShaders();
+				atmosphere.InvalidateStages();
 				ui_compilation_requested = false;
 			}
 			
+			const bool params_changed = std::memcmp(&requested_params, &precomp_params, sizeof(PrecomputedSctrParams)) != 0
+				|| requested_num_scattering != atmosphere.GetNumScattering();
+			requested_params = precomp_params;
+			requested_num_scattering = atmosphere.GetNumScattering();
+
+			// An approximation from the atlas at once
+			if (params_changed && atlas_ready && atlas->Contains(precomp_params) && requested_num_scattering == atlas->GetDesc().mNumScattering)
+			{
+				atlas->Blend(precomp_params, *atlas_tables);
+				swap_in(*atlas_tables);
+			}
+
+			if (ui_background_precomputation)
+			{
+				// Any edit restarts the bake, the previous request is cancelled
+				if (ui_precomputation_requested || params_changed)
+				{
+					background_atmosphere->Request(requested_params, requested_num_scattering);
+					ui_precomputation_requested = false;
+				}
+
+				if (std::unique_ptr<atmosphere::AsyncPrecomputedAtmosphericScattering::Result> baked = background_atmosphere->TakeResult())
+					swap_in(*baked);
+			}
+
 			if (ui_precomputation_requested)
 			{
 				atmosphere.GeneratePrecomputedTexture();
@@ -625,6 +957,7 @@ int main()
 				ctx.mInputTexture3Ds[1] = &atmosphere.GetTotalInscatterTexture(PrecomputedAtmosphericScattering::RAYLEIGH);
 				ctx.mInputTexture3Ds[2] = &atmosphere.GetTotalInscatterTexture(PrecomputedAtmosphericScattering::MIE);
 				ctx.mInputTexture2Ds[0] = &atmosphere.GetOpticalDepthTexture();
+				front_lut_set = -1;
 				ui_precomputation_requested = false;
 			}
 
@@ -643,6 +976,19 @@ int main()
 				{
 					if (ImGui::Button("Precompute"))
 						ui_precomputation_requested = true;
+					ImGui::SameLine();
+					if (ImGui::Checkbox("Background", &ui_background_precomputation))
+					{
+						if (ui_background_precomputation)
+						{
+							background_atmosphere = std::make_unique<atmosphere::AsyncPrecomputedAtmosphericScattering>(create_engine_desc());
+							ui_precomputation_requested = true;
+						}
+						else
+							background_atmosphere = nullptr;	// cancels the running bake
+					}
+					if (background_atmosphere)
+						ImGui::Text("%s, %llu cancelled", background_atmosphere->IsBusy() ? "Baking" : "Idle", (unsigned long long)background_atmosphere->GetNumCancelled());
 
 					int num_scattering = atmosphere.GetNumScattering();
 					ImGui::DragInt("Num. Scattering", &num_scattering, 1.0f, 1, 11);
@@ -653,6 +999,66 @@ int main()
 					ImGui::InputFloat3("Mie Scattering Coeff", (float*)&precomp_params.mMieSctrCoeff, 2);
 					ImGui::InputFloat("Mie Scale Height", &precomp_params.mMieScaleHeight, 0.0f, 0.0f, 2);
 					ImGui::InputFloat("Mie Absorption", &precomp_params.mMieAbsorption, 0.0f, 0.0f, 2);
+
+					// GPU passes of the last bake, summed over the orders
+					const atmosphere::BakeTimings& timings = atmosphere.GetBakeTimings();
+					if (!timings.mStages.empty() && ImGui::TreeNode("Timings"))
+					{
+						for (size_t stage = 0; stage < PrecomputedAtmosphericScattering::NUM_BUFFERS; ++stage)
+						{
+							const atmosphere::BakeStageTiming total = timings.GetStageTotal(stage);
+							if (total.mNumTexels > 0)
+								ImGui::Text("%-22s %8.2f [ms], %.2e texels/s, %.2e samples/s", atmosphere::GetBakeStageName(stage), total.mWallMs, total.GetTexelsPerSecond(), total.GetSamplesPerSecond());
+						}
+						ImGui::Text("%-22s %8.2f [ms]", "bake", timings.mTotalMs);
+						if (ImGui::Button("Export JSON"))
+							atmosphere::WriteJson("atmosphere_timings.json", timings);
+						ImGui::TreePop();
+					}
+					ImGui::TreePop();
+				}
+
+				if (ImGui::TreeNode("Atlas"))
+				{
+					// Grid around the current parameters : Mie coefficient x [0.5, 2], Mie scale height x [0.5, 1.5]
+					ImGui::SliderInt("Points per Axis", &ui_atlas_num_points, 2, 5);
+					if (ImGui::Button("Build"))
+					{
+						stop_atlas_build();
+						atlas_ready = false;
+						atmosphere::LookUpTableAtlas::Desc desc;
+						desc.mEngineDesc = create_engine_desc();
+						desc.mBaseParams = precomp_params;
+						desc.mNumScattering = atmosphere.GetNumScattering();
+						atmosphere::LookUpTableAtlas::Axis mie_coeff;
+						mie_coeff.mParameter = atmosphere::AtlasParameter::MieSctrScale;
+						mie_coeff.mMin = 0.5f;
+						mie_coeff.mMax = 2.0f;
+						mie_coeff.mNumPoints = ui_atlas_num_points;
+						atmosphere::LookUpTableAtlas::Axis mie_scale_height;
+						mie_scale_height.mParameter = atmosphere::AtlasParameter::MieScaleHeight;
+						mie_scale_height.mMin = 0.5f * precomp_params.mMieScaleHeight;
+						mie_scale_height.mMax = 1.5f * precomp_params.mMieScaleHeight;
+						mie_scale_height.mNumPoints = ui_atlas_num_points;
+						desc.mAxes = { mie_coeff, mie_scale_height };
+						atlas = std::make_unique<atmosphere::LookUpTableAtlas>(desc);
+						atlas_tables = std::make_unique<atmosphere::LookUpTableAtlas::Tables>(desc.mEngineDesc);
+						ui_atlas_mie_scale = 1.0f;
+						atlas_thread = std::thread([&atlas, &atlas_cancel, &atlas_ready]() { atlas_ready = atlas->Build(&atlas_cancel); });
+					}
+					if (atlas)
+					{
+						const atmosphere::LookUpTableAtlas::Desc& desc = atlas->GetDesc();
+						ImGui::Text("%s, %zu points, %.1f MB", atlas_ready ? "Ready" : "Building", atlas->GetNumPoints(), atlas_ready ? double(atlas->GetMemorySize()) / (1024.0 * 1024.0) : 0.0);
+						if (atlas_ready)
+						{
+							// The Mie coefficient moves as a whole, the atlas scales the RGB coefficients of its base
+							if (ImGui::SliderFloat("Mie Coeff Scale", &ui_atlas_mie_scale, desc.mAxes[0].mMin, desc.mAxes[0].mMax))
+								precomp_params = atmosphere::LookUpTableAtlas::SetParameter(precomp_params, desc.mBaseParams, atmosphere::AtlasParameter::MieSctrScale, ui_atlas_mie_scale);
+							ImGui::SliderFloat("Mie Scale Height", &precomp_params.mMieScaleHeight, desc.mAxes[1].mMin, desc.mAxes[1].mMax);
+							ImGui::Text("%s", atlas->Contains(precomp_params) ? "Blending" : "Outside of the atlas");
+						}
+					}
 					ImGui::TreePop();
 				}
 
@@ -689,6 +1095,7 @@ int main()
 		}
 	}
 
+	stop_atlas_build();
 	ImGui_ImplDX11_Shutdown();
 
 	return exit_code;
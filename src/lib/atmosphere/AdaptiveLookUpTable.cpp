@@ -0,0 +1,513 @@
+#include "AdaptiveLookUpTable.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+namespace atmosphere {
+
+namespace detail {
+
+// Largest relative error of the 4 channels, a channel is relative to max(reference, its floor)
+inline double ComputeTexelError(const math::Float4& inApprox, const math::Float4& inReference, const double (&inFloor)[4])
+{
+	const float approx[4] = { inApprox.x, inApprox.y, inApprox.z, inApprox.w };
+	const float reference[4] = { inReference.x, inReference.y, inReference.z, inReference.w };
+	double error = 0.0;
+	for (size_t c = 0; c < 4; ++c)
+	{
+		const double denominator = std::max(double(reference[c]), inFloor[c]);
+		if (denominator > 0.0)
+			error = std::max(error, std::abs(double(approx[c]) - double(reference[c])) / denominator);
+	}
+	return error;
+}
+
+inline void ComputeChannelFloors(const LookUpTableView3D<math::Float4>& inReference, float inRelativeFloor, double (&outFloor)[4])
+{
+	double largest[4] = { 0.0, 0.0, 0.0, 0.0 };
+	for (size_t i = 0; i < inReference.GetNumTexels(); ++i)
+	{
+		const math::Float4& texel = inReference.GetData()[i];
+		largest[0] = std::max(largest[0], double(texel.x));
+		largest[1] = std::max(largest[1], double(texel.y));
+		largest[2] = std::max(largest[2], double(texel.z));
+		largest[3] = std::max(largest[3], double(texel.w));
+	}
+	for (size_t c = 0; c < 4; ++c)
+		outFloor[c] = double(inRelativeFloor) * largest[c];
+}
+
+// Knots of an axis as texel indices of the reference, and the interval of every texel
+struct IndexAxis
+{
+	std::vector<size_t>	mKnots;
+	std::vector<size_t>	mLower;		// knot index below each texel, the last knot is lower for none
+	std::vector<float>	mWeight;	// weight of the upper knot
+
+	void Update(size_t inResolution)
+	{
+		mLower.resize(inResolution);
+		mWeight.resize(inResolution);
+		size_t k = 0;
+		for (size_t i = 0; i < inResolution; ++i)
+		{
+			while (k + 2 < mKnots.size() && i >= mKnots[k + 1])
+				++k;
+			mLower[i] = k;
+			mWeight[i] = float(i - mKnots[k]) / float(mKnots[k + 1] - mKnots[k]);
+		}
+	}
+
+	bool IsKnot(size_t inTexel) const { return mWeight[inTexel] == 0.0f || mWeight[inTexel] == 1.0f; }
+
+	std::vector<float> ToUnit(size_t inResolution) const
+	{
+		std::vector<float> unit(mKnots.size());
+		for (size_t k = 0; k < mKnots.size(); ++k)
+			unit[k] = float(mKnots[k]) / float(inResolution - 1);
+		return unit;
+	}
+};
+
+} // namespace detail
+
+//--------------------------------------------------------------------------------------------
+// AdaptiveAxis
+//--------------------------------------------------------------------------------------------
+AdaptiveAxis::AdaptiveAxis(const std::vector<float>& inKnots)
+	: mKnots(inKnots)
+{
+	assert(mKnots.size() >= 2 && mKnots.size() <= std::numeric_limits<std::uint16_t>::max());
+	assert(std::is_sorted(mKnots.begin(), mKnots.end()));
+	float narrowest = 1.0f;
+	for (size_t k = 0; k + 1 < mKnots.size(); ++k)
+		narrowest = std::min(narrowest, mKnots[k + 1] - mKnots[k]);
+	const size_t max_bins = 4096;
+	const size_t num_bins = (narrowest > 0.0f) ? std::min(max_bins, size_t(std::ceil(1.0f / narrowest))) : max_bins;
+
+	mBins.resize(std::max(num_bins, size_t(1)));
+	size_t k = 0;
+	for (size_t b = 0; b < mBins.size(); ++b)
+	{
+		const float start = float(b) / float(mBins.size());
+		while (k + 2 < mKnots.size() && start >= mKnots[k + 1])
+			++k;
+		mBins[b] = std::uint16_t(k);
+	}
+}
+
+detail::LinearTap AdaptiveAxis::Locate(float inCoord) const
+{
+	const float coord = Saturate(inCoord);
+	const size_t bin = std::min(size_t(coord * float(mBins.size())), mBins.size() - 1);
+	size_t k = mBins[bin];
+	while (k + 2 < mKnots.size() && coord >= mKnots[k + 1])
+		++k;
+	detail::LinearTap tap;
+	tap.i0 = k;
+	tap.i1 = k + 1;
+	const float width = mKnots[k + 1] - mKnots[k];
+	tap.t = (width > 0.0f) ? Saturate((coord - mKnots[k]) / width) : 0.0f;
+	return tap;
+}
+
+//--------------------------------------------------------------------------------------------
+// AdaptiveInscatterTable
+//--------------------------------------------------------------------------------------------
+AdaptiveInscatterTable::AdaptiveInscatterTable(const std::vector<float>& inSunZenithKnots, const std::vector<SliceKnots>& inSlices, const LookUpTableView3D<math::Float4>& inReference)
+	: mSunZenith(inSunZenithKnots)
+{
+	assert(inSlices.size() == inSunZenithKnots.size());
+	mSlices.resize(inSlices.size());
+	size_t num_texels = 0;
+	for (size_t s = 0; s < inSlices.size(); ++s)
+	{
+		Slice& slice = mSlices[s];
+		for (size_t a = 0; a < NUM_SLICE_AXES; ++a)
+			slice.mAxes[a] = AdaptiveAxis(inSlices[s].mKnots[a]);
+		slice.mOffset = num_texels;
+		slice.mHeight = inSlices[s].mKnots[VIEW_ZENITH_BELOW].size() + inSlices[s].mKnots[VIEW_ZENITH_ABOVE].size();
+		num_texels += slice.mHeight * inSlices[s].mKnots[HEIGHT].size();
+	}
+
+	// Texel centers of the reference at the knots, see WorldCoordToLUTCoord() and ZenithAngle2TexCoord()
+	const math::Float3 resolution = LUTResolution(inReference);
+	mTexels.resize(num_texels);
+	for (size_t s = 0; s < inSlices.size(); ++s)
+	{
+		const SliceKnots& knots = inSlices[s];
+		const size_t num_below = knots.mKnots[VIEW_ZENITH_BELOW].size();
+		const float u = (inSunZenithKnots[s] * (resolution.x - 1.0f) + 0.5f) / resolution.x;
+		for (size_t z = 0; z < knots.mKnots[HEIGHT].size(); ++z)
+		{
+			const float w = (knots.mKnots[HEIGHT][z] * (resolution.z - 1.0f) + 0.5f) / resolution.z;
+			for (size_t y = 0; y < mSlices[s].mHeight; ++y)
+			{
+				const bool is_above = (y >= num_below);
+				const float unit_v = is_above ? knots.mKnots[VIEW_ZENITH_ABOVE][y - num_below] : knots.mKnots[VIEW_ZENITH_BELOW][y];
+				const float v = (is_above ? 0.5f : 0.0f) + 0.5f / resolution.y + unit_v * (resolution.y / 2.0f - 1.0f) / resolution.y;
+				mTexels[mSlices[s].mOffset + y + mSlices[s].mHeight * z] = inReference.Sample(math::Float3(u, v, w));
+			}
+		}
+	}
+}
+
+size_t AdaptiveInscatterTable::GetMemorySize() const
+{
+	size_t bytes = mTexels.size() * sizeof(math::Float4) + mSunZenith.GetMemorySize();
+	for (const Slice& slice : mSlices)
+	{
+		bytes += sizeof(slice.mOffset);
+		for (size_t a = 0; a < NUM_SLICE_AXES; ++a)
+			bytes += slice.mAxes[a].GetMemorySize();
+	}
+	return bytes;
+}
+
+math::Float4 AdaptiveInscatterTable::SampleSlice(size_t inSlice, float inViewZenith, float inHeight, bool inIsAboveHorizon) const
+{
+	const Slice& slice = mSlices[inSlice];
+	detail::LinearTap ty = slice.mAxes[inIsAboveHorizon ? VIEW_ZENITH_ABOVE : VIEW_ZENITH_BELOW].Locate(inViewZenith);
+	const detail::LinearTap tz = slice.mAxes[HEIGHT].Locate(inHeight);
+	if (inIsAboveHorizon)
+	{
+		// The knots above the horizon follow the ones below it
+		const size_t offset = slice.mAxes[VIEW_ZENITH_BELOW].GetNumKnots();
+		ty.i0 += offset;
+		ty.i1 += offset;
+	}
+	const math::Float4 c0 = At(inSlice, ty.i0, tz.i0) * (1.0f - ty.t) + At(inSlice, ty.i1, tz.i0) * ty.t;
+	const math::Float4 c1 = At(inSlice, ty.i0, tz.i1) * (1.0f - ty.t) + At(inSlice, ty.i1, tz.i1) * ty.t;
+	return c0 * (1.0f - tz.t) + c1 * tz.t;
+}
+
+math::Float4 AdaptiveInscatterTable::Sample(const math::Float3& inUnitCoord, bool inIsAboveHorizon) const
+{
+	const detail::LinearTap tx = mSunZenith.Locate(inUnitCoord.x);
+	return SampleSlice(tx.i0, inUnitCoord.y, inUnitCoord.z, inIsAboveHorizon) * (1.0f - tx.t)
+		+ SampleSlice(tx.i1, inUnitCoord.y, inUnitCoord.z, inIsAboveHorizon) * tx.t;
+}
+
+math::Float4 AdaptiveInscatterTable::Sample(float inHeight, float inCosViewZenith, float inCosLightZenith) const
+{
+	bool is_above = false;
+	const math::Float3 unit = WorldCoordToUnitLUTCoord(inHeight, inCosViewZenith, inCosLightZenith, is_above);
+	return Sample(unit, is_above);
+}
+
+void AdaptiveInscatterTable::LookUp(
+	const math::Float3& inStartPos,
+	const math::Float3& inViewDir,
+	const math::Float3& inLightDir,
+	const math::Float3& inBetaR,
+	math::Float3& outInscatterR,
+	math::Float3& outInscatterM) const
+{
+	math::Float3 dir = inStartPos - EarthCenter();
+	const float dist = math::L2Norm(dir);
+	dir = dir / dist;
+	const float height = dist - EARTH_RADIUS;
+	const math::Float4 packed_inscatter = Sample(height, math::InnerProduct(dir, inViewDir), math::InnerProduct(dir, inLightDir));
+	outInscatterR = math::Float3(packed_inscatter.x, packed_inscatter.y, packed_inscatter.z);
+	outInscatterM = UnpackMieInscatter(packed_inscatter, inBetaR);
+}
+
+//--------------------------------------------------------------------------------------------
+// Construction and error
+//--------------------------------------------------------------------------------------------
+AdaptiveInscatterError MeasureAdaptiveInscatterError(const AdaptiveInscatterTable& inTable, const LookUpTableView3D<math::Float4>& inReference, float inRelativeFloor)
+{
+	double floor[4];
+	detail::ComputeChannelFloors(inReference, inRelativeFloor, floor);
+
+	const size_t width = inReference.GetWidth();
+	const size_t half_height = inReference.GetHeight() / 2;
+	const size_t depth = inReference.GetDepth();
+	AdaptiveInscatterError error;
+	for (size_t z = 0; z < depth; ++z)
+	{
+		for (size_t y = 0; y < 2 * half_height; ++y)
+		{
+			const bool is_above = (y >= half_height);
+			for (size_t x = 0; x < width; ++x)
+			{
+				const math::Float3 unit(
+					float(x) / float(width - 1),
+					float(is_above ? y - half_height : y) / float(half_height - 1),
+					float(z) / float(depth - 1));
+				const double texel_error = detail::ComputeTexelError(inTable.Sample(unit, is_above), inReference.At(x, y, z), floor);
+				error.mMaxRelativeError = std::max(error.mMaxRelativeError, texel_error);
+				error.mMeanRelativeError += texel_error;
+			}
+		}
+	}
+	error.mMeanRelativeError /= double(std::max(inReference.GetNumTexels(), size_t(1)));
+	return error;
+}
+
+AdaptiveInscatterTable MakeUniformInscatterTable(const LookUpTableView3D<math::Float4>& inReference, size_t inWidth, size_t inHeight, size_t inDepth)
+{
+	assert(inWidth >= 2 && inHeight >= 4 && inHeight % 2 == 0 && inDepth >= 2);
+	const auto make_knots = [](size_t inNumKnots)
+	{
+		std::vector<float> knots(inNumKnots);
+		for (size_t k = 0; k < inNumKnots; ++k)
+			knots[k] = float(k) / float(inNumKnots - 1);
+		return knots;
+	};
+	AdaptiveInscatterTable::SliceKnots slice;
+	slice.mKnots[AdaptiveInscatterTable::VIEW_ZENITH_BELOW] = make_knots(inHeight / 2);
+	slice.mKnots[AdaptiveInscatterTable::VIEW_ZENITH_ABOVE] = make_knots(inHeight / 2);
+	slice.mKnots[AdaptiveInscatterTable::HEIGHT] = make_knots(inDepth);
+	return AdaptiveInscatterTable(make_knots(inWidth), std::vector<AdaptiveInscatterTable::SliceKnots>(inWidth, slice), inReference);
+}
+
+AdaptiveInscatterTable BuildAdaptiveInscatterTable(const LookUpTableView3D<math::Float4>& inReference, const AdaptiveInscatterSettings& inSettings,
+	AdaptiveInscatterError* outError)
+{
+	using Table = AdaptiveInscatterTable;
+	const size_t width = inReference.GetWidth();
+	const size_t half_height = inReference.GetHeight() / 2;
+	const size_t depth = inReference.GetDepth();
+	const size_t resolution[Table::NUM_SLICE_AXES] = { half_height, half_height, depth };
+	assert(width >= 2 && half_height >= 2 && depth >= 2);
+
+	double floor[4];
+	detail::ComputeChannelFloors(inReference, inSettings.mRelativeFloor, floor);
+
+	struct Slice
+	{
+		size_t				mColumn;	// sun zenith texel of the reference
+		detail::IndexAxis	mAxes[Table::NUM_SLICE_AXES];
+		std::vector<double>	mVotes[Table::NUM_SLICE_AXES];
+
+		size_t GetNumTexels() const { return (mAxes[Table::VIEW_ZENITH_BELOW].mKnots.size() + mAxes[Table::VIEW_ZENITH_ABOVE].mKnots.size()) * mAxes[Table::HEIGHT].mKnots.size(); }
+	};
+	std::vector<Slice> slices(2);
+	slices[0].mColumn = 0;
+	slices[1].mColumn = width - 1;
+	for (Slice& slice : slices)
+	{
+		for (size_t a = 0; a < Table::NUM_SLICE_AXES; ++a)
+			slice.mAxes[a].mKnots = { 0, resolution[a] - 1 };
+	}
+	detail::IndexAxis sun_axis;
+	std::vector<double> sun_votes;
+
+	// Every pass measures the error at all the reference texels, and the texels above the target vote. The error along
+	// a single axis, the other ones being exact, is a bound of what bisecting that axis can fix.
+	AdaptiveInscatterError error;
+	for (;;)
+	{
+		sun_axis.mKnots.resize(slices.size());
+		for (size_t s = 0; s < slices.size(); ++s)
+		{
+			sun_axis.mKnots[s] = slices[s].mColumn;
+			for (size_t a = 0; a < Table::NUM_SLICE_AXES; ++a)
+			{
+				slices[s].mAxes[a].Update(resolution[a]);
+				slices[s].mVotes[a].assign(slices[s].mAxes[a].mKnots.size() - 1, 0.0);
+			}
+		}
+		sun_axis.Update(width);
+		sun_votes.assign(slices.size() - 1, 0.0);
+
+		error = AdaptiveInscatterError{ 0.0, 0.0, error.mNumRefinements };
+		for (size_t z = 0; z < depth; ++z)
+		{
+			for (size_t y = 0; y < 2 * half_height; ++y)
+			{
+				const bool is_above = (y >= half_height);
+				const size_t view_axis = is_above ? Table::VIEW_ZENITH_ABOVE : Table::VIEW_ZENITH_BELOW;
+				const size_t offset = is_above ? half_height : 0;
+				const size_t j = y - offset;
+				for (size_t x = 0; x < width; ++x)
+				{
+					const size_t s0 = sun_axis.mLower[x];
+					const float tx = sun_axis.mWeight[x];
+					const math::Float4& reference = inReference.At(x, y, z);
+
+					// Bilinear in a slice, and the error along its own axes at its own column
+					struct SliceTap
+					{
+						math::Float4	mValue;
+						size_t			mWorstAxis;
+						double			mWorstError;
+					};
+					const auto sample_slice = [&](size_t inSlice, bool inNeedsVote)
+					{
+						const Slice& slice = slices[inSlice];
+						const detail::IndexAxis& ay = slice.mAxes[view_axis];
+						const detail::IndexAxis& az = slice.mAxes[Table::HEIGHT];
+						const size_t y0 = offset + ay.mKnots[ay.mLower[j]], y1 = offset + ay.mKnots[ay.mLower[j] + 1];
+						const size_t z0 = az.mKnots[az.mLower[z]], z1 = az.mKnots[az.mLower[z] + 1];
+						const float ty = ay.mWeight[j], tz = az.mWeight[z];
+						const size_t column = slice.mColumn;
+						SliceTap tap;
+						tap.mValue = (inReference.At(column, y0, z0) * (1.0f - ty) + inReference.At(column, y1, z0) * ty) * (1.0f - tz)
+							+ (inReference.At(column, y0, z1) * (1.0f - ty) + inReference.At(column, y1, z1) * ty) * tz;
+						tap.mWorstAxis = Table::NUM_SLICE_AXES;
+						tap.mWorstError = -1.0;
+						if (inNeedsVote)
+						{
+							const math::Float4& exact = inReference.At(column, y, z);
+							if (!ay.IsKnot(j))
+							{
+								tap.mWorstAxis = view_axis;
+								tap.mWorstError = detail::ComputeTexelError(inReference.At(column, y0, z) * (1.0f - ty) + inReference.At(column, y1, z) * ty, exact, floor);
+							}
+							if (!az.IsKnot(z))
+							{
+								const double axis_error = detail::ComputeTexelError(inReference.At(column, y, z0) * (1.0f - tz) + inReference.At(column, y, z1) * tz, exact, floor);
+								if (axis_error > tap.mWorstError)
+								{
+									tap.mWorstAxis = Table::HEIGHT;
+									tap.mWorstError = axis_error;
+								}
+							}
+						}
+						return tap;
+					};
+					const SliceTap taps[2] = { sample_slice(s0, false), sample_slice(s0 + 1, false) };
+					const double texel_error = detail::ComputeTexelError(taps[0].mValue * (1.0f - tx) + taps[1].mValue * tx, reference, floor);
+					error.mMaxRelativeError = std::max(error.mMaxRelativeError, texel_error);
+					error.mMeanRelativeError += texel_error;
+					if (texel_error <= inSettings.mMaxRelativeError)
+						continue;
+
+					// The sun zenith between the exact slices, or an axis of a slice the texel depends on.
+					// A texel on the knots of every axis has no error, so one of them is always free.
+					size_t worst_slice = slices.size();	// the sun zenith
+					size_t worst_axis = Table::NUM_SLICE_AXES;
+					double worst_error = -1.0;
+					if (!sun_axis.IsKnot(x))
+					{
+						worst_error = detail::ComputeTexelError(inReference.At(slices[s0].mColumn, y, z) * (1.0f - tx) + inReference.At(slices[s0 + 1].mColumn, y, z) * tx, reference, floor);
+					}
+					for (size_t s = s0; s <= s0 + 1; ++s)
+					{
+						if ((s == s0 && tx == 1.0f) || (s == s0 + 1 && tx == 0.0f))
+							continue;
+						const SliceTap tap = sample_slice(s, true);
+						if (tap.mWorstError > worst_error)
+						{
+							worst_slice = s;
+							worst_axis = tap.mWorstAxis;
+							worst_error = tap.mWorstError;
+						}
+					}
+					assert(worst_error >= 0.0);
+					if (worst_slice == slices.size())
+					{
+						sun_votes[s0] = std::max(sun_votes[s0], texel_error);
+					}
+					else
+					{
+						Slice& slice = slices[worst_slice];
+						double& vote = slice.mVotes[worst_axis][slice.mAxes[worst_axis].mLower[worst_axis == Table::HEIGHT ? z : j]];
+						vote = std::max(vote, texel_error);
+					}
+				}
+			}
+		}
+		error.mMeanRelativeError /= double(std::max(inReference.GetNumTexels(), size_t(1)));
+		if (error.mMaxRelativeError <= inSettings.mMaxRelativeError)
+			break;
+
+		// Worst intervals first, as many as the texel budget takes
+		struct Refinement
+		{
+			double	mError;
+			size_t	mSlice;		// slices.size() for the sun zenith
+			size_t	mAxis;
+			size_t	mInterval;
+		};
+		std::vector<Refinement> refinements;
+		for (size_t k = 0; k < sun_votes.size(); ++k)
+		{
+			if (sun_votes[k] > 0.0)
+				refinements.push_back(Refinement{ sun_votes[k], slices.size(), 0, k });
+		}
+		for (size_t s = 0; s < slices.size(); ++s)
+		{
+			for (size_t a = 0; a < Table::NUM_SLICE_AXES; ++a)
+			{
+				for (size_t k = 0; k < slices[s].mVotes[a].size(); ++k)
+				{
+					if (slices[s].mVotes[a][k] > 0.0)
+						refinements.push_back(Refinement{ slices[s].mVotes[a][k], s, a, k });
+				}
+			}
+		}
+		std::sort(refinements.begin(), refinements.end(), [](const Refinement& inA, const Refinement& inB) { return inA.mError > inB.mError; });
+
+		// The knots are appended and sorted at the end, the intervals keep their indices meanwhile
+		size_t num_texels = 0;
+		for (const Slice& slice : slices)
+			num_texels += slice.GetNumTexels();
+		size_t num_inserted = 0;
+		std::vector<Slice> new_slices;
+		for (const Refinement& refinement : refinements)
+		{
+			if (refinement.mSlice == slices.size())
+			{
+				// Both neighbours at the start of the pass, before their own refinements
+				const Slice& lower = slices[refinement.mInterval];
+				const Slice& upper = slices[refinement.mInterval + 1];
+				Slice slice;
+				slice.mColumn = (lower.mColumn + upper.mColumn) / 2;
+				for (size_t a = 0; a < Table::NUM_SLICE_AXES; ++a)
+				{
+					const std::vector<size_t>& lower_knots = lower.mAxes[a].mKnots;
+					const std::vector<size_t>& upper_knots = upper.mAxes[a].mKnots;
+					std::set_union(lower_knots.begin(), lower_knots.begin() + lower.mVotes[a].size() + 1, upper_knots.begin(), upper_knots.begin() + upper.mVotes[a].size() + 1,
+						std::back_inserter(slice.mAxes[a].mKnots));
+				}
+				if (num_texels + slice.GetNumTexels() > inSettings.mMaxTexels)
+					continue;
+				num_texels += slice.GetNumTexels();
+				new_slices.push_back(std::move(slice));
+			}
+			else
+			{
+				Slice& slice = slices[refinement.mSlice];
+				std::vector<size_t>& knots = slice.mAxes[refinement.mAxis].mKnots;
+				const size_t before = slice.GetNumTexels();
+				knots.push_back((knots[refinement.mInterval] + knots[refinement.mInterval + 1]) / 2);
+				if (num_texels - before + slice.GetNumTexels() > inSettings.mMaxTexels)
+				{
+					knots.pop_back();
+					continue;
+				}
+				assert(knots.back() != knots[refinement.mInterval]);
+				num_texels += slice.GetNumTexels() - before;
+			}
+			++num_inserted;
+		}
+		if (num_inserted == 0)
+			break;
+		for (Slice& slice : slices)
+		{
+			for (size_t a = 0; a < Table::NUM_SLICE_AXES; ++a)
+				std::sort(slice.mAxes[a].mKnots.begin(), slice.mAxes[a].mKnots.end());
+		}
+		for (Slice& slice : new_slices)
+			slices.push_back(std::move(slice));
+		std::sort(slices.begin(), slices.end(), [](const Slice& inA, const Slice& inB) { return inA.mColumn < inB.mColumn; });
+		error.mNumRefinements += num_inserted;
+	}
+
+	if (outError)
+		*outError = error;
+	std::vector<Table::SliceKnots> slice_knots(slices.size());
+	for (size_t s = 0; s < slices.size(); ++s)
+	{
+		for (size_t a = 0; a < Table::NUM_SLICE_AXES; ++a)
+			slice_knots[s].mKnots[a] = slices[s].mAxes[a].ToUnit(resolution[a]);
+	}
+	return Table(sun_axis.ToUnit(width), slice_knots, inReference);
+}
+
+} // namespace atmosphere
@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <src/lib/math/Math.hpp>
+#include "AtmosphereExport.hpp"
+#include "AtmosphericScattering.hpp"
+#include "LookUpTable.hpp"
+
+namespace atmosphere {
+
+//--------------------------------------------------------------------------------------------
+// Adaptive inscatter look-up table
+//		- The packed inscatter on non-uniform knots along the axes of the 3d parametrization, in two levels : the sun zenith
+//		  knots, and per sun zenith knot a slice with its own knots of the view zenith below and above the horizon (the two
+//		  halves of the 3d tables) and of the height. The twilight slices take the knots they need without the daylight ones.
+//		- The knots are in the coordinates of WorldCoordToUnitLUTCoord(), a piecewise linear warp on top of the fixed ones
+//		- Built from a dense 3d table. The knots are the texel centers of the dense table, an axis is bisected where the
+//		  interpolation misses the dense texels the most, until a maximum relative error or a texel budget is reached.
+//		- An axis locates a coordinate through a uniform index of bins into its knots, no search. The lookup is bilinear
+//		  in the two slices around the sun zenith, then linear between them.
+//--------------------------------------------------------------------------------------------
+struct ATMOSPHERE_EXPORT AdaptiveAxis
+{
+	AdaptiveAxis() = default;
+	// Increasing knots, the first one 0 and the last one 1
+	explicit AdaptiveAxis(const std::vector<float>& inKnots);
+
+	size_t GetNumKnots() const { return mKnots.size(); }
+	const std::vector<float>& GetKnots() const { return mKnots; }
+	// Bytes of the knots and the bins
+	size_t GetMemorySize() const { return mKnots.size() * sizeof(float) + mBins.size() * sizeof(std::uint16_t); }
+
+	// Knots around inCoord and the weight of the second one, inCoord is clamped to [0, 1]
+	detail::LinearTap Locate(float inCoord) const;
+
+protected:
+	std::vector<float>			mKnots;
+	std::vector<std::uint16_t>	mBins;	// interval of the start of every bin, a bin is no wider than the narrowest interval
+};
+
+struct ATMOSPHERE_EXPORT AdaptiveInscatterTable
+{
+	// Axes of a slice
+	enum SliceAxis {
+		VIEW_ZENITH_BELOW = 0,	// below the horizon, 0 at the horizon, 1 at the nadir
+		VIEW_ZENITH_ABOVE,		// above the horizon, 0 at the horizon, 1 at the zenith
+		HEIGHT,
+		NUM_SLICE_AXES,
+	};
+
+	struct SliceKnots
+	{
+		std::vector<float>	mKnots[NUM_SLICE_AXES];
+	};
+
+	AdaptiveInscatterTable() = default;
+	// One slice per sun zenith knot. The texels at the knots are sampled from inReference, a packed inscatter table of any resolution.
+	AdaptiveInscatterTable(const std::vector<float>& inSunZenithKnots, const std::vector<SliceKnots>& inSlices, const LookUpTableView3D<math::Float4>& inReference);
+
+	const AdaptiveAxis& GetSunZenithAxis() const { return mSunZenith; }
+	size_t GetNumSlices() const { return mSlices.size(); }
+	const AdaptiveAxis& GetSliceAxis(size_t inSlice, SliceAxis inAxis) const { return mSlices[inSlice].mAxes[inAxis]; }
+	size_t GetNumTexels() const { return mTexels.size(); }
+	// Bytes of the texels, the axes and the slice offsets
+	size_t GetMemorySize() const;
+
+	// y : view zenith knot of the slice (the ones below the horizon, then the ones above), z : height knot of the slice
+	const math::Float4& At(size_t inSlice, size_t y, size_t z) const
+	{
+		const Slice& slice = mSlices[inSlice];
+		return mTexels[slice.mOffset + y + slice.mHeight * z];
+	}
+
+	// inUnitCoord : WorldCoordToUnitLUTCoord()
+	math::Float4 Sample(const math::Float3& inUnitCoord, bool inIsAboveHorizon) const;
+	math::Float4 Sample(float inHeight, float inCosViewZenith, float inCosLightZenith) const;
+
+	// LookUpPrecomputedScatteringPacked() on this table
+	void LookUp(
+		const math::Float3& inStartPos,
+		const math::Float3& inViewDir,
+		const math::Float3& inLightDir,
+		const math::Float3& inBetaR,
+		math::Float3& outInscatterR,
+		math::Float3& outInscatterM) const;
+
+protected:
+	struct Slice
+	{
+		AdaptiveAxis	mAxes[NUM_SLICE_AXES];
+		size_t			mOffset = 0;	// first texel
+		size_t			mHeight = 0;	// view zenith knots, below and above the horizon
+	};
+
+	math::Float4 SampleSlice(size_t inSlice, float inViewZenith, float inHeight, bool inIsAboveHorizon) const;
+
+	AdaptiveAxis				mSunZenith;
+	std::vector<Slice>			mSlices;
+	std::vector<math::Float4>	mTexels;
+};
+
+struct AdaptiveInscatterSettings
+{
+	float	mMaxRelativeError = 0.01f;		// over the texels of the reference
+	float	mRelativeFloor = 1e-3f;			// a channel is relative to max(value, floor * the largest value of the channel)
+	size_t	mMaxTexels = size_t(1) << 20;	// the refinement stops before the table grows past it
+};
+
+struct AdaptiveInscatterError
+{
+	double	mMaxRelativeError = 0.0;
+	double	mMeanRelativeError = 0.0;
+	size_t	mNumRefinements = 0;	// knots and slices inserted by BuildAdaptiveInscatterTable()
+};
+
+// Error of inTable at the texel centers of inReference, the worst of the 4 channels per texel
+ATMOSPHERE_EXPORT AdaptiveInscatterError MeasureAdaptiveInscatterError(const AdaptiveInscatterTable& inTable, const LookUpTableView3D<math::Float4>& inReference, float inRelativeFloor = 1e-3f);
+
+// Evenly spaced knots, the same in every slice : the 3d table of that resolution (inHeight even) resampled from inReference
+ATMOSPHERE_EXPORT AdaptiveInscatterTable MakeUniformInscatterTable(const LookUpTableView3D<math::Float4>& inReference, size_t inWidth, size_t inHeight, size_t inDepth);
+
+// Starts from the ends of every axis. Every reference texel above the maximum error votes for the interval around it along
+// the axis where the interpolation along that axis alone misses it the most, the sun zenith or an axis of one of the two
+// slices around it, and the voted intervals are bisected. A new slice starts with the knots of both its neighbours.
+ATMOSPHERE_EXPORT AdaptiveInscatterTable BuildAdaptiveInscatterTable(const LookUpTableView3D<math::Float4>& inReference, const AdaptiveInscatterSettings& inSettings,
+	AdaptiveInscatterError* outError = nullptr);
+
+} // namespace atmosphere
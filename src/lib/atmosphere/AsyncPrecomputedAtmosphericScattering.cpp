@@ -0,0 +1,125 @@
+#include "AsyncPrecomputedAtmosphericScattering.hpp"
+
+namespace atmosphere {
+
+AsyncPrecomputedAtmosphericScattering::Result::Result(const Engine& inEngine)
+	: mOpticalDepth(inEngine.GetOpticalDepthTexture())
+	, mTotalInscatter{
+		Engine::Table3D(inEngine.GetTotalInscatterTexture(Engine::RAYLEIGH)),
+		Engine::Table3D(inEngine.GetTotalInscatterTexture(Engine::MIE)) }
+	, mPackInscatter(inEngine.GetPackedTotalInscatterTexture())
+	, mIrradiance(inEngine.GetIrradianceTexture())
+	, mParams(inEngine.GetParam())
+	, mNumScattering(inEngine.GetNumScatteringComputed())
+	, mTimings(inEngine.GetBakeTimings())
+{
+	if (inEngine.HasInscatter4d())
+	{
+		const LookUpTableView4D<math::Float4> inscatter_4d = inEngine.GetPackedInscatter4dTexture();
+		mPackInscatter4d = std::make_unique<Engine::Table3D>(inscatter_4d.GetSlices());
+		mInscatter4dSlices = inscatter_4d.GetNumSlices();
+	}
+}
+
+AsyncPrecomputedAtmosphericScattering::AsyncPrecomputedAtmosphericScattering(const Engine::Desc& inDesc)
+	: mDesc(inDesc)
+{
+	// Constructing a pool per bake would cost more than a small bake
+	if (!mDesc.mScheduler)
+	{
+		mOwnedScheduler = std::make_unique<etc::TaskScheduler>(mDesc.mNumThreads);
+		mDesc.mScheduler = mOwnedScheduler.get();
+	}
+	mEngine = std::make_unique<Engine>(mDesc);
+	mWorker = std::thread(&AsyncPrecomputedAtmosphericScattering::WorkerMain, this);
+}
+
+AsyncPrecomputedAtmosphericScattering::~AsyncPrecomputedAtmosphericScattering()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+		mCancel = true;
+	}
+	mRequestCondition.notify_all();
+	mWorker.join();
+}
+
+std::uint64_t AsyncPrecomputedAtmosphericScattering::Request(const PrecomputedSctrParams& inParams, std::uint32_t inNumScattering)
+{
+	std::uint64_t id;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		id = mNextRequestId++;
+		if (mPendingRequest)
+			mNumCancelled.fetch_add(1, std::memory_order_relaxed); // never started
+		mPendingRequest = std::make_unique<PendingRequest>();
+		mPendingRequest->mId = id;
+		mPendingRequest->mParams = inParams;
+		mPendingRequest->mNumScattering = inNumScattering;
+		if (mIsRunning)
+			mCancel = true;
+	}
+	mRequestCondition.notify_one();
+	return id;
+}
+
+std::unique_ptr<AsyncPrecomputedAtmosphericScattering::Result> AsyncPrecomputedAtmosphericScattering::TakeResult(std::uint64_t* outRequestId)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (outRequestId)
+		*outRequestId = mResult ? mResultId : 0;
+	return std::move(mResult);
+}
+
+bool AsyncPrecomputedAtmosphericScattering::IsBusy() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mIsRunning || mPendingRequest;
+}
+
+void AsyncPrecomputedAtmosphericScattering::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mIdleCondition.wait(lock, [this] { return !mIsRunning && !mPendingRequest; });
+}
+
+void AsyncPrecomputedAtmosphericScattering::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true)
+	{
+		mRequestCondition.wait(lock, [this] { return mQuit || mPendingRequest; });
+		if (mQuit)
+			break;
+
+		// Reset the flag under the lock, a Request() from now on cancels this bake
+		const std::unique_ptr<PendingRequest> request = std::move(mPendingRequest);
+		mIsRunning = true;
+		mCancel = false;
+		lock.unlock();
+
+		// A cancelled bake leaves the stages it did not finish stale, the next request runs them again
+		mEngine->GetParam() = request->mParams;
+		mEngine->SetNumScattering(request->mNumScattering);
+		std::unique_ptr<Result> result = nullptr;
+		if (mEngine->GeneratePrecomputedTexture(&mCancel))
+			result = std::make_unique<Result>(*mEngine);
+
+		lock.lock();
+		mIsRunning = false;
+		if (result && !mPendingRequest)
+		{
+			mResult = std::move(result);
+			mResultId = request->mId;
+		}
+		else
+		{
+			mNumCancelled.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (!mPendingRequest)
+			mIdleCondition.notify_all();
+	}
+}
+
+} // namespace atmosphere
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <src/lib/etc/TaskScheduler.hpp>
+#include "AtmosphereExport.hpp"
+#include "CpuPrecomputedAtmosphericScattering.hpp"
+
+namespace atmosphere {
+
+//--------------------------------------------------------------------------------------------
+// Background precomputation
+//		- Bakes with CpuPrecomputedAtmosphericScattering on a worker thread, the caller keeps rendering with its current tables
+//		- One engine on the worker bakes every request, so only the stages whose inputs changed since the last bake run again
+//		  (ComputeLookUpTableStageFingerprints()). A finished bake is delivered as copies of its tables, the caller swaps
+//		  them in when TakeResult() returns them.
+//		- A newer request cancels the bake that is still running, only the latest parameters are ever delivered
+//--------------------------------------------------------------------------------------------
+struct ATMOSPHERE_EXPORT AsyncPrecomputedAtmosphericScattering
+{
+	using Engine = CpuPrecomputedAtmosphericScattering;
+
+	// The tables of a finished bake, and the parameters they stand for
+	struct Result
+	{
+		explicit Result(const Engine& inEngine);
+
+		Engine::Table2D						mOpticalDepth;
+		Engine::Table3D						mTotalInscatter[2];
+		Engine::Table3D						mPackInscatter;
+		Engine::IrradianceTable				mIrradiance;
+		std::unique_ptr<Engine::Table3D>	mPackInscatter4d = nullptr;	// the slices in the depth, only with Desc::mInscatter4dSlices > 0
+		size_t								mInscatter4dSlices = 0;
+		PrecomputedSctrParams				mParams;
+		std::uint32_t						mNumScattering = 0;	// orders computed
+		BakeTimings							mTimings;			// the stages that ran
+	};
+
+	// inDesc.mScheduler = null : the bakes share a pool of inDesc.mNumThreads threads owned by this object
+	explicit AsyncPrecomputedAtmosphericScattering(const Engine::Desc& inDesc);
+	~AsyncPrecomputedAtmosphericScattering();
+
+	AsyncPrecomputedAtmosphericScattering(const AsyncPrecomputedAtmosphericScattering&) = delete;
+	AsyncPrecomputedAtmosphericScattering& operator=(const AsyncPrecomputedAtmosphericScattering&) = delete;
+
+	// Returns the id of the request, ids increase from 1
+	std::uint64_t Request(const PrecomputedSctrParams& inParams, std::uint32_t inNumScattering);
+
+	// The finished bake of the latest request, or nullptr. Ownership moves to the caller.
+	std::unique_ptr<Result> TakeResult(std::uint64_t* outRequestId = nullptr);
+
+	// A request is pending or being baked
+	bool IsBusy() const;
+
+	// Blocks until the latest request is finished
+	void Wait();
+
+	// Bakes stopped, or thrown away, because a newer request came in
+	std::uint64_t GetNumCancelled() const { return mNumCancelled.load(std::memory_order_relaxed); }
+
+protected:
+	struct PendingRequest
+	{
+		std::uint64_t			mId = 0;
+		PrecomputedSctrParams	mParams;
+		std::uint32_t			mNumScattering = 0;
+	};
+
+	void WorkerMain();
+
+	Engine::Desc							mDesc;
+	std::unique_ptr<etc::TaskScheduler>		mOwnedScheduler = nullptr;
+	std::unique_ptr<Engine>					mEngine = nullptr;	// only used by the worker
+
+	mutable std::mutex				mMutex;
+	std::condition_variable			mRequestCondition;
+	std::condition_variable			mIdleCondition;
+	std::unique_ptr<PendingRequest>	mPendingRequest = nullptr;
+	bool							mIsRunning = false;
+	bool							mQuit = false;
+	std::uint64_t					mNextRequestId = 1;
+	std::unique_ptr<Result>			mResult = nullptr;
+	std::uint64_t					mResultId = 0;
+
+	std::atomic<bool>			mCancel{ false };
+	std::atomic<std::uint64_t>	mNumCancelled{ 0 };
+	std::thread					mWorker;
+};
+
+} // namespace atmosphere
@@ -0,0 +1,11 @@
+#pragma once
+
+#if defined(_WIN32) && defined(BUILD_SHARED_LIBS)
+	#ifdef atmosphere_EXPORTS
+		#define  ATMOSPHERE_EXPORT __declspec( dllexport )
+	#else
+		#define  ATMOSPHERE_EXPORT __declspec( dllimport )
+	#endif
+#else
+	#define	ATMOSPHERE_EXPORT
+#endif
@@ -0,0 +1,904 @@
+#pragma once
+//------------------------------------------------------
+//	Precomputed atmospheric scattering (CPU)
+//		- C++ port of shader/atmosphere/AtmosphericScattering.hlsl.h
+//		- Keep the functions in sync with the shader version so that both paths produce the same LUTs.
+//
+//	 References
+//		[Bruneton08]	Bruneton, E., Neyret, F. "Precomputed atmospheric scattering", Proc. of EGSR'08, Vol 27, no 4, pp. 1079--1086 (2008)
+//		[Elek09]		Elek, O. "Rendering Parametrizable Planetary Atmosphere with Multiple Scattering in Real-Time", CESCG 2009. (2009)
+//		[Yusov13]		Yusov, E. "Outdoor Light Scattering Sample Update", https://software.intel.com/en-us/blogs/2013/09/19/otdoor-light-scattering-sample-update, (2013)
+//		[Borjesson79]	Borjesson, P., Sundberg, C. "Simple Approximations of the Error Function Q(x) for Communications Applications", IEEE Trans. Commun. 27(3), pp. 639--643 (1979)
+//		[Marques13]		Marques, R., Bouville, C., Ribardiere, M., Santos, L. P., Bouatouch, K. "Spherical Fibonacci Point Sets for Illumination Integrals", Computer Graphics Forum 32(8), pp. 134--143 (2013)
+//		[Bogacki89]		Bogacki, P., Shampine, L. F. "A 3(2) pair of Runge - Kutta formulas", Appl. Math. Lett. 2(4), pp. 321--325 (1989)
+//------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <src/lib/math/Math.hpp>
+#include <shader/atmosphere/AtmosphereConstants.h>
+#include "LookUpTable.hpp"
+
+namespace atmosphere {
+
+//------------------------------------------------------
+//	HLSL intrinsics
+//------------------------------------------------------
+inline float Saturate(float x) { return std::min(std::max(x, 0.0f), 1.0f); }
+inline float Lerp(float a, float b, float t) { return a + (b - a) * t; }
+inline float Frac(float x) { return x - std::floor(x); }
+
+inline math::Float3 Exp(const math::Float3& v)
+{
+	return math::Float3(std::exp(v.x), std::exp(v.y), std::exp(v.z));
+}
+
+inline math::Float3 Saturate(const math::Float3& v)
+{
+	return math::Float3(Saturate(v.x), Saturate(v.y), Saturate(v.z));
+}
+
+// Default resolution of the 3d look-up tables
+inline const math::Float3& LUTResolution()
+{
+	static const math::Float3 sResolution(float(TEX4D_U), float(TEX4D_V), float(TEX4D_W));
+	return sResolution;
+}
+
+// Resolution of a 3d look-up table, the parametrization depends on it
+template<typename T> math::Float3 LUTResolution(const LookUpTableView3D<T>& inTable)
+{
+	return math::Float3(float(inTable.GetWidth()), float(inTable.GetHeight()), float(inTable.GetDepth()));
+}
+
+// Resolution of a 4d look-up table, the azimuth slices in w
+template<typename T> math::Float4 LUTResolution(const LookUpTableView4D<T>& inTable)
+{
+	return math::Float4(float(inTable.GetWidth()), float(inTable.GetHeight()), float(inTable.GetDepth()), float(inTable.GetNumSlices()));
+}
+
+// Default resolution of the 2d sunlight / skylight tables
+inline const math::Float2& IrradianceResolution()
+{
+	static const math::Float2 sResolution(float(IRRADIANCE_U), float(IRRADIANCE_V));
+	return sResolution;
+}
+
+template<typename T> math::Float2 LUTResolution(const LookUpTableView2D<T>& inTable)
+{
+	return math::Float2(float(inTable.GetWidth()), float(inTable.GetHeight()));
+}
+
+inline const math::Float3& EarthCenter()
+{
+	static const math::Float3 sEarthCenter = EARTH_CENTER;
+	return sEarthCenter;
+}
+
+//------------------------------------------------------
+//	Intersection tests
+//------------------------------------------------------
+inline math::Float4 RayDoubleSphereIntersect(
+	const math::Float3& inRayOrigin,
+	const math::Float3& inRayDir,
+	const math::Float2& inSphereRadii	//	x = 1st sphere, y = 2nd sphere
+	)
+{
+	const float a = math::InnerProduct(inRayDir, inRayDir);
+	const float b = 2.0f * math::InnerProduct(inRayOrigin, inRayDir);
+	const float origin2 = math::InnerProduct(inRayOrigin, inRayOrigin);
+	math::Float4 distance(-1.0f);
+	for (size_t i = 0; i < 2; ++i)
+	{
+		// d < 0 .. Ray misses the sphere
+		const float c = origin2 - inSphereRadii[i] * inSphereRadii[i];
+		const float d = b * b - 4.0f * a * c;
+		if (d < 0.0f)
+			continue;
+		const float sqrt_d = std::sqrt(d);
+		distance[2 * i + 0] = (-b - sqrt_d) / (2.0f * a);
+		distance[2 * i + 1] = (-b + sqrt_d) / (2.0f * a);
+	}
+	// distance.x = distance to the intersection point of the 1st sphere (near side)
+	// distance.y = distance to the intersection point of the 1st sphere (far side)
+	// distance.z = distance to the intersection point of the 2nd sphere (near side)
+	// distance.w = distance to the intersection point of the 2nd sphere (far side)
+	return distance;
+}
+
+//------------------------------------------------------
+//	 [Bruneton09]
+//------------------------------------------------------
+inline math::Float3 UnpackMieInscatter(const math::Float4& inRayleighMie, const math::Float3& inRayleighScatteringCoeff)
+{
+	const math::Float3 rayleigh(inRayleighMie.x, inRayleighMie.y, inRayleighMie.z);
+	const math::Float3 ratio = math::Float3(inRayleighScatteringCoeff.x) / inRayleighScatteringCoeff;
+	return rayleigh * (inRayleighMie.w / std::max(inRayleighMie.x, 1e-9f)) * ratio;
+}
+
+inline math::Float4 PackInscatter(const math::Float3& inRayleigh, const math::Float3& inMie)
+{
+	return math::Float4(inRayleigh.x, inRayleigh.y, inRayleigh.z, inMie.x);
+}
+
+//------------------------------------------------------
+//	 3d LookUpTable parametrization [Yusov13]
+//------------------------------------------------------
+inline math::Float3 ComputeViewDir(float inCosViewZenith)
+{
+	return math::Float3(std::sqrt(Saturate(1.0f - inCosViewZenith * inCosViewZenith)), inCosViewZenith, 0.0f);
+}
+
+inline math::Float3 ComputeLightDir(const math::Float3& inViewDir, float inCosLightZenith)
+{
+	math::Float3 light_dir;
+	light_dir.x = (inViewDir.x > 0) ? (1.0f - inCosLightZenith * inViewDir.y) / inViewDir.x : 0.0f;
+	light_dir.y = inCosLightZenith;
+	light_dir.z = std::sqrt(Saturate(1.0f - light_dir.x * light_dir.x - light_dir.y * light_dir.y));
+	// Do not normalize light_dir [Yusov13]
+	return light_dir;
+}
+
+inline float GetCosHorizonAngle(float inHeight)
+{
+	// Due to numeric precision issues, height might sometimes be slightly negative [Yusov13]
+	const float height = std::max(inHeight, 0.0f);
+	return -std::sqrt(height * (2.0f * EARTH_RADIUS + height)) / (EARTH_RADIUS + height);
+}
+
+inline float ZenithAngle2TexCoord(float inCosZenith, float inHeight, float inTextureResolution)
+{
+	// See ZenithAngle2TexCoord() in AtmosphericScattering.hlsl.h for the texel layout
+	const float cos_horizon = GetCosHorizonAngle(inHeight);
+	float tex_coord;
+	float offset;
+	if (inCosZenith > cos_horizon)
+	{
+		// Upper half of the texture
+		tex_coord = Saturate((inCosZenith - cos_horizon) / (1.0f - cos_horizon));
+		tex_coord = std::sqrt(std::sqrt(tex_coord));
+		offset = 0.5f;
+	}
+	else
+	{
+		// Lower half of the texture
+		tex_coord = Saturate((cos_horizon - inCosZenith) / (cos_horizon - (-1.0f)));
+		tex_coord = std::sqrt(std::sqrt(tex_coord));
+		offset = 0.0f;
+	}
+	return offset + 0.5f / inTextureResolution + tex_coord * (inTextureResolution / 2.0f - 1.0f) / inTextureResolution;
+}
+
+inline float TexCoord2ZenithAngle(float inTexcoord, float inHeight, float inTextureResolution)
+{
+	const float cos_horizon = GetCosHorizonAngle(inHeight);
+	float cos_zenith;
+	if (inTexcoord > 0.5f)
+	{
+		// Remap to [0,1] from the upper half of the texture [0.5 + 0.5/inTextureResolution, 1 - 0.5/inTextureResolution]
+		float t = Saturate((inTexcoord - (0.5f + 0.5f / inTextureResolution)) * inTextureResolution / (inTextureResolution / 2.0f - 1.0f));
+		t *= t;
+		t *= t;
+		// Assure that the ray does NOT hit Earth
+		cos_zenith = std::max((cos_horizon + t * (1.0f - cos_horizon)), cos_horizon + 1e-4f);
+	}
+	else
+	{
+		// Remap to [0,1] from the lower half of the texture [0.5, 0.5 - 0.5/inTextureResolution]
+		float t = Saturate((inTexcoord - 0.5f / inTextureResolution) * inTextureResolution / (inTextureResolution / 2.0f - 1.0f));
+		t *= t;
+		t *= t;
+		// Assure that the ray DOES hit Earth
+		cos_zenith = std::min((cos_horizon - t * (1.0f + cos_horizon)), cos_horizon - 1e-4f);
+	}
+	return cos_zenith;
+}
+
+inline math::Float3 WorldCoordToLUTCoord(float inHeight, float inCosViewZenith, float inCosLightZenith, const math::Float3& inResolution = LUTResolution())
+{
+	const math::Float3& resolution = inResolution;
+	math::Float3 uvw;
+	const float height = std::min(std::max(inHeight, float(LUT_HEIGHT_MARGIN)), float(ATM_TOP_HEIGHT - LUT_HEIGHT_MARGIN));
+	uvw.z = Saturate((height - float(LUT_HEIGHT_MARGIN)) / float(ATM_TOP_HEIGHT - 2.0 * LUT_HEIGHT_MARGIN));
+	uvw.z = std::sqrt(uvw.z);
+	uvw.y = ZenithAngle2TexCoord(inCosViewZenith, height, resolution.y);
+	uvw.x = (std::atan(std::max(inCosLightZenith, -0.1975f) * std::tan(1.26f * 1.1f)) / 1.1f + (1.0f - 0.26f)) * 0.5f; // Bruneton's formula [Bruneton09]
+	uvw.x = (uvw.x * (resolution.x - 1.0f) + 0.5f) / resolution.x;
+	uvw.z = (uvw.z * (resolution.z - 1.0f) + 0.5f) / resolution.z;
+	return uvw;
+}
+
+inline void LUTCoordToWorldCoord(
+	const math::Float3& inUVW,
+	float& outHeight,
+	float& outCosViewZenith,
+	float& outCosLightZenith,
+	const math::Float3& inResolution = LUTResolution())
+{
+	const math::Float3& resolution = inResolution;
+	// Rescale to exactly 0,1 range
+	const float u = Saturate((inUVW.x * resolution.x - 0.5f) / (resolution.x - 1.0f));
+	float w = Saturate((inUVW.z * resolution.z - 0.5f) / (resolution.z - 1.0f));
+	w = w * w;
+	outHeight = w * float(ATM_TOP_HEIGHT - 2.0 * LUT_HEIGHT_MARGIN) + float(LUT_HEIGHT_MARGIN);
+	outCosViewZenith = TexCoord2ZenithAngle(inUVW.y, outHeight, resolution.y);
+	outCosLightZenith = std::tan((2.0f * u - 1.0f + 0.26f) * 1.1f) / std::tan(1.26f * 1.1f); // Bruneton's formula [Bruneton09]
+}
+
+// The warps of WorldCoordToLUTCoord() without the texel layout, every axis in [0, 1]
+//	- x : sun zenith, z : height
+//	- y : view zenith within its half of the table, 0 at the horizon and 1 at the zenith or the nadir. outIsAboveHorizon tells the half.
+inline math::Float3 WorldCoordToUnitLUTCoord(float inHeight, float inCosViewZenith, float inCosLightZenith, bool& outIsAboveHorizon)
+{
+	math::Float3 unit;
+	const float height = std::min(std::max(inHeight, float(LUT_HEIGHT_MARGIN)), float(ATM_TOP_HEIGHT - LUT_HEIGHT_MARGIN));
+	unit.z = std::sqrt(Saturate((height - float(LUT_HEIGHT_MARGIN)) / float(ATM_TOP_HEIGHT - 2.0 * LUT_HEIGHT_MARGIN)));
+	const float cos_horizon = GetCosHorizonAngle(height);
+	outIsAboveHorizon = (inCosViewZenith > cos_horizon);
+	unit.y = outIsAboveHorizon
+		? Saturate((inCosViewZenith - cos_horizon) / (1.0f - cos_horizon))
+		: Saturate((cos_horizon - inCosViewZenith) / (cos_horizon - (-1.0f)));
+	unit.y = std::sqrt(std::sqrt(unit.y));
+	unit.x = (std::atan(std::max(inCosLightZenith, -0.1975f) * std::tan(1.26f * 1.1f)) / 1.1f + (1.0f - 0.26f)) * 0.5f; // Bruneton's formula [Bruneton09]
+	return unit;
+}
+
+inline math::Float3 ComputeLUTCoord(const math::Float3& inStartPos, const math::Float3& inViewDir, const math::Float3& inLightDir, const math::Float3& inResolution = LUTResolution())
+{
+	math::Float3 dir = inStartPos - EarthCenter();
+	const float dist = math::L2Norm(dir);
+	dir = dir / dist;
+	const float height = dist - EARTH_RADIUS;
+	const float cos_view_zenith = math::InnerProduct(dir, inViewDir);
+	const float cos_light_zenith = math::InnerProduct(dir, inLightDir);
+	return WorldCoordToLUTCoord(height, cos_view_zenith, cos_light_zenith, inResolution);
+}
+
+inline math::Float4 SamplePrecomputedTexture(
+	const math::Float3& inStartPos,
+	const math::Float3& inViewDir,
+	const math::Float3& inLightDir,
+	const LookUpTableView3D<math::Float4>& inTexture3d)
+{
+	return inTexture3d.Sample(ComputeLUTCoord(inStartPos, inViewDir, inLightDir, LUTResolution(inTexture3d)));
+}
+
+inline void LookUpPrecomputedScatteringSeparated(
+	const math::Float3& inStartPos,
+	const math::Float3& inViewDir,
+	const math::Float3& inLightDir,
+	const LookUpTableView3D<math::Float4>& inInscatterTextureR,
+	const LookUpTableView3D<math::Float4>& inInscatterTextureM,
+	math::Float3& outInscatterR,
+	math::Float3& outInscatterM)
+{
+	// Both textures share the parametrization, compute the texture coordinate once
+	const math::Float3 uvw = ComputeLUTCoord(inStartPos, inViewDir, inLightDir, LUTResolution(inInscatterTextureR));
+	const math::Float4 inscatter_r = inInscatterTextureR.Sample(uvw);
+	const math::Float4 inscatter_m = inInscatterTextureM.Sample(uvw);
+	outInscatterR = math::Float3(inscatter_r.x, inscatter_r.y, inscatter_r.z);
+	outInscatterM = math::Float3(inscatter_m.x, inscatter_m.y, inscatter_m.z);
+}
+
+inline void LookUpPrecomputedScatteringPacked(
+	const math::Float3& inStartPos,
+	const math::Float3& inViewDir,
+	const math::Float3& inLightDir,
+	const math::Float3& inBetaR,
+	const LookUpTableView3D<math::Float4>& inPackedInscatterTexture,
+	math::Float3& outInscatterR,
+	math::Float3& outInscatterM)
+{
+	const math::Float4 packed_inscatter = SamplePrecomputedTexture(inStartPos, inViewDir, inLightDir, inPackedInscatterTexture);
+	outInscatterR = math::Float3(packed_inscatter.x, packed_inscatter.y, packed_inscatter.z);
+	outInscatterM = UnpackMieInscatter(packed_inscatter, inBetaR);
+}
+
+//------------------------------------------------------
+//	 4d LookUpTable parametrization
+//		- (u, v, w) of the 3d tables, and q : azimuth between the view and the sun directions around the zenith,
+//		  linear in the angle over [0, PI]. The sky is symmetric about the plane of the sun, -PI..0 mirrors it.
+//		- The light direction is normalized, the 3d tables make it up with ComputeLightDir() instead, and the sun zenith
+//		  along the view ray is only right for one azimuth. It matters at low sun, where the shadow of the earth and the
+//		  sunlight path length change quickly with the azimuth.
+//------------------------------------------------------
+inline math::Float3 ComputeLightDir4D(float inCosLightZenith, float inCosAzimuth)
+{
+	// In the frame of ComputeViewDir() : the view direction is in the xy plane toward +x
+	const float sin_light_zenith = std::sqrt(Saturate(1.0f - inCosLightZenith * inCosLightZenith));
+	const float cos_azimuth = std::min(std::max(inCosAzimuth, -1.0f), 1.0f);
+	const float sin_azimuth = std::sqrt(Saturate(1.0f - cos_azimuth * cos_azimuth));
+	return math::Float3(sin_light_zenith * cos_azimuth, inCosLightZenith, sin_light_zenith * sin_azimuth);
+}
+
+inline float Azimuth2TexCoord(float inCosAzimuth, float inTextureResolution)
+{
+	const float azimuth = std::acos(std::min(std::max(inCosAzimuth, -1.0f), 1.0f)) / math::PI<float>;
+	return (azimuth * (inTextureResolution - 1.0f) + 0.5f) / inTextureResolution;
+}
+
+inline float TexCoord2Azimuth(float inTexcoord, float inTextureResolution)
+{
+	const float azimuth = Saturate((inTexcoord * inTextureResolution - 0.5f) / (inTextureResolution - 1.0f));
+	return std::cos(azimuth * math::PI<float>);
+}
+
+inline math::Float4 WorldCoordToLUTCoord4D(float inHeight, float inCosViewZenith, float inCosLightZenith, float inCosAzimuth, const math::Float4& inResolution)
+{
+	const math::Float3 uvw = WorldCoordToLUTCoord(inHeight, inCosViewZenith, inCosLightZenith, math::Float3(inResolution.x, inResolution.y, inResolution.z));
+	return math::Float4(uvw.x, uvw.y, uvw.z, Azimuth2TexCoord(inCosAzimuth, inResolution.w));
+}
+
+inline void LUTCoordToWorldCoord4D(
+	const math::Float4& inUVWQ,
+	float& outHeight,
+	float& outCosViewZenith,
+	float& outCosLightZenith,
+	float& outCosAzimuth,
+	const math::Float4& inResolution)
+{
+	LUTCoordToWorldCoord(math::Float3(inUVWQ.x, inUVWQ.y, inUVWQ.z), outHeight, outCosViewZenith, outCosLightZenith,
+		math::Float3(inResolution.x, inResolution.y, inResolution.z));
+	outCosAzimuth = TexCoord2Azimuth(inUVWQ.w, inResolution.w);
+}
+
+inline math::Float4 ComputeLUTCoord4D(const math::Float3& inStartPos, const math::Float3& inViewDir, const math::Float3& inLightDir, const math::Float4& inResolution)
+{
+	math::Float3 dir = inStartPos - EarthCenter();
+	const float dist = math::L2Norm(dir);
+	dir = dir / dist;
+	const float height = dist - EARTH_RADIUS;
+	const float cos_view_zenith = math::InnerProduct(dir, inViewDir);
+	const float cos_light_zenith = math::InnerProduct(dir, inLightDir);
+
+	// Azimuth between the projections on the horizontal plane, 0 when either direction is vertical
+	const math::Float3 view_horizontal = inViewDir - dir * cos_view_zenith;
+	const math::Float3 light_horizontal = inLightDir - dir * cos_light_zenith;
+	const float length_product = math::L2Norm(view_horizontal) * math::L2Norm(light_horizontal);
+	const float cos_azimuth = (length_product > 1e-6f) ? math::InnerProduct(view_horizontal, light_horizontal) / length_product : 1.0f;
+	return WorldCoordToLUTCoord4D(height, cos_view_zenith, cos_light_zenith, cos_azimuth, inResolution);
+}
+
+inline void LookUpPrecomputedScatteringPacked4D(
+	const math::Float3& inStartPos,
+	const math::Float3& inViewDir,
+	const math::Float3& inLightDir,
+	const math::Float3& inBetaR,
+	const LookUpTableView4D<math::Float4>& inPackedInscatterTexture,
+	math::Float3& outInscatterR,
+	math::Float3& outInscatterM)
+{
+	const math::Float4 packed_inscatter = inPackedInscatterTexture.Sample(ComputeLUTCoord4D(inStartPos, inViewDir, inLightDir, LUTResolution(inPackedInscatterTexture)));
+	outInscatterR = math::Float3(packed_inscatter.x, packed_inscatter.y, packed_inscatter.z);
+	outInscatterM = UnpackMieInscatter(packed_inscatter, inBetaR);
+}
+
+//------------------------------------------------------
+//	 2d LookUpTable parametrization for sunlight and skylight
+//		- u : height, v : sun zenith, the same mappings as w and u of the 3d tables
+//------------------------------------------------------
+inline void SunlightLUTCoordToWorldCoord(const math::Float2& inUV, float& outHeight, float& outSunZenith, const math::Float2& inResolution = IrradianceResolution())
+{
+	// Rescale to exactly 0,1 range
+	const float u = Saturate((inUV.x * inResolution.x - 0.5f) / (inResolution.x - 1.0f));
+	const float v = Saturate((inUV.y * inResolution.y - 0.5f) / (inResolution.y - 1.0f));
+	outHeight = u * u * float(ATM_TOP_HEIGHT - 2.0 * LUT_HEIGHT_MARGIN) + float(LUT_HEIGHT_MARGIN);
+	outSunZenith = std::tan((2.0f * v - 1.0f + 0.26f) * 1.1f) / std::tan(1.26f * 1.1f); // Bruneton's formula [Bruneton09]
+}
+
+inline math::Float2 WorldCoordToSunlightLUTCoord(float inHeight, float inSunZenith, const math::Float2& inResolution = IrradianceResolution())
+{
+	const float height = std::min(std::max(inHeight, float(LUT_HEIGHT_MARGIN)), float(ATM_TOP_HEIGHT - LUT_HEIGHT_MARGIN));
+	math::Float2 uv;
+	uv.x = std::sqrt(Saturate((height - float(LUT_HEIGHT_MARGIN)) / float(ATM_TOP_HEIGHT - 2.0 * LUT_HEIGHT_MARGIN)));
+	uv.y = (std::atan(std::max(inSunZenith, -0.1975f) * std::tan(1.26f * 1.1f)) / 1.1f + (1.0f - 0.26f)) * 0.5f; // Bruneton's formula [Bruneton09]
+	uv.x = (uv.x * (inResolution.x - 1.0f) + 0.5f) / inResolution.x;
+	uv.y = (uv.y * (inResolution.y - 1.0f) + 0.5f) / inResolution.y;
+	return uv;
+}
+
+//------------------------------------------------------
+//	Phase functions
+//------------------------------------------------------
+inline float RayleighPhase(float mu)
+{
+	return 3.0f / 4.0f * 1.0f / (4.0f * math::PI<float>) * (1.0f + mu * mu);
+}
+
+inline float HenyeyGreensteinPhaseFunc(float mu, float g)
+{
+	return (1.0f - g * g) / ((4.0f * math::PI<float>) * std::pow(1.0f + g * g - 2.0f * g * mu, 1.5f));
+}
+
+inline float CornetteShanksPhaseFunc(float mu, float g)
+{
+	return (3.0f / 2.0f) / (4.0f * math::PI<float>) * (1.0f - g * g) / (2.0f + g * g) * (1.0f + mu * mu) * std::pow(std::abs(1.0f + g * g - 2.0f * g * mu), -1.5f);
+}
+
+inline float MiePhase(float mu, float g)
+{
+	return CornetteShanksPhaseFunc(mu, g);
+}
+
+//------------------------------------------------------
+//	Naive optical depth
+//		- We call the optical depth considering only height-falloff as "naive optical depth"
+//------------------------------------------------------
+inline math::Float2 CalulateNaiveOpticalDepth(
+	const math::Float3& inStartPos,
+	const math::Float3& inEndPos,
+	const math::Float2& inScaleHeights,
+	const int inNumSteps)
+{
+	const math::Float3	dr			= (inEndPos - inStartPos) / float(inNumSteps);
+	const float			length_dr	= math::L2Norm(dr);
+
+	math::Float2 optical_depth(0.0f);
+	for (int i = 0; i <= inNumSteps; ++i)
+	{
+		const math::Float3	curr_pos	= inStartPos + dr * float(i);
+		const float			height		= std::abs(math::L2Norm(curr_pos - EarthCenter()) - EARTH_RADIUS);
+		optical_depth.x += std::exp(-height / inScaleHeights.x) * length_dr;
+		optical_depth.y += std::exp(-height / inScaleHeights.y) * length_dr;
+	}
+	return optical_depth;
+}
+
+inline math::Float2 CalculateNaiveOpticalDepthAlongRay(
+	const math::Float3& inWorldPos,
+	const math::Float3& inRayDir,
+	const math::Float2& inScaleHeights,
+	const int inNumSteps)
+{
+	// Ray - {Earth, The top of atmosphere} intersection test
+	const math::Float4 distances = RayDoubleSphereIntersect(inWorldPos - EarthCenter(), inRayDir, math::Float2(EARTH_RADIUS, ATM_TOP_RADIUS));
+	if (distances.x > 0)
+		return math::Float2(1e20f, 1e20f); // huge optical depth
+
+	const float			ray_length			= distances.w; // far side of the top of atmosphere
+	const math::Float3	intersection_pos	= inWorldPos + inRayDir * ray_length;
+	return CalulateNaiveOpticalDepth(inWorldPos, intersection_pos, inScaleHeights, inNumSteps);
+}
+
+//------------------------------------------------------
+//	Analytic optical depth
+//		- Optical depth to the top of the atmosphere in closed form, replaces the optical depth texture
+//		- Chapman function Ch(x, mu) ~ sqrt(pi x / 2) erfcx(mu sqrt(x / 2)), x = r / H (second order in the curvature of the ray)
+//		- Rays below the horizontal use Ch(x, -mu) = 2 exp(x - x0) Ch(x0, 0) - Ch(x, mu), x0 = x sin(zenith)
+//		- The atmosphere is assumed to extend to infinity, exp(-ATM_TOP_HEIGHT / H) is negligible
+//------------------------------------------------------
+enum class OpticalDepthMode
+{
+	Table = 0,	// Sampled from the optical depth texture (128 steps numeric integration per texel)
+	Analytic,	// CalculateAnalyticOpticalDepthToTop()
+};
+
+// exp(y^2) erfc(y) for y >= 0, relative error < 0.3% [Borjesson79]
+inline float ErfcxApprox(float y)
+{
+	const float a = 0.339f;
+	const float b = 5.510f;
+	return 0.7978845608f / ((1.0f - a) * 1.4142135624f * y + a * std::sqrt(2.0f * y * y + b));
+}
+
+// Ch(x, mu) for mu >= 0
+inline float ChapmanUpper(float x, float mu)
+{
+	return std::sqrt(0.5f * math::PI<float> * x) * ErfcxApprox(mu * std::sqrt(0.5f * x));
+}
+
+inline float AnalyticOpticalDepth(float inHeight, float inCosZenith, float inScaleHeight)
+{
+	const float r = EARTH_RADIUS + inHeight;
+	const float x = r / inScaleHeight;
+	const float upper = inScaleHeight * std::exp(-inHeight / inScaleHeight) * ChapmanUpper(x, std::abs(inCosZenith));
+	if (inCosZenith >= 0.0f)
+		return upper;
+
+	// Twice the optical depth of the whole horizontal ray through the periapsis, minus the opposite direction
+	const float r0 = r * std::sqrt(Saturate(1.0f - inCosZenith * inCosZenith));
+	return inScaleHeight * 2.0f * std::exp(-(r0 - EARTH_RADIUS) / inScaleHeight) * std::sqrt(0.5f * math::PI<float> * r0 / inScaleHeight) - upper;
+}
+
+inline math::Float2 CalculateAnalyticOpticalDepthToTop(float inHeight, float inCosZenith, const math::Float2& inScaleHeights)
+{
+	const float height = std::max(inHeight, 0.0f);
+	if (inCosZenith < GetCosHorizonAngle(height))
+		return math::Float2(1e20f, 1e20f); // huge optical depth, same as CalculateNaiveOpticalDepthAlongRay()
+	return math::Float2(AnalyticOpticalDepth(height, inCosZenith, inScaleHeights.x), AnalyticOpticalDepth(height, inCosZenith, inScaleHeights.y));
+}
+
+//------------------------------------------------------
+//	 Single scattering
+//------------------------------------------------------
+inline math::Float2 SampleOpticalDepth(const LookUpTableView2D<math::Float2>& inOpticalDepthTexture, float inHeight, float inCosLightZenith)
+{
+	return inOpticalDepthTexture.Sample(math::Float2(inHeight / ATM_TOP_HEIGHT, inCosLightZenith * 0.5f + 0.5f));
+}
+
+// Optical depth from a point to the top of the atmosphere, from the optical depth texture or in closed form
+inline math::Float2 GetOpticalDepthToTop(
+	float inHeight,
+	float inCosZenith,
+	const math::Float2& inScaleHeights,
+	OpticalDepthMode inOpticalDepthMode,
+	const LookUpTableView2D<math::Float2>& inOpticalDepthTexture)
+{
+	if (inOpticalDepthMode == OpticalDepthMode::Analytic)
+		return CalculateAnalyticOpticalDepthToTop(inHeight, inCosZenith, inScaleHeights);
+	return SampleOpticalDepth(inOpticalDepthTexture, inHeight, inCosZenith);
+}
+
+inline void SingleScattering(
+	const math::Float3& inStartPos,
+	const math::Float3& inEndPos,
+	const math::Float3& inLightDir,
+	const PrecomputedSctrParams& inParams,
+	const LookUpTableView2D<math::Float2>& inOpticalDepthTexture,
+	OpticalDepthMode inOpticalDepthMode,
+	math::Float3& outInscatterR,
+	math::Float3& outInscatterM,
+	math::Float3& outTransmittance,
+	const int inNumSteps)
+{
+	outInscatterR = math::Float3(0.0f);
+	outInscatterM = math::Float3(0.0f);
+
+	const math::Float3 dr = (inEndPos - inStartPos) / float(inNumSteps);
+	const float length_dr = math::L2Norm(dr);
+
+	const float mie_g = 0.0f;
+	const math::Float3 betaR = inParams.mRayleighSctrCoeff;
+	const math::Float3 betaM = inParams.mMieSctrCoeff * (inParams.mMieAbsorption * (1.0f - mie_g));
+	const math::Float2 scale_height(inParams.mRayleighScaleHeight, inParams.mMieScaleHeight);
+
+	math::Float2 optdepth_from_cam(0.0f);
+	// Integrand: exp(-h(x)/H) * t(x->Pc) * t(x->s)
+	for (int i = 0; i <= inNumSteps; i++)
+	{
+		const math::Float3 sample_pos = inStartPos + dr * float(i);
+		const math::Float3 earth_to_sample = sample_pos - EarthCenter();
+		const float dist = math::L2Norm(earth_to_sample);
+
+		// optdepth_from_cam_integrand = ( exp(-h(x)/HR), exp(-h(x)/HM) )
+		const float height = dist - EARTH_RADIUS;
+		const math::Float2 optdepth_from_cam_integrand(std::exp(-height / inParams.mRayleighScaleHeight), std::exp(-height / inParams.mMieScaleHeight));
+
+		// optdepth_to_top is precalculated in the texture, or computed in closed form
+		const float cos_light_zenith = math::InnerProduct(earth_to_sample / dist, inLightDir);
+		const math::Float2 optdepth_to_top = GetOpticalDepthToTop(height, cos_light_zenith, scale_height, inOpticalDepthMode, inOpticalDepthTexture);
+
+		const math::Float3 trans_from_cam	= Exp(-(betaR * optdepth_from_cam.x + betaM * optdepth_from_cam.y));
+		const math::Float3 trans_to_top		= Exp(-(betaR * optdepth_to_top.x + betaM * optdepth_to_top.y));
+		const math::Float3 trans = trans_from_cam * trans_to_top;
+
+		outInscatterR += trans * (optdepth_from_cam_integrand.x * length_dr);
+		outInscatterM += trans * (optdepth_from_cam_integrand.y * length_dr);
+		optdepth_from_cam = optdepth_from_cam + optdepth_from_cam_integrand * length_dr;
+	}
+
+	outTransmittance = Exp(-(betaR * optdepth_from_cam.x + betaM * optdepth_from_cam.y));
+	outInscatterR *= inParams.mRayleighSctrCoeff;
+	outInscatterM *= inParams.mMieSctrCoeff;
+}
+
+//------------------------------------------------------
+//	 Multiple scattering
+//------------------------------------------------------
+inline void MultipleScattering(
+	const math::Float3& inStartPos,
+	const math::Float3& inEndPos,
+	const math::Float3& inLightDir,
+	const PrecomputedSctrParams& inParams,
+	const LookUpTableView3D<math::Float4>& inInscatterTextureR,
+	const LookUpTableView3D<math::Float4>& inInscatterTextureM,
+	math::Float3& outInscatterR,
+	math::Float3& outInscatterM,
+	math::Float3& outTransmittance,
+	const int inNumSteps)
+{
+	outInscatterR = math::Float3(0.0f);
+	outInscatterM = math::Float3(0.0f);
+
+	const math::Float3 dr = (inEndPos - inStartPos) / float(inNumSteps);
+	const math::Float3 view_dir = math::L2Normalize(inEndPos - inStartPos);
+	const float length_dr = math::L2Norm(dr);
+
+	const float mie_g = 0.0f;
+	const math::Float3 betaR = inParams.mRayleighSctrCoeff;
+	const math::Float3 betaM = inParams.mMieSctrCoeff * (inParams.mMieAbsorption * (1.0f - mie_g));
+
+	math::Float2 optdepth_from_cam(0.0f);
+	for (int i = 0; i <= inNumSteps; i++)
+	{
+		const math::Float3 sample_pos = inStartPos + dr * float(i);
+
+		// optdepth_from_cam_integrand = ( exp(-h(x)/HR), exp(-h(x)/HM) )
+		const float height = math::L2Norm(sample_pos - EarthCenter()) - EARTH_RADIUS;
+		const math::Float2 optdepth_from_cam_integrand(std::exp(-height / inParams.mRayleighScaleHeight), std::exp(-height / inParams.mMieScaleHeight));
+		const math::Float3 trans_from_cam = Exp(-(betaR * optdepth_from_cam.x + betaM * optdepth_from_cam.y));
+
+		math::Float3 inscatter_r, inscatter_m;
+		LookUpPrecomputedScatteringSeparated(
+			sample_pos, view_dir, inLightDir,
+			inInscatterTextureR, inInscatterTextureM,
+			inscatter_r, inscatter_m);
+		outInscatterR += inscatter_r * trans_from_cam * (optdepth_from_cam_integrand.x * length_dr);
+		outInscatterM += inscatter_m * trans_from_cam * (optdepth_from_cam_integrand.y * length_dr);
+		optdepth_from_cam = optdepth_from_cam + optdepth_from_cam_integrand * length_dr;
+	}
+
+	outTransmittance = Exp(-(betaR * optdepth_from_cam.x + betaM * optdepth_from_cam.y));
+	outInscatterR *= inParams.mRayleighSctrCoeff;
+	outInscatterM *= inParams.mMieSctrCoeff;
+}
+
+//------------------------------------------------------
+//	Adaptive step integration
+//		- Error-controlled alternative to the uniform steps of SingleScattering() / MultipleScattering()
+//		- The state y = (optical depth from the camera, inscatter R, inscatter M) is an ODE along the ray,
+//		  integrated with the embedded Bogacki-Shampine 3(2) pair [Bogacki89]
+//		- inSource(pos, outSourceR, outSourceM) is the radiance arriving at pos, before the camera transmittance
+//		- Each step is accepted when |y3 - y2| < tolerance * |y| for every component, the step size follows err^(-1/3)
+//		- Returns the number of sample positions evaluated, comparable to the inNumSteps + 1 samples of the uniform version
+//------------------------------------------------------
+
+struct AdaptiveIntegrationSettings
+{
+	float	mTolerance		= 1e-3f;	// relative, per step
+	int		mInitialSteps	= 16;		// the first step is ray length / mInitialSteps
+	int		mMaxSteps		= 4096;		// the smallest step is ray length / mMaxSteps
+};
+
+template<typename SourceFunc>
+inline int IntegrateInscatterAdaptive(
+	const math::Float3& inStartPos,
+	const math::Float3& inEndPos,
+	const PrecomputedSctrParams& inParams,
+	const AdaptiveIntegrationSettings& inSettings,
+	SourceFunc&& inSource,
+	math::Float3& outInscatterR,
+	math::Float3& outInscatterM,
+	math::Float3& outTransmittance)
+{
+	const float mie_g = 0.0f;
+	const math::Float3 betaR = inParams.mRayleighSctrCoeff;
+	const math::Float3 betaM = inParams.mMieSctrCoeff * (inParams.mMieAbsorption * (1.0f - mie_g));
+
+	const float ray_length = math::L2Norm(inEndPos - inStartPos);
+	const math::Float3 view_dir = (ray_length > 0.0f) ? (inEndPos - inStartPos) / ray_length : math::Float3(0.0f);
+	const float min_step = ray_length / float(inSettings.mMaxSteps);
+
+	// Everything but the camera transmittance depends on the position only, the stages of a step reuse it
+	struct Sample
+	{
+		math::Float2	density;	// ( exp(-h(x)/HR), exp(-h(x)/HM) )
+		math::Float3	source_r;
+		math::Float3	source_m;
+	};
+	struct State
+	{
+		math::Float2	optdepth;
+		math::Float3	inscatter_r;
+		math::Float3	inscatter_m;
+	};
+
+	int num_samples = 0;
+	auto sample = [&](float t)
+	{
+		const math::Float3 pos = inStartPos + view_dir * t;
+		const float height = math::L2Norm(pos - EarthCenter()) - EARTH_RADIUS;
+		Sample s;
+		s.density = math::Float2(std::exp(-height / inParams.mRayleighScaleHeight), std::exp(-height / inParams.mMieScaleHeight));
+		inSource(pos, s.source_r, s.source_m);
+		++num_samples;
+		return s;
+	};
+	auto derivative = [&](const Sample& s, const math::Float2& optdepth)
+	{
+		const math::Float3 trans_from_cam = Exp(-(betaR * optdepth.x + betaM * optdepth.y));
+		State d;
+		d.optdepth = s.density;
+		d.inscatter_r = s.source_r * trans_from_cam * s.density.x;
+		d.inscatter_m = s.source_m * trans_from_cam * s.density.y;
+		return d;
+	};
+	auto axpy = [](const State& y, float h, const State& k)
+	{
+		State r;
+		r.optdepth = y.optdepth + k.optdepth * h;
+		r.inscatter_r = y.inscatter_r + k.inscatter_r * h;
+		r.inscatter_m = y.inscatter_m + k.inscatter_m * h;
+		return r;
+	};
+	// max over the components of |a - b| / (tolerance * max(|a|, |b|))
+	auto error_ratio = [&](const State& a, const State& b)
+	{
+		const float tiny = 1e-20f;
+		float ratio = 0.0f;
+		auto accumulate = [&](float x, float y)
+		{
+			ratio = std::max(ratio, std::abs(x - y) / (inSettings.mTolerance * std::max(std::max(std::abs(x), std::abs(y)), tiny)));
+		};
+		for (size_t c = 0; c < 2; ++c)
+			accumulate(a.optdepth[c], b.optdepth[c]);
+		for (size_t c = 0; c < 3; ++c)
+		{
+			accumulate(a.inscatter_r[c], b.inscatter_r[c]);
+			accumulate(a.inscatter_m[c], b.inscatter_m[c]);
+		}
+		return ratio;
+	};
+
+	State y{ math::Float2(0.0f), math::Float3(0.0f), math::Float3(0.0f) };
+	float t = 0.0f;
+	float h = ray_length / float(std::max(inSettings.mInitialSteps, 1));
+	Sample s0 = sample(0.0f);
+	State k1 = derivative(s0, y.optdepth);
+	while (ray_length - t > 1e-6f * ray_length)
+	{
+		h = std::min(std::max(h, min_step), ray_length - t);
+		const Sample s2 = sample(t + 0.5f * h);
+		const Sample s3 = sample(t + 0.75f * h);
+		const Sample s4 = sample(t + h);
+
+		const State k2 = derivative(s2, axpy(y, 0.5f * h, k1).optdepth);
+		const State k3 = derivative(s3, axpy(y, 0.75f * h, k2).optdepth);
+		State y3 = axpy(y, h * (2.0f / 9.0f), k1);
+		y3 = axpy(y3, h * (1.0f / 3.0f), k2);
+		y3 = axpy(y3, h * (4.0f / 9.0f), k3);
+		const State k4 = derivative(s4, y3.optdepth);
+
+		State y2 = axpy(y, h * (7.0f / 24.0f), k1);
+		y2 = axpy(y2, h * 0.25f, k2);
+		y2 = axpy(y2, h * (1.0f / 3.0f), k3);
+		y2 = axpy(y2, h * 0.125f, k4);
+
+		const float ratio = error_ratio(y3, y2);
+		if (ratio <= 1.0f || h <= min_step)
+		{
+			// Accept, the last stage is the first stage of the next step (FSAL)
+			t += h;
+			y = y3;
+			k1 = k4;
+		}
+		const float safety = 0.9f;
+		h *= std::min(std::max(safety / std::cbrt(std::max(ratio, 1e-6f)), 0.2f), 5.0f);
+	}
+
+	outTransmittance = Exp(-(betaR * y.optdepth.x + betaM * y.optdepth.y));
+	outInscatterR = y.inscatter_r * inParams.mRayleighSctrCoeff;
+	outInscatterM = y.inscatter_m * inParams.mMieSctrCoeff;
+	return num_samples;
+}
+
+// SingleScattering() with adaptive steps
+inline int SingleScatteringAdaptive(
+	const math::Float3& inStartPos,
+	const math::Float3& inEndPos,
+	const math::Float3& inLightDir,
+	const PrecomputedSctrParams& inParams,
+	const LookUpTableView2D<math::Float2>& inOpticalDepthTexture,
+	OpticalDepthMode inOpticalDepthMode,
+	const AdaptiveIntegrationSettings& inSettings,
+	math::Float3& outInscatterR,
+	math::Float3& outInscatterM,
+	math::Float3& outTransmittance)
+{
+	const float mie_g = 0.0f;
+	const math::Float3 betaR = inParams.mRayleighSctrCoeff;
+	const math::Float3 betaM = inParams.mMieSctrCoeff * (inParams.mMieAbsorption * (1.0f - mie_g));
+	const math::Float2 scale_height(inParams.mRayleighScaleHeight, inParams.mMieScaleHeight);
+	auto source = [&](const math::Float3& inPos, math::Float3& outSourceR, math::Float3& outSourceM)
+	{
+		const math::Float3 earth_to_sample = inPos - EarthCenter();
+		const float dist = math::L2Norm(earth_to_sample);
+		const float cos_light_zenith = math::InnerProduct(earth_to_sample / dist, inLightDir);
+		const math::Float2 optdepth_to_top = GetOpticalDepthToTop(dist - EARTH_RADIUS, cos_light_zenith, scale_height, inOpticalDepthMode, inOpticalDepthTexture);
+		outSourceR = Exp(-(betaR * optdepth_to_top.x + betaM * optdepth_to_top.y));
+		outSourceM = outSourceR;
+	};
+	return IntegrateInscatterAdaptive(inStartPos, inEndPos, inParams, inSettings, source, outInscatterR, outInscatterM, outTransmittance);
+}
+
+// MultipleScattering() with adaptive steps
+inline int MultipleScatteringAdaptive(
+	const math::Float3& inStartPos,
+	const math::Float3& inEndPos,
+	const math::Float3& inLightDir,
+	const PrecomputedSctrParams& inParams,
+	const LookUpTableView3D<math::Float4>& inInscatterTextureR,
+	const LookUpTableView3D<math::Float4>& inInscatterTextureM,
+	const AdaptiveIntegrationSettings& inSettings,
+	math::Float3& outInscatterR,
+	math::Float3& outInscatterM,
+	math::Float3& outTransmittance)
+{
+	const math::Float3 view_dir = math::L2Normalize(inEndPos - inStartPos);
+	auto source = [&](const math::Float3& inPos, math::Float3& outSourceR, math::Float3& outSourceM)
+	{
+		LookUpPrecomputedScatteringSeparated(inPos, view_dir, inLightDir, inInscatterTextureR, inInscatterTextureM, outSourceR, outSourceM);
+	};
+	return IntegrateInscatterAdaptive(inStartPos, inEndPos, inParams, inSettings, source, outInscatterR, outInscatterM, outTransmittance);
+}
+
+//------------------------------------------------------
+//	Gather quadrature
+//		- Directions of GatherInscatter(), hashed random directions or a spherical Fibonacci set [Marques13]
+//		- The Fibonacci set is deterministic and nearly uniform, every direction has the weight 4 pi / N
+//		- Its axis is the zenith, so that the rings of the set follow the horizon
+//------------------------------------------------------
+enum class GatherQuadrature
+{
+	Random = 0,				// NUM_RANDOMDIR_SAMPLES hashed random directions per texel, as GatherInscatterPS.hlsl
+	SphericalFibonacci,		// the same N directions for every texel
+};
+
+inline math::Float3 SphericalFibonacci(int inIndex, int inNumSamples)
+{
+	const float golden_angle = 2.39996323f; // pi * (3 - sqrt(5))
+	const float cos_zenith = 1.0f - (2.0f * float(inIndex) + 1.0f) / float(inNumSamples);
+	const float sin_zenith = std::sqrt(Saturate(1.0f - cos_zenith * cos_zenith));
+	const float phi = golden_angle * float(inIndex);
+	return math::Float3(sin_zenith * std::cos(phi), cos_zenith, sin_zenith * std::sin(phi));
+}
+
+//------------------------------------------------------
+//	Sky irradiance [Bruneton08]
+//		- Irradiance of a horizontal surface from the inscatter of one scattering order, for a sun of 1
+//		- The first half of 2 * inNumSamples spherical Fibonacci directions is the upper hemisphere
+//		- The phase functions take mie_g = 0 as the gather [Elek09]. The ground does not reflect.
+//------------------------------------------------------
+inline math::Float3 IntegrateSkyIrradiance(
+	float inHeight,
+	float inCosSunZenith,
+	const LookUpTableView3D<math::Float4>& inInscatterTextureR,
+	const LookUpTableView3D<math::Float4>& inInscatterTextureM,
+	int inNumSamples = NUM_IRRADIANCE_SAMPLES)
+{
+	const math::Float3 start_pos(0.0f, inHeight, 0.0f);
+	const math::Float3 light_dir(std::sqrt(Saturate(1.0f - inCosSunZenith * inCosSunZenith)), inCosSunZenith, 0.0f);
+
+	math::Float3 irradiance(0.0f);
+	for (int i = 0; i < inNumSamples; ++i)
+	{
+		const math::Float3 dir = SphericalFibonacci(i, 2 * inNumSamples);
+		math::Float3 inscatter_r, inscatter_m;
+		LookUpPrecomputedScatteringSeparated(start_pos, dir, light_dir, inInscatterTextureR, inInscatterTextureM, inscatter_r, inscatter_m);
+
+		const float mu = math::InnerProduct(dir, light_dir);
+		const float mie_g = 0.0f; // [Elek09]
+		irradiance += (inscatter_r * RayleighPhase(mu) + inscatter_m * CornetteShanksPhaseFunc(mu, mie_g)) * dir.y;
+	}
+	return irradiance * (2.0f * 3.14159265f / float(inNumSamples));
+}
+
+//------------------------------------------------------
+//	Random numbers (port of shader/Random.hlsl)
+//------------------------------------------------------
+inline math::Float2 Hash22(const math::Float2& p)
+{
+	// https://www.shadertoy.com/view/4djSRW
+	math::Float3 p3(Frac(p.x * 0.1031f), Frac(p.y * 0.1030f), Frac(p.x * 0.0973f));
+	const float d = p3.x * (p3.y + 19.19f) + p3.y * (p3.z + 19.19f) + p3.z * (p3.x + 19.19f);
+	p3 = p3 + math::Float3(d);
+	return math::Float2(Frac((p3.x + p3.y) * p3.z), Frac((p3.x + p3.z) * p3.y));
+}
+
+inline math::Float2 Hash21(float p)
+{
+	math::Float3 p3(Frac(p * 0.1031f), Frac(p * 0.1030f), Frac(p * 0.0973f));
+	const float d = p3.x * (p3.y + 19.19f) + p3.y * (p3.z + 19.19f) + p3.z * (p3.x + 19.19f);
+	p3 = p3 + math::Float3(d);
+	return math::Float2(Frac((p3.x + p3.y) * p3.z), Frac((p3.x + p3.z) * p3.y));
+}
+
+inline math::Float3 RandomUnitVector(const math::Float2& p)
+{
+	const math::Float2 random = Hash22(p);
+	const float z = random.x * 2.0f - 1.0f;
+	const float t = random.y * 3.14159265f;
+	const float r = std::sqrt(1.0f - z * z);
+	return math::Float3(r * std::cos(t), r * std::sin(t), z);
+}
+
+} // namespace atmosphere
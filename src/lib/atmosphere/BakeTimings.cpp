@@ -0,0 +1,99 @@
+#include "BakeTimings.hpp"
+#include <cstdio>
+#include <fstream>
+
+namespace atmosphere {
+
+namespace detail {
+
+inline void AppendJsonNumber(std::string& ioJson, const char* inName, double inValue, bool inIsLast = false)
+{
+	char buffer[96];
+	std::snprintf(buffer, sizeof(buffer), "\"%s\": %.6g%s", inName, inValue, inIsLast ? "" : ", ");
+	ioJson += buffer;
+}
+
+} // namespace detail
+
+void BakeTimings::Clear()
+{
+	mNumScattering = 0;
+	mTotalMs = 0.0;
+	mStages.clear();
+}
+
+BakeStageTiming BakeTimings::GetStageTotal(size_t inStage) const
+{
+	BakeStageTiming total;
+	total.mStage = inStage;
+	for (const BakeStageTiming& timing : mStages)
+	{
+		if (timing.mStage != inStage)
+			continue;
+		total.mWallMs += timing.mWallMs;
+		total.mBusyMs += timing.mBusyMs;
+		total.mNumTexels += timing.mNumTexels;
+		total.mNumSamples += timing.mNumSamples;
+	}
+	return total;
+}
+
+const char* GetBakeStageName(size_t inStage)
+{
+	static const char* sNames[] = {
+		"optical_depth",
+		"single_scattering",
+		"multiple_scattering",
+		"gather_inscatter",
+		"accumulate_inscatter",
+		"total_inscatter",
+		"pack_inscatter",
+		"irradiance",
+		"inscatter_4d",
+	};
+	return (inStage < sizeof(sNames) / sizeof(sNames[0])) ? sNames[inStage] : "unknown";
+}
+
+std::string ToJson(const BakeTimings& inTimings)
+{
+	std::string json = "{\n";
+	json += "\t\"backend\": \"" + inTimings.mBackend + "\",\n";
+	json += "\t\"instruction_set\": \"" + inTimings.mInstructionSet + "\",\n";
+	json += "\t\"num_threads\": " + std::to_string(inTimings.mNumThreads) + ",\n";
+	json += "\t\"num_scattering\": " + std::to_string(inTimings.mNumScattering) + ",\n";
+	json += "\t\"inscatter_resolution\": [" + std::to_string(inTimings.mInscatterResolution[0]) + ", "
+		+ std::to_string(inTimings.mInscatterResolution[1]) + ", " + std::to_string(inTimings.mInscatterResolution[2]) + "],\n";
+	json += "\t\"optical_depth_resolution\": [" + std::to_string(inTimings.mOpticalDepthResolution[0]) + ", "
+		+ std::to_string(inTimings.mOpticalDepthResolution[1]) + "],\n";
+	json += "\t";
+	detail::AppendJsonNumber(json, "total_ms", inTimings.mTotalMs, true);
+	json += ",\n\t\"stages\": [\n";
+	for (size_t i = 0; i < inTimings.mStages.size(); ++i)
+	{
+		const BakeStageTiming& timing = inTimings.mStages[i];
+		json += "\t\t{ \"stage\": \"";
+		json += GetBakeStageName(timing.mStage);
+		json += "\", \"order\": " + std::to_string(timing.mOrder) + ", ";
+		detail::AppendJsonNumber(json, "wall_ms", timing.mWallMs);
+		detail::AppendJsonNumber(json, "busy_ms", timing.mBusyMs);
+		json += "\"texels\": " + std::to_string(timing.mNumTexels) + ", ";
+		json += "\"samples\": " + std::to_string(timing.mNumSamples) + ", ";
+		detail::AppendJsonNumber(json, "texels_per_s", timing.GetTexelsPerSecond());
+		detail::AppendJsonNumber(json, "samples_per_s", timing.GetSamplesPerSecond(), true);
+		json += (i + 1 < inTimings.mStages.size()) ? " },\n" : " }\n";
+	}
+	json += "\t]\n}\n";
+	return json;
+}
+
+bool WriteJson(const std::string& inPath, const BakeTimings& inTimings)
+{
+	std::ofstream file(inPath, std::ios::binary);
+	if (!file)
+		return false;
+	const std::string json = ToJson(inTimings);
+	file.write(json.data(), std::streamsize(json.size()));
+	return bool(file);
+}
+
+} // namespace atmosphere
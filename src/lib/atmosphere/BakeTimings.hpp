@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "AtmosphereExport.hpp"
+
+namespace atmosphere {
+
+//------------------------------------------------------
+//	Per-stage timings of a look-up table bake
+//		- Filled by CpuPrecomputedAtmosphericScattering (wall clock, and the time the worker threads spent in the tasks)
+//		  and by the D3D11 app (timestamp queries, no busy time)
+//		- One entry per run of a stage, the stages of the multiple scattering loop have one per order
+//		- ToJson() is meant for the regression tracking of the bake, e.g. AtmosphereBaker --timings
+//------------------------------------------------------
+struct BakeStageTiming
+{
+	size_t			mStage = 0;			// CpuPrecomputedAtmosphericScattering::BufferType
+	std::uint32_t	mOrder = 0;			// scattering order of the loop stages, 0 for the others
+	double			mWallMs = 0.0;
+	double			mBusyMs = 0.0;		// summed over the worker threads, 0 when not measured (GPU)
+	std::uint64_t	mNumTexels = 0;		// texels written, a Rayleigh / Mie pair counts once
+	std::uint64_t	mNumSamples = 0;	// ray steps (integrals), gathered directions or texels read
+
+	double GetTexelsPerSecond() const { return (mWallMs > 0.0) ? double(mNumTexels) * 1e3 / mWallMs : 0.0; }
+	double GetSamplesPerSecond() const { return (mWallMs > 0.0) ? double(mNumSamples) * 1e3 / mWallMs : 0.0; }
+};
+
+struct ATMOSPHERE_EXPORT BakeTimings
+{
+	std::string		mBackend = "cpu";	// "cpu" or "gpu"
+	std::string		mInstructionSet;	// SIMD path of the CPU engine
+	std::uint32_t	mNumThreads = 0;
+	std::uint32_t	mNumScattering = 0;	// orders computed
+	size_t			mInscatterResolution[3] = {};
+	size_t			mOpticalDepthResolution[2] = {};
+	double			mTotalMs = 0.0;		// whole bake, including what the stages do not cover
+	std::vector<BakeStageTiming>	mStages;
+
+	void Clear();
+	// Sum of the entries of inStage (every order)
+	BakeStageTiming GetStageTotal(size_t inStage) const;
+};
+
+// "optical_depth", "single_scattering", ... in the order of CpuPrecomputedAtmosphericScattering::BufferType
+ATMOSPHERE_EXPORT const char* GetBakeStageName(size_t inStage);
+
+// Flat JSON object, one entry of "stages" per BakeStageTiming with its throughputs
+ATMOSPHERE_EXPORT std::string ToJson(const BakeTimings& inTimings);
+ATMOSPHERE_EXPORT bool WriteJson(const std::string& inPath, const BakeTimings& inTimings);
+
+} // namespace atmosphere
@@ -0,0 +1,1038 @@
+#include "CpuPrecomputedAtmosphericScattering.hpp"
+#include "AtmosphericScattering.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+namespace atmosphere {
+
+namespace detail {
+
+// Uniform steps of the numeric optical depth integral, OpticalDepthPS.hlsl
+constexpr int sNumOpticalDepthSteps = 128;
+
+inline std::uint64_t GetBusyNanoseconds(const etc::TaskScheduler& inScheduler)
+{
+	std::uint64_t busy = 0;
+	for (const etc::TaskScheduler::Stats& stats : inScheduler.GetStats())
+		busy += stats.mBusyNanoseconds;
+	return busy;
+}
+
+inline math::Float3 TexelToLUTCoord(size_t x, size_t y, size_t z, const LookUpTable3D<math::Float4>& inTable)
+{
+	return math::Float3(
+		(float(x) + 0.5f) / float(inTable.GetWidth()),
+		(float(y) + 0.5f) / float(inTable.GetHeight()),
+		(float(z) + 0.5f) / float(inTable.GetDepth()));
+}
+
+inline math::Float4 ToFloat4(const math::Float3& v, float w)
+{
+	return math::Float4(v.x, v.y, v.z, w);
+}
+
+} // namespace detail
+
+//--------------------------------------------------------------------------------------------
+
+CpuPrecomputedAtmosphericScattering::CpuPrecomputedAtmosphericScattering(const Desc& inDesc)
+	: mDesc(inDesc)
+{
+	mScheduler = inDesc.mScheduler;
+	if (!mScheduler)
+	{
+		mOwnedScheduler = std::make_unique<etc::TaskScheduler>(inDesc.mNumThreads);
+		mScheduler = mOwnedScheduler.get();
+	}
+	assert(inDesc.mInscatterWidth >= 2 && inDesc.mInscatterHeight >= 4 && inDesc.mInscatterHeight % 2 == 0 && inDesc.mInscatterDepth >= 2);
+	mInstructionSet = ResolveSimdInstructionSet(inDesc.mInstructionSet);
+	if (inDesc.mInscatter4dSlices > 0)
+	{
+		assert(inDesc.mInscatter4dWidth >= 2 && inDesc.mInscatter4dHeight >= 4 && inDesc.mInscatter4dHeight % 2 == 0 && inDesc.mInscatter4dDepth >= 2);
+		const size_t slice_bytes = inDesc.mInscatter4dWidth * inDesc.mInscatter4dHeight * inDesc.mInscatter4dDepth * sizeof(math::Float4);
+		mInscatter4dSlices = std::max<size_t>(std::min(inDesc.mInscatter4dSlices, inDesc.mMaxInscatter4dBytes / slice_bytes), 2);
+	}
+	if (!inDesc.mCacheDirectory.empty())
+		mCache = std::make_unique<LookUpTableCache>(inDesc.mCacheDirectory);
+
+	ResetScatteringParameters(Planet::Earth);
+	if (inDesc.mGatherQuadrature == GatherQuadrature::SphericalFibonacci)
+		PrecomputeGatherWeights();
+}
+
+std::uint32_t CpuPrecomputedAtmosphericScattering::GetNumGatherSamples() const
+{
+	if (mDesc.mGatherQuadrature == GatherQuadrature::SphericalFibonacci)
+		return std::max<std::uint32_t>(mDesc.mNumGatherSamples, 1);
+	return NUM_RANDOMDIR_SAMPLES;
+}
+
+CpuPrecomputedAtmosphericScattering::~CpuPrecomputedAtmosphericScattering()
+{
+}
+
+PrecomputedSctrParams CpuPrecomputedAtmosphericScattering::GetKernelParameters() const
+{
+	// Same as PrecomputedAtmosphericScattering::UpdateShaderParameters()
+	PrecomputedSctrParams param = mPrecomputedParam;
+	param.mRayleighSctrCoeff = param.mRayleighSctrCoeff * 1e-3f;
+	param.mMieSctrCoeff = param.mMieSctrCoeff * 1e-3f;
+	return param;
+}
+
+AdaptiveIntegrationSettings CpuPrecomputedAtmosphericScattering::GetAdaptiveIntegrationSettings() const
+{
+	AdaptiveIntegrationSettings settings;
+	settings.mTolerance = mDesc.mIntegrationTolerance;
+	settings.mMaxSteps = 8 * INSCATTER_INTEGRAL_STEPS;
+	return settings;
+}
+
+void CpuPrecomputedAtmosphericScattering::AddIntegrationStats(std::uint64_t inNumRays, std::uint64_t inNumSamples)
+{
+	mNumIntegratedRays.fetch_add(inNumRays, std::memory_order_relaxed);
+	mNumIntegrationSamples.fetch_add(inNumSamples, std::memory_order_relaxed);
+}
+
+CpuPrecomputedAtmosphericScattering::IntegrationStats CpuPrecomputedAtmosphericScattering::GetIntegrationStats() const
+{
+	IntegrationStats stats;
+	stats.mNumRays = mNumIntegratedRays.load(std::memory_order_relaxed);
+	stats.mNumSamples = mNumIntegrationSamples.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void CpuPrecomputedAtmosphericScattering::ForEachTile3D(const std::function<void(const size_t inBegin[3], const size_t inEnd[3])>& inKernel) const
+{
+	const size_t size[3] = { mDesc.mInscatterWidth, mDesc.mInscatterHeight, mDesc.mInscatterDepth };
+	const size_t tile[3] = {
+		std::max<size_t>(mDesc.mTileWidth, 1),
+		std::max<size_t>(mDesc.mTileHeight, 1),
+		std::max<size_t>(mDesc.mTileDepth, 1) };
+	const size_t num_tiles[3] = {
+		(size[0] + tile[0] - 1) / tile[0],
+		(size[1] + tile[1] - 1) / tile[1],
+		(size[2] + tile[2] - 1) / tile[2] };
+
+	// The cost of a texel depends on where its ray ends, so small tiles + work stealing keep every thread busy
+	mScheduler->ParallelFor(num_tiles[0] * num_tiles[1] * num_tiles[2], 1, [&](size_t inBegin, size_t inEnd)
+	{
+		for (size_t index = inBegin; index < inEnd; ++index)
+		{
+			if (IsCancelled())
+				return; // The remaining tiles are skipped, the stage ends as soon as the running ones do
+			const size_t tile_index[3] = {
+				index % num_tiles[0],
+				index / num_tiles[0] % num_tiles[1],
+				index / (num_tiles[0] * num_tiles[1]) };
+			size_t begin[3], end[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				begin[i] = tile_index[i] * tile[i];
+				end[i] = std::min(begin[i] + tile[i], size[i]);
+			}
+			inKernel(begin, end);
+		}
+	});
+}
+
+void CpuPrecomputedAtmosphericScattering::ForEachTexel3D(const std::function<void(size_t, size_t, size_t)>& inKernel) const
+{
+	ForEachTile3D([&](const size_t inBegin[3], const size_t inEnd[3])
+	{
+		for (size_t z = inBegin[2]; z < inEnd[2]; ++z)
+			for (size_t y = inBegin[1]; y < inEnd[1]; ++y)
+				for (size_t x = inBegin[0]; x < inEnd[0]; ++x)
+					inKernel(x, y, z);
+	});
+}
+
+bool CpuPrecomputedAtmosphericScattering::GeneratePrecomputedTexture(const std::atomic<bool>* inCancel)
+{
+	mCancel = inCancel;
+	mBakeTimings.Clear();
+	mBakeTimings.mInstructionSet = GetSimdInstructionSetName(mInstructionSet);
+	mBakeTimings.mNumThreads = GetNumThreads();
+	mBakeTimings.mInscatterResolution[0] = mDesc.mInscatterWidth;
+	mBakeTimings.mInscatterResolution[1] = mDesc.mInscatterHeight;
+	mBakeTimings.mInscatterResolution[2] = mDesc.mInscatterDepth;
+	mBakeTimings.mOpticalDepthResolution[0] = mDesc.mOpticalDepthWidth;
+	mBakeTimings.mOpticalDepthResolution[1] = mDesc.mOpticalDepthHeight;
+
+	const auto time_start = std::chrono::steady_clock::now();
+	const bool finished = RunPrecomputation();
+	mBakeTimings.mTotalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+	mBakeTimings.mNumScattering = mNumScatteringComputed;
+	mCancel = nullptr;
+	return finished;
+}
+
+bool CpuPrecomputedAtmosphericScattering::RunPrecomputation()
+{
+	static_assert(size_t(NUM_BUFFERS) == LookUpTableStageFingerprints::sNumStages, "A fingerprint per stage");
+	mNumIntegratedRays = 0;
+	mNumIntegrationSamples = 0;
+	std::fill(std::begin(mNumStageExecutions), std::end(mNumStageExecutions), 0u);
+
+	const LookUpTableCacheKeyDesc key_desc = GetCacheKeyDesc();
+	const LookUpTableStageFingerprints fingerprints = ComputeLookUpTableStageFingerprints(mPrecomputedParam, key_desc);
+	const std::uint64_t* stage = fingerprints.mStages;
+	if (mStageFingerprints[BUF_OPTICAL_DEPTH] == stage[BUF_OPTICAL_DEPTH]
+		&& mStageFingerprints[BUF_TOTAL_INSCATTER] == stage[BUF_TOTAL_INSCATTER]
+		&& mStageFingerprints[BUF_PACK_INSCATTER] == stage[BUF_PACK_INSCATTER]
+		&& mStageFingerprints[BUF_IRRADIANCE] == stage[BUF_IRRADIANCE]
+		&& mStageFingerprints[BUF_INSCATTER_4D] == stage[BUF_INSCATTER_4D])
+		return true; // Up to date
+
+	const std::uint64_t cache_key = ComputeLookUpTableCacheKey(mPrecomputedParam, key_desc);
+	mIsLoadedFromCache = mCache && LoadFromCache(cache_key);
+	if (mIsLoadedFromCache)
+	{
+		for (BufferType loaded : { BUF_OPTICAL_DEPTH, BUF_TOTAL_INSCATTER, BUF_PACK_INSCATTER, BUF_IRRADIANCE, BUF_INSCATTER_4D })
+			mStageFingerprints[loaded] = stage[loaded];
+		return true;
+	}
+	PrepareTables();
+
+	if (!RunStage(BUF_OPTICAL_DEPTH, stage[BUF_OPTICAL_DEPTH], [this]() { ComputeOpticalDepth(); })
+		|| !RunStage(BUF_SINGLE_SCATTERING, stage[BUF_SINGLE_SCATTERING], [this]() { ComputeSingleScattering(); }))
+		return false;
+
+	//
+	// Multiple scattering
+	//	The loop resumes from the orders accumulated so far unless its inputs changed or fewer orders are requested.
+	//	The gathered and the order tables ping-pong : the gather reads order n - 1 and writes the gathered table,
+	//	order n reads it back and overwrites order n - 1. Order n is added to the totals in the same pass,
+	//	its sky irradiance to the irradiance table right after.
+	//
+	const bool is_loop_valid = (mStageFingerprints[BUF_ACCUMULATE_INSCATTER] == stage[BUF_ACCUMULATE_INSCATTER])
+		&& (mNumScatteringAccumulated <= mNumScattering);
+	for (BufferType loop_stage : { BUF_GATHER_INSCATTER, BUF_MULTIPLE_SCATTERING, BUF_ACCUMULATE_INSCATTER })
+		mStageFingerprints[loop_stage] = 0;
+	if (!is_loop_valid)
+	{
+		// The totals accumulate the orders, starting from the single scattering
+		TimeStage(BUF_TOTAL_INSCATTER, 1, [this]()
+		{
+			for (int i : { RAYLEIGH, MIE })
+				std::copy(mSingleScattering[i]->GetData(), mSingleScattering[i]->GetData() + mSingleScattering[i]->GetNumTexels(), mTotalInscatter[i]->GetData());
+		});
+		mStageFingerprints[BUF_TOTAL_INSCATTER] = 0;
+		mStageFingerprints[BUF_IRRADIANCE] = 0;
+		TimeStage(BUF_IRRADIANCE, 1, [this]() { ComputeIrradiance(*mSingleScattering[RAYLEIGH], *mSingleScattering[MIE], false); });
+		++mNumStageExecutions[BUF_IRRADIANCE];
+		mNumScatteringAccumulated = 1;
+		mIsAccumulationConverged = false;
+		mScatteringIncrements.clear();
+	}
+
+	for (std::uint32_t order = mNumScatteringAccumulated + 1; order <= mNumScattering && !mIsAccumulationConverged; ++order)
+	{
+		const Table3D* previous[2] = { mSingleScattering[RAYLEIGH].get(), mSingleScattering[MIE].get() };
+		if (order > 2)
+		{
+			previous[RAYLEIGH] = mMultipleScattering[RAYLEIGH].get();
+			previous[MIE] = mMultipleScattering[MIE].get();
+		}
+		TimeStage(BUF_GATHER_INSCATTER, order, [&]() { GatherInscatter(*previous[RAYLEIGH], *previous[MIE]); });
+		mStageFingerprints[BUF_TOTAL_INSCATTER] = 0;
+		TimeStage(BUF_MULTIPLE_SCATTERING, order, [this]() { ComputeMultipleScattering(); });
+		mStageFingerprints[BUF_IRRADIANCE] = 0;
+		TimeStage(BUF_IRRADIANCE, order, [this]() { ComputeIrradiance(*mMultipleScattering[RAYLEIGH], *mMultipleScattering[MIE], true); });
+		for (BufferType loop_stage : { BUF_GATHER_INSCATTER, BUF_MULTIPLE_SCATTERING, BUF_ACCUMULATE_INSCATTER, BUF_IRRADIANCE })
+			++mNumStageExecutions[loop_stage];
+		if (IsCancelled())
+			return false;
+		mNumScatteringAccumulated = order;
+
+		// The accumulation is fused into the multiple scattering, the entry times the convergence measure
+		TimeStage(BUF_ACCUMULATE_INSCATTER, order, [this]() { mScatteringIncrements.push_back(MeasureScatteringIncrement()); });
+		if (mDesc.mConvergenceThreshold > 0.0f && mScatteringIncrements.back() < mDesc.mConvergenceThreshold)
+			mIsAccumulationConverged = true; // The next orders are even smaller
+	}
+	for (BufferType loop_stage : { BUF_GATHER_INSCATTER, BUF_MULTIPLE_SCATTERING, BUF_ACCUMULATE_INSCATTER })
+		mStageFingerprints[loop_stage] = stage[loop_stage];
+	mNumScatteringComputed = mNumScatteringAccumulated;
+
+	//
+	// Result
+	//	The totals and the irradiance are complete once the loop is, they only change with it
+	//
+	if (mStageFingerprints[BUF_TOTAL_INSCATTER] == 0)
+		++mNumStageExecutions[BUF_TOTAL_INSCATTER];
+	mStageFingerprints[BUF_TOTAL_INSCATTER] = stage[BUF_TOTAL_INSCATTER];
+	mStageFingerprints[BUF_IRRADIANCE] = stage[BUF_IRRADIANCE];
+	if (mStageFingerprints[BUF_PACK_INSCATTER] != stage[BUF_PACK_INSCATTER])
+		mStageFingerprints[BUF_PACK_INSCATTER] = 0;
+	if (!RunStage(BUF_PACK_INSCATTER, stage[BUF_PACK_INSCATTER], [this]() { PackInscatter(); }))
+		return false;
+
+	// Reads the single scattering and the totals, both are valid whenever its inputs changed
+	if (mInscatter4dSlices == 0)
+		mStageFingerprints[BUF_INSCATTER_4D] = stage[BUF_INSCATTER_4D]; // Nothing to compute
+	else if (!RunStage(BUF_INSCATTER_4D, stage[BUF_INSCATTER_4D], [this]() { ComputeInscatter4d(); }))
+		return false;
+
+	if (mCache)
+		StoreToCache(cache_key);
+	return true;
+}
+
+bool CpuPrecomputedAtmosphericScattering::RunStage(BufferType inStage, std::uint64_t inFingerprint, const std::function<void()>& inKernel)
+{
+	if (mStageFingerprints[inStage] == inFingerprint)
+		return true;
+	mStageFingerprints[inStage] = 0;
+	TimeStage(inStage, 0, inKernel);
+	++mNumStageExecutions[inStage];
+	if (IsCancelled())
+		return false;
+	mStageFingerprints[inStage] = inFingerprint;
+	return true;
+}
+
+void CpuPrecomputedAtmosphericScattering::TimeStage(BufferType inStage, std::uint32_t inOrder, const std::function<void()>& inKernel)
+{
+	const std::uint64_t samples_start = mNumIntegrationSamples.load(std::memory_order_relaxed);
+	const std::uint64_t busy_start = detail::GetBusyNanoseconds(*mScheduler);
+	const auto time_start = std::chrono::steady_clock::now();
+	inKernel();
+	const auto time_end = std::chrono::steady_clock::now();
+
+	BakeStageTiming timing;
+	timing.mStage = size_t(inStage);
+	timing.mOrder = inOrder;
+	timing.mWallMs = std::chrono::duration<double, std::milli>(time_end - time_start).count();
+	timing.mBusyMs = double(detail::GetBusyNanoseconds(*mScheduler) - busy_start) * 1e-6;
+	timing.mNumTexels = std::uint64_t(mDesc.mInscatterWidth * mDesc.mInscatterHeight * mDesc.mInscatterDepth);
+	if (inStage == BUF_OPTICAL_DEPTH)
+		timing.mNumTexels = std::uint64_t(mDesc.mOpticalDepthWidth * mDesc.mOpticalDepthHeight);
+	else if (inStage == BUF_IRRADIANCE)
+		timing.mNumTexels = std::uint64_t(mDesc.mIrradianceWidth * mDesc.mIrradianceHeight);
+	else if (inStage == BUF_INSCATTER_4D)
+		timing.mNumTexels = std::uint64_t(mPackInscatter4d->GetNumTexels());
+	timing.mNumSamples = GetNumStageSamples(inStage, mNumIntegrationSamples.load(std::memory_order_relaxed) - samples_start);
+	mBakeTimings.mStages.push_back(timing);
+}
+
+std::uint64_t CpuPrecomputedAtmosphericScattering::GetNumStageSamples(BufferType inStage, std::uint64_t inNumIntegrationSamples) const
+{
+	const std::uint64_t num_texels = std::uint64_t(mDesc.mInscatterWidth * mDesc.mInscatterHeight * mDesc.mInscatterDepth);
+	switch (inStage)
+	{
+	case BUF_OPTICAL_DEPTH:
+	{
+		const std::uint64_t steps = (mDesc.mOpticalDepthMode == OpticalDepthMode::Analytic) ? 1 : std::uint64_t(detail::sNumOpticalDepthSteps);
+		return std::uint64_t(mDesc.mOpticalDepthWidth * mDesc.mOpticalDepthHeight) * steps;
+	}
+	case BUF_SINGLE_SCATTERING:
+	case BUF_MULTIPLE_SCATTERING:
+	case BUF_INSCATTER_4D:
+		return inNumIntegrationSamples;
+	case BUF_GATHER_INSCATTER:
+		return num_texels * GetNumGatherSamples();
+	case BUF_IRRADIANCE:
+		return std::uint64_t(mDesc.mIrradianceWidth * mDesc.mIrradianceHeight) * NUM_IRRADIANCE_SAMPLES;
+	default:
+		return num_texels; // copies and per-texel passes
+	}
+}
+
+void CpuPrecomputedAtmosphericScattering::InvalidateStages()
+{
+	std::fill(std::begin(mStageFingerprints), std::end(mStageFingerprints), std::uint64_t(0));
+}
+
+const std::vector<float>& CpuPrecomputedAtmosphericScattering::GetScatteringIncrements() const
+{
+	static const std::vector<float> sNone;
+	return mIsLoadedFromCache ? sNone : mScatteringIncrements;
+}
+
+LookUpTableCacheKeyDesc CpuPrecomputedAtmosphericScattering::GetCacheKeyDesc() const
+{
+	LookUpTableCacheKeyDesc key_desc;
+	key_desc.mNumScattering = mNumScattering;
+	key_desc.mOpticalDepthWidth = mDesc.mOpticalDepthWidth;
+	key_desc.mOpticalDepthHeight = mDesc.mOpticalDepthHeight;
+	key_desc.mOpticalDepthMode = mDesc.mOpticalDepthMode;
+	key_desc.mInscatterWidth = mDesc.mInscatterWidth;
+	key_desc.mInscatterHeight = mDesc.mInscatterHeight;
+	key_desc.mInscatterDepth = mDesc.mInscatterDepth;
+	key_desc.mIrradianceWidth = mDesc.mIrradianceWidth;
+	key_desc.mIrradianceHeight = mDesc.mIrradianceHeight;
+	key_desc.mInscatter4dWidth = mDesc.mInscatter4dWidth;
+	key_desc.mInscatter4dHeight = mDesc.mInscatter4dHeight;
+	key_desc.mInscatter4dDepth = mDesc.mInscatter4dDepth;
+	key_desc.mInscatter4dSlices = mInscatter4dSlices;
+	key_desc.mIntegrationTolerance = mDesc.mIntegrationTolerance;
+	key_desc.mGatherQuadrature = std::uint32_t(mDesc.mGatherQuadrature);
+	key_desc.mNumGatherSamples = GetNumGatherSamples();
+	key_desc.mConvergenceThreshold = mDesc.mConvergenceThreshold;
+	key_desc.mConvergenceMetric = std::uint32_t(mDesc.mConvergenceMetric);
+	return key_desc;
+}
+
+std::uint64_t CpuPrecomputedAtmosphericScattering::GetCacheKey() const
+{
+	return ComputeLookUpTableCacheKey(mPrecomputedParam, GetCacheKeyDesc());
+}
+
+bool CpuPrecomputedAtmosphericScattering::LoadFromCache(std::uint64_t inKey)
+{
+	// The file records the orders actually computed, fewer than requested when the bake converged early
+	std::unique_ptr<LookUpTableFile> file = mCache->Load(inKey);
+	if (!file || file->GetNumScattering() > mNumScattering
+		|| (file->GetNumScattering() < mNumScattering && mDesc.mConvergenceThreshold <= 0.0f))
+		return false;
+
+	auto is_valid = [](const auto& inView, size_t inWidth, size_t inHeight)
+	{
+		return inView.IsValid() && inView.GetWidth() == inWidth && inView.GetHeight() == inHeight;
+	};
+	auto is_valid_3d = [&file, &is_valid](LookUpTableCache::TableId inId, size_t inWidth, size_t inHeight, size_t inDepth)
+	{
+		const View3D view = file->GetView3D(inId);
+		return is_valid(view, inWidth, inHeight) && view.GetDepth() == inDepth;
+	};
+	const size_t w = mDesc.mInscatterWidth;
+	const size_t h = mDesc.mInscatterHeight;
+	const size_t d = mDesc.mInscatterDepth;
+	if (!is_valid(file->GetView2D(LookUpTableCache::OPTICAL_DEPTH), mDesc.mOpticalDepthWidth, mDesc.mOpticalDepthHeight)
+		|| !is_valid_3d(LookUpTableCache::TOTAL_INSCATTER_RAYLEIGH, w, h, d)
+		|| !is_valid_3d(LookUpTableCache::TOTAL_INSCATTER_MIE, w, h, d)
+		|| !is_valid_3d(LookUpTableCache::PACK_INSCATTER, w, h, d)
+		|| !is_valid(file->GetView2D<math::Float4>(LookUpTableCache::IRRADIANCE), mDesc.mIrradianceWidth, mDesc.mIrradianceHeight)
+		|| (mInscatter4dSlices > 0 && !is_valid_3d(LookUpTableCache::PACK_INSCATTER_4D,
+			mDesc.mInscatter4dWidth, mDesc.mInscatter4dHeight, mDesc.mInscatter4dDepth * mInscatter4dSlices)))
+		return false;
+
+	// The tables are sampled from the mapping, PrepareTables() copies them out when a later bake runs a stage.
+	// The totals are also the state of the loop, which restarts then.
+	mCachedFile = std::move(file);
+	mNumScatteringComputed = mCachedFile->GetNumScattering();
+	mStageFingerprints[BUF_ACCUMULATE_INSCATTER] = 0;
+	return true;
+}
+
+void CpuPrecomputedAtmosphericScattering::PrepareTables()
+{
+	// The tables are kept between the bakes, every stage overwrites all the texels of its table
+	if (!mOpticalDepth)
+	{
+		const size_t w = mDesc.mInscatterWidth;
+		const size_t h = mDesc.mInscatterHeight;
+		const size_t d = mDesc.mInscatterDepth;
+		mOpticalDepth = std::make_unique<Table2D>(mDesc.mOpticalDepthWidth, mDesc.mOpticalDepthHeight);
+		for (int i : { RAYLEIGH, MIE })
+		{
+			mSingleScattering[i]	= std::make_unique<Table3D>(w, h, d);
+			mInscatterGathering[i]	= std::make_unique<Table3D>(w, h, d);
+			mMultipleScattering[i]	= std::make_unique<Table3D>(w, h, d);
+			mTotalInscatter[i]		= std::make_unique<Table3D>(w, h, d);
+		}
+		mPackInscatter = std::make_unique<Table3D>(w, h, d);
+		mIrradiance = std::make_unique<IrradianceTable>(mDesc.mIrradianceWidth, mDesc.mIrradianceHeight);
+		if (mInscatter4dSlices > 0)
+			mPackInscatter4d = std::make_unique<Table3D>(mDesc.mInscatter4dWidth, mDesc.mInscatter4dHeight, mDesc.mInscatter4dDepth * mInscatter4dSlices);
+	}
+	if (!mCachedFile)
+		return;
+
+	// The fingerprints of the cached stages describe the mapped tables, the stages that did not change are not run again
+	auto copy = [](const auto& inView, auto& outTable)
+	{
+		std::copy(inView.GetData(), inView.GetData() + inView.GetNumTexels(), outTable.GetData());
+	};
+	copy(GetOpticalDepthTexture(), *mOpticalDepth);
+	for (int i : { RAYLEIGH, MIE })
+		copy(GetTotalInscatterTexture(TextureIndex(i)), *mTotalInscatter[i]);
+	copy(GetPackedTotalInscatterTexture(), *mPackInscatter);
+	copy(GetIrradianceTexture(), *mIrradiance);
+	if (mPackInscatter4d)
+		copy(GetPackedInscatter4dTexture().GetSlices(), *mPackInscatter4d);
+	mCachedFile.reset();
+}
+
+CpuPrecomputedAtmosphericScattering::View2D CpuPrecomputedAtmosphericScattering::GetOpticalDepthTexture() const
+{
+	return mCachedFile ? mCachedFile->GetView2D(LookUpTableCache::OPTICAL_DEPTH) : GetView(mOpticalDepth);
+}
+
+CpuPrecomputedAtmosphericScattering::View3D CpuPrecomputedAtmosphericScattering::GetTotalInscatterTexture(TextureIndex index) const
+{
+	if (mCachedFile)
+		return mCachedFile->GetView3D(index == RAYLEIGH ? LookUpTableCache::TOTAL_INSCATTER_RAYLEIGH : LookUpTableCache::TOTAL_INSCATTER_MIE);
+	return GetView(mTotalInscatter[index]);
+}
+
+CpuPrecomputedAtmosphericScattering::View3D CpuPrecomputedAtmosphericScattering::GetPackedTotalInscatterTexture() const
+{
+	return mCachedFile ? mCachedFile->GetView3D(LookUpTableCache::PACK_INSCATTER) : GetView(mPackInscatter);
+}
+
+CpuPrecomputedAtmosphericScattering::IrradianceView CpuPrecomputedAtmosphericScattering::GetIrradianceTexture() const
+{
+	return mCachedFile ? mCachedFile->GetView2D<math::Float4>(LookUpTableCache::IRRADIANCE) : GetView(mIrradiance);
+}
+
+LookUpTableView4D<math::Float4> CpuPrecomputedAtmosphericScattering::GetPackedInscatter4dTexture() const
+{
+	const View3D slices = mCachedFile ? mCachedFile->GetView3D(LookUpTableCache::PACK_INSCATTER_4D) : GetView(mPackInscatter4d);
+	return slices.IsValid() ? LookUpTableView4D<math::Float4>(slices, mInscatter4dSlices) : LookUpTableView4D<math::Float4>();
+}
+
+void CpuPrecomputedAtmosphericScattering::StoreToCache(std::uint64_t inKey) const
+{
+	auto table = [](LookUpTableCache::TableId inId, const Table3D& inTable)
+	{
+		LookUpTableFile::Table file_table;
+		file_table.mId = inId;
+		file_table.mFormat = TextureFormat::R32G32B32A32;
+		file_table.mWidth = inTable.GetWidth();
+		file_table.mHeight = inTable.GetHeight();
+		file_table.mDepth = inTable.GetDepth();
+		file_table.mTexels = inTable.GetData();
+		return file_table;
+	};
+
+	LookUpTableFile::Table optical_depth;
+	optical_depth.mId = LookUpTableCache::OPTICAL_DEPTH;
+	optical_depth.mFormat = TextureFormat::R32G32;
+	optical_depth.mWidth = mOpticalDepth->GetWidth();
+	optical_depth.mHeight = mOpticalDepth->GetHeight();
+	optical_depth.mTexels = mOpticalDepth->GetData();
+
+	LookUpTableFile::Table irradiance;
+	irradiance.mId = LookUpTableCache::IRRADIANCE;
+	irradiance.mFormat = TextureFormat::R32G32B32A32;
+	irradiance.mWidth = mIrradiance->GetWidth();
+	irradiance.mHeight = mIrradiance->GetHeight();
+	irradiance.mTexels = mIrradiance->GetData();
+
+	std::vector<LookUpTableFile::Table> tables = {
+		optical_depth,
+		table(LookUpTableCache::TOTAL_INSCATTER_RAYLEIGH, *mTotalInscatter[RAYLEIGH]),
+		table(LookUpTableCache::TOTAL_INSCATTER_MIE, *mTotalInscatter[MIE]),
+		table(LookUpTableCache::PACK_INSCATTER, *mPackInscatter),
+		irradiance,
+	};
+	if (mPackInscatter4d)
+		tables.push_back(table(LookUpTableCache::PACK_INSCATTER_4D, *mPackInscatter4d));
+	mCache->Store(inKey, mNumScatteringComputed, tables);
+}
+
+//--------------------------------------------------------------------------------------------
+// Stages
+//--------------------------------------------------------------------------------------------
+
+void CpuPrecomputedAtmosphericScattering::ComputeOpticalDepth()
+{
+	// OpticalDepthPS.hlsl
+	Table2D& table = *mOpticalDepth;
+	const bool analytic = (mDesc.mOpticalDepthMode == OpticalDepthMode::Analytic);
+	const size_t width = table.GetWidth();
+	const size_t height = table.GetHeight();
+	const math::Float2 scale_heights(mPrecomputedParam.mRayleighScaleHeight, mPrecomputedParam.mMieScaleHeight);
+
+	const size_t rows_per_task = 8;
+	mScheduler->ParallelFor(height, rows_per_task, [&](size_t inBegin, size_t inEnd)
+	{
+		for (size_t y = inBegin; y < inEnd; ++y)
+		{
+			for (size_t x = 0; x < width; ++x)
+			{
+				// u : height, v : zenith altitude
+				const float u = (float(x) + 0.5f) / float(width);
+				const float v = (float(y) + 0.5f) / float(height);
+				const float costheta = 2.0f * v - 1.0f;
+				float sample_height = Lerp(0.0f, ATM_TOP_HEIGHT, u);
+				sample_height = std::min(std::max(sample_height, float(LUT_HEIGHT_MARGIN)), float(ATM_TOP_HEIGHT - LUT_HEIGHT_MARGIN));
+
+				const float sintheta = std::sqrt(Saturate(1.0f - costheta * costheta));
+				const math::Float3 sample_pos(0.0f, sample_height, 0.0f);
+				const math::Float3 ray_dir(0.0f, costheta, sintheta);
+
+				if (analytic)
+				{
+					table.At(x, y) = CalculateAnalyticOpticalDepthToTop(sample_height, costheta, scale_heights);
+					continue;
+				}
+
+				table.At(x, y) = CalculateNaiveOpticalDepthAlongRay(sample_pos, ray_dir, scale_heights, detail::sNumOpticalDepthSteps);
+			}
+		}
+	});
+}
+
+void CpuPrecomputedAtmosphericScattering::ComputeSingleScattering()
+{
+	// SingleScatteringPS.hlsl
+	Table3D& out_r = *mSingleScattering[RAYLEIGH];
+	Table3D& out_m = *mSingleScattering[MIE];
+	const math::Float3 resolution = GetInscatterResolution();
+
+	ForEachTile3D([&](const size_t inBegin[3], const size_t inEnd[3])
+	{
+		// The texels of the tile in x, y, z order
+		const size_t tile_width = inEnd[0] - inBegin[0];
+		const size_t tile_height = inEnd[1] - inBegin[1];
+		auto texel = [&](size_t i, size_t& x, size_t& y, size_t& z)
+		{
+			x = inBegin[0] + i % tile_width;
+			y = inBegin[1] + (i / tile_width) % tile_height;
+			z = inBegin[2] + i / (tile_width * tile_height);
+		};
+
+		IntegrateSingleScattering(tile_width * tile_height * (inEnd[2] - inBegin[2]),
+			[&](size_t i, math::Float3& outStartPos, math::Float3& outViewDir, math::Float3& outLightDir)
+			{
+				size_t x, y, z;
+				texel(i, x, y, z);
+				float height, cos_view_zenith, cos_sun_zenith;
+				LUTCoordToWorldCoord(detail::TexelToLUTCoord(x, y, z, out_r), height, cos_view_zenith, cos_sun_zenith, resolution);
+				outStartPos = math::Float3(0.0f, height, 0.0f);
+				outViewDir = ComputeViewDir(cos_view_zenith);
+				outLightDir = ComputeLightDir(outViewDir, cos_sun_zenith);
+			},
+			[&](size_t i, const math::Float3& inInscatterR, const math::Float3& inInscatterM)
+			{
+				size_t x, y, z;
+				texel(i, x, y, z);
+				out_r.At(x, y, z) = detail::ToFloat4(inInscatterR, 1.0f);
+				out_m.At(x, y, z) = detail::ToFloat4(inInscatterM, 1.0f);
+			});
+	});
+}
+
+void CpuPrecomputedAtmosphericScattering::IntegrateSingleScattering(
+	size_t inNumRays,
+	const std::function<void(size_t, math::Float3&, math::Float3&, math::Float3&)>& inGetRay,
+	const std::function<void(size_t, const math::Float3&, const math::Float3&)>& inStore)
+{
+	//	The rays are marched PACKET_MAX_RAYS at a time by the packet kernel
+	const PrecomputedSctrParams params = GetKernelParameters();
+	const Table2D& optical_depth = *mOpticalDepth;
+	const OpticalDepthMode optical_depth_mode = mDesc.mOpticalDepthMode;
+	const math::Float2 scale_heights(params.mRayleighScaleHeight, params.mMieScaleHeight);
+	const bool adaptive = (mDesc.mIntegrationTolerance > 0.0f);
+	const AdaptiveIntegrationSettings adaptive_settings = GetAdaptiveIntegrationSettings();
+
+	struct RayInfo
+	{
+		size_t			index;
+		bool			is_ground;
+		math::Float3	end_pos;
+		math::Float3	light_dir;
+	};
+
+	RayPacket rays;
+	SingleScatteringPacketResult result;
+	RayInfo infos[PACKET_MAX_RAYS];
+	rays.mNumRays = 0;
+
+	std::uint64_t num_rays = 0;
+	std::uint64_t num_samples = 0;
+
+	auto store = [&](const RayInfo& info, math::Float3 inscatter_r, math::Float3 inscatter_m, const math::Float3& transmittance)
+	{
+		if (info.is_ground)
+		{
+			const math::Float3 ground_albedo(0.45f, 0.45f, 0.45f);
+			const math::Float3 earth_to_end = info.end_pos - EarthCenter();
+			const float end_height = math::L2Norm(earth_to_end) - EARTH_RADIUS;
+			const float cos_light_zenith = math::InnerProduct(math::L2Normalize(earth_to_end), info.light_dir);
+			const math::Float2 optdepth_to_top = GetOpticalDepthToTop(end_height, cos_light_zenith, scale_heights, optical_depth_mode, optical_depth);
+			const math::Float3 trans_to_top = Exp(-(params.mRayleighSctrCoeff * optdepth_to_top.x + params.mMieSctrCoeff * optdepth_to_top.y));
+			const math::Float3 ground = ground_albedo * Saturate(cos_light_zenith) * transmittance * trans_to_top;
+			inscatter_r += ground;
+			inscatter_m += ground;
+		}
+		inStore(info.index, inscatter_r, inscatter_m);
+	};
+
+	auto flush = [&]()
+	{
+		SingleScatteringPacket(mInstructionSet, params, optical_depth, optical_depth_mode, rays, result);
+		for (size_t i = 0; i < rays.mNumRays; ++i)
+		{
+			const math::Float3 inscatter_r(result.mInscatterR[0][i], result.mInscatterR[1][i], result.mInscatterR[2][i]);
+			const math::Float3 inscatter_m(result.mInscatterM[0][i], result.mInscatterM[1][i], result.mInscatterM[2][i]);
+			const math::Float3 transmittance(result.mTransmittance[0][i], result.mTransmittance[1][i], result.mTransmittance[2][i]);
+			store(infos[i], inscatter_r, inscatter_m, transmittance);
+		}
+		num_rays += rays.mNumRays;
+		num_samples += rays.mNumRays * std::uint64_t(INSCATTER_INTEGRAL_STEPS + 1);
+		rays.mNumRays = 0;
+	};
+
+	for (size_t i = 0; i < inNumRays; ++i)
+	{
+		math::Float3 start_pos, view_dir, light_dir;
+		inGetRay(i, start_pos, view_dir, light_dir);
+
+		// Intersect view ray with the top of the atmosphere and the earth
+		const math::Float4 distances = RayDoubleSphereIntersect(start_pos - EarthCenter(), view_dir, math::Float2(EARTH_RADIUS, ATM_TOP_RADIUS));
+		if (distances.w <= 0)
+		{
+			inStore(i, math::Float3(0.0f), math::Float3(0.0f)); // Error: Ray misses the earth
+			continue;
+		}
+
+		bool is_ground = false;
+		float ray_distance = distances.w;
+		if (distances.x > 0)
+		{
+			ray_distance = std::min(ray_distance, distances.x); // Ray hits the earth
+			is_ground = true;
+		}
+		const math::Float3 end_pos = start_pos + view_dir * ray_distance;
+
+		if (adaptive)
+		{
+			// One ray at a time, the packet kernel marches uniform steps only
+			math::Float3 transmittance, inscatter_r, inscatter_m;
+			num_samples += SingleScatteringAdaptive(start_pos, end_pos, light_dir, params, optical_depth, optical_depth_mode, adaptive_settings,
+				inscatter_r, inscatter_m, transmittance);
+			++num_rays;
+			store(RayInfo{ i, is_ground, end_pos, light_dir }, inscatter_r, inscatter_m, transmittance);
+			continue;
+		}
+
+		const size_t lane = rays.mNumRays++;
+		for (int c = 0; c < 3; ++c)
+		{
+			rays.mStartPos[c][lane] = start_pos[c];
+			rays.mEndPos[c][lane] = end_pos[c];
+			rays.mLightDir[c][lane] = light_dir[c];
+		}
+		rays.mNumSteps[lane] = INSCATTER_INTEGRAL_STEPS;
+		infos[lane] = RayInfo{ i, is_ground, end_pos, light_dir };
+
+		if (rays.mNumRays == PACKET_MAX_RAYS)
+			flush();
+	}
+	flush();
+	AddIntegrationStats(num_rays, num_samples);
+}
+
+void CpuPrecomputedAtmosphericScattering::PrecomputeGatherWeights()
+{
+	const size_t num_samples = GetNumGatherSamples();
+	mGatherDirections.resize(num_samples);
+	for (size_t i = 0; i < num_samples; ++i)
+		mGatherDirections[i] = SphericalFibonacci(int(i), int(num_samples));
+
+	// The view direction depends on (v, w) only, u is the sun. The view zenith of a v depends on the height
+	// through the horizon angle (TexCoord2ZenithAngle()).
+	const size_t h = mDesc.mInscatterHeight;
+	const size_t d = mDesc.mInscatterDepth;
+	const float weight = 4.0f * 3.14159265f / float(num_samples);
+	mGatherWeights.resize(h * d * num_samples);
+	for (size_t z = 0; z < d; ++z)
+	{
+		for (size_t y = 0; y < h; ++y)
+		{
+			const math::Float3 uvw(0.5f, (float(y) + 0.5f) / float(h), (float(z) + 0.5f) / float(d));
+			float height, cos_view_zenith, cos_sun_zenith;
+			LUTCoordToWorldCoord(uvw, height, cos_view_zenith, cos_sun_zenith, GetInscatterResolution());
+			const math::Float3 view_dir = ComputeViewDir(cos_view_zenith);
+
+			math::Float2* weights = &mGatherWeights[(y + h * z) * num_samples];
+			for (size_t i = 0; i < num_samples; ++i)
+			{
+				const float mu = math::InnerProduct(view_dir, mGatherDirections[i]);
+				const float mie_g = 0.0f; // [Elek09]
+				weights[i] = math::Float2(RayleighPhase(mu), CornetteShanksPhaseFunc(mu, mie_g)) * weight;
+			}
+		}
+	}
+}
+
+void CpuPrecomputedAtmosphericScattering::GatherInscatter(const Table3D& inInscatterR, const Table3D& inInscatterM)
+{
+	// GatherInscatterPS.hlsl
+	Table3D& out_r = *mInscatterGathering[RAYLEIGH];
+	Table3D& out_m = *mInscatterGathering[MIE];
+	const bool fibonacci = (mDesc.mGatherQuadrature == GatherQuadrature::SphericalFibonacci);
+
+	ForEachTexel3D([&](size_t x, size_t y, size_t z)
+	{
+		const math::Float3 uvw = detail::TexelToLUTCoord(x, y, z, out_r);
+		float height, cos_view_zenith, cos_sun_zenith;
+		LUTCoordToWorldCoord(uvw, height, cos_view_zenith, cos_sun_zenith, GetInscatterResolution());
+		const math::Float3 start_pos(0.0f, height, 0.0f);
+		const math::Float3 view_dir = ComputeViewDir(cos_view_zenith);
+		const math::Float3 light_dir = ComputeLightDir(view_dir, cos_sun_zenith);
+
+		if (fibonacci)
+		{
+			const size_t num_samples = mGatherDirections.size();
+			const math::Float2* weights = &mGatherWeights[(y + out_r.GetHeight() * z) * num_samples];
+			math::Float3 inscatter_sum_r(0.0f);
+			math::Float3 inscatter_sum_m(0.0f);
+			for (size_t i = 0; i < num_samples; ++i)
+			{
+				math::Float3 inscatter_r, inscatter_m;
+				LookUpPrecomputedScatteringSeparated(start_pos, mGatherDirections[i], light_dir, inInscatterR, inInscatterM, inscatter_r, inscatter_m);
+				inscatter_sum_r += inscatter_r * weights[i].x;
+				inscatter_sum_m += inscatter_m * weights[i].y;
+			}
+			out_r.At(x, y, z) = detail::ToFloat4(inscatter_sum_r, 0.0f);
+			out_m.At(x, y, z) = detail::ToFloat4(inscatter_sum_m, 0.0f);
+			return;
+		}
+
+		math::Float3 inscatter_sum_r(0.0f);
+		math::Float3 inscatter_sum_m(0.0f);
+		for (int i = 0; i < NUM_RANDOMDIR_SAMPLES; ++i)
+		{
+			const math::Float2 hash = Hash21(float(i) + uvw.z * 2236.20679f);
+			const math::Float2 seed(uvw.x * hash.x * 1414.24356f, uvw.y * hash.y * 1414.24356f);
+			const math::Float3 rand_dir = math::L2Normalize(RandomUnitVector(seed));
+			const float mu = math::InnerProduct(view_dir, rand_dir);
+
+			math::Float3 inscatter_r, inscatter_m;
+			LookUpPrecomputedScatteringSeparated(start_pos, rand_dir, light_dir, inInscatterR, inInscatterM, inscatter_r, inscatter_m);
+
+			const float mie_g = 0.0f; // [Elek09]
+			inscatter_sum_r += inscatter_r * RayleighPhase(mu);
+			inscatter_sum_m += inscatter_m * CornetteShanksPhaseFunc(mu, mie_g);
+		}
+
+		const float weight = 4.0f * 3.14159265f / float(NUM_RANDOMDIR_SAMPLES);
+		out_r.At(x, y, z) = detail::ToFloat4(inscatter_sum_r * weight, 0.0f);
+		out_m.At(x, y, z) = detail::ToFloat4(inscatter_sum_m * weight, 0.0f);
+	});
+}
+
+void CpuPrecomputedAtmosphericScattering::ComputeMultipleScattering()
+{
+	// MultipleScatteringPS.hlsl, accumulated into the totals as its additive render targets
+	const PrecomputedSctrParams params = GetKernelParameters();
+	const Table3D& gathered_r = *mInscatterGathering[RAYLEIGH];
+	const Table3D& gathered_m = *mInscatterGathering[MIE];
+	Table3D& out_r = *mMultipleScattering[RAYLEIGH];
+	Table3D& out_m = *mMultipleScattering[MIE];
+	Table3D& total_r = *mTotalInscatter[RAYLEIGH];
+	Table3D& total_m = *mTotalInscatter[MIE];
+	const bool adaptive = (mDesc.mIntegrationTolerance > 0.0f);
+	const AdaptiveIntegrationSettings adaptive_settings = GetAdaptiveIntegrationSettings();
+
+	ForEachTexel3D([&](size_t x, size_t y, size_t z)
+	{
+		out_r.At(x, y, z) = math::Float4(0.0f);
+		out_m.At(x, y, z) = math::Float4(0.0f);
+
+		const math::Float3 uvw = detail::TexelToLUTCoord(x, y, z, out_r);
+		float height, cos_view_zenith, cos_sun_zenith;
+		LUTCoordToWorldCoord(uvw, height, cos_view_zenith, cos_sun_zenith, GetInscatterResolution());
+		const math::Float3 start_pos(0.0f, height, 0.0f);
+		const math::Float3 view_dir = ComputeViewDir(cos_view_zenith);
+		const math::Float3 light_dir = ComputeLightDir(view_dir, cos_sun_zenith);
+
+		// Intersect view ray with the top of the atmosphere and the earth
+		const math::Float4 distances = RayDoubleSphereIntersect(start_pos - EarthCenter(), view_dir, math::Float2(EARTH_RADIUS, ATM_TOP_RADIUS));
+		if (distances.w <= 0)
+			return; // Error: Ray misses the earth
+
+		float ray_distance = distances.w;
+		if (distances.x > 0)
+			ray_distance = std::min(ray_distance, distances.x); // Ray hits the earth
+		const math::Float3 end_pos = start_pos + view_dir * ray_distance;
+
+		math::Float3 transmittance, inscatter_r, inscatter_m;
+		std::uint64_t num_samples = INSCATTER_INTEGRAL_STEPS + 1;
+		if (adaptive)
+			num_samples = MultipleScatteringAdaptive(start_pos, end_pos, light_dir, params, gathered_r, gathered_m, adaptive_settings,
+				inscatter_r, inscatter_m, transmittance);
+		else
+			MultipleScattering(start_pos, end_pos, light_dir, params, gathered_r, gathered_m,
+				inscatter_r, inscatter_m, transmittance, INSCATTER_INTEGRAL_STEPS);
+		AddIntegrationStats(1, num_samples);
+
+		// (We ignored the reflection from the ground)
+		out_r.At(x, y, z) = detail::ToFloat4(inscatter_r, 0.0f);
+		out_m.At(x, y, z) = detail::ToFloat4(inscatter_m, 0.0f);
+		total_r.At(x, y, z) = total_r.At(x, y, z) + out_r.At(x, y, z);
+		total_m.At(x, y, z) = total_m.At(x, y, z) + out_m.At(x, y, z);
+	});
+}
+
+float CpuPrecomputedAtmosphericScattering::MeasureScatteringIncrement() const
+{
+	// |x| of a texel is the sum of the RGB of Rayleigh and Mie
+	auto magnitude = [](const Table3D* inTables[2], size_t inIndex)
+	{
+		float sum = 0.0f;
+		for (int i : { RAYLEIGH, MIE })
+		{
+			const math::Float4& texel = inTables[i]->GetData()[inIndex];
+			sum += std::abs(texel.x) + std::abs(texel.y) + std::abs(texel.z);
+		}
+		return sum;
+	};
+	const Table3D* accumulated[2] = { mTotalInscatter[RAYLEIGH].get(), mTotalInscatter[MIE].get() };
+	const Table3D* increment[2] = { mMultipleScattering[RAYLEIGH].get(), mMultipleScattering[MIE].get() };
+	const size_t num_texels = mPackInscatter->GetNumTexels();
+
+	struct Partial
+	{
+		double	sum_increment = 0.0;
+		double	sum_total = 0.0;
+		float	max_total = 0.0f;
+		float	max_ratio = 0.0f;
+	};
+	const size_t texels_per_task = 1024;
+	std::vector<Partial> partials((num_texels + texels_per_task - 1) / texels_per_task);
+
+	// 1st pass : sums and the brightest texel
+	mScheduler->ParallelFor(num_texels, texels_per_task, [&](size_t inBegin, size_t inEnd)
+	{
+		Partial& partial = partials[inBegin / texels_per_task];
+		for (size_t i = inBegin; i < inEnd; ++i)
+		{
+			const float total = magnitude(accumulated, i);
+			partial.sum_increment += magnitude(increment, i);
+			partial.sum_total += total;
+			partial.max_total = std::max(partial.max_total, total);
+		}
+	});
+
+	Partial result;
+	for (const Partial& partial : partials)
+	{
+		result.sum_increment += partial.sum_increment;
+		result.sum_total += partial.sum_total;
+		result.max_total = std::max(result.max_total, partial.max_total);
+	}
+	if (result.sum_total <= 0.0)
+		return 0.0f;
+	if (mDesc.mConvergenceMetric == ConvergenceMetric::Mean)
+		return float(result.sum_increment / result.sum_total);
+
+	// 2nd pass : largest ratio, texels darker than 1e-4 of the brightest one are compared to that floor
+	const float floor = 1e-4f * result.max_total;
+	mScheduler->ParallelFor(num_texels, texels_per_task, [&](size_t inBegin, size_t inEnd)
+	{
+		Partial& partial = partials[inBegin / texels_per_task];
+		for (size_t i = inBegin; i < inEnd; ++i)
+		{
+			const float total = magnitude(accumulated, i);
+			partial.max_ratio = std::max(partial.max_ratio, magnitude(increment, i) / std::max(total, floor));
+		}
+	});
+	for (const Partial& partial : partials)
+		result.max_ratio = std::max(result.max_ratio, partial.max_ratio);
+	return result.max_ratio;
+}
+
+void CpuPrecomputedAtmosphericScattering::ComputeIrradiance(const Table3D& inInscatterR, const Table3D& inInscatterM, bool inAccumulate)
+{
+	// IrradiancePS.hlsl, added to the previous orders as its additive blend
+	IrradianceTable& table = *mIrradiance;
+	const size_t width = table.GetWidth();
+	const math::Float2 resolution = GetIrradianceResolution();
+
+	const size_t rows_per_task = 4;
+	mScheduler->ParallelFor(table.GetHeight(), rows_per_task, [&](size_t inBegin, size_t inEnd)
+	{
+		for (size_t y = inBegin; y < inEnd; ++y)
+		{
+			for (size_t x = 0; x < width; ++x)
+			{
+				const math::Float2 uv((float(x) + 0.5f) / resolution.x, (float(y) + 0.5f) / resolution.y);
+				float height, cos_sun_zenith;
+				SunlightLUTCoordToWorldCoord(uv, height, cos_sun_zenith, resolution);
+				const math::Float4 irradiance = detail::ToFloat4(IntegrateSkyIrradiance(height, cos_sun_zenith, inInscatterR, inInscatterM), 0.0f);
+				table.At(x, y) = inAccumulate ? table.At(x, y) + irradiance : irradiance;
+			}
+		}
+	});
+}
+
+void CpuPrecomputedAtmosphericScattering::PackInscatter()
+{
+	// PackInscatterPS.hlsl
+	//	The tables share their layout, a row of a tile is contiguous
+	const math::Float4* total_r = mTotalInscatter[RAYLEIGH]->GetData();
+	const math::Float4* total_m = mTotalInscatter[MIE]->GetData();
+	math::Float4* packed = mPackInscatter->GetData();
+	const size_t w = mDesc.mInscatterWidth;
+	const size_t h = mDesc.mInscatterHeight;
+	ForEachTile3D([&](const size_t inBegin[3], const size_t inEnd[3])
+	{
+		for (size_t z = inBegin[2]; z < inEnd[2]; ++z)
+		{
+			for (size_t y = inBegin[1]; y < inEnd[1]; ++y)
+			{
+				const size_t row = w * (y + h * z);
+				for (size_t i = row + inBegin[0]; i < row + inEnd[0]; ++i)
+					packed[i] = atmosphere::PackInscatter(math::Float3(total_r[i].x, total_r[i].y, total_r[i].z), math::Float3(total_m[i].x, total_m[i].y, total_m[i].z));
+			}
+		}
+	});
+}
+
+void CpuPrecomputedAtmosphericScattering::ComputeInscatter4d()
+{
+	// The single scattering with the light direction of every azimuth, the higher orders of the 3d tables on top of it.
+	// They are smooth in the azimuth, the sun zenith of the 3d parametrization is a fair approximation for them.
+	Table3D& packed = *mPackInscatter4d;
+	const math::Float4 resolution = GetInscatter4dResolution();
+	const math::Float3 resolution_3d = GetInscatterResolution();
+	const size_t width = mDesc.mInscatter4dWidth;
+	const size_t height = mDesc.mInscatter4dHeight;
+	const size_t depth = mDesc.mInscatter4dDepth;
+	const LookUpTableView3D<math::Float4> total[2] = { *mTotalInscatter[RAYLEIGH], *mTotalInscatter[MIE] };
+	const LookUpTableView3D<math::Float4> single[2] = { *mSingleScattering[RAYLEIGH], *mSingleScattering[MIE] };
+
+	// One row of u per (v, w, q), a few rows per task fill the packets
+	const size_t rows_per_task = 4;
+	mScheduler->ParallelFor(height * depth * mInscatter4dSlices, rows_per_task, [&](size_t inBegin, size_t inEnd)
+	{
+		struct TexelInfo
+		{
+			size_t			x, y, z;	// z : slice q * depth + w
+			math::Float3	uvw_3d;
+		};
+		std::vector<TexelInfo> texels((inEnd - inBegin) * width);
+
+		IntegrateSingleScattering(texels.size(),
+			[&](size_t i, math::Float3& outStartPos, math::Float3& outViewDir, math::Float3& outLightDir)
+			{
+				const size_t row = inBegin + i / width;
+				const size_t x = i % width;
+				const size_t y = row % height;
+				const size_t w = (row / height) % depth;
+				const size_t q = row / (height * depth);
+				const math::Float4 uvwq(
+					(float(x) + 0.5f) / float(width),
+					(float(y) + 0.5f) / float(height),
+					(float(w) + 0.5f) / float(depth),
+					(float(q) + 0.5f) / float(mInscatter4dSlices));
+				float sample_height, cos_view_zenith, cos_sun_zenith, cos_azimuth;
+				LUTCoordToWorldCoord4D(uvwq, sample_height, cos_view_zenith, cos_sun_zenith, cos_azimuth, resolution);
+				texels[i] = TexelInfo{ x, y, q * depth + w, WorldCoordToLUTCoord(sample_height, cos_view_zenith, cos_sun_zenith, resolution_3d) };
+				outStartPos = math::Float3(0.0f, sample_height, 0.0f);
+				outViewDir = ComputeViewDir(cos_view_zenith);
+				outLightDir = ComputeLightDir4D(cos_sun_zenith, cos_azimuth);
+			},
+			[&](size_t i, const math::Float3& inInscatterR, const math::Float3& inInscatterM)
+			{
+				const TexelInfo& texel = texels[i];
+				math::Float3 inscatter[2] = { inInscatterR, inInscatterM };
+				for (int t : { RAYLEIGH, MIE })
+				{
+					const math::Float4 total_inscatter = total[t].Sample(texel.uvw_3d);
+					const math::Float4 single_inscatter = single[t].Sample(texel.uvw_3d);
+					inscatter[t] += math::Float3(total_inscatter.x - single_inscatter.x, total_inscatter.y - single_inscatter.y, total_inscatter.z - single_inscatter.z);
+				}
+				packed.At(texel.x, texel.y, texel.z) = atmosphere::PackInscatter(inscatter[RAYLEIGH], inscatter[MIE]);
+			});
+	});
+}
+
+} // namespace atmosphere
@@ -0,0 +1,276 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <src/lib/math/Math.hpp>
+#include <src/lib/etc/TaskScheduler.hpp>
+#include <shader/atmosphere/AtmosphereConstants.h>
+#include "AtmosphereExport.hpp"
+#include "BakeTimings.hpp"
+#include "LookUpTable.hpp"
+#include "LookUpTableCache.hpp"
+#include "Planet.hpp"
+#include "SingleScatteringPacket.hpp"
+
+namespace atmosphere {
+
+//--------------------------------------------------------------------------------------------
+// Precomputed Atmospheric Scattering on CPU
+//		- Produces the same look-up tables as PrecomputedAtmosphericScattering (D3D11) without a GPU
+//		- Each stage is the CPU counterpart of a pixel shader in shader/atmosphere/
+//--------------------------------------------------------------------------------------------
+struct ATMOSPHERE_EXPORT CpuPrecomputedAtmosphericScattering
+{
+	enum BufferType {
+		BUF_OPTICAL_DEPTH = 0,		// OpticalDepthPS.hlsl
+		BUF_SINGLE_SCATTERING,		// SingleScatteringPS.hlsl
+		BUF_MULTIPLE_SCATTERING,	// MultipleScatteringPS.hlsl
+		BUF_GATHER_INSCATTER,		// GatherInscatterPS.hlsl
+		BUF_ACCUMULATE_INSCATTER,	// MultipleScatteringPS.hlsl, added to the totals in the same pass
+		BUF_TOTAL_INSCATTER,		// the single scattering and the accumulated orders
+		BUF_PACK_INSCATTER,			// PackInscatterPS.hlsl
+		BUF_IRRADIANCE,				// IrradiancePS.hlsl, the sky irradiance of every order added in place
+		BUF_INSCATTER_4D,			// optional packed inscatter with the view-sun azimuth
+		NUM_BUFFERS,
+	};
+
+	enum TextureIndex {
+		RAYLEIGH = 0,
+		MIE,
+	};
+
+	// Relative increment of the inscatter brought by one scattering order
+	enum class ConvergenceMetric {
+		Max = 0,	// max over the texels of |increment| / |total|
+		Mean,		// sum of |increment| / sum of |total|, i.e. the share of the energy
+	};
+
+	using Table2D = LookUpTable2D<math::Float2>;	// R32G32
+	using Table3D = LookUpTable3D<math::Float4>;	// R32G32B32A32
+	using IrradianceTable = LookUpTable2D<math::Float4>;	// R32G32B32A32, alpha unused
+	using View2D = LookUpTableView2D<math::Float2>;
+	using View3D = LookUpTableView3D<math::Float4>;
+	using IrradianceView = LookUpTableView2D<math::Float4>;
+
+	struct Desc
+	{
+		size_t	mOpticalDepthWidth	= 512;
+		size_t	mOpticalDepthHeight	= 512;
+		// Resolution of the 3d tables : height, view zenith (even, the horizon splits it in half), sun zenith
+		size_t	mInscatterWidth		= TEX4D_U;
+		size_t	mInscatterHeight	= TEX4D_V;
+		size_t	mInscatterDepth		= TEX4D_W;
+		// Resolution of the sky irradiance table : height, sun zenith (SunlightLUTCoordToWorldCoord())
+		size_t	mIrradianceWidth	= IRRADIANCE_U;
+		size_t	mIrradianceHeight	= IRRADIANCE_V;
+		// Optional 4d packed inscatter (WorldCoordToLUTCoord4D()) : (u, v, w) as the 3d tables, and mInscatter4dSlices
+		// view-sun azimuths in [0, PI], 0 = no 4d table. The single scattering is integrated per azimuth, the higher orders
+		// come from the 3d tables. The slices are reduced, down to 2, until the table fits in mMaxInscatter4dBytes.
+		size_t	mInscatter4dWidth	= TEX4D_U;
+		size_t	mInscatter4dHeight	= TEX4D_V;
+		size_t	mInscatter4dDepth	= TEX4D_W;
+		size_t	mInscatter4dSlices	= 0;
+		size_t	mMaxInscatter4dBytes	= size_t(64) << 20;
+		std::uint32_t	mNumThreads	= 0;	// 0 = std::thread::hardware_concurrency()
+
+		// Texels of a 3d table are processed in (u, v, w) tiles of this size, one task per tile
+		size_t	mTileWidth	= 4;
+		size_t	mTileHeight	= 8;
+		size_t	mTileDepth	= 2;
+
+		// Instruction set of the single scattering packet kernel
+		SimdInstructionSet	mInstructionSet = SimdInstructionSet::Auto;
+
+		// Analytic : single scattering evaluates the optical depth in closed form,
+		//            the optical depth table is filled with the same formula instead of the numeric integration
+		OpticalDepthMode	mOpticalDepthMode = OpticalDepthMode::Table;
+
+		// > 0 : the inscatter integrals take adaptive steps with this relative tolerance (IntegrateInscatterAdaptive),
+		//       instead of INSCATTER_INTEGRAL_STEPS uniform steps. Single scattering then bypasses the packet kernel.
+		float	mIntegrationTolerance = 0.0f;
+
+		// Directions of the gather pass. mNumGatherSamples applies to SphericalFibonacci, Random takes NUM_RANDOMDIR_SAMPLES.
+		GatherQuadrature	mGatherQuadrature = GatherQuadrature::Random;
+		std::uint32_t		mNumGatherSamples = 64;
+
+		// > 0 : the scattering orders stop as soon as one adds less than this, measured with mConvergenceMetric.
+		//       SetNumScattering() is the upper bound then.
+		float				mConvergenceThreshold = 0.0f;
+		ConvergenceMetric	mConvergenceMetric = ConvergenceMetric::Max;
+
+		// Directory of the on-disk cache of the finished tables. Empty = no cache.
+		std::string	mCacheDirectory;
+
+		// Optional pool shared with other systems. When null, the engine owns a pool of mNumThreads threads.
+		etc::TaskScheduler*	mScheduler = nullptr;
+	};
+
+	// Sample positions evaluated by the inscatter integrals (single and multiple scattering, 4d table) of the last bake
+	struct IntegrationStats
+	{
+		std::uint64_t	mNumRays = 0;
+		std::uint64_t	mNumSamples = 0;
+
+		// The same rays with INSCATTER_INTEGRAL_STEPS uniform steps
+		std::uint64_t GetNumUniformSamples() const { return mNumRays * std::uint64_t(INSCATTER_INTEGRAL_STEPS + 1); }
+		std::int64_t GetNumSamplesSaved() const { return std::int64_t(GetNumUniformSamples()) - std::int64_t(mNumSamples); }
+	};
+
+	CpuPrecomputedAtmosphericScattering(const Desc& inDesc);
+	~CpuPrecomputedAtmosphericScattering();
+
+	void ResetScatteringParameters(Planet inPlanet) { mPrecomputedParam = GetScatteringParameters(inPlanet); }
+
+	// Only the stages whose inputs changed since the last call run again (ComputeLookUpTableStageFingerprints()),
+	// e.g. the optical depth survives a change of the scattering coefficients, more scattering orders resume the loop.
+	// On a cache hit only the optical depth, total inscatter, packed inscatter, irradiance and 4d tables are filled,
+	// they view the mapped file.
+	// Returns false when *inCancel was set during the bake, the tables are incomplete then and nothing is cached.
+	bool GeneratePrecomputedTexture(const std::atomic<bool>* inCancel = nullptr);
+	// The next GeneratePrecomputedTexture() runs every stage
+	void InvalidateStages();
+	// Times the stage ran during the last bake, the stages of the loop run once per order
+	std::uint32_t GetNumStageExecutions(BufferType inStage) const { return mNumStageExecutions[inStage]; }
+	// Wall clock and worker time of every stage run by the last bake, empty when it was up to date or loaded from the cache.
+	// The busy time includes the other users of a shared scheduler.
+	const BakeTimings& GetBakeTimings() const { return mBakeTimings; }
+	bool IsLoadedFromCache() const { return mIsLoadedFromCache; }
+	std::uint64_t GetCacheKey() const;
+
+	// The views are valid until the next GeneratePrecomputedTexture(). A table is invalid before the first bake that fills it,
+	// e.g. the intermediate tables after a cache hit.
+	View3D GetSingleScatteringTexture(TextureIndex index) const { return GetView(mSingleScattering[index]); }
+	View3D GetMultipleScatteringTexture(TextureIndex index) const { return GetView(mMultipleScattering[index]); }
+	View2D GetOpticalDepthTexture() const;
+	View3D GetInscatterGatherTexture(TextureIndex index) const { return GetView(mInscatterGathering[index]); }
+	View3D GetTotalInscatterTexture(TextureIndex index) const;
+	View3D GetPackedTotalInscatterTexture() const;
+	// Sky irradiance of a horizontal surface for a sun of 1, all the orders. Look it up with WorldCoordToSunlightLUTCoord().
+	IrradianceView GetIrradianceTexture() const;
+	// Packed inscatter with the azimuth, the slices in the depth (LookUpTableView4D). Only with Desc::mInscatter4dSlices > 0.
+	bool HasInscatter4d() const { return mInscatter4dSlices > 0; }
+	LookUpTableView4D<math::Float4> GetPackedInscatter4dTexture() const;
+
+	PrecomputedSctrParams& GetParam() { return mPrecomputedParam; }
+	const PrecomputedSctrParams& GetParam() const { return mPrecomputedParam; }
+
+	void SetNumScattering(std::uint32_t n) { mNumScattering = n; }
+	std::uint32_t GetNumScattering() const { return mNumScattering; }
+	// Orders computed by the last bake, <= GetNumScattering() with a convergence threshold
+	std::uint32_t GetNumScatteringComputed() const { return mNumScatteringComputed; }
+	// Increment of every multiple scattering order in the accumulated inscatter, [0] = 2nd order. Empty on a cache hit.
+	const std::vector<float>& GetScatteringIncrements() const;
+	std::uint32_t GetNumThreads() const { return mScheduler->GetNumThreads(); }
+	etc::TaskScheduler& GetScheduler() const { return *mScheduler; }
+	SimdInstructionSet GetInstructionSet() const { return mInstructionSet; }
+	OpticalDepthMode GetOpticalDepthMode() const { return mDesc.mOpticalDepthMode; }
+	math::Float3 GetInscatterResolution() const { return math::Float3(float(mDesc.mInscatterWidth), float(mDesc.mInscatterHeight), float(mDesc.mInscatterDepth)); }
+	math::Float2 GetIrradianceResolution() const { return math::Float2(float(mDesc.mIrradianceWidth), float(mDesc.mIrradianceHeight)); }
+	// After the memory bound, w = 0 without a 4d table
+	math::Float4 GetInscatter4dResolution() const { return math::Float4(float(mDesc.mInscatter4dWidth), float(mDesc.mInscatter4dHeight), float(mDesc.mInscatter4dDepth), float(mInscatter4dSlices)); }
+	float GetIntegrationTolerance() const { return mDesc.mIntegrationTolerance; }
+	GatherQuadrature GetGatherQuadrature() const { return mDesc.mGatherQuadrature; }
+	// Directions per texel of the gather pass
+	std::uint32_t GetNumGatherSamples() const;
+	IntegrationStats GetIntegrationStats() const;
+
+	// Scattering parameters in the units the kernels expect (see PrecomputedAtmosphericScattering::UpdateShaderParameters)
+	PrecomputedSctrParams GetKernelParameters() const;
+
+protected:
+	bool RunPrecomputation();
+	void ComputeOpticalDepth();
+	void ComputeSingleScattering();
+	void GatherInscatter(const Table3D& inInscatterR, const Table3D& inInscatterM);
+	void PrecomputeGatherWeights();
+	void ComputeMultipleScattering();
+	// Sky irradiance of the order in inInscatterR / M, written or added to mIrradiance
+	void ComputeIrradiance(const Table3D& inInscatterR, const Table3D& inInscatterM, bool inAccumulate);
+	void PackInscatter();
+	void ComputeInscatter4d();
+
+	// Single scattering along inNumRays view rays, the ground reflection included (SingleScatteringPS.hlsl).
+	// inGetRay(i, start_pos, view_dir, light_dir) describes ray i, inStore(i, inscatter_r, inscatter_m) receives its result.
+	void IntegrateSingleScattering(
+		size_t inNumRays,
+		const std::function<void(size_t, math::Float3&, math::Float3&, math::Float3&)>& inGetRay,
+		const std::function<void(size_t, const math::Float3&, const math::Float3&)>& inStore);
+
+	// Increment of the last order (mMultipleScattering) relative to the inscatter accumulated so far (mTotalInscatter)
+	float MeasureScatteringIncrement() const;
+
+	AdaptiveIntegrationSettings GetAdaptiveIntegrationSettings() const;
+	void AddIntegrationStats(std::uint64_t inNumRays, std::uint64_t inNumSamples);
+
+	template<typename T> static auto GetView(const std::unique_ptr<T>& inTable) -> decltype(inTable->GetView())
+	{
+		return inTable ? inTable->GetView() : decltype(inTable->GetView())();
+	}
+
+	// Allocates the tables on the first bake that runs a stage, and copies the tables of a cache hit into them
+	void PrepareTables();
+
+	LookUpTableCacheKeyDesc GetCacheKeyDesc() const;
+	// Keeps the file mapped on a hit, the cached tables are sampled from it
+	bool LoadFromCache(std::uint64_t inKey);
+	void StoreToCache(std::uint64_t inKey) const;
+
+	bool IsCancelled() const { return mCancel && mCancel->load(std::memory_order_relaxed); }
+
+	// Runs inStage unless the table already holds inFingerprint, returns false when cancelled
+	bool RunStage(BufferType inStage, std::uint64_t inFingerprint, const std::function<void()>& inKernel);
+	// Runs inKernel and appends its timing to mBakeTimings
+	void TimeStage(BufferType inStage, std::uint32_t inOrder, const std::function<void()>& inKernel);
+	// Work of one run of inStage, BakeStageTiming::mNumSamples
+	std::uint64_t GetNumStageSamples(BufferType inStage, std::uint64_t inNumIntegrationSamples) const;
+
+	// Runs inKernel(begin, end) for every tile of a 3d table, tiles are distributed over the worker threads
+	void ForEachTile3D(const std::function<void(const size_t inBegin[3], const size_t inEnd[3])>& inKernel) const;
+
+	// Runs inKernel(x, y, z) for every texel of a 3d table
+	void ForEachTexel3D(const std::function<void(size_t, size_t, size_t)>& inKernel) const;
+
+	const Desc				mDesc;
+	PrecomputedSctrParams	mPrecomputedParam;
+	std::uint32_t			mNumScattering = 6;
+	std::uint32_t			mNumScatteringComputed = 0;
+	size_t					mInscatter4dSlices = 0;	// Desc::mInscatter4dSlices within the memory bound
+	std::vector<float>		mScatteringIncrements;
+
+	// Inputs the tables were computed with (LookUpTableStageFingerprints), 0 = stale
+	std::uint64_t	mStageFingerprints[NUM_BUFFERS] = {};
+	std::uint32_t	mNumStageExecutions[NUM_BUFFERS] = {};
+	BakeTimings		mBakeTimings;
+	// State of the loop : orders added to mTotalInscatter (1 = none), the last one is in mMultipleScattering
+	std::uint32_t	mNumScatteringAccumulated = 0;
+	bool			mIsAccumulationConverged = false;
+
+	// Fixed gather quadrature : directions, and (Rayleigh, Mie) phase function * solid angle for every (v, w) of the LUT,
+	// i.e. every view direction, and every direction. Independent of the scattering parameters (mie_g = 0).
+	std::vector<math::Float3>	mGatherDirections;
+	std::vector<math::Float2>	mGatherWeights;
+	SimdInstructionSet		mInstructionSet = SimdInstructionSet::Scalar;
+	bool					mIsLoadedFromCache = false;
+	std::unique_ptr<LookUpTableCache>	mCache = nullptr;
+	std::unique_ptr<LookUpTableFile>	mCachedFile = nullptr;	// the last cache hit, until a bake runs a stage
+	const std::atomic<bool>*	mCancel = nullptr;	// during GeneratePrecomputedTexture()
+	std::atomic<std::uint64_t>	mNumIntegratedRays{ 0 };
+	std::atomic<std::uint64_t>	mNumIntegrationSamples{ 0 };
+
+	std::unique_ptr<etc::TaskScheduler>	mOwnedScheduler = nullptr;
+	etc::TaskScheduler*					mScheduler = nullptr;
+
+	std::unique_ptr<Table2D>	mOpticalDepth = nullptr;
+	std::unique_ptr<Table3D>	mSingleScattering[2];
+	std::unique_ptr<Table3D>	mInscatterGathering[2];
+	std::unique_ptr<Table3D>	mMultipleScattering[2];
+	std::unique_ptr<Table3D>	mTotalInscatter[2];
+	std::unique_ptr<Table3D>	mPackInscatter = nullptr;
+	std::unique_ptr<Table3D>	mPackInscatter4d = nullptr;	// depth = mInscatter4dDepth * mInscatter4dSlices
+	std::unique_ptr<IrradianceTable>	mIrradiance = nullptr;
+};
+
+} // namespace atmosphere
@@ -0,0 +1,361 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <src/lib/math/Math.hpp>
+
+namespace atmosphere {
+
+//------------------------------------------------------
+//	CPU look-up tables
+//		- Texel (x, y, z) is stored at x + width * (y + height * z), the same as a D3D11 texture
+//		- Sample() emulates SampleLevel() with MIN_MAG_MIP_LINEAR filter and CLAMP addressing,
+//		  i.e. texel centers are at (i + 0.5) / resolution
+//		- LookUpTableView* are non-owning, e.g. over a memory mapped file. Tables convert to views implicitly.
+//		- LookUpTableView4D reads a 3d table whose depth holds the slices of a 4th dimension
+//		- TiledLookUpTable3D is a read-only copy in a cache-friendly layout (LookUpTableLayout)
+//------------------------------------------------------
+namespace detail {
+
+struct LinearTap
+{
+	size_t	i0, i1;
+	float	t;		// weight of i1
+};
+
+inline LinearTap ComputeLinearTap(float inCoord, size_t inResolution)
+{
+	const float texel = inCoord * float(inResolution) - 0.5f;
+	const float texel_floor = std::floor(texel);
+	const int last = int(inResolution) - 1;
+	const int i0 = int(texel_floor);
+	LinearTap tap;
+	tap.i0 = size_t(std::min(std::max(i0, 0), last));
+	tap.i1 = size_t(std::min(std::max(i0 + 1, 0), last));
+	tap.t = texel - texel_floor;
+	return tap;
+}
+
+} // namespace detail
+
+template<typename T> struct LookUpTableView2D
+{
+	LookUpTableView2D() = default;
+	LookUpTableView2D(const T* inTexels, size_t inWidth, size_t inHeight)
+		: mTexels(inTexels), mWidth(inWidth), mHeight(inHeight)
+	{}
+
+	bool IsValid() const { return mTexels != nullptr; }
+	size_t GetWidth() const { return mWidth; }
+	size_t GetHeight() const { return mHeight; }
+	size_t GetNumTexels() const { return mWidth * mHeight; }
+
+	const T& At(size_t x, size_t y) const { assert(x < mWidth && y < mHeight); return mTexels[x + mWidth * y]; }
+	const T* GetData() const { return mTexels; }
+
+	T Sample(const math::Float2& inUV) const
+	{
+		const detail::LinearTap tx = detail::ComputeLinearTap(inUV.x, mWidth);
+		const detail::LinearTap ty = detail::ComputeLinearTap(inUV.y, mHeight);
+		const T c0 = At(tx.i0, ty.i0) * (1.0f - tx.t) + At(tx.i1, ty.i0) * tx.t;
+		const T c1 = At(tx.i0, ty.i1) * (1.0f - tx.t) + At(tx.i1, ty.i1) * tx.t;
+		return c0 * (1.0f - ty.t) + c1 * ty.t;
+	}
+
+protected:
+	const T*	mTexels = nullptr;
+	size_t		mWidth = 0;
+	size_t		mHeight = 0;
+};
+
+template<typename T> struct LookUpTableView3D
+{
+	LookUpTableView3D() = default;
+	LookUpTableView3D(const T* inTexels, size_t inWidth, size_t inHeight, size_t inDepth)
+		: mTexels(inTexels), mWidth(inWidth), mHeight(inHeight), mDepth(inDepth)
+	{}
+
+	bool IsValid() const { return mTexels != nullptr; }
+	size_t GetWidth() const { return mWidth; }
+	size_t GetHeight() const { return mHeight; }
+	size_t GetDepth() const { return mDepth; }
+	size_t GetNumTexels() const { return mWidth * mHeight * mDepth; }
+
+	const T& At(size_t x, size_t y, size_t z) const { assert(x < mWidth && y < mHeight && z < mDepth); return mTexels[x + mWidth * (y + mHeight * z)]; }
+	const T* GetData() const { return mTexels; }
+
+	T Sample(const math::Float3& inUVW) const
+	{
+		const detail::LinearTap tx = detail::ComputeLinearTap(inUVW.x, mWidth);
+		const detail::LinearTap ty = detail::ComputeLinearTap(inUVW.y, mHeight);
+		const detail::LinearTap tz = detail::ComputeLinearTap(inUVW.z, mDepth);
+		const T c00 = At(tx.i0, ty.i0, tz.i0) * (1.0f - tx.t) + At(tx.i1, ty.i0, tz.i0) * tx.t;
+		const T c10 = At(tx.i0, ty.i1, tz.i0) * (1.0f - tx.t) + At(tx.i1, ty.i1, tz.i0) * tx.t;
+		const T c01 = At(tx.i0, ty.i0, tz.i1) * (1.0f - tx.t) + At(tx.i1, ty.i0, tz.i1) * tx.t;
+		const T c11 = At(tx.i0, ty.i1, tz.i1) * (1.0f - tx.t) + At(tx.i1, ty.i1, tz.i1) * tx.t;
+		const T c0 = c00 * (1.0f - ty.t) + c10 * ty.t;
+		const T c1 = c01 * (1.0f - ty.t) + c11 * ty.t;
+		return c0 * (1.0f - tz.t) + c1 * tz.t;
+	}
+
+protected:
+	const T*	mTexels = nullptr;
+	size_t		mWidth = 0;
+	size_t		mHeight = 0;
+	size_t		mDepth = 0;
+};
+
+//------------------------------------------------------
+//	4d look-up table packed in the depth of a 3d table
+//		- Texel (x, y, z, q) is the texel (x, y, q * depth + z) of a 3d table of depth * slices texels,
+//		  the layout ScreenBufferUpdater3D renders with ScreenUpdateContext::mNum4dSlices
+//		- Sample() is quadrilinear : a trilinear fetch in the two nearest slices, z clamped within each slice,
+//		  then a linear blend along q. Hardware trilinear filtering would blend across the slices instead.
+//------------------------------------------------------
+template<typename T> struct LookUpTableView4D
+{
+	LookUpTableView4D() = default;
+	LookUpTableView4D(const LookUpTableView3D<T>& inSlices, size_t inNumSlices)
+		: mSlices(inSlices), mDepth(inSlices.GetDepth() / inNumSlices), mNumSlices(inNumSlices)
+	{
+		assert(inNumSlices > 0 && mDepth * inNumSlices == inSlices.GetDepth());
+	}
+
+	bool IsValid() const { return mSlices.IsValid(); }
+	size_t GetWidth() const { return mSlices.GetWidth(); }
+	size_t GetHeight() const { return mSlices.GetHeight(); }
+	size_t GetDepth() const { return mDepth; }
+	size_t GetNumSlices() const { return mNumSlices; }
+	size_t GetNumTexels() const { return mSlices.GetNumTexels(); }
+	// The 3d table as a whole, e.g. to upload it
+	const LookUpTableView3D<T>& GetSlices() const { return mSlices; }
+
+	const T& At(size_t x, size_t y, size_t z, size_t q) const { assert(z < mDepth && q < mNumSlices); return mSlices.At(x, y, q * mDepth + z); }
+	const T* GetData() const { return mSlices.GetData(); }
+
+	T Sample(const math::Float4& inUVWQ) const
+	{
+		const detail::LinearTap tx = detail::ComputeLinearTap(inUVWQ.x, GetWidth());
+		const detail::LinearTap ty = detail::ComputeLinearTap(inUVWQ.y, GetHeight());
+		const detail::LinearTap tz = detail::ComputeLinearTap(inUVWQ.z, mDepth);
+		const detail::LinearTap tq = detail::ComputeLinearTap(inUVWQ.w, mNumSlices);
+		auto sample_slice = [&](size_t q)
+		{
+			const T c00 = At(tx.i0, ty.i0, tz.i0, q) * (1.0f - tx.t) + At(tx.i1, ty.i0, tz.i0, q) * tx.t;
+			const T c10 = At(tx.i0, ty.i1, tz.i0, q) * (1.0f - tx.t) + At(tx.i1, ty.i1, tz.i0, q) * tx.t;
+			const T c01 = At(tx.i0, ty.i0, tz.i1, q) * (1.0f - tx.t) + At(tx.i1, ty.i0, tz.i1, q) * tx.t;
+			const T c11 = At(tx.i0, ty.i1, tz.i1, q) * (1.0f - tx.t) + At(tx.i1, ty.i1, tz.i1, q) * tx.t;
+			const T c0 = c00 * (1.0f - ty.t) + c10 * ty.t;
+			const T c1 = c01 * (1.0f - ty.t) + c11 * ty.t;
+			return c0 * (1.0f - tz.t) + c1 * tz.t;
+		};
+		return sample_slice(tq.i0) * (1.0f - tq.t) + sample_slice(tq.i1) * tq.t;
+	}
+
+protected:
+	LookUpTableView3D<T>	mSlices;
+	size_t					mDepth = 0;
+	size_t					mNumSlices = 0;
+};
+
+template<typename T> struct LookUpTable2D
+{
+	LookUpTable2D(size_t inWidth, size_t inHeight)
+		: mWidth(inWidth), mHeight(inHeight), mTexels(inWidth * inHeight, T(0.0f))
+	{}
+	// A copy of the texels of inView
+	explicit LookUpTable2D(const LookUpTableView2D<T>& inView)
+		: mWidth(inView.GetWidth()), mHeight(inView.GetHeight()), mTexels(inView.GetData(), inView.GetData() + inView.GetNumTexels())
+	{}
+
+	size_t GetWidth() const { return mWidth; }
+	size_t GetHeight() const { return mHeight; }
+	size_t GetNumTexels() const { return mTexels.size(); }
+
+	T& At(size_t x, size_t y) { assert(x < mWidth && y < mHeight); return mTexels[x + mWidth * y]; }
+	const T& At(size_t x, size_t y) const { assert(x < mWidth && y < mHeight); return mTexels[x + mWidth * y]; }
+	T* GetData() { return mTexels.data(); }
+	const T* GetData() const { return mTexels.data(); }
+
+	LookUpTableView2D<T> GetView() const { return LookUpTableView2D<T>(mTexels.data(), mWidth, mHeight); }
+	operator LookUpTableView2D<T>() const { return GetView(); }
+
+	T Sample(const math::Float2& inUV) const { return GetView().Sample(inUV); }
+
+protected:
+	size_t			mWidth;
+	size_t			mHeight;
+	std::vector<T>	mTexels;
+};
+
+template<typename T> struct LookUpTable3D
+{
+	LookUpTable3D(size_t inWidth, size_t inHeight, size_t inDepth)
+		: mWidth(inWidth), mHeight(inHeight), mDepth(inDepth), mTexels(inWidth * inHeight * inDepth, T(0.0f))
+	{}
+	// A copy of the texels of inView
+	explicit LookUpTable3D(const LookUpTableView3D<T>& inView)
+		: mWidth(inView.GetWidth()), mHeight(inView.GetHeight()), mDepth(inView.GetDepth()), mTexels(inView.GetData(), inView.GetData() + inView.GetNumTexels())
+	{}
+
+	size_t GetWidth() const { return mWidth; }
+	size_t GetHeight() const { return mHeight; }
+	size_t GetDepth() const { return mDepth; }
+	size_t GetNumTexels() const { return mTexels.size(); }
+
+	T& At(size_t x, size_t y, size_t z) { assert(x < mWidth && y < mHeight && z < mDepth); return mTexels[x + mWidth * (y + mHeight * z)]; }
+	const T& At(size_t x, size_t y, size_t z) const { assert(x < mWidth && y < mHeight && z < mDepth); return mTexels[x + mWidth * (y + mHeight * z)]; }
+	T* GetData() { return mTexels.data(); }
+	const T* GetData() const { return mTexels.data(); }
+
+	LookUpTableView3D<T> GetView() const { return LookUpTableView3D<T>(mTexels.data(), mWidth, mHeight, mDepth); }
+	operator LookUpTableView3D<T>() const { return GetView(); }
+
+	T Sample(const math::Float3& inUVW) const { return GetView().Sample(inUVW); }
+
+protected:
+	size_t			mWidth;
+	size_t			mHeight;
+	size_t			mDepth;
+	std::vector<T>	mTexels;
+};
+
+// Order of the texels of a TiledLookUpTable3D
+enum class LookUpTableLayout
+{
+	Linear = 0,	// x + width * (y + height * z), the same as LookUpTable3D
+	Morton,		// Z-order curve, the axes are padded to powers of two
+	Brick,		// 4x4x4 bricks in linear order, texels in linear order within a brick. The axes are padded to multiples of 4.
+};
+
+//------------------------------------------------------
+//	3d look-up table in a cache-friendly layout
+//		- The 8 taps of a trilinear fetch are close in memory, e.g. in a linear layout the neighbours along z are
+//		  width * height texels apart, in a brick most fetches stay within 1KB (Float4)
+//		- Every layout is separable : index(x, y, z) = offset_x[x] + offset_y[y] + offset_z[z].
+//		  Sample() looks the offsets up per axis, then fetches and filters exactly like LookUpTableView3D::Sample().
+//------------------------------------------------------
+template<typename T> struct TiledLookUpTable3D
+{
+	static constexpr size_t sBrickSize = 4;
+
+	TiledLookUpTable3D(const LookUpTableView3D<T>& inSource, LookUpTableLayout inLayout)
+		: mLayout(inLayout), mWidth(inSource.GetWidth()), mHeight(inSource.GetHeight()), mDepth(inSource.GetDepth())
+	{
+		const size_t size[3] = { mWidth, mHeight, mDepth };
+		size_t padded[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			padded[axis] = size[axis];
+			if (inLayout == LookUpTableLayout::Morton)
+				padded[axis] = RoundUpToPowerOfTwo(size[axis]);
+			else if (inLayout == LookUpTableLayout::Brick)
+				padded[axis] = (size[axis] + sBrickSize - 1) / sBrickSize * sBrickSize;
+			mOffsets[axis].resize(size[axis]);
+		}
+
+		switch (inLayout)
+		{
+		case LookUpTableLayout::Linear:
+		{
+			const size_t strides[3] = { 1, mWidth, mWidth * mHeight };
+			for (int axis = 0; axis < 3; ++axis)
+				for (size_t i = 0; i < size[axis]; ++i)
+					mOffsets[axis][i] = std::uint32_t(i * strides[axis]);
+			break;
+		}
+		case LookUpTableLayout::Morton:
+		{
+			// Bits are interleaved x, y, z from the lowest one, an axis with fewer bits drops out of the rotation
+			std::uint32_t num_bits[3];
+			for (int axis = 0; axis < 3; ++axis)
+				for (num_bits[axis] = 0; (size_t(1) << num_bits[axis]) < padded[axis]; ++num_bits[axis]) {}
+			std::uint32_t bit_position[3][32];
+			std::uint32_t position = 0;
+			for (std::uint32_t bit = 0; bit < 32; ++bit)
+				for (int axis = 0; axis < 3; ++axis)
+					if (bit < num_bits[axis])
+						bit_position[axis][bit] = position++;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				for (size_t i = 0; i < size[axis]; ++i)
+				{
+					std::uint32_t offset = 0;
+					for (std::uint32_t bit = 0; bit < num_bits[axis]; ++bit)
+						offset |= std::uint32_t((i >> bit) & 1) << bit_position[axis][bit];
+					mOffsets[axis][i] = offset;
+				}
+			}
+			break;
+		}
+		case LookUpTableLayout::Brick:
+		{
+			const size_t brick_texels = sBrickSize * sBrickSize * sBrickSize;
+			const size_t brick_strides[3] = { brick_texels, brick_texels * (padded[0] / sBrickSize), brick_texels * (padded[0] / sBrickSize) * (padded[1] / sBrickSize) };
+			const size_t texel_strides[3] = { 1, sBrickSize, sBrickSize * sBrickSize };
+			for (int axis = 0; axis < 3; ++axis)
+				for (size_t i = 0; i < size[axis]; ++i)
+					mOffsets[axis][i] = std::uint32_t((i / sBrickSize) * brick_strides[axis] + (i % sBrickSize) * texel_strides[axis]);
+			break;
+		}
+		}
+
+		mTexels.assign(padded[0] * padded[1] * padded[2], T(0.0f));
+		for (size_t z = 0; z < mDepth; ++z)
+			for (size_t y = 0; y < mHeight; ++y)
+				for (size_t x = 0; x < mWidth; ++x)
+					mTexels[GetIndex(x, y, z)] = inSource.At(x, y, z);
+	}
+
+	LookUpTableLayout GetLayout() const { return mLayout; }
+	size_t GetWidth() const { return mWidth; }
+	size_t GetHeight() const { return mHeight; }
+	size_t GetDepth() const { return mDepth; }
+	// Bytes of the texels, padding included
+	size_t GetMemorySize() const { return mTexels.size() * sizeof(T); }
+
+	size_t GetIndex(size_t x, size_t y, size_t z) const
+	{
+		assert(x < mWidth && y < mHeight && z < mDepth);
+		return size_t(mOffsets[0][x]) + mOffsets[1][y] + mOffsets[2][z];
+	}
+	const T& At(size_t x, size_t y, size_t z) const { return mTexels[GetIndex(x, y, z)]; }
+
+	T Sample(const math::Float3& inUVW) const
+	{
+		const detail::LinearTap tx = detail::ComputeLinearTap(inUVW.x, mWidth);
+		const detail::LinearTap ty = detail::ComputeLinearTap(inUVW.y, mHeight);
+		const detail::LinearTap tz = detail::ComputeLinearTap(inUVW.z, mDepth);
+		const std::uint32_t x0 = mOffsets[0][tx.i0], x1 = mOffsets[0][tx.i1];
+		const std::uint32_t y0 = mOffsets[1][ty.i0], y1 = mOffsets[1][ty.i1];
+		const std::uint32_t z0 = mOffsets[2][tz.i0], z1 = mOffsets[2][tz.i1];
+		const T* texels = mTexels.data();
+		const T c00 = texels[x0 + y0 + z0] * (1.0f - tx.t) + texels[x1 + y0 + z0] * tx.t;
+		const T c10 = texels[x0 + y1 + z0] * (1.0f - tx.t) + texels[x1 + y1 + z0] * tx.t;
+		const T c01 = texels[x0 + y0 + z1] * (1.0f - tx.t) + texels[x1 + y0 + z1] * tx.t;
+		const T c11 = texels[x0 + y1 + z1] * (1.0f - tx.t) + texels[x1 + y1 + z1] * tx.t;
+		const T c0 = c00 * (1.0f - ty.t) + c10 * ty.t;
+		const T c1 = c01 * (1.0f - ty.t) + c11 * ty.t;
+		return c0 * (1.0f - tz.t) + c1 * tz.t;
+	}
+
+protected:
+	static size_t RoundUpToPowerOfTwo(size_t inValue)
+	{
+		size_t value = 1;
+		while (value < inValue)
+			value *= 2;
+		return value;
+	}
+
+	LookUpTableLayout			mLayout;
+	size_t						mWidth;
+	size_t						mHeight;
+	size_t						mDepth;
+	std::vector<std::uint32_t>	mOffsets[3];
+	std::vector<T>				mTexels;
+};
+
+} // namespace atmosphere
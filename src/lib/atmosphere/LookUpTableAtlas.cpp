@@ -0,0 +1,289 @@
+#include "LookUpTableAtlas.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace atmosphere {
+
+namespace detail {
+
+inline bool IsScaleHeight(AtlasParameter inParameter)
+{
+	return inParameter == AtlasParameter::RayleighScaleHeight || inParameter == AtlasParameter::MieScaleHeight;
+}
+
+inline bool NearlyEqualRelative(float a, float b)
+{
+	return std::abs(a - b) <= 1e-4f * std::max(std::abs(a), std::abs(b));
+}
+
+template<typename TTable> void AddWeighted(TTable& outTable, const TTable& inTable, float inWeight)
+{
+	auto* dst = outTable.GetData();
+	const auto* src = inTable.GetData();
+	for (size_t i = 0, n = outTable.GetNumTexels(); i < n; ++i)
+		dst[i] = dst[i] + src[i] * inWeight;
+}
+
+// Geometric blend : the inscatter varies about exponentially with the coefficients and the scale heights.
+// Zero texels are blended as sLogFloor, and the texels that end at the floor are zero again.
+static const float sLogFloor = 1e-30f;
+
+inline void AddWeightedLog(LookUpTable3D<math::Float4>& outTable, const LookUpTable3D<math::Float4>& inTable, float inWeight)
+{
+	math::Float4* dst = outTable.GetData();
+	const math::Float4* src = inTable.GetData();
+	for (size_t i = 0, n = outTable.GetNumTexels(); i < n; ++i)
+		for (int c = 0; c < 4; ++c)
+			dst[i][c] += std::log(std::max(src[i][c], sLogFloor)) * inWeight;
+}
+
+inline void Exp(LookUpTable3D<math::Float4>& ioTable)
+{
+	math::Float4* texels = ioTable.GetData();
+	for (size_t i = 0, n = ioTable.GetNumTexels(); i < n; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			const float value = std::exp(texels[i][c]);
+			texels[i][c] = (value > 2.0f * sLogFloor) ? value : 0.0f;
+		}
+	}
+}
+
+} // namespace detail
+
+//--------------------------------------------------------------------------------------------
+
+LookUpTableAtlas::Tables::Tables(const Engine::Desc& inDesc)
+	: mOpticalDepth(inDesc.mOpticalDepthWidth, inDesc.mOpticalDepthHeight)
+	, mTotalInscatter{
+		Engine::Table3D(inDesc.mInscatterWidth, inDesc.mInscatterHeight, inDesc.mInscatterDepth),
+		Engine::Table3D(inDesc.mInscatterWidth, inDesc.mInscatterHeight, inDesc.mInscatterDepth) }
+	, mPackInscatter(inDesc.mInscatterWidth, inDesc.mInscatterHeight, inDesc.mInscatterDepth)
+{
+}
+
+LookUpTableAtlas::Point::Point(const Engine::Desc& inDesc)
+	: mTotalInscatter{
+		Engine::Table3D(inDesc.mInscatterWidth, inDesc.mInscatterHeight, inDesc.mInscatterDepth),
+		Engine::Table3D(inDesc.mInscatterWidth, inDesc.mInscatterHeight, inDesc.mInscatterDepth) }
+	, mPackInscatter(inDesc.mInscatterWidth, inDesc.mInscatterHeight, inDesc.mInscatterDepth)
+{
+}
+
+LookUpTableAtlas::LookUpTableAtlas(const Desc& inDesc)
+	: mDesc(inDesc)
+{
+	for (Axis& axis : mDesc.mAxes)
+		axis.mNumPoints = std::max<std::uint32_t>(axis.mNumPoints, 2);
+
+	// A single engine bakes every point, consecutive points only rebuild the stages their axis reaches
+	mEngine = std::make_unique<Engine>(mDesc.mEngineDesc);
+	mEngine->SetNumScattering(mDesc.mNumScattering);
+}
+
+LookUpTableAtlas::~LookUpTableAtlas()
+{
+}
+
+size_t LookUpTableAtlas::GetNumPoints() const
+{
+	size_t num_points = 1;
+	for (const Axis& axis : mDesc.mAxes)
+		num_points *= axis.mNumPoints;
+	return num_points;
+}
+
+size_t LookUpTableAtlas::GetMemorySize() const
+{
+	size_t size = 0;
+	for (const auto& optical_depth : mOpticalDepths)
+		if (optical_depth)
+			size += optical_depth->GetNumTexels() * sizeof(math::Float2);
+	for (const auto& point : mPoints)
+		size += 3 * point->mPackInscatter.GetNumTexels() * sizeof(math::Float4);
+	return size;
+}
+
+PrecomputedSctrParams LookUpTableAtlas::SetParameter(const PrecomputedSctrParams& inParams, const PrecomputedSctrParams& inBase, AtlasParameter inParameter, float inValue)
+{
+	PrecomputedSctrParams params = inParams;
+	switch (inParameter)
+	{
+	case AtlasParameter::RayleighSctrScale:		params.mRayleighSctrCoeff = inBase.mRayleighSctrCoeff * inValue; break;
+	case AtlasParameter::RayleighScaleHeight:	params.mRayleighScaleHeight = inValue; break;
+	case AtlasParameter::MieSctrScale:			params.mMieSctrCoeff = inBase.mMieSctrCoeff * inValue; break;
+	case AtlasParameter::MieScaleHeight:		params.mMieScaleHeight = inValue; break;
+	case AtlasParameter::MieAbsorption:			params.mMieAbsorption = inValue; break;
+	}
+	return params;
+}
+
+float LookUpTableAtlas::GetParameter(const PrecomputedSctrParams& inParams, const PrecomputedSctrParams& inBase, AtlasParameter inParameter)
+{
+	// Scales are the mean ratio of the channels, Contains() tells whether the channels moved together
+	auto scale = [](const math::Float3& inCoeff, const math::Float3& inBaseCoeff)
+	{
+		float sum = 0.0f;
+		for (int c = 0; c < 3; ++c)
+			sum += (inBaseCoeff[c] != 0.0f) ? inCoeff[c] / inBaseCoeff[c] : 1.0f;
+		return sum / 3.0f;
+	};
+
+	switch (inParameter)
+	{
+	case AtlasParameter::RayleighSctrScale:		return scale(inParams.mRayleighSctrCoeff, inBase.mRayleighSctrCoeff);
+	case AtlasParameter::RayleighScaleHeight:	return inParams.mRayleighScaleHeight;
+	case AtlasParameter::MieSctrScale:			return scale(inParams.mMieSctrCoeff, inBase.mMieSctrCoeff);
+	case AtlasParameter::MieScaleHeight:		return inParams.mMieScaleHeight;
+	case AtlasParameter::MieAbsorption:			return inParams.mMieAbsorption;
+	}
+	return 0.0f;
+}
+
+PrecomputedSctrParams LookUpTableAtlas::GetPointParams(size_t inPoint) const
+{
+	PrecomputedSctrParams params = mDesc.mBaseParams;
+	for (const Axis& axis : mDesc.mAxes)
+	{
+		const size_t index = inPoint % axis.mNumPoints;
+		inPoint /= axis.mNumPoints;
+		const float value = axis.mMin + (axis.mMax - axis.mMin) * float(index) / float(axis.mNumPoints - 1);
+		params = SetParameter(params, mDesc.mBaseParams, axis.mParameter, value);
+	}
+	return params;
+}
+
+size_t LookUpTableAtlas::GetOpticalDepthIndex(size_t inPoint) const
+{
+	size_t index = 0;
+	size_t stride = 1;
+	for (const Axis& axis : mDesc.mAxes)
+	{
+		const size_t axis_index = inPoint % axis.mNumPoints;
+		inPoint /= axis.mNumPoints;
+		if (!detail::IsScaleHeight(axis.mParameter))
+			continue;
+		index += axis_index * stride;
+		stride *= axis.mNumPoints;
+	}
+	return index;
+}
+
+bool LookUpTableAtlas::Build(const std::atomic<bool>* inCancel)
+{
+	size_t num_optical_depths = 1;
+	for (const Axis& axis : mDesc.mAxes)
+		if (detail::IsScaleHeight(axis.mParameter))
+			num_optical_depths *= axis.mNumPoints;
+
+	mIsBuilt = false;
+	mPoints.clear();
+	mOpticalDepths.clear();
+	mOpticalDepths.resize(num_optical_depths);
+
+	for (size_t point = 0, num_points = GetNumPoints(); point < num_points; ++point)
+	{
+		mEngine->GetParam() = GetPointParams(point);
+		if (!mEngine->GeneratePrecomputedTexture(inCancel))
+			return false;
+
+		std::unique_ptr<Point> tables = std::make_unique<Point>(mDesc.mEngineDesc);
+		for (auto i : { Engine::RAYLEIGH, Engine::MIE })
+			tables->mTotalInscatter[i] = Engine::Table3D(mEngine->GetTotalInscatterTexture(i));
+		tables->mPackInscatter = Engine::Table3D(mEngine->GetPackedTotalInscatterTexture());
+		mPoints.push_back(std::move(tables));
+
+		std::unique_ptr<Engine::Table2D>& optical_depth = mOpticalDepths[GetOpticalDepthIndex(point)];
+		if (!optical_depth)
+			optical_depth = std::make_unique<Engine::Table2D>(mEngine->GetOpticalDepthTexture());
+	}
+	mIsBuilt = true;
+	return true;
+}
+
+bool LookUpTableAtlas::Contains(const PrecomputedSctrParams& inParams) const
+{
+	const PrecomputedSctrParams& base = mDesc.mBaseParams;
+	PrecomputedSctrParams reconstructed = base;
+	for (const Axis& axis : mDesc.mAxes)
+	{
+		const float value = GetParameter(inParams, base, axis.mParameter);
+		const float margin = 1e-4f * std::abs(axis.mMax - axis.mMin);
+		if (value < std::min(axis.mMin, axis.mMax) - margin || value > std::max(axis.mMin, axis.mMax) + margin)
+			return false;
+		reconstructed = SetParameter(reconstructed, base, axis.mParameter, value);
+	}
+
+	for (int c = 0; c < 3; ++c)
+	{
+		if (!detail::NearlyEqualRelative(reconstructed.mRayleighSctrCoeff[c], inParams.mRayleighSctrCoeff[c])
+			|| !detail::NearlyEqualRelative(reconstructed.mMieSctrCoeff[c], inParams.mMieSctrCoeff[c]))
+			return false;
+	}
+	return detail::NearlyEqualRelative(reconstructed.mRayleighScaleHeight, inParams.mRayleighScaleHeight)
+		&& detail::NearlyEqualRelative(reconstructed.mMieScaleHeight, inParams.mMieScaleHeight)
+		&& detail::NearlyEqualRelative(reconstructed.mMieAbsorption, inParams.mMieAbsorption);
+}
+
+void LookUpTableAtlas::Blend(const PrecomputedSctrParams& inParams, Tables& outTables) const
+{
+	assert(mIsBuilt);
+	assert(outTables.mOpticalDepth.GetNumTexels() == mOpticalDepths.front()->GetNumTexels());
+
+	// Lower grid point and the weight of the upper one along every axis
+	const size_t num_axes = mDesc.mAxes.size();
+	std::vector<size_t> lower(num_axes);
+	std::vector<float> weight(num_axes);
+	std::vector<size_t> stride(num_axes);
+	size_t point_stride = 1;
+	for (size_t a = 0; a < num_axes; ++a)
+	{
+		const Axis& axis = mDesc.mAxes[a];
+		const float value = GetParameter(inParams, mDesc.mBaseParams, axis.mParameter);
+		const float last = float(axis.mNumPoints - 1);
+		const float coord = std::min(std::max((value - axis.mMin) / (axis.mMax - axis.mMin) * last, 0.0f), last);
+		lower[a] = std::min(size_t(coord), size_t(axis.mNumPoints - 2));
+		weight[a] = coord - float(lower[a]);
+		stride[a] = point_stride;
+		point_stride *= axis.mNumPoints;
+	}
+
+	std::fill(outTables.mOpticalDepth.GetData(), outTables.mOpticalDepth.GetData() + outTables.mOpticalDepth.GetNumTexels(), math::Float2(0.0f));
+	for (Engine::Table3D* table : { &outTables.mTotalInscatter[Engine::RAYLEIGH], &outTables.mTotalInscatter[Engine::MIE], &outTables.mPackInscatter })
+		std::fill(table->GetData(), table->GetData() + table->GetNumTexels(), math::Float4(0.0f));
+
+	// 2^axes corners, bit a of the corner = upper point along axis a
+	for (size_t corner = 0; corner < (size_t(1) << num_axes); ++corner)
+	{
+		float corner_weight = 1.0f;
+		size_t point = 0;
+		for (size_t a = 0; a < num_axes; ++a)
+		{
+			const bool upper = (corner >> a) & 1;
+			corner_weight *= upper ? weight[a] : 1.0f - weight[a];
+			point += (lower[a] + (upper ? 1 : 0)) * stride[a];
+		}
+		if (corner_weight <= 0.0f)
+			continue;
+
+		const Point& tables = *mPoints[point];
+		detail::AddWeighted(outTables.mOpticalDepth, *mOpticalDepths[GetOpticalDepthIndex(point)], corner_weight);
+		detail::AddWeightedLog(outTables.mTotalInscatter[Engine::RAYLEIGH], tables.mTotalInscatter[Engine::RAYLEIGH], corner_weight);
+		detail::AddWeightedLog(outTables.mTotalInscatter[Engine::MIE], tables.mTotalInscatter[Engine::MIE], corner_weight);
+		detail::AddWeightedLog(outTables.mPackInscatter, tables.mPackInscatter, corner_weight);
+	}
+	for (Engine::Table3D* table : { &outTables.mTotalInscatter[Engine::RAYLEIGH], &outTables.mTotalInscatter[Engine::MIE], &outTables.mPackInscatter })
+		detail::Exp(*table);
+	outTables.mParams = inParams;
+}
+
+std::unique_ptr<LookUpTableAtlas::Tables> LookUpTableAtlas::Blend(const PrecomputedSctrParams& inParams) const
+{
+	std::unique_ptr<Tables> tables = std::make_unique<Tables>(mDesc.mEngineDesc);
+	Blend(inParams, *tables);
+	return tables;
+}
+
+} // namespace atmosphere
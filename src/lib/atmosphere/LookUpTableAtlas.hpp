@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "AtmosphereExport.hpp"
+#include "CpuPrecomputedAtmosphericScattering.hpp"
+
+namespace atmosphere {
+
+// Dimensions of PrecomputedSctrParams an atlas can span. *Scale multiplies the RGB coefficients of the base parameters.
+enum class AtlasParameter {
+	RayleighSctrScale = 0,
+	RayleighScaleHeight,
+	MieSctrScale,
+	MieScaleHeight,
+	MieAbsorption,
+};
+
+//--------------------------------------------------------------------------------------------
+// Look-up table atlas over the scattering parameters
+//		- Bakes the tables at the points of a coarse grid over a few dimensions of PrecomputedSctrParams
+//		- Blend() interpolates the surrounding grid points, an immediate approximation while an exact bake runs.
+//		  The inscatter is interpolated geometrically (linearly in log space), the optical depth linearly.
+//		- The optical depth only depends on the scale heights, it is stored once per scale height point
+//--------------------------------------------------------------------------------------------
+struct ATMOSPHERE_EXPORT LookUpTableAtlas
+{
+	using Engine = CpuPrecomputedAtmosphericScattering;
+
+	struct Axis
+	{
+		AtlasParameter	mParameter = AtlasParameter::MieSctrScale;
+		float			mMin = 0.5f;
+		float			mMax = 2.0f;
+		std::uint32_t	mNumPoints = 3;	// >= 2, evenly spaced
+	};
+
+	struct Desc
+	{
+		Engine::Desc			mEngineDesc;
+		PrecomputedSctrParams	mBaseParams;	// value of the dimensions that are not an axis
+		std::uint32_t			mNumScattering = 6;
+		std::vector<Axis>		mAxes;
+	};
+
+	// The tables the renderer binds, and the parameters they stand for
+	struct Tables
+	{
+		// Dimensions of the tables of inDesc
+		explicit Tables(const Engine::Desc& inDesc);
+
+		Engine::Table2D			mOpticalDepth;
+		Engine::Table3D			mTotalInscatter[2];
+		Engine::Table3D			mPackInscatter;
+		PrecomputedSctrParams	mParams;
+	};
+
+	explicit LookUpTableAtlas(const Desc& inDesc);
+	~LookUpTableAtlas();
+
+	// Bakes every grid point, returns false when *inCancel was set
+	bool Build(const std::atomic<bool>* inCancel = nullptr);
+	bool IsBuilt() const { return mIsBuilt; }
+
+	const Desc& GetDesc() const { return mDesc; }
+	size_t GetNumPoints() const;
+	// Bytes of the baked tables
+	size_t GetMemorySize() const;
+
+	// inParams can be blended : the dimensions that are not an axis equal the base, the axes are in range
+	bool Contains(const PrecomputedSctrParams& inParams) const;
+
+	// Blend of the 2^axes grid points around inParams with multilinear weights, coordinates outside an axis are clamped.
+	// outTables.mParams = inParams.
+	void Blend(const PrecomputedSctrParams& inParams, Tables& outTables) const;
+	std::unique_ptr<Tables> Blend(const PrecomputedSctrParams& inParams) const;
+
+	static PrecomputedSctrParams SetParameter(const PrecomputedSctrParams& inParams, const PrecomputedSctrParams& inBase, AtlasParameter inParameter, float inValue);
+	static float GetParameter(const PrecomputedSctrParams& inParams, const PrecomputedSctrParams& inBase, AtlasParameter inParameter);
+
+protected:
+	struct Point
+	{
+		explicit Point(const Engine::Desc& inDesc);
+
+		Engine::Table3D	mTotalInscatter[2];
+		Engine::Table3D	mPackInscatter;
+	};
+
+	// Value of every axis at a grid point
+	PrecomputedSctrParams GetPointParams(size_t inPoint) const;
+	size_t GetOpticalDepthIndex(size_t inPoint) const;
+
+	Desc						mDesc;
+	std::unique_ptr<Engine>		mEngine = nullptr;
+	std::vector<std::unique_ptr<Engine::Table2D>>	mOpticalDepths;		// per point of the scale height axes
+	std::vector<std::unique_ptr<Point>>				mPoints;			// the first axis varies fastest
+	bool						mIsBuilt = false;
+};
+
+} // namespace atmosphere
@@ -0,0 +1,160 @@
+#include "LookUpTableCache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <src/lib/etc/Hash.hpp>
+
+namespace atmosphere {
+
+namespace detail {
+
+// Bump when the kernels change so that stale tables are not reused
+static const std::uint32_t sCacheRevision = 4;
+
+// Suffix of the temporary file of one Store() : the writers of one key, in this process or in others sharing the
+// directory, never write into the same file
+static std::string MakeTemporarySuffix()
+{
+	static std::atomic<std::uint64_t> sNumStores{ 0 };
+	std::random_device device;
+	etc::Hash64 hash;
+	hash.Add(device()).Add(device());
+	hash.Add(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	hash.Add(sNumStores.fetch_add(1));
+	hash.Add(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), ".%016llx.tmp", static_cast<unsigned long long>(hash.GetValue()));
+	return suffix;
+}
+
+} // namespace detail
+
+std::uint64_t ComputeLookUpTableCacheKey(const PrecomputedSctrParams& inParams, const LookUpTableCacheKeyDesc& inDesc)
+{
+	// Field by field, the padding of PrecomputedSctrParams is not initialized
+	etc::Hash64 hash;
+	hash.Add(detail::sCacheRevision);
+	hash.Add(inParams.mRayleighSctrCoeff.x).Add(inParams.mRayleighSctrCoeff.y).Add(inParams.mRayleighSctrCoeff.z);
+	hash.Add(inParams.mRayleighScaleHeight);
+	hash.Add(inParams.mMieSctrCoeff.x).Add(inParams.mMieSctrCoeff.y).Add(inParams.mMieSctrCoeff.z);
+	hash.Add(inParams.mMieScaleHeight);
+	hash.Add(inParams.mMieAbsorption);
+	hash.Add(inDesc.mNumScattering);
+	hash.Add(std::uint64_t(inDesc.mOpticalDepthWidth)).Add(std::uint64_t(inDesc.mOpticalDepthHeight));
+	hash.Add(std::uint32_t(inDesc.mOpticalDepthMode));
+	hash.Add(std::uint32_t(inDesc.mInscatterWidth)).Add(std::uint32_t(inDesc.mInscatterHeight)).Add(std::uint32_t(inDesc.mInscatterDepth));
+	hash.Add(std::uint32_t(inDesc.mIrradianceWidth)).Add(std::uint32_t(inDesc.mIrradianceHeight));
+	hash.Add(std::uint32_t(INSCATTER_INTEGRAL_STEPS));
+	hash.Add(inDesc.mIntegrationTolerance);
+	hash.Add(inDesc.mGatherQuadrature).Add(inDesc.mNumGatherSamples);
+	hash.Add(inDesc.mConvergenceThreshold).Add(inDesc.mConvergenceMetric);
+	if (inDesc.mInscatter4dSlices > 0) // The keys of the caches without a 4d table do not change
+	{
+		hash.Add(std::uint32_t(inDesc.mInscatter4dWidth)).Add(std::uint32_t(inDesc.mInscatter4dHeight)).Add(std::uint32_t(inDesc.mInscatter4dDepth));
+		hash.Add(std::uint32_t(inDesc.mInscatter4dSlices));
+	}
+	return hash.GetValue();
+}
+
+LookUpTableStageFingerprints ComputeLookUpTableStageFingerprints(const PrecomputedSctrParams& inParams, const LookUpTableCacheKeyDesc& inDesc)
+{
+	enum : size_t { OPTICAL_DEPTH = 0, SINGLE_SCATTERING, MULTIPLE_SCATTERING, GATHER_INSCATTER, ACCUMULATE_INSCATTER, TOTAL_INSCATTER, PACK_INSCATTER, IRRADIANCE, INSCATTER_4D };
+	auto finish = [](const etc::Hash64& inHash) { return std::max<std::uint64_t>(inHash.GetValue(), 1); };
+	LookUpTableStageFingerprints fingerprints;
+
+	// The table is the optical depth of the unit density profiles, the coefficients apply when it is read
+	etc::Hash64 optical_depth;
+	optical_depth.Add(detail::sCacheRevision).Add(std::uint32_t(OPTICAL_DEPTH));
+	optical_depth.Add(inParams.mRayleighScaleHeight).Add(inParams.mMieScaleHeight);
+	optical_depth.Add(std::uint64_t(inDesc.mOpticalDepthWidth)).Add(std::uint64_t(inDesc.mOpticalDepthHeight));
+	optical_depth.Add(std::uint32_t(inDesc.mOpticalDepthMode));
+	fingerprints.mStages[OPTICAL_DEPTH] = finish(optical_depth);
+
+	etc::Hash64 single_scattering;
+	single_scattering.Add(std::uint32_t(SINGLE_SCATTERING)).Add(fingerprints.mStages[OPTICAL_DEPTH]);
+	single_scattering.Add(inParams.mRayleighSctrCoeff.x).Add(inParams.mRayleighSctrCoeff.y).Add(inParams.mRayleighSctrCoeff.z);
+	single_scattering.Add(inParams.mMieSctrCoeff.x).Add(inParams.mMieSctrCoeff.y).Add(inParams.mMieSctrCoeff.z);
+	single_scattering.Add(inParams.mMieAbsorption);
+	single_scattering.Add(std::uint32_t(inDesc.mInscatterWidth)).Add(std::uint32_t(inDesc.mInscatterHeight)).Add(std::uint32_t(inDesc.mInscatterDepth));
+	single_scattering.Add(std::uint32_t(INSCATTER_INTEGRAL_STEPS)).Add(inDesc.mIntegrationTolerance);
+	fingerprints.mStages[SINGLE_SCATTERING] = finish(single_scattering);
+
+	// The loop reads the coefficients and the tolerance again, they are in the single scattering fingerprint already
+	etc::Hash64 gather;
+	gather.Add(std::uint32_t(GATHER_INSCATTER)).Add(fingerprints.mStages[SINGLE_SCATTERING]);
+	gather.Add(inDesc.mGatherQuadrature).Add(inDesc.mNumGatherSamples);
+	fingerprints.mStages[GATHER_INSCATTER] = finish(gather);
+
+	etc::Hash64 multiple_scattering;
+	multiple_scattering.Add(std::uint32_t(MULTIPLE_SCATTERING)).Add(fingerprints.mStages[GATHER_INSCATTER]);
+	fingerprints.mStages[MULTIPLE_SCATTERING] = finish(multiple_scattering);
+
+	etc::Hash64 accumulate;
+	accumulate.Add(std::uint32_t(ACCUMULATE_INSCATTER)).Add(fingerprints.mStages[MULTIPLE_SCATTERING]);
+	accumulate.Add(inDesc.mConvergenceThreshold).Add(inDesc.mConvergenceMetric);
+	fingerprints.mStages[ACCUMULATE_INSCATTER] = finish(accumulate);
+
+	for (size_t stage : { TOTAL_INSCATTER, PACK_INSCATTER })
+	{
+		etc::Hash64 result;
+		result.Add(std::uint32_t(stage)).Add(fingerprints.mStages[ACCUMULATE_INSCATTER]).Add(inDesc.mNumScattering);
+		fingerprints.mStages[stage] = finish(result);
+	}
+
+	etc::Hash64 irradiance;
+	irradiance.Add(std::uint32_t(IRRADIANCE)).Add(fingerprints.mStages[ACCUMULATE_INSCATTER]).Add(inDesc.mNumScattering);
+	irradiance.Add(std::uint32_t(inDesc.mIrradianceWidth)).Add(std::uint32_t(inDesc.mIrradianceHeight)).Add(std::uint32_t(NUM_IRRADIANCE_SAMPLES));
+	fingerprints.mStages[IRRADIANCE] = finish(irradiance);
+
+	etc::Hash64 inscatter_4d;
+	inscatter_4d.Add(std::uint32_t(INSCATTER_4D)).Add(fingerprints.mStages[SINGLE_SCATTERING]).Add(fingerprints.mStages[TOTAL_INSCATTER]);
+	inscatter_4d.Add(std::uint32_t(inDesc.mInscatter4dWidth)).Add(std::uint32_t(inDesc.mInscatter4dHeight)).Add(std::uint32_t(inDesc.mInscatter4dDepth));
+	inscatter_4d.Add(std::uint32_t(inDesc.mInscatter4dSlices));
+	fingerprints.mStages[INSCATTER_4D] = finish(inscatter_4d);
+	return fingerprints;
+}
+
+LookUpTableCache::LookUpTableCache(const std::string& inDirectory)
+	: mDirectory(inDirectory)
+{
+}
+
+std::string LookUpTableCache::GetPath(std::uint64_t inKey) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.lut", static_cast<unsigned long long>(inKey));
+	return (std::filesystem::path(mDirectory) / name).string();
+}
+
+std::unique_ptr<LookUpTableFile> LookUpTableCache::Load(std::uint64_t inKey) const
+{
+	std::unique_ptr<LookUpTableFile> file = LookUpTableFile::Open(GetPath(inKey));
+	if (!file || file->GetParameterHash() != inKey)
+		return nullptr;
+	return file;
+}
+
+bool LookUpTableCache::Store(std::uint64_t inKey, std::uint32_t inNumScattering, const std::vector<LookUpTableFile::Table>& inTables) const
+{
+	std::error_code error;
+	std::filesystem::create_directories(mDirectory, error);
+
+	const std::string path = GetPath(inKey);
+	const std::string temporary_path = path + detail::MakeTemporarySuffix();
+	const bool succeeded = LookUpTableFile::Write(temporary_path, inKey, inNumScattering, inTables);
+
+	if (succeeded)
+		std::filesystem::rename(temporary_path, path, error);
+	if (!succeeded || error)
+	{
+		std::filesystem::remove(temporary_path, error);
+		return false;
+	}
+	return true;
+}
+
+} // namespace atmosphere
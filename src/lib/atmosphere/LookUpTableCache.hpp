@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <shader/atmosphere/AtmosphereConstants.h>
+#include "AtmosphereExport.hpp"
+#include "AtmosphericScattering.hpp"
+#include "LookUpTableFile.hpp"
+
+namespace atmosphere {
+
+//------------------------------------------------------
+//	Persistent on-disk cache of the precomputed look-up tables
+//		- Content addressed: the file name is the hash of everything the tables depend on
+//		- Entries are LookUpTableFile containers, a hit is sampled straight from the mapping
+//------------------------------------------------------
+
+// Everything the tables depend on besides the scattering parameters
+struct LookUpTableCacheKeyDesc
+{
+	std::uint32_t		mNumScattering			= 0;
+	size_t				mOpticalDepthWidth		= 0;
+	size_t				mOpticalDepthHeight		= 0;
+	OpticalDepthMode	mOpticalDepthMode		= OpticalDepthMode::Table;
+	size_t				mInscatterWidth			= TEX4D_U;
+	size_t				mInscatterHeight		= TEX4D_V;
+	size_t				mInscatterDepth			= TEX4D_W;
+	size_t				mIrradianceWidth		= IRRADIANCE_U;
+	size_t				mIrradianceHeight		= IRRADIANCE_V;
+	size_t				mInscatter4dWidth		= 0;
+	size_t				mInscatter4dHeight		= 0;
+	size_t				mInscatter4dDepth		= 0;
+	size_t				mInscatter4dSlices		= 0;	// 0 = no 4d table
+	float				mIntegrationTolerance	= 0.0f;	// 0 = INSCATTER_INTEGRAL_STEPS uniform steps
+	std::uint32_t		mGatherQuadrature		= 0;	// GatherQuadrature
+	std::uint32_t		mNumGatherSamples		= NUM_RANDOMDIR_SAMPLES;
+	float				mConvergenceThreshold	= 0.0f;	// 0 = every scattering order is computed
+	std::uint32_t		mConvergenceMetric		= 0;
+};
+
+// Hash of the inputs of the precomputation
+ATMOSPHERE_EXPORT std::uint64_t ComputeLookUpTableCacheKey(const PrecomputedSctrParams& inParams, const LookUpTableCacheKeyDesc& inDesc);
+
+// Hash of the inputs of every stage of the precomputation, indexed by BufferType (optical depth, single scattering, ..., pack, irradiance, 4d inscatter)
+//	- A stage hashes the fingerprints of the stages it reads, a change only makes the stages downstream stale
+//	- The multiple scattering loop (gather, multiple scattering, accumulation) leaves out mNumScattering, more orders resume the loop.
+//	  Total inscatter, pack inscatter and irradiance hash it.
+//	- 0 is never a fingerprint, it marks a stage whose table is stale
+struct LookUpTableStageFingerprints
+{
+	static constexpr size_t sNumStages = 9;
+	std::uint64_t	mStages[sNumStages] = {};
+};
+ATMOSPHERE_EXPORT LookUpTableStageFingerprints ComputeLookUpTableStageFingerprints(const PrecomputedSctrParams& inParams, const LookUpTableCacheKeyDesc& inDesc);
+
+struct ATMOSPHERE_EXPORT LookUpTableCache
+{
+	// LookUpTableFile::Table::mId of the cached tables
+	enum TableId : std::uint32_t {
+		OPTICAL_DEPTH = 0,			// R32G32
+		TOTAL_INSCATTER_RAYLEIGH,	// R32G32B32A32
+		TOTAL_INSCATTER_MIE,		// R32G32B32A32
+		PACK_INSCATTER,				// R32G32B32A32
+		IRRADIANCE,					// R32G32B32A32, 2d
+		PACK_INSCATTER_4D,			// R32G32B32A32, the azimuth slices in the depth. Only with a 4d table.
+		NUM_TABLES,
+	};
+
+	explicit LookUpTableCache(const std::string& inDirectory);
+
+	std::string GetPath(std::uint64_t inKey) const;
+
+	// nullptr on a miss, or when the file is broken, was written by another version or for another key
+	std::unique_ptr<LookUpTableFile> Load(std::uint64_t inKey) const;
+
+	// Writes to a temporary file of its own first, so that a concurrent Load() never sees a partial file
+	// and concurrent Store() of the same key never write into the same file
+	bool Store(std::uint64_t inKey, std::uint32_t inNumScattering, const std::vector<LookUpTableFile::Table>& inTables) const;
+
+protected:
+	std::string	mDirectory;
+};
+
+} // namespace atmosphere
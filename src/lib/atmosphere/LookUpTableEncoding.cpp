@@ -0,0 +1,343 @@
+#include "LookUpTableEncoding.hpp"
+#include "LookUpTableEncodingKernel.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace atmosphere {
+
+namespace detail {
+
+static bool UseF16C(SimdInstructionSet inInstructionSet)
+{
+	const SimdInstructionSet instruction_set = ResolveSimdInstructionSet(inInstructionSet);
+	return IsLookUpTableEncodingAVX2CompiledIn()
+		&& (instruction_set == SimdInstructionSet::AVX2 || instruction_set == SimdInstructionSet::AVX512);
+}
+
+static size_t GetNumChannels(TextureFormat inFormat)
+{
+	switch (inFormat)
+	{
+	case TextureFormat::R32G32:
+	case TextureFormat::R16G16_FLOAT:		return 2;
+	case TextureFormat::R9G9B9E5:			return 3;
+	default:								return 4;
+	}
+}
+
+// Largest finite value of a format
+static float GetMaxValue(TextureFormat inFormat)
+{
+	switch (inFormat)
+	{
+	case TextureFormat::R16G16_FLOAT:
+	case TextureFormat::R16G16B16A16_FLOAT:	return 65504.0f;
+	case TextureFormat::R9G9B9E5:			return 65408.0f;
+	default:								return std::numeric_limits<float>::max();
+	}
+}
+
+static EncodedLookUpTable EncodeTexels(const float* inTexels, size_t inNumChannels, size_t inWidth, size_t inHeight, size_t inDepth, TextureFormat inFormat, SimdInstructionSet inInstructionSet)
+{
+	EncodedLookUpTable table;
+	table.mFormat = inFormat;
+	table.mWidth = inWidth;
+	table.mHeight = inHeight;
+	table.mDepth = inDepth;
+	const size_t num_texels = table.GetNumTexels();
+	table.mTexels.resize(num_texels * GetTexelSize(inFormat));
+
+	switch (inFormat)
+	{
+	case TextureFormat::R32G32:
+	case TextureFormat::R32G32B32A32:
+		std::memcpy(table.mTexels.data(), inTexels, table.mTexels.size());
+		break;
+	case TextureFormat::R16G16_FLOAT:
+	case TextureFormat::R16G16B16A16_FLOAT:
+		FloatToHalf(inInstructionSet, inTexels, reinterpret_cast<std::uint16_t*>(table.mTexels.data()), num_texels * inNumChannels);
+		break;
+	case TextureFormat::R9G9B9E5:
+	{
+		std::uint32_t* texels = reinterpret_cast<std::uint32_t*>(table.mTexels.data());
+		for (size_t i = 0; i < num_texels; ++i)
+		{
+			const float* texel = inTexels + i * inNumChannels;
+			texels[i] = FloatToRGB9E5(math::Float3(texel[0], texel[1], texel[2]));
+		}
+		break;
+	}
+	default:
+		assert(false);
+	}
+	return table;
+}
+
+static void DecodeTexels(const EncodedLookUpTable& inTable, float* outTexels, size_t inNumChannels, SimdInstructionSet inInstructionSet)
+{
+	const size_t num_texels = inTable.GetNumTexels();
+	switch (inTable.mFormat)
+	{
+	case TextureFormat::R32G32:
+	case TextureFormat::R32G32B32A32:
+		std::memcpy(outTexels, inTable.GetData(), inTable.GetMemorySize());
+		break;
+	case TextureFormat::R16G16_FLOAT:
+	case TextureFormat::R16G16B16A16_FLOAT:
+		HalfToFloat(inInstructionSet, static_cast<const std::uint16_t*>(inTable.GetData()), outTexels, num_texels * inNumChannels);
+		break;
+	case TextureFormat::R9G9B9E5:
+	{
+		const std::uint32_t* texels = static_cast<const std::uint32_t*>(inTable.GetData());
+		for (size_t i = 0; i < num_texels; ++i)
+		{
+			const math::Float3 rgb = RGB9E5ToFloat(texels[i]);
+			float* texel = outTexels + i * inNumChannels;
+			texel[0] = rgb.x;
+			texel[1] = rgb.y;
+			texel[2] = rgb.z;
+			texel[3] = 0.0f;
+		}
+		break;
+	}
+	default:
+		assert(false);
+	}
+}
+
+static LookUpTableEncodingError MeasureError(const float* inReference, const float* inDecoded, size_t inNumChannels, size_t inNumComparedChannels,
+	size_t inWidth, size_t inHeight, size_t inDepth, TextureFormat inFormat, float inRelativeFloor)
+{
+	const size_t num_texels = inWidth * inHeight * inDepth;
+	const float range = GetMaxValue(inFormat);
+	float max_value = 0.0f;
+	for (size_t i = 0; i < num_texels; ++i)
+		for (size_t c = 0; c < inNumComparedChannels; ++c)
+			if (std::abs(inReference[i * inNumChannels + c]) <= range)
+				max_value = std::max(max_value, std::abs(inReference[i * inNumChannels + c]));
+	const float floor = inRelativeFloor * max_value;
+
+	LookUpTableEncodingError error;
+	double sum = 0.0;
+	for (size_t i = 0; i < num_texels; ++i)
+	{
+		for (size_t c = 0; c < inNumComparedChannels; ++c)
+		{
+			const double reference = inReference[i * inNumChannels + c];
+			if (std::abs(reference) > range)
+			{
+				++error.mNumOverflows;
+				continue;
+			}
+			const double difference = std::abs(double(inDecoded[i * inNumChannels + c]) - reference);
+			error.mMaxAbsoluteError = std::max(error.mMaxAbsoluteError, difference);
+			if (std::abs(reference) < floor || reference == 0.0)
+				continue;
+			const double relative = difference / std::abs(reference);
+			sum += relative;
+			++error.mNumChannels;
+			if (relative > error.mMaxRelativeError)
+			{
+				error.mMaxRelativeError = relative;
+				error.mMaxRelativeErrorTexel[0] = i % inWidth;
+				error.mMaxRelativeErrorTexel[1] = (i / inWidth) % inHeight;
+				error.mMaxRelativeErrorTexel[2] = i / (inWidth * inHeight);
+			}
+		}
+	}
+	error.mMeanRelativeError = error.mNumChannels > 0 ? sum / double(error.mNumChannels) : 0.0;
+	return error;
+}
+
+} // namespace detail
+
+//------------------------------------------------------
+//	Half
+//------------------------------------------------------
+std::uint16_t FloatToHalf(float inValue)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &inValue, sizeof(bits));
+	const std::uint16_t sign = std::uint16_t((bits >> 16) & 0x8000);
+	bits &= 0x7fffffff;
+
+	if (bits >= 0x7f800000) // inf, NaN (quiet)
+		return sign | 0x7c00 | (bits > 0x7f800000 ? 0x0200 : 0);
+	if (bits >= 0x477ff000) // >= 65520 rounds to inf
+		return sign | 0x7c00;
+	if (bits >= 0x38800000) // normal half, >= 2^-14
+	{
+		std::uint32_t rebiased = bits - ((127 - 15) << 23);
+		rebiased += 0x0fff + ((rebiased >> 13) & 1); // round to nearest even
+		return sign | std::uint16_t(rebiased >> 13);
+	}
+	if (bits < 0x33000000) // <= half of the smallest subnormal
+		return sign;
+
+	// Subnormal half : mantissa * 2^-24
+	const std::uint32_t exponent = bits >> 23;
+	const std::uint32_t mantissa = (bits & 0x007fffff) | 0x00800000;
+	const std::uint32_t shift = 126 - exponent;
+	std::uint32_t half = mantissa >> shift;
+	const std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+	const std::uint32_t halfway = 1u << (shift - 1);
+	if (remainder > halfway || (remainder == halfway && (half & 1)))
+		++half;
+	return sign | std::uint16_t(half);
+}
+
+float HalfToFloat(std::uint16_t inValue)
+{
+	const std::uint32_t sign = std::uint32_t(inValue & 0x8000) << 16;
+	const std::uint32_t exponent = (inValue >> 10) & 0x1f;
+	const std::uint32_t mantissa = inValue & 0x03ff;
+
+	std::uint32_t bits;
+	if (exponent == 0)
+	{
+		const float value = float(mantissa) * 5.9604644775390625e-8f; // 2^-24
+		std::memcpy(&bits, &value, sizeof(bits));
+		bits |= sign;
+	}
+	else if (exponent == 31)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void FloatToHalf(SimdInstructionSet inInstructionSet, const float* inValues, std::uint16_t* outValues, size_t inCount)
+{
+	if (detail::UseF16C(inInstructionSet))
+	{
+		detail::FloatToHalfAVX2(inValues, outValues, inCount);
+		return;
+	}
+	for (size_t i = 0; i < inCount; ++i)
+		outValues[i] = FloatToHalf(inValues[i]);
+}
+
+void HalfToFloat(SimdInstructionSet inInstructionSet, const std::uint16_t* inValues, float* outValues, size_t inCount)
+{
+	if (detail::UseF16C(inInstructionSet))
+	{
+		detail::HalfToFloatAVX2(inValues, outValues, inCount);
+		return;
+	}
+	for (size_t i = 0; i < inCount; ++i)
+		outValues[i] = HalfToFloat(inValues[i]);
+}
+
+//------------------------------------------------------
+//	RGB9E5, the conversion of the D3D11 functional specification
+//------------------------------------------------------
+std::uint32_t FloatToRGB9E5(const math::Float3& inValue)
+{
+	constexpr int MANTISSA_BITS = 9;
+	constexpr int EXPONENT_BIAS = 15;
+	constexpr int MAX_EXPONENT = 31;
+	constexpr float MAX_VALUE = float((1 << MANTISSA_BITS) - 1) / float(1 << MANTISSA_BITS) * float(1 << (MAX_EXPONENT - EXPONENT_BIAS));
+
+	// !(x > 0) also catches NaN
+	auto clamp = [=](float x) { return !(x > 0.0f) ? 0.0f : std::min(x, MAX_VALUE); };
+	const float r = clamp(inValue.x);
+	const float g = clamp(inValue.y);
+	const float b = clamp(inValue.z);
+	const float max_channel = std::max(r, std::max(g, b));
+	if (max_channel == 0.0f)
+		return 0;
+
+	int exponent;
+	std::frexp(max_channel, &exponent); // max_channel = [0.5, 1) * 2^exponent, floor(log2(max_channel)) = exponent - 1
+	int shared_exponent = std::max(-EXPONENT_BIAS - 1, exponent - 1) + 1 + EXPONENT_BIAS;
+	if (std::floor(max_channel / std::ldexp(1.0f, shared_exponent - EXPONENT_BIAS - MANTISSA_BITS) + 0.5f) == float(1 << MANTISSA_BITS))
+		++shared_exponent;
+
+	const float scale = std::ldexp(1.0f, EXPONENT_BIAS + MANTISSA_BITS - shared_exponent);
+	const std::uint32_t rm = std::uint32_t(std::floor(r * scale + 0.5f));
+	const std::uint32_t gm = std::uint32_t(std::floor(g * scale + 0.5f));
+	const std::uint32_t bm = std::uint32_t(std::floor(b * scale + 0.5f));
+	return rm | (gm << 9) | (bm << 18) | (std::uint32_t(shared_exponent) << 27);
+}
+
+math::Float3 RGB9E5ToFloat(std::uint32_t inValue)
+{
+	const float scale = std::ldexp(1.0f, int(inValue >> 27) - 15 - 9);
+	return math::Float3(
+		float(inValue & 0x1ff) * scale,
+		float((inValue >> 9) & 0x1ff) * scale,
+		float((inValue >> 18) & 0x1ff) * scale);
+}
+
+//------------------------------------------------------
+//	Tables
+//------------------------------------------------------
+static_assert(sizeof(math::Float2) == 2 * sizeof(float), "math::Float2 is not 2 packed floats");
+static_assert(sizeof(math::Float4) == 4 * sizeof(float), "math::Float4 is not 4 packed floats");
+
+bool IsEncodingSupported2D(TextureFormat inFormat)
+{
+	return inFormat == TextureFormat::R32G32 || inFormat == TextureFormat::R16G16_FLOAT;
+}
+
+bool IsEncodingSupported3D(TextureFormat inFormat)
+{
+	return inFormat == TextureFormat::R32G32B32A32 || inFormat == TextureFormat::R16G16B16A16_FLOAT || inFormat == TextureFormat::R9G9B9E5;
+}
+
+EncodedLookUpTable EncodeLookUpTable(const LookUpTableView2D<math::Float2>& inTable, TextureFormat inFormat, SimdInstructionSet inInstructionSet)
+{
+	assert(IsEncodingSupported2D(inFormat));
+	return detail::EncodeTexels(reinterpret_cast<const float*>(inTable.GetData()), 2, inTable.GetWidth(), inTable.GetHeight(), 1, inFormat, inInstructionSet);
+}
+
+EncodedLookUpTable EncodeLookUpTable(const LookUpTableView3D<math::Float4>& inTable, TextureFormat inFormat, SimdInstructionSet inInstructionSet)
+{
+	assert(IsEncodingSupported3D(inFormat));
+	return detail::EncodeTexels(reinterpret_cast<const float*>(inTable.GetData()), 4, inTable.GetWidth(), inTable.GetHeight(), inTable.GetDepth(), inFormat, inInstructionSet);
+}
+
+void DecodeLookUpTable(const EncodedLookUpTable& inTable, LookUpTable2D<math::Float2>& outTable, SimdInstructionSet inInstructionSet)
+{
+	assert(IsEncodingSupported2D(inTable.mFormat) && inTable.mDepth == 1);
+	if (outTable.GetWidth() != inTable.mWidth || outTable.GetHeight() != inTable.mHeight)
+		outTable = LookUpTable2D<math::Float2>(inTable.mWidth, inTable.mHeight);
+	detail::DecodeTexels(inTable, reinterpret_cast<float*>(outTable.GetData()), 2, inInstructionSet);
+}
+
+void DecodeLookUpTable(const EncodedLookUpTable& inTable, LookUpTable3D<math::Float4>& outTable, SimdInstructionSet inInstructionSet)
+{
+	assert(IsEncodingSupported3D(inTable.mFormat));
+	if (outTable.GetWidth() != inTable.mWidth || outTable.GetHeight() != inTable.mHeight || outTable.GetDepth() != inTable.mDepth)
+		outTable = LookUpTable3D<math::Float4>(inTable.mWidth, inTable.mHeight, inTable.mDepth);
+	detail::DecodeTexels(inTable, reinterpret_cast<float*>(outTable.GetData()), 4, inInstructionSet);
+}
+
+LookUpTableEncodingError MeasureEncodingError(const LookUpTableView2D<math::Float2>& inReference, const EncodedLookUpTable& inTable, float inRelativeFloor)
+{
+	assert(inReference.GetWidth() == inTable.mWidth && inReference.GetHeight() == inTable.mHeight);
+	LookUpTable2D<math::Float2> decoded(inTable.mWidth, inTable.mHeight);
+	DecodeLookUpTable(inTable, decoded);
+	return detail::MeasureError(reinterpret_cast<const float*>(inReference.GetData()), reinterpret_cast<const float*>(decoded.GetData()),
+		2, 2, inTable.mWidth, inTable.mHeight, 1, inTable.mFormat, inRelativeFloor);
+}
+
+LookUpTableEncodingError MeasureEncodingError(const LookUpTableView3D<math::Float4>& inReference, const EncodedLookUpTable& inTable, float inRelativeFloor)
+{
+	assert(inReference.GetWidth() == inTable.mWidth && inReference.GetHeight() == inTable.mHeight && inReference.GetDepth() == inTable.mDepth);
+	LookUpTable3D<math::Float4> decoded(inTable.mWidth, inTable.mHeight, inTable.mDepth);
+	DecodeLookUpTable(inTable, decoded);
+	return detail::MeasureError(reinterpret_cast<const float*>(inReference.GetData()), reinterpret_cast<const float*>(decoded.GetData()),
+		4, detail::GetNumChannels(inTable.mFormat), inTable.mWidth, inTable.mHeight, inTable.mDepth, inTable.mFormat, inRelativeFloor);
+}
+
+} // namespace atmosphere
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <src/lib/math/Math.hpp>
+#include <src/lib/etc/TextureFormat.hpp>
+#include "AtmosphereExport.hpp"
+#include "LookUpTable.hpp"
+#include "SingleScatteringPacket.hpp"
+
+namespace atmosphere {
+
+using etc::TextureFormat;
+
+//------------------------------------------------------
+//	Compact storage formats of the finished look-up tables
+//		- R16G16_FLOAT / R16G16B16A16_FLOAT : IEEE half, round to nearest even. Half the memory of R32*.
+//		- R9G9B9E5 : shared exponent RGB of D3D11 (DXGI_FORMAT_R9G9B9E5_SHAREDEXP), alpha is dropped.
+//		  A quarter of R32G32B32A32, only for the total inscatter tables whose alpha is unused.
+//		- The bulk conversions use F16C when the instruction set resolves to AVX2 or AVX-512 (every AVX2 CPU has it),
+//		  the results are bit-identical to the scalar path
+//		- Half keeps ~3 significant digits down to 6.1e-5, smaller values lose precision (subnormals down to 6e-8).
+//		  RGB9E5 keeps 9 bits for the brightest channel, the dim channels of a texel get less.
+//------------------------------------------------------
+
+ATMOSPHERE_EXPORT std::uint16_t FloatToHalf(float inValue);
+ATMOSPHERE_EXPORT float HalfToFloat(std::uint16_t inValue);
+ATMOSPHERE_EXPORT void FloatToHalf(SimdInstructionSet inInstructionSet, const float* inValues, std::uint16_t* outValues, size_t inCount);
+ATMOSPHERE_EXPORT void HalfToFloat(SimdInstructionSet inInstructionSet, const std::uint16_t* inValues, float* outValues, size_t inCount);
+
+// Negative and NaN channels are stored as 0, channels above 65408 are clamped
+ATMOSPHERE_EXPORT std::uint32_t FloatToRGB9E5(const math::Float3& inValue);
+ATMOSPHERE_EXPORT math::Float3 RGB9E5ToFloat(std::uint32_t inValue);
+
+// Texels of a table in a storage format, laid out as the float table
+struct ATMOSPHERE_EXPORT EncodedLookUpTable
+{
+	TextureFormat	mFormat = TextureFormat::R16G16B16A16_FLOAT;
+	size_t			mWidth = 0;
+	size_t			mHeight = 0;
+	size_t			mDepth = 1;
+	std::vector<std::uint8_t>	mTexels;
+
+	const void* GetData() const { return mTexels.data(); }
+	size_t GetNumTexels() const { return mWidth * mHeight * mDepth; }
+	size_t GetMemorySize() const { return mTexels.size(); }
+};
+
+// R32G32 and R16G16_FLOAT
+ATMOSPHERE_EXPORT bool IsEncodingSupported2D(TextureFormat inFormat);
+// R32G32B32A32, R16G16B16A16_FLOAT and R9G9B9E5
+ATMOSPHERE_EXPORT bool IsEncodingSupported3D(TextureFormat inFormat);
+
+ATMOSPHERE_EXPORT EncodedLookUpTable EncodeLookUpTable(const LookUpTableView2D<math::Float2>& inTable, TextureFormat inFormat, SimdInstructionSet inInstructionSet = SimdInstructionSet::Auto);
+ATMOSPHERE_EXPORT EncodedLookUpTable EncodeLookUpTable(const LookUpTableView3D<math::Float4>& inTable, TextureFormat inFormat, SimdInstructionSet inInstructionSet = SimdInstructionSet::Auto);
+// outTable is resized to the encoded table. R9G9B9E5 decodes with alpha = 0.
+ATMOSPHERE_EXPORT void DecodeLookUpTable(const EncodedLookUpTable& inTable, LookUpTable2D<math::Float2>& outTable, SimdInstructionSet inInstructionSet = SimdInstructionSet::Auto);
+ATMOSPHERE_EXPORT void DecodeLookUpTable(const EncodedLookUpTable& inTable, LookUpTable3D<math::Float4>& outTable, SimdInstructionSet inInstructionSet = SimdInstructionSet::Auto);
+
+// Per-texel error of an encoded table against the float table it was encoded from
+//	- Relative errors are |decoded - reference| / |reference| per channel, over the channels >= inRelativeFloor * the largest
+//	  channel of the table, the tiny ones would only measure the underflow
+//	- Channels beyond the range of the format, e.g. the 1e20 optical depth of a ray hitting the ground, overflow to inf (half)
+//	  or are clamped (RGB9E5). They are counted apart and left out of the errors.
+//	- R9G9B9E5 compares RGB only
+struct LookUpTableEncodingError
+{
+	double	mMaxRelativeError = 0.0;
+	double	mMeanRelativeError = 0.0;
+	double	mMaxAbsoluteError = 0.0;
+	size_t	mNumChannels = 0;				// channels measured by the relative errors
+	size_t	mNumOverflows = 0;				// channels beyond the range of the format
+	size_t	mMaxRelativeErrorTexel[3] = {};	// (x, y, z) of mMaxRelativeError
+};
+
+ATMOSPHERE_EXPORT LookUpTableEncodingError MeasureEncodingError(const LookUpTableView2D<math::Float2>& inReference, const EncodedLookUpTable& inTable, float inRelativeFloor = 1e-3f);
+ATMOSPHERE_EXPORT LookUpTableEncodingError MeasureEncodingError(const LookUpTableView3D<math::Float4>& inReference, const EncodedLookUpTable& inTable, float inRelativeFloor = 1e-3f);
+
+} // namespace atmosphere
@@ -0,0 +1,86 @@
+//------------------------------------------------------
+//	F16C conversion of the half look-up tables (8 values per instruction)
+//		- Compiled with /arch:AVX2 (-mavx2 -mfma -mf16c), see CMakeLists.txt
+//		- The tail goes through a padded block of 8, so that no code is shared with the generic translation units
+//		  (see LookUpTableEncodingKernel.hpp)
+//------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include "LookUpTableEncodingKernel.hpp"
+
+#if defined(__AVX2__) && (defined(__F16C__) || defined(_MSC_VER))
+#include <immintrin.h>
+
+namespace atmosphere {
+namespace detail {
+
+bool IsLookUpTableEncodingAVX2CompiledIn()
+{
+	return true;
+}
+
+void FloatToHalfAVX2(const float* inValues, std::uint16_t* outValues, size_t inCount)
+{
+	size_t i = 0;
+	for (; i + 8 <= inCount; i += 8)
+	{
+		const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(inValues + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(outValues + i), half);
+	}
+	if (i < inCount)
+	{
+		float values[8] = {};
+		std::uint16_t halves[8];
+		for (size_t j = 0; i + j < inCount; ++j)
+			values[j] = inValues[i + j];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(halves), _mm256_cvtps_ph(_mm256_loadu_ps(values), _MM_FROUND_TO_NEAREST_INT));
+		for (size_t j = 0; i + j < inCount; ++j)
+			outValues[i + j] = halves[j];
+	}
+}
+
+void HalfToFloatAVX2(const std::uint16_t* inValues, float* outValues, size_t inCount)
+{
+	size_t i = 0;
+	for (; i + 8 <= inCount; i += 8)
+	{
+		const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inValues + i));
+		_mm256_storeu_ps(outValues + i, _mm256_cvtph_ps(half));
+	}
+	if (i < inCount)
+	{
+		std::uint16_t halves[8] = {};
+		float values[8];
+		for (size_t j = 0; i + j < inCount; ++j)
+			halves[j] = inValues[i + j];
+		_mm256_storeu_ps(values, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(halves))));
+		for (size_t j = 0; i + j < inCount; ++j)
+			outValues[i + j] = values[j];
+	}
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#else
+
+namespace atmosphere {
+namespace detail {
+
+bool IsLookUpTableEncodingAVX2CompiledIn()
+{
+	return false;
+}
+
+void FloatToHalfAVX2(const float*, std::uint16_t*, size_t)
+{
+}
+
+void HalfToFloatAVX2(const std::uint16_t*, float*, size_t)
+{
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#endif
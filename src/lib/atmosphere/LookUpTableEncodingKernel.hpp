@@ -0,0 +1,23 @@
+#pragma once
+//------------------------------------------------------
+//	F16C conversions of the half look-up tables, LookUpTableEncodingAVX2.cpp
+//		- Same restrictions as SingleScatteringPacketKernel.hpp, this header is included by the translation unit
+//		  compiled with /arch:AVX2 (-mavx2 -mfma -mf16c). Only plain types here.
+//------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+namespace atmosphere {
+
+namespace detail {
+
+// False when the compiler cannot target F16C, the conversions below are then empty
+bool IsLookUpTableEncodingAVX2CompiledIn();
+
+// Round to nearest even, as FloatToHalf(float)
+void FloatToHalfAVX2(const float* inValues, std::uint16_t* outValues, size_t inCount);
+void HalfToFloatAVX2(const std::uint16_t* inValues, float* outValues, size_t inCount);
+
+} // namespace detail
+
+} // namespace atmosphere
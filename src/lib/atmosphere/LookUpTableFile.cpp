@@ -0,0 +1,123 @@
+#include "LookUpTableFile.hpp"
+#include <cassert>
+#include <cstring>
+#include <fstream>
+
+namespace atmosphere {
+
+namespace detail {
+
+inline std::uint64_t AlignUp(std::uint64_t inValue, std::uint64_t inAlignment)
+{
+	return (inValue + inAlignment - 1) / inAlignment * inAlignment;
+}
+
+} // namespace detail
+
+constexpr char LookUpTableFileHeader::sMagic[8];
+
+std::unique_ptr<LookUpTableFile> LookUpTableFile::Open(const std::string& inPath)
+{
+	std::unique_ptr<etc::MappedFile> mapped_file = etc::MappedFile::Open(inPath);
+	if (!mapped_file || mapped_file->GetSize() < sizeof(LookUpTableFileHeader))
+		return nullptr;
+
+	const std::uint8_t* data = mapped_file->GetData();
+	const std::uint64_t size = mapped_file->GetSize();
+
+	std::unique_ptr<LookUpTableFile> file(new LookUpTableFile());
+	LookUpTableFileHeader& header = file->mHeader;
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.mMagic, LookUpTableFileHeader::sMagic, sizeof(header.mMagic)) != 0
+		|| header.mMajorVersion != LookUpTableFileHeader::sMajorVersion
+		|| header.mFileSize != size
+		|| (size - sizeof(header)) / sizeof(LookUpTableFileTableHeader) < header.mNumTables)
+		return nullptr;
+
+	file->mTables.resize(header.mNumTables);
+	for (std::uint32_t i = 0; i < header.mNumTables; ++i)
+	{
+		LookUpTableFileTableHeader table_header;
+		std::memcpy(&table_header, data + sizeof(header) + i * sizeof(table_header), sizeof(table_header));
+
+		Table& table = file->mTables[i];
+		table.mId = table_header.mId;
+		table.mFormat = static_cast<TextureFormat>(table_header.mFormat);
+		table.mWidth = table_header.mWidth;
+		table.mHeight = table_header.mHeight;
+		table.mDepth = table_header.mDepth;
+		if (GetTexelSize(table.mFormat) == 0
+			|| table_header.mOffset % sAlignment != 0
+			|| table_header.mSize != table.GetSize()
+			|| table_header.mOffset > size
+			|| table_header.mSize > size - table_header.mOffset)
+			return nullptr;
+		table.mTexels = data + table_header.mOffset;
+	}
+
+	file->mFile = std::move(mapped_file);
+	return file;
+}
+
+bool LookUpTableFile::Write(const std::string& inPath, std::uint64_t inParameterHash, std::uint32_t inNumScattering, const std::vector<Table>& inTables)
+{
+	std::vector<LookUpTableFileTableHeader> table_headers(inTables.size());
+	std::uint64_t offset = detail::AlignUp(sizeof(LookUpTableFileHeader) + inTables.size() * sizeof(LookUpTableFileTableHeader), sAlignment);
+	for (size_t i = 0; i < inTables.size(); ++i)
+	{
+		const Table& table = inTables[i];
+		assert(table.mTexels);
+		LookUpTableFileTableHeader& table_header = table_headers[i];
+		std::memset(&table_header, 0, sizeof(table_header));
+		table_header.mId = table.mId;
+		table_header.mFormat = static_cast<std::uint32_t>(table.mFormat);
+		table_header.mWidth = static_cast<std::uint32_t>(table.mWidth);
+		table_header.mHeight = static_cast<std::uint32_t>(table.mHeight);
+		table_header.mDepth = static_cast<std::uint32_t>(table.mDepth);
+		table_header.mOffset = offset;
+		table_header.mSize = table.GetSize();
+		offset = detail::AlignUp(offset + table_header.mSize, sAlignment);
+	}
+
+	LookUpTableFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.mMagic, LookUpTableFileHeader::sMagic, sizeof(header.mMagic));
+	header.mMajorVersion = LookUpTableFileHeader::sMajorVersion;
+	header.mMinorVersion = LookUpTableFileHeader::sMinorVersion;
+	header.mParameterHash = inParameterHash;
+	header.mFileSize = offset;
+	header.mNumScattering = inNumScattering;
+	header.mNumTables = static_cast<std::uint32_t>(inTables.size());
+
+	std::ofstream stream(inPath, std::ios::binary | std::ios::trunc);
+	if (!stream)
+		return false;
+
+	const char padding[sAlignment] = {};
+	auto pad_to = [&](std::uint64_t inOffset)
+	{
+		const std::uint64_t position = static_cast<std::uint64_t>(stream.tellp());
+		assert(position <= inOffset && inOffset - position < sAlignment);
+		stream.write(padding, static_cast<std::streamsize>(inOffset - position));
+	};
+
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(reinterpret_cast<const char*>(table_headers.data()), table_headers.size() * sizeof(LookUpTableFileTableHeader));
+	for (size_t i = 0; i < inTables.size(); ++i)
+	{
+		pad_to(table_headers[i].mOffset);
+		stream.write(static_cast<const char*>(inTables[i].mTexels), static_cast<std::streamsize>(table_headers[i].mSize));
+	}
+	pad_to(header.mFileSize);
+	return bool(stream);
+}
+
+const LookUpTableFile::Table* LookUpTableFile::FindTable(std::uint32_t inId) const
+{
+	for (const Table& table : mTables)
+		if (table.mId == inId)
+			return &table;
+	return nullptr;
+}
+
+} // namespace atmosphere
@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <src/lib/math/Math.hpp>
+#include <src/lib/etc/TextureFormat.hpp>
+#include <src/lib/etc/MappedFile.hpp>
+#include "AtmosphereExport.hpp"
+#include "LookUpTable.hpp"
+
+namespace atmosphere {
+
+using etc::TextureFormat;
+
+//------------------------------------------------------
+//	Binary container of look-up tables (*.lut)
+//		- Self-describing: dimensions, TextureFormat, parameter hash and scattering order are in the headers
+//		- Every payload starts at a 64 byte boundary, so a read-only mapping can be sampled in place
+//
+//	Layout (little endian, offsets from the beginning of the file)
+//		LookUpTableFileHeader				64 bytes
+//		LookUpTableFileTableHeader x N		64 bytes each
+//		payloads							64 byte aligned, texel (x, y, z) at x + width * (y + height * z)
+//------------------------------------------------------
+struct LookUpTableFileHeader
+{
+	static constexpr char			sMagic[8] = { 'A', 'T', 'M', 'O', 'L', 'U', 'T', '\0' };
+	static constexpr std::uint32_t	sMajorVersion = 1;	// Readers reject other major versions
+	static constexpr std::uint32_t	sMinorVersion = 0;	// Backward compatible additions
+
+	char			mMagic[8];
+	std::uint32_t	mMajorVersion;
+	std::uint32_t	mMinorVersion;
+	std::uint64_t	mParameterHash;		// see ComputeLookUpTableCacheKey()
+	std::uint64_t	mFileSize;
+	std::uint32_t	mNumScattering;
+	std::uint32_t	mNumTables;
+	std::uint8_t	mReserved[24];
+};
+static_assert(sizeof(LookUpTableFileHeader) == 64, "sizeof(""LookUpTableFileHeader"") is not 64");
+
+struct LookUpTableFileTableHeader
+{
+	std::uint32_t	mId;				// user defined, e.g. LookUpTableCache::TableId
+	std::uint32_t	mFormat;			// TextureFormat
+	std::uint32_t	mWidth;
+	std::uint32_t	mHeight;
+	std::uint32_t	mDepth;
+	std::uint32_t	mReserved0;
+	std::uint64_t	mOffset;
+	std::uint64_t	mSize;				// [bytes]
+	std::uint8_t	mReserved1[24];
+};
+static_assert(sizeof(LookUpTableFileTableHeader) == 64, "sizeof(""LookUpTableFileTableHeader"") is not 64");
+
+namespace detail {
+
+// Format of the tables of T, see LookUpTableFile::GetView2D()
+template<typename T> struct FloatTextureFormat;
+template<> struct FloatTextureFormat<math::Float2> { static constexpr TextureFormat sFormat = TextureFormat::R32G32; };
+template<> struct FloatTextureFormat<math::Float4> { static constexpr TextureFormat sFormat = TextureFormat::R32G32B32A32; };
+
+} // namespace detail
+
+struct ATMOSPHERE_EXPORT LookUpTableFile
+{
+	static constexpr size_t sAlignment = 64;
+
+	// A table to write, or a table of an opened file
+	struct Table
+	{
+		std::uint32_t	mId = 0;
+		TextureFormat	mFormat = TextureFormat::R32G32B32A32;
+		size_t			mWidth = 0;
+		size_t			mHeight = 0;
+		size_t			mDepth = 1;
+		const void*		mTexels = nullptr;
+
+		size_t GetSize() const { return mWidth * mHeight * mDepth * GetTexelSize(mFormat); }
+	};
+
+	// Maps the file and validates every header. Returns nullptr if the file is missing, truncated or of another major version.
+	static std::unique_ptr<LookUpTableFile> Open(const std::string& inPath);
+
+	static bool Write(const std::string& inPath, std::uint64_t inParameterHash, std::uint32_t inNumScattering, const std::vector<Table>& inTables);
+
+	const LookUpTableFileHeader& GetHeader() const { return mHeader; }
+	std::uint64_t GetParameterHash() const { return mHeader.mParameterHash; }
+	std::uint32_t GetNumScattering() const { return mHeader.mNumScattering; }
+	const std::vector<Table>& GetTables() const { return mTables; }
+	const Table* FindTable(std::uint32_t inId) const;
+
+	// Views over the mapped texels, invalid when the table is missing or has another format.
+	// T : math::Float2 (R32G32) or math::Float4 (R32G32B32A32)
+	template<typename T = math::Float2> LookUpTableView2D<T> GetView2D(std::uint32_t inId) const
+	{
+		const Table* table = FindTable(inId);
+		if (!table || table->mFormat != detail::FloatTextureFormat<T>::sFormat || table->mDepth != 1)
+			return LookUpTableView2D<T>();
+		return LookUpTableView2D<T>(static_cast<const T*>(table->mTexels), table->mWidth, table->mHeight);
+	}
+	template<typename T = math::Float4> LookUpTableView3D<T> GetView3D(std::uint32_t inId) const
+	{
+		const Table* table = FindTable(inId);
+		if (!table || table->mFormat != detail::FloatTextureFormat<T>::sFormat)
+			return LookUpTableView3D<T>();
+		return LookUpTableView3D<T>(static_cast<const T*>(table->mTexels), table->mWidth, table->mHeight, table->mDepth);
+	}
+
+protected:
+	LookUpTableFile() = default;
+
+	std::unique_ptr<etc::MappedFile>	mFile;
+	LookUpTableFileHeader				mHeader;
+	std::vector<Table>					mTables;
+};
+
+} // namespace atmosphere
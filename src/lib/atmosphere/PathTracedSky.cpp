@@ -0,0 +1,438 @@
+#include "PathTracedSky.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include "AtmosphericScattering.hpp"
+
+namespace atmosphere {
+
+namespace detail {
+
+// PCG-XSH-RR 32 [O'Neill14], one stream per (seed, pixel, sample)
+struct Pcg32
+{
+	std::uint64_t	mState = 0;
+	std::uint64_t	mIncrement = 1;
+
+	static std::uint64_t SplitMix64(std::uint64_t x)
+	{
+		x += 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	Pcg32(std::uint64_t inSeed, std::uint64_t inPixel, std::uint64_t inSample)
+	{
+		mIncrement = (SplitMix64(inSeed ^ SplitMix64(inPixel)) << 1u) | 1u;
+		mState = SplitMix64(inSample + mIncrement);
+		NextUint();
+	}
+
+	std::uint32_t NextUint()
+	{
+		const std::uint64_t old_state = mState;
+		mState = old_state * 6364136223846793005ull + mIncrement;
+		const std::uint32_t xorshifted = std::uint32_t(((old_state >> 18u) ^ old_state) >> 27u);
+		const std::uint32_t rot = std::uint32_t(old_state >> 59u);
+		return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+	}
+
+	// [0, 1)
+	double NextDouble()
+	{
+		return double(NextUint()) * (1.0 / 4294967296.0);
+	}
+};
+
+// Rayleigh, Mie scattering and extinction of one channel [km^{-1}]
+struct Medium
+{
+	double	mRayleighSctr;
+	double	mMieSctr;
+	double	mMieExt;
+	double	mInvRayleighScaleHeight;
+	double	mInvMieScaleHeight;
+
+	// The densities at the height of a position relative to the earth center, clamped to the ground
+	void GetDensities(const math::Double3& inPos, double& outRayleigh, double& outMie) const
+	{
+		const double height = std::max(math::L2Norm(inPos) - double(EARTH_RADIUS), 0.0);
+		outRayleigh = std::exp(-height * mInvRayleighScaleHeight);
+		outMie = std::exp(-height * mInvMieScaleHeight);
+	}
+
+	double GetExtinction(const math::Double3& inPos) const
+	{
+		double density_r, density_m;
+		GetDensities(inPos, density_r, density_m);
+		return mRayleighSctr * density_r + mMieExt * density_m;
+	}
+
+	// The densities only decrease with the height : the extinction at the lowest point of the segment bounds it
+	double GetMajorant(const math::Double3& inPos, const math::Double3& inDir, double inLength) const
+	{
+		const double b = math::InnerProduct(inPos, inDir);
+		const double r2 = math::InnerProduct(inPos, inPos);
+		double min_radius;
+		if (-b > 0.0 && -b < inLength)
+			min_radius = std::sqrt(std::max(r2 - b * b, 0.0));
+		else
+			min_radius = std::min(std::sqrt(r2), math::L2Norm(inPos + inDir * inLength));
+		const double height = std::max(min_radius - double(EARTH_RADIUS), 0.0);
+		return mRayleighSctr * std::exp(-height * mInvRayleighScaleHeight) + mMieExt * std::exp(-height * mInvMieScaleHeight);
+	}
+};
+
+// Nearest positive intersection with a sphere around the earth center, -1 on a miss
+static double IntersectSphere(const math::Double3& inPos, const math::Double3& inDir, double inRadius, bool inIsFar)
+{
+	const double b = math::InnerProduct(inPos, inDir);
+	const double c = math::InnerProduct(inPos, inPos) - inRadius * inRadius;
+	const double discriminant = b * b - c;
+	if (discriminant < 0.0)
+		return -1.0;
+	const double sqrt_d = std::sqrt(discriminant);
+	const double t = inIsFar ? (-b + sqrt_d) : (-b - sqrt_d);
+	return (t > 0.0) ? t : -1.0;
+}
+
+// Distance to the ground or out of the atmosphere along a ray from inside, and whether the ground was hit
+static double GetRayLength(const math::Double3& inPos, const math::Double3& inDir, bool& outIsGround)
+{
+	const double ground = IntersectSphere(inPos, inDir, double(EARTH_RADIUS), false);
+	outIsGround = (ground > 0.0);
+	return outIsGround ? ground : std::max(IntersectSphere(inPos, inDir, double(ATM_TOP_RADIUS), true), 0.0);
+}
+
+// Tentative collisions along a ray : a Poisson process with inRateScale * the majorant of each segment, the segments grow
+// with the height so that the rate follows the density. The exponential distances are memoryless, the process restarts
+// at every segment boundary. ioFunc(position, rate) is called at every tentative collision.
+template<typename Func>
+static void TrackRay(const Medium& inMedium, const math::Double3& inPos, const math::Double3& inDir, double inLength, double inRateScale, Pcg32& ioRng, Func&& ioFunc)
+{
+	double segment_begin = 0.0;
+	while (segment_begin < inLength)
+	{
+		const math::Double3 segment_pos = inPos + inDir * segment_begin;
+		const double height = std::max(math::L2Norm(segment_pos) - double(EARTH_RADIUS), 0.0);
+		const double segment_length = std::min(inLength - segment_begin, 1.0 + 0.5 * height);	// [km]
+		const double rate = inRateScale * inMedium.GetMajorant(segment_pos, inDir, segment_length);
+		double t = 0.0;
+		while (true)
+		{
+			t -= std::log(1.0 - ioRng.NextDouble()) / rate;
+			if (t >= segment_length)
+				break;
+			ioFunc(segment_pos + inDir * t, rate);
+		}
+		segment_begin += segment_length;
+	}
+}
+
+// Transmittance to the sun by ratio tracking, 0 in the shadow of the earth.
+// With a tight majorant the ratios close to the start are close to 0, a higher rate lowers the variance.
+static double SunTransmittance(const Medium& inMedium, const math::Double3& inPos, const math::Double3& inLightDir, double inRateScale, Pcg32& ioRng)
+{
+	bool is_ground;
+	const double length = GetRayLength(inPos, inLightDir, is_ground);
+	if (is_ground)
+		return 0.0;
+	double transmittance = 1.0;
+	TrackRay(inMedium, inPos, inLightDir, length, inRateScale, ioRng, [&](const math::Double3& inSamplePos, double inRate)
+	{
+		transmittance *= 1.0 - inMedium.GetExtinction(inSamplePos) / inRate;
+	});
+	return transmittance;
+}
+
+// Any unit vector orthogonal to inDir gives a basis with the cross product
+static math::Double3 GetPerpendicular(const math::Double3& inDir)
+{
+	const math::Double3 axis = (std::abs(inDir.x) < 0.9) ? math::Double3(1.0, 0.0, 0.0) : math::Double3(0.0, 1.0, 0.0);
+	return math::L2Normalize(math::Cross(inDir, axis));
+}
+
+static math::Double3 SampleAroundDirection(const math::Double3& inDir, double inCosTheta, double inPhi)
+{
+	const math::Double3 tangent = GetPerpendicular(inDir);
+	const math::Double3 bitangent = math::Cross(inDir, tangent);
+	const double sin_theta = std::sqrt(std::max(1.0 - inCosTheta * inCosTheta, 0.0));
+	return math::L2Normalize(inDir * inCosTheta + tangent * (sin_theta * std::cos(inPhi)) + bitangent * (sin_theta * std::sin(inPhi)));
+}
+
+// Inverse CDF of the Henyey-Greenstein phase function
+static double SampleHenyeyGreensteinCos(double g, double u)
+{
+	if (std::abs(g) < 1e-3)
+		return 1.0 - 2.0 * u;
+	const double s = (1.0 - g * g) / (1.0 - g + 2.0 * g * u);
+	return std::clamp((1.0 + g * g - s * s) / (2.0 * g), -1.0, 1.0);
+}
+
+static double TraceChannel(const PathTracerSettings& inSettings, const Medium& inMedium, const math::Double3& inPos, const math::Double3& inDir, const math::Double3& inLightDir,
+	double inSunIlluminance, Pcg32& ioRng)
+{
+	const double mie_g = double(inSettings.mMieAsymmetry);
+	const double rate_scale = std::max(double(inSettings.mTrackingRateScale), 1.0);
+	math::Double3 pos = inPos;
+	math::Double3 dir = inDir;
+	double throughput = 1.0;
+	double radiance = 0.0;
+
+	for (std::uint32_t bounce = 0; bounce < inSettings.mMaxBounces; ++bounce)
+	{
+		// One pass over the tentative collisions of the ray, up to the ground or the top of the atmosphere. The transmittance
+		// from the start is tracked by ratio tracking, T * extinction / rate is the weight of a real collision there.
+		//	- Next-event estimation at every tentative collision : the sum of T * the sunlight scattered there / rate is the
+		//	  single scattering along the ray
+		//	- The path continues from one of the tentative collisions chosen in proportion to its weight (weighted reservoir)
+		//	  with the sum of the weights, an estimate of 1 - T of the ray. Delta tracking would stop at the first real
+		//	  collision, but most paths leave the thin atmosphere without one.
+		bool is_ground;
+		const double length = GetRayLength(pos, dir, is_ground);
+		const double mu = math::InnerProduct(dir, inLightDir);
+		const double phase_r = double(RayleighPhase(float(mu)));
+		const double phase_m = double(MiePhase(float(mu), float(mie_g)));
+		math::Double3 collision_pos = pos;
+		double collision_density_r = 0.0, collision_density_m = 0.0;
+		double collision_weight = 0.0;
+		double transmittance = 1.0;
+		TrackRay(inMedium, pos, dir, length, rate_scale, ioRng, [&](const math::Double3& inSamplePos, double inRate)
+		{
+			double density_r, density_m;
+			inMedium.GetDensities(inSamplePos, density_r, density_m);
+			const double phase = inMedium.mRayleighSctr * density_r * phase_r + inMedium.mMieSctr * density_m * phase_m;
+			radiance += throughput * transmittance * phase / inRate * SunTransmittance(inMedium, inSamplePos, inLightDir, rate_scale, ioRng) * inSunIlluminance;
+
+			const double extinction = inMedium.mRayleighSctr * density_r + inMedium.mMieExt * density_m;
+			const double weight = transmittance * extinction / inRate;
+			collision_weight += weight;
+			if (ioRng.NextDouble() * collision_weight < weight)
+			{
+				collision_pos = inSamplePos;
+				collision_density_r = density_r;
+				collision_density_m = density_m;
+			}
+			transmittance *= 1.0 - extinction / inRate;
+		});
+		// Out of the atmosphere, or on the black ground
+		if (!(collision_weight > 0.0))
+			break;
+		pos = collision_pos;
+		throughput *= collision_weight;
+
+		const double sctr_r = inMedium.mRayleighSctr * collision_density_r;
+		const double sctr_m = inMedium.mMieSctr * collision_density_m;
+		const double extinction = sctr_r + inMedium.mMieExt * collision_density_m;
+
+		// Scattering : Rayleigh in an isotropic direction weighted by its phase function,
+		// Mie from Henyey-Greenstein weighted by Cornette-Shanks / Henyey-Greenstein
+		throughput *= (sctr_r + sctr_m) / extinction;
+		const double phi = 2.0 * math::PI<double> * ioRng.NextDouble();
+		if (ioRng.NextDouble() * (sctr_r + sctr_m) < sctr_r)
+		{
+			const double cos_theta = 1.0 - 2.0 * ioRng.NextDouble();
+			throughput *= 4.0 * math::PI<double> * double(RayleighPhase(float(cos_theta)));
+			dir = SampleAroundDirection(dir, cos_theta, phi);
+		}
+		else
+		{
+			const double cos_theta = SampleHenyeyGreensteinCos(mie_g, ioRng.NextDouble());
+			throughput *= double(CornetteShanksPhaseFunc(float(cos_theta), float(mie_g))) / double(HenyeyGreensteinPhaseFunc(float(cos_theta), float(mie_g)));
+			dir = SampleAroundDirection(dir, cos_theta, phi);
+		}
+
+		// Russian roulette
+		if (bounce + 1 >= inSettings.mRussianRouletteBounces)
+		{
+			const double survival = std::min(throughput, 0.95);
+			if (ioRng.NextDouble() >= survival)
+				break;
+			throughput /= survival;
+		}
+	}
+	return radiance;
+}
+
+} // namespace detail
+
+math::Float3 TraceSkyPath(const PathTracerSettings& inSettings, const math::Float3& inPosition, const math::Float3& inViewDir, const math::Float3& inLightDir,
+	std::uint64_t inPixel, std::uint64_t inSample)
+{
+	detail::Pcg32 rng(inSettings.mSeed, inPixel, inSample);
+	const PrecomputedSctrParams& params = inSettings.mParams;
+	const math::Double3 dir = math::L2Normalize(math::Double3(inViewDir.x, inViewDir.y, inViewDir.z));
+	const math::Double3 light_dir = math::L2Normalize(math::Double3(inLightDir.x, inLightDir.y, inLightDir.z));
+	math::Double3 pos(inPosition.x, double(inPosition.y) + double(EARTH_RADIUS), inPosition.z);
+
+	// From above the atmosphere, start at its top
+	if (math::L2Norm(pos) > double(ATM_TOP_RADIUS))
+	{
+		const double top = detail::IntersectSphere(pos, dir, double(ATM_TOP_RADIUS), false);
+		if (top < 0.0)
+			return math::Float3(0.0f);
+		pos = pos + dir * top;
+	}
+
+	math::Float3 radiance(0.0f);
+	for (int c = 0; c < 3; ++c)
+	{
+		detail::Medium medium;
+		medium.mRayleighSctr = double(params.mRayleighSctrCoeff[c]);
+		medium.mMieSctr = double(params.mMieSctrCoeff[c]);
+		medium.mMieExt = double(params.mMieSctrCoeff[c]) * double(params.mMieAbsorption);
+		medium.mInvRayleighScaleHeight = 1.0 / double(params.mRayleighScaleHeight);
+		medium.mInvMieScaleHeight = 1.0 / double(params.mMieScaleHeight);
+		radiance[c] = float(detail::TraceChannel(inSettings, medium, pos, dir, light_dir, double(inSettings.mSunIlluminance[c]), rng));
+	}
+	return radiance;
+}
+
+PathTracedSky::PathTracedSky(const Desc& inDesc, const PathTracerSettings& inSettings, const SkyView& inView)
+	: mDesc(inDesc)
+	, mSettings(inSettings)
+	, mView(inView)
+{
+	assert(mDesc.mTileSize > 0);
+	const bool is_cubemap = (inView.mProjection == SkyProjection::Cubemap);
+	mWidth = inView.mWidth;
+	mHeight = is_cubemap ? inView.mWidth : inView.mHeight;
+	mNumFaces = is_cubemap ? 6 : 1;
+	mSum.assign(3 * mWidth * mHeight * mNumFaces, 0.0);
+	mSumSquares.assign(mSum.size(), 0.0);
+
+	mScheduler = inDesc.mScheduler;
+	if (!mScheduler)
+	{
+		mOwnedScheduler = std::make_unique<etc::TaskScheduler>(inDesc.mNumThreads);
+		mScheduler = mOwnedScheduler.get();
+	}
+}
+
+PathTracedSky::~PathTracedSky()
+{
+}
+
+void PathTracedSky::Refine(std::uint32_t inNumSamples)
+{
+	const size_t tile_size = mDesc.mTileSize;
+	const size_t num_tiles_x = (mWidth + tile_size - 1) / tile_size;
+	const size_t num_tiles_y = (mHeight + tile_size - 1) / tile_size;
+	const size_t num_tiles_per_face = num_tiles_x * num_tiles_y;
+	const std::uint64_t first_sample = mNumSamples;
+
+	mScheduler->ParallelFor(num_tiles_per_face * mNumFaces, 1, [&](size_t inBegin, size_t inEnd)
+	{
+		for (size_t tile = inBegin; tile < inEnd; ++tile)
+		{
+			const size_t face = tile / num_tiles_per_face;
+			const size_t x0 = (tile % num_tiles_x) * tile_size;
+			const size_t y0 = ((tile % num_tiles_per_face) / num_tiles_x) * tile_size;
+			const size_t x1 = std::min(x0 + tile_size, mWidth);
+			const size_t y1 = std::min(y0 + tile_size, mHeight);
+			for (size_t y = y0; y < y1; ++y)
+			{
+				for (size_t x = x0; x < x1; ++x)
+				{
+					// The center of the pixel, the error maps compare directions
+					const math::Float3 view_dir = SkyRenderer::GetViewDir(mView, x, y, face);
+					const size_t pixel = x + mWidth * (y + mHeight * face);
+					for (std::uint32_t s = 0; s < inNumSamples; ++s)
+					{
+						const math::Float3 radiance = TraceSkyPath(mSettings, mView.mCameraPosition, view_dir, mView.mLightDir, pixel, first_sample + s);
+						for (int c = 0; c < 3; ++c)
+						{
+							mSum[3 * pixel + c] += double(radiance[c]);
+							mSumSquares[3 * pixel + c] += double(radiance[c]) * double(radiance[c]);
+						}
+					}
+				}
+			}
+		}
+	});
+	mNumSamples += inNumSamples;
+}
+
+void PathTracedSky::GetImage(SkyImage& outImage) const
+{
+	outImage.mWidth = mWidth;
+	outImage.mHeight = mHeight;
+	outImage.mNumFaces = mNumFaces;
+	outImage.mPixels.assign(mWidth * mHeight * mNumFaces, math::Float3(0.0f));
+	if (mNumSamples == 0)
+		return;
+	const double inv_num_samples = 1.0 / double(mNumSamples);
+	for (size_t i = 0; i < outImage.mPixels.size(); ++i)
+		for (int c = 0; c < 3; ++c)
+			outImage.mPixels[i][c] = float(mSum[3 * i + c] * inv_num_samples);
+}
+
+void PathTracedSky::GetStandardError(SkyImage& outImage) const
+{
+	outImage.mWidth = mWidth;
+	outImage.mHeight = mHeight;
+	outImage.mNumFaces = mNumFaces;
+	outImage.mPixels.assign(mWidth * mHeight * mNumFaces, math::Float3(0.0f));
+	if (mNumSamples < 2)
+		return;
+	const double n = double(mNumSamples);
+	for (size_t i = 0; i < outImage.mPixels.size(); ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			const double mean = mSum[3 * i + c] / n;
+			const double variance = std::max(mSumSquares[3 * i + c] / n - mean * mean, 0.0) * n / (n - 1.0);
+			outImage.mPixels[i][c] = float(std::sqrt(variance / n));
+		}
+	}
+}
+
+SkyImageError CompareSkyImages(const SkyImage& inReference, const SkyImage& inImage, SkyImage* outErrorMap, float inRelativeFloor)
+{
+	assert(inReference.mPixels.size() == inImage.mPixels.size());
+	float max_reference = 0.0f;
+	for (const math::Float3& pixel : inReference.mPixels)
+		max_reference = std::max({ max_reference, pixel.x, pixel.y, pixel.z });
+	const float floor = std::max(inRelativeFloor * max_reference, std::numeric_limits<float>::min());
+
+	if (outErrorMap)
+	{
+		outErrorMap->mWidth = inReference.mWidth;
+		outErrorMap->mHeight = inReference.mHeight;
+		outErrorMap->mNumFaces = inReference.mNumFaces;
+		outErrorMap->mPixels.resize(inReference.mPixels.size());
+	}
+
+	SkyImageError error;
+	double sum_squares = 0.0;
+	for (size_t i = 0; i < inReference.mPixels.size(); ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			const float reference = inReference.mPixels[i][c];
+			const float difference = inImage.mPixels[i][c] - reference;
+			if (outErrorMap)
+				outErrorMap->mPixels[i][c] = std::abs(difference) / std::max(reference, floor);
+			if (reference < floor)
+				continue;
+			const double relative = double(difference) / double(reference);
+			error.mMeanRelativeError += std::abs(relative);
+			error.mMeanRelativeBias += relative;
+			error.mMaxRelativeError = std::max(error.mMaxRelativeError, std::abs(relative));
+			sum_squares += relative * relative;
+			++error.mNumChannels;
+		}
+	}
+	if (error.mNumChannels > 0)
+	{
+		const double n = double(error.mNumChannels);
+		error.mMeanRelativeError /= n;
+		error.mMeanRelativeBias /= n;
+		error.mRmsRelativeError = std::sqrt(sum_squares / n);
+	}
+	return error;
+}
+
+} // namespace atmosphere
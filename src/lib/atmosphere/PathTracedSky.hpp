@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <src/lib/etc/TaskScheduler.hpp>
+#include <src/lib/math/Math.hpp>
+#include <shader/atmosphere/AtmosphereConstants.h>
+#include "AtmosphereExport.hpp"
+#include "SkyRenderer.hpp"
+
+namespace atmosphere {
+
+//--------------------------------------------------------------------------------------------
+// Path-traced reference of the sky
+//		- Ground truth for the look-up tables : the same atmosphere (PrecomputedSctrParams, exponential densities,
+//		  Cornette-Shanks Mie phase function with its asymmetry at every bounce, black ground, sun as a directional light)
+//		  without the 3d parametrization, the Mie packing nor the gather quadrature
+//		- Volumetric path tracing per RGB channel. The tentative collisions of delta tracking come from piecewise majorants
+//		  (the density at the lowest point of segments that grow with the height), times a rate scale. Next-event estimation
+//		  toward the sun with ratio tracking at every tentative collision, the path continues from one of them chosen in
+//		  proportion to its collision weight, Russian roulette after a few bounces.
+//		- Progressive : Refine() adds samples to every pixel over a task scheduler. The random numbers only depend on
+//		  the seed, the pixel and the sample index, so the image does not depend on the threads nor on how the samples
+//		  were split between the calls.
+//		- Geometry in double, a float position 6360 km from the earth center is only good to ~0.5 m
+//--------------------------------------------------------------------------------------------
+struct PathTracerSettings
+{
+	PrecomputedSctrParams	mParams;					// in the units of the kernels, CpuPrecomputedAtmosphericScattering::GetKernelParameters()
+	float					mMieAsymmetry = 0.76f;
+	math::Float3			mSunIlluminance = math::Float3(1e5f);	// same as SkyRadianceTables
+	std::uint32_t			mMaxBounces = 64;
+	std::uint32_t			mRussianRouletteBounces = 3;	// bounces before the roulette starts
+	float					mTrackingRateScale = 4.0f;	// tentative collisions per mean free path of the majorant, >= 1
+	std::uint64_t			mSeed = 1;
+};
+
+// One sample of the radiance seen from inPosition along inViewDir (SkyRadiance() conventions), the sun excluded.
+// inPixel and inSample select the random numbers.
+ATMOSPHERE_EXPORT math::Float3 TraceSkyPath(const PathTracerSettings& inSettings, const math::Float3& inPosition, const math::Float3& inViewDir, const math::Float3& inLightDir,
+	std::uint64_t inPixel, std::uint64_t inSample);
+
+struct ATMOSPHERE_EXPORT PathTracedSky
+{
+	struct Desc
+	{
+		std::uint32_t		mNumThreads = 0;		// 0 = std::thread::hardware_concurrency()
+		etc::TaskScheduler*	mScheduler = nullptr;	// optional pool shared with other systems
+		size_t				mTileSize = 8;
+	};
+
+	// inView : projection, resolution, camera and sun. The exposure and the tone mapping are not applied.
+	PathTracedSky(const Desc& inDesc, const PathTracerSettings& inSettings, const SkyView& inView);
+	~PathTracedSky();
+
+	// Adds inNumSamples samples to every pixel
+	void Refine(std::uint32_t inNumSamples);
+
+	std::uint64_t GetNumSamples() const { return mNumSamples; }
+	const SkyView& GetView() const { return mView; }
+
+	// Mean radiance, and the standard error of the mean per channel
+	void GetImage(SkyImage& outImage) const;
+	void GetStandardError(SkyImage& outImage) const;
+
+protected:
+	Desc				mDesc;
+	PathTracerSettings	mSettings;
+	SkyView				mView;
+	size_t				mWidth = 0;
+	size_t				mHeight = 0;
+	size_t				mNumFaces = 1;
+	std::uint64_t		mNumSamples = 0;
+	std::vector<double>	mSum;			// rgb per pixel
+	std::vector<double>	mSumSquares;
+	std::unique_ptr<etc::TaskScheduler>	mOwnedScheduler = nullptr;
+	etc::TaskScheduler*					mScheduler = nullptr;
+};
+
+// Per-channel relative error of an image against a reference of the same size
+//	- Channels below inRelativeFloor * the largest channel of the reference are left out, e.g. the black ground
+//	- outErrorMap (optional) : |image - reference| / max(reference, floor) per channel
+struct SkyImageError
+{
+	double	mMeanRelativeError = 0.0;
+	double	mRmsRelativeError = 0.0;
+	double	mMaxRelativeError = 0.0;
+	double	mMeanRelativeBias = 0.0;	// mean of (image - reference) / reference, the sign tells over or under estimation
+	size_t	mNumChannels = 0;
+};
+
+ATMOSPHERE_EXPORT SkyImageError CompareSkyImages(const SkyImage& inReference, const SkyImage& inImage, SkyImage* outErrorMap = nullptr, float inRelativeFloor = 1e-3f);
+
+} // namespace atmosphere
@@ -0,0 +1,65 @@
+#include "Planet.hpp"
+#include <cassert>
+
+namespace atmosphere {
+
+math::Float3 ComputeRayleighScatteringCoefficients()
+{
+	// For details, see "A practical Analytic Model for Daylight" by Preetham & Hoffman, p.23
+
+	// Wave lengths
+	// [BN08] follows [REK04] and gives the following values for Rayleigh scattering coefficients:
+	// RayleighBeta(lambda = (680nm, 550nm, 440nm) ) = (5.8, 13.5, 33.1)e-6
+	static const double dWaveLengths[] =
+	{
+		680e-9,     // red
+		550e-9,     // green
+		440e-9      // blue
+	};
+
+	math::Float3 out_coeff;
+
+	// Calculate angular and total scattering coefficients for Rayleigh scattering:
+	{
+		double n = 1.0003;    // - Refractive index of air in the visible spectrum
+		double N = 2.545e+25; // - Number of molecules per unit volume
+		double Pn = 0.035;    // - Depolarization factor for air which expresses corrections 
+							  //   due to anisotropy of air molecules
+
+		double dRayleighConst = 8.0*math::PI<double>*math::PI<double>*math::PI<double> * (n*n - 1.0) * (n*n - 1.0) / (3.0 * N) * (6.0 + 3.0*Pn) / (6.0 - 7.0*Pn);
+		for (int i = 0; i < 3; ++i)
+		{
+			double dSctrCoeff;
+			{
+				double Lambda2 = dWaveLengths[i] * dWaveLengths[i];
+				double Lambda4 = Lambda2 * Lambda2;
+				dSctrCoeff = dRayleighConst / Lambda4;
+				// Total Rayleigh scattering coefficient is the integral of angular scattering coefficient in all directions
+				out_coeff[i] = static_cast<float>(dSctrCoeff);
+			}
+		}
+		// Air molecules do not absorb light, so extinction coefficient is only caused by out-scattering
+	}
+	return out_coeff;
+}
+
+PrecomputedSctrParams GetScatteringParameters(Planet inPlanet)
+{
+	// ToDo: scattering coeff. calculation (https://www.cs.utah.edu/~shirley/papers/sunsky/sunsky.pdf, Appendix 3)
+	PrecomputedSctrParams param;
+	switch (inPlanet)
+	{
+	case Planet::Earth:
+		param.mRayleighSctrCoeff = 1e6f * ComputeRayleighScatteringCoefficients();
+		param.mRayleighScaleHeight = 7.997f;
+		param.mMieSctrCoeff = math::Float3(20.0f, 20.0f, 20.0f);
+		param.mMieScaleHeight = 1.2f;
+		param.mMieAbsorption = 1.11f;
+		break;
+	default:
+		assert(false);
+	}
+	return param;
+}
+
+} // namespace atmosphere
@@ -0,0 +1,21 @@
+#pragma once
+#include <src/lib/math/Math.hpp>
+#include <shader/atmosphere/AtmosphereConstants.h>
+#include "AtmosphereExport.hpp"
+
+namespace atmosphere {
+
+enum class Planet { Earth = 0, Mars };
+
+/*
+	Calculate the scattering coefficients[Yusov13]
+	@return scattering coefficients (R, G, B)  [10^{-6}/m]
+*/
+ATMOSPHERE_EXPORT math::Float3 ComputeRayleighScatteringCoefficients();
+
+/*
+	@return default scattering parameters of the planet
+*/
+ATMOSPHERE_EXPORT PrecomputedSctrParams GetScatteringParameters(Planet inPlanet);
+
+} // namespace atmosphere
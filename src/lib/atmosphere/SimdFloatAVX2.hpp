@@ -0,0 +1,71 @@
+#pragma once
+//------------------------------------------------------
+//	AVX2 + FMA SIMD float of the packet kernels (8 lanes)
+//		- Only for the translation units compiled with /arch:AVX2 (-mavx2 -mfma), see CMakeLists.txt
+//		- Everything is in an unnamed namespace, each translation unit gets its own copy
+//------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace atmosphere {
+namespace detail {
+namespace {
+
+struct Avx2Float
+{
+	static constexpr size_t WIDTH = 8;
+	using Mask = __m256;
+
+	__m256 v;
+
+	Avx2Float() = default;
+	Avx2Float(__m256 inValue) : v(inValue) {}
+	explicit Avx2Float(float inValue) : v(_mm256_set1_ps(inValue)) {}
+
+	static Avx2Float Load(const float* inPtr) { return _mm256_loadu_ps(inPtr); }
+};
+
+inline void Store(const Avx2Float& a, float* outPtr) { _mm256_storeu_ps(outPtr, a.v); }
+inline Avx2Float operator+(const Avx2Float& a, const Avx2Float& b) { return _mm256_add_ps(a.v, b.v); }
+inline Avx2Float operator-(const Avx2Float& a, const Avx2Float& b) { return _mm256_sub_ps(a.v, b.v); }
+inline Avx2Float operator*(const Avx2Float& a, const Avx2Float& b) { return _mm256_mul_ps(a.v, b.v); }
+inline Avx2Float operator/(const Avx2Float& a, const Avx2Float& b) { return _mm256_div_ps(a.v, b.v); }
+inline Avx2Float FMA(const Avx2Float& a, const Avx2Float& b, const Avx2Float& c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+inline Avx2Float Sqrt(const Avx2Float& a) { return _mm256_sqrt_ps(a.v); }
+inline Avx2Float Min(const Avx2Float& a, const Avx2Float& b) { return _mm256_min_ps(a.v, b.v); }
+inline Avx2Float Max(const Avx2Float& a, const Avx2Float& b) { return _mm256_max_ps(a.v, b.v); }
+inline Avx2Float Floor(const Avx2Float& a) { return _mm256_floor_ps(a.v); }
+inline Avx2Float::Mask Less(const Avx2Float& a, const Avx2Float& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline Avx2Float Select(const Avx2Float::Mask& inMask, const Avx2Float& a, const Avx2Float& b) { return _mm256_blendv_ps(b.v, a.v, inMask); }
+
+// 2^n for integral n in [-126, 127]
+inline Avx2Float Pow2i(const Avx2Float& n)
+{
+	const __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127));
+	return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+}
+
+inline void GatherFloat2(const float* inTexels, std::int32_t inWidth, const Avx2Float& x, const Avx2Float& y, Avx2Float& outX, Avx2Float& outY)
+{
+	const __m256i index = _mm256_cvtps_epi32(_mm256_fmadd_ps(y.v, _mm256_set1_ps(float(inWidth)), x.v));
+	const __m256i offset = _mm256_slli_epi32(index, 1);
+	outX = _mm256_i32gather_ps(inTexels, offset, 4);
+	outY = _mm256_i32gather_ps(inTexels + 1, offset, 4);
+}
+
+// R32G32B32A32 texels, inIndex holds integral texel indices
+inline void GatherFloat4(const float* inTexels, const Avx2Float& inIndex, Avx2Float outTexel[4])
+{
+	const __m256i offset = _mm256_slli_epi32(_mm256_cvtps_epi32(inIndex.v), 2);
+	for (int c = 0; c < 4; ++c)
+		outTexel[c] = _mm256_i32gather_ps(inTexels + c, offset, 4);
+}
+
+} // namespace
+} // namespace detail
+} // namespace atmosphere
+
+#endif
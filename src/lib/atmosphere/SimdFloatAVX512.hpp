@@ -0,0 +1,71 @@
+#pragma once
+//------------------------------------------------------
+//	AVX-512F SIMD float of the packet kernels (16 lanes)
+//		- Only for the translation units compiled with /arch:AVX512 (-mavx512f), see CMakeLists.txt
+//		- Everything is in an unnamed namespace, each translation unit gets its own copy
+//------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace atmosphere {
+namespace detail {
+namespace {
+
+struct Avx512Float
+{
+	static constexpr size_t WIDTH = 16;
+	using Mask = __mmask16;
+
+	__m512 v;
+
+	Avx512Float() = default;
+	Avx512Float(__m512 inValue) : v(inValue) {}
+	explicit Avx512Float(float inValue) : v(_mm512_set1_ps(inValue)) {}
+
+	static Avx512Float Load(const float* inPtr) { return _mm512_loadu_ps(inPtr); }
+};
+
+inline void Store(const Avx512Float& a, float* outPtr) { _mm512_storeu_ps(outPtr, a.v); }
+inline Avx512Float operator+(const Avx512Float& a, const Avx512Float& b) { return _mm512_add_ps(a.v, b.v); }
+inline Avx512Float operator-(const Avx512Float& a, const Avx512Float& b) { return _mm512_sub_ps(a.v, b.v); }
+inline Avx512Float operator*(const Avx512Float& a, const Avx512Float& b) { return _mm512_mul_ps(a.v, b.v); }
+inline Avx512Float operator/(const Avx512Float& a, const Avx512Float& b) { return _mm512_div_ps(a.v, b.v); }
+inline Avx512Float FMA(const Avx512Float& a, const Avx512Float& b, const Avx512Float& c) { return _mm512_fmadd_ps(a.v, b.v, c.v); }
+inline Avx512Float Sqrt(const Avx512Float& a) { return _mm512_sqrt_ps(a.v); }
+inline Avx512Float Min(const Avx512Float& a, const Avx512Float& b) { return _mm512_min_ps(a.v, b.v); }
+inline Avx512Float Max(const Avx512Float& a, const Avx512Float& b) { return _mm512_max_ps(a.v, b.v); }
+inline Avx512Float Floor(const Avx512Float& a) { return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+inline Avx512Float::Mask Less(const Avx512Float& a, const Avx512Float& b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+inline Avx512Float Select(const Avx512Float::Mask& inMask, const Avx512Float& a, const Avx512Float& b) { return _mm512_mask_blend_ps(inMask, b.v, a.v); }
+
+// 2^n for integral n in [-126, 127]
+inline Avx512Float Pow2i(const Avx512Float& n)
+{
+	const __m512i e = _mm512_add_epi32(_mm512_cvtps_epi32(n.v), _mm512_set1_epi32(127));
+	return _mm512_castsi512_ps(_mm512_slli_epi32(e, 23));
+}
+
+inline void GatherFloat2(const float* inTexels, std::int32_t inWidth, const Avx512Float& x, const Avx512Float& y, Avx512Float& outX, Avx512Float& outY)
+{
+	const __m512i index = _mm512_cvtps_epi32(_mm512_fmadd_ps(y.v, _mm512_set1_ps(float(inWidth)), x.v));
+	const __m512i offset = _mm512_slli_epi32(index, 1);
+	outX = _mm512_i32gather_ps(offset, inTexels, 4);
+	outY = _mm512_i32gather_ps(offset, inTexels + 1, 4);
+}
+
+// R32G32B32A32 texels, inIndex holds integral texel indices
+inline void GatherFloat4(const float* inTexels, const Avx512Float& inIndex, Avx512Float outTexel[4])
+{
+	const __m512i offset = _mm512_slli_epi32(_mm512_cvtps_epi32(inIndex.v), 2);
+	for (int c = 0; c < 4; ++c)
+		outTexel[c] = _mm512_i32gather_ps(offset, inTexels + c, 4);
+}
+
+} // namespace
+} // namespace detail
+} // namespace atmosphere
+
+#endif
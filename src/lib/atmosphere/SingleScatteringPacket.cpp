@@ -0,0 +1,164 @@
+#include "SingleScatteringPacket.hpp"
+#include "AtmosphericScattering.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace atmosphere {
+
+namespace detail {
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#if defined(_MSC_VER)
+static bool IsCpuFeatureSupported(SimdInstructionSet inInstructionSet)
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool fma = (info[2] & (1 << 12)) != 0;
+	if (!osxsave)
+		return false;
+	const unsigned long long xcr0 = _xgetbv(0);
+	const bool os_avx = (xcr0 & 0x6) == 0x6;				// XMM, YMM
+	const bool os_avx512 = (xcr0 & 0xe6) == 0xe6;			// XMM, YMM, opmask, ZMM
+
+	__cpuidex(info, 7, 0);
+	const bool avx2 = (info[1] & (1 << 5)) != 0;
+	const bool avx512f = (info[1] & (1 << 16)) != 0;
+
+	switch (inInstructionSet)
+	{
+	case SimdInstructionSet::AVX2:		return os_avx && avx2 && fma;
+	case SimdInstructionSet::AVX512:	return os_avx512 && avx512f;
+	default:							return true;
+	}
+}
+#else
+static bool IsCpuFeatureSupported(SimdInstructionSet inInstructionSet)
+{
+	switch (inInstructionSet)
+	{
+	case SimdInstructionSet::AVX2:		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	case SimdInstructionSet::AVX512:	return __builtin_cpu_supports("avx512f");
+	default:							return true;
+	}
+}
+#endif
+#else
+static bool IsCpuFeatureSupported(SimdInstructionSet inInstructionSet)
+{
+	return inInstructionSet == SimdInstructionSet::Scalar;
+}
+#endif
+
+static bool IsCompiledIn(SimdInstructionSet inInstructionSet)
+{
+	switch (inInstructionSet)
+	{
+	case SimdInstructionSet::AVX2:		return IsSingleScatteringPacketAVX2CompiledIn();
+	case SimdInstructionSet::AVX512:	return IsSingleScatteringPacketAVX512CompiledIn();
+	default:							return true;
+	}
+}
+
+} // namespace detail
+
+bool IsSimdInstructionSetSupported(SimdInstructionSet inInstructionSet)
+{
+	if (inInstructionSet == SimdInstructionSet::Auto)
+		return true;
+	return detail::IsCompiledIn(inInstructionSet) && detail::IsCpuFeatureSupported(inInstructionSet);
+}
+
+SimdInstructionSet ResolveSimdInstructionSet(SimdInstructionSet inInstructionSet)
+{
+	if (inInstructionSet != SimdInstructionSet::Auto)
+		return IsSimdInstructionSetSupported(inInstructionSet) ? inInstructionSet : SimdInstructionSet::Scalar;
+
+	static const SimdInstructionSet sBest =
+		IsSimdInstructionSetSupported(SimdInstructionSet::AVX512) ? SimdInstructionSet::AVX512 :
+		IsSimdInstructionSetSupported(SimdInstructionSet::AVX2) ? SimdInstructionSet::AVX2 :
+		SimdInstructionSet::Scalar;
+	return sBest;
+}
+
+const char* GetSimdInstructionSetName(SimdInstructionSet inInstructionSet)
+{
+	switch (inInstructionSet)
+	{
+	case SimdInstructionSet::Auto:		return "auto";
+	case SimdInstructionSet::Scalar:	return "scalar";
+	case SimdInstructionSet::AVX2:		return "avx2";
+	case SimdInstructionSet::AVX512:	return "avx512";
+	}
+	return "unknown";
+}
+
+void SingleScatteringPacket(
+	SimdInstructionSet inInstructionSet,
+	const PrecomputedSctrParams& inParams,
+	const LookUpTableView2D<math::Float2>& inOpticalDepthTexture,
+	OpticalDepthMode inOpticalDepthMode,
+	const RayPacket& inRays,
+	SingleScatteringPacketResult& outResult)
+{
+	assert(inRays.mNumRays <= PACKET_MAX_RAYS);
+	if (inRays.mNumRays == 0)
+		return;
+
+	const SimdInstructionSet instruction_set = ResolveSimdInstructionSet(inInstructionSet);
+	if (instruction_set != SimdInstructionSet::Scalar)
+	{
+		// Gather offsets are computed in float, texel indices must be exact
+		assert(inOpticalDepthTexture.GetNumTexels() <= (size_t(1) << 24));
+
+		const float mie_g = 0.0f;
+		detail::SingleScatteringKernelArgs args;
+		for (int c = 0; c < 3; ++c)
+		{
+			args.mRayleighSctrCoeff[c] = inParams.mRayleighSctrCoeff[c];
+			args.mMieSctrCoeff[c] = inParams.mMieSctrCoeff[c];
+			args.mMieExtinctionCoeff[c] = inParams.mMieSctrCoeff[c] * (inParams.mMieAbsorption * (1.0f - mie_g));
+			args.mEarthCenter[c] = EarthCenter()[c];
+		}
+		args.mRayleighScaleHeight = inParams.mRayleighScaleHeight;
+		args.mMieScaleHeight = inParams.mMieScaleHeight;
+		args.mEarthRadius = EARTH_RADIUS;
+		args.mAtmosphereTopHeight = ATM_TOP_HEIGHT;
+		args.mOpticalDepth = &inOpticalDepthTexture.GetData()->x;
+		args.mOpticalDepthWidth = std::int32_t(inOpticalDepthTexture.GetWidth());
+		args.mOpticalDepthHeight = std::int32_t(inOpticalDepthTexture.GetHeight());
+		args.mAnalyticOpticalDepth = (inOpticalDepthMode == OpticalDepthMode::Analytic) ? 1 : 0;
+
+		if (instruction_set == SimdInstructionSet::AVX512)
+			detail::SingleScatteringPacketAVX512(args, inRays, outResult);
+		else
+			detail::SingleScatteringPacketAVX2(args, inRays, outResult);
+		return;
+	}
+
+	// Scalar fallback
+	for (size_t i = 0; i < inRays.mNumRays; ++i)
+	{
+		const math::Float3 start_pos(inRays.mStartPos[0][i], inRays.mStartPos[1][i], inRays.mStartPos[2][i]);
+		const math::Float3 end_pos(inRays.mEndPos[0][i], inRays.mEndPos[1][i], inRays.mEndPos[2][i]);
+		const math::Float3 light_dir(inRays.mLightDir[0][i], inRays.mLightDir[1][i], inRays.mLightDir[2][i]);
+		math::Float3 inscatter_r(0.0f), inscatter_m(0.0f), transmittance(1.0f);
+		if (inRays.mNumSteps[i] > 0)
+			SingleScattering(start_pos, end_pos, light_dir, inParams, inOpticalDepthTexture, inOpticalDepthMode, inscatter_r, inscatter_m, transmittance, inRays.mNumSteps[i]);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			outResult.mInscatterR[c][i] = inscatter_r[c];
+			outResult.mInscatterM[c][i] = inscatter_m[c];
+			outResult.mTransmittance[c][i] = transmittance[c];
+		}
+	}
+}
+
+} // namespace atmosphere
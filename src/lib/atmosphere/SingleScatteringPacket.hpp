@@ -0,0 +1,39 @@
+#pragma once
+#include <src/lib/math/Math.hpp>
+#include <shader/atmosphere/AtmosphereConstants.h>
+#include "AtmosphereExport.hpp"
+#include "AtmosphericScattering.hpp"
+#include "LookUpTable.hpp"
+#include "SingleScatteringPacketKernel.hpp"
+
+namespace atmosphere {
+
+//------------------------------------------------------
+//	SIMD packet version of SingleScattering()
+//		- Marches PACKET_MAX_RAYS rays in lockstep (2 x 8 lanes with AVX2, 16 lanes with AVX-512)
+//		- Scalar falls back to SingleScattering() ray by ray and gives exactly the same result as before
+//		- AVX2/AVX-512 use a polynomial exp() and fold the two transmittance exp() into one,
+//		  the results match the scalar path to ~1e-5 relative error
+//------------------------------------------------------
+enum class SimdInstructionSet
+{
+	Auto = 0,	// The best one supported by both the compiler and the CPU
+	Scalar,
+	AVX2,
+	AVX512,
+};
+
+ATMOSPHERE_EXPORT bool IsSimdInstructionSetSupported(SimdInstructionSet inInstructionSet);
+ATMOSPHERE_EXPORT SimdInstructionSet ResolveSimdInstructionSet(SimdInstructionSet inInstructionSet);
+ATMOSPHERE_EXPORT const char* GetSimdInstructionSetName(SimdInstructionSet inInstructionSet);
+
+// outResult.[lane] = SingleScattering(inRays.[lane])
+ATMOSPHERE_EXPORT void SingleScatteringPacket(
+	SimdInstructionSet inInstructionSet,
+	const PrecomputedSctrParams& inParams,
+	const LookUpTableView2D<math::Float2>& inOpticalDepthTexture,
+	OpticalDepthMode inOpticalDepthMode,
+	const RayPacket& inRays,
+	SingleScatteringPacketResult& outResult);
+
+} // namespace atmosphere
@@ -0,0 +1,44 @@
+//------------------------------------------------------
+//	AVX2 + FMA instantiation of the SingleScattering packet kernel (8 rays per instruction)
+//		- Compiled with /arch:AVX2 (-mavx2 -mfma), see CMakeLists.txt
+//------------------------------------------------------
+#include "SingleScatteringPacketKernel.hpp"
+#include "SimdFloatAVX2.hpp"
+
+#if defined(__AVX2__)
+
+namespace atmosphere {
+namespace detail {
+
+bool IsSingleScatteringPacketAVX2CompiledIn()
+{
+	return true;
+}
+
+void SingleScatteringPacketAVX2(const SingleScatteringKernelArgs& inArgs, const RayPacket& inRays, SingleScatteringPacketResult& outResult)
+{
+	for (size_t lane = 0; lane < inRays.mNumRays; lane += Avx2Float::WIDTH)
+		SingleScatteringPacketT<Avx2Float>(inArgs, inRays, lane, outResult);
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#else
+
+namespace atmosphere {
+namespace detail {
+
+bool IsSingleScatteringPacketAVX2CompiledIn()
+{
+	return false;
+}
+
+void SingleScatteringPacketAVX2(const SingleScatteringKernelArgs&, const RayPacket&, SingleScatteringPacketResult&)
+{
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#endif
@@ -0,0 +1,43 @@
+//------------------------------------------------------
+//	AVX-512F instantiation of the SingleScattering packet kernel (16 rays per instruction)
+//		- Compiled with /arch:AVX512 (-mavx512f), see CMakeLists.txt
+//------------------------------------------------------
+#include "SingleScatteringPacketKernel.hpp"
+#include "SimdFloatAVX512.hpp"
+
+#if defined(__AVX512F__)
+
+namespace atmosphere {
+namespace detail {
+
+bool IsSingleScatteringPacketAVX512CompiledIn()
+{
+	return true;
+}
+
+void SingleScatteringPacketAVX512(const SingleScatteringKernelArgs& inArgs, const RayPacket& inRays, SingleScatteringPacketResult& outResult)
+{
+	SingleScatteringPacketT<Avx512Float>(inArgs, inRays, 0, outResult);
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#else
+
+namespace atmosphere {
+namespace detail {
+
+bool IsSingleScatteringPacketAVX512CompiledIn()
+{
+	return false;
+}
+
+void SingleScatteringPacketAVX512(const SingleScatteringKernelArgs&, const RayPacket&, SingleScatteringPacketResult&)
+{
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#endif
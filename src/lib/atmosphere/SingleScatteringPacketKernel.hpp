@@ -0,0 +1,244 @@
+#pragma once
+//------------------------------------------------------
+//	Packet kernel of SingleScattering()
+//		- Marches up to PACKET_MAX_RAYS rays in lockstep, one ray per SIMD lane
+//		- This header is included by the translation units compiled with /arch:AVX2, /arch:AVX512 (-mavx2, -mavx512f).
+//		  Do NOT include Math.hpp or any other header with inline functions here. The linker may otherwise pick
+//		  the AVX copy of an inline function for the generic code and crash on older CPUs.
+//------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+namespace atmosphere {
+
+constexpr size_t PACKET_MAX_RAYS = 16;
+
+// Structure-of-arrays rays. Lanes >= mNumRays are ignored.
+struct alignas(64) RayPacket
+{
+	float			mStartPos[3][PACKET_MAX_RAYS];
+	float			mEndPos[3][PACKET_MAX_RAYS];
+	float			mLightDir[3][PACKET_MAX_RAYS];
+	std::int32_t	mNumSteps[PACKET_MAX_RAYS];		// A ray ends (and its lane is masked out) after mNumSteps steps
+	size_t			mNumRays;
+};
+
+struct alignas(64) SingleScatteringPacketResult
+{
+	float	mInscatterR[3][PACKET_MAX_RAYS];
+	float	mInscatterM[3][PACKET_MAX_RAYS];
+	float	mTransmittance[3][PACKET_MAX_RAYS];
+};
+
+namespace detail {
+
+// Everything the kernel reads, flattened into plain types (see the note at the top of the file)
+struct SingleScatteringKernelArgs
+{
+	float			mRayleighSctrCoeff[3];
+	float			mMieSctrCoeff[3];
+	float			mMieExtinctionCoeff[3];
+	float			mRayleighScaleHeight;
+	float			mMieScaleHeight;
+	float			mEarthRadius;
+	float			mEarthCenter[3];
+	float			mAtmosphereTopHeight;
+
+	const float*	mOpticalDepth;			// R32G32 texels, row major
+	std::int32_t	mOpticalDepthWidth;
+	std::int32_t	mOpticalDepthHeight;
+	std::int32_t	mAnalyticOpticalDepth;	// 1 : CalculateAnalyticOpticalDepthToTop() instead of the texture
+};
+
+// Implemented in SingleScatteringPacketAVX2.cpp / SingleScatteringPacketAVX512.cpp.
+// Is*CompiledIn() returns false when the compiler could not build the instruction set, the kernel is then empty.
+bool IsSingleScatteringPacketAVX2CompiledIn();
+bool IsSingleScatteringPacketAVX512CompiledIn();
+void SingleScatteringPacketAVX2(const SingleScatteringKernelArgs& inArgs, const RayPacket& inRays, SingleScatteringPacketResult& outResult);
+void SingleScatteringPacketAVX512(const SingleScatteringKernelArgs& inArgs, const RayPacket& inRays, SingleScatteringPacketResult& outResult);
+
+//------------------------------------------------------
+//	Generic part of the kernel, P is a SIMD float type providing
+//		P(float), P::Load(), Store(), + - * /, FMA(), Sqrt(), Min(), Max(), Floor(), Less(), Select(), Pow2i(),
+//		GatherFloat2(), P::Mask and P::WIDTH
+//------------------------------------------------------
+
+// exp(x) with a degree 5 polynomial on [-ln2/2, ln2/2] (cephes expf), ~2 ulp
+template<typename P> P ExpPacket(P x)
+{
+	const P lower(-87.3f);
+	const typename P::Mask underflow = Less(x, lower);
+	x = Min(Max(x, lower), P(88.3f));
+
+	const P n = Floor(FMA(x, P(1.44269504088896341f), P(0.5f)));
+	P r = FMA(n, P(-0.693359375f), x);
+	r = FMA(n, P(2.12194440e-4f), r);
+
+	P y = P(1.9875691500e-4f);
+	y = FMA(y, r, P(1.3981999507e-3f));
+	y = FMA(y, r, P(8.3334519073e-3f));
+	y = FMA(y, r, P(4.1665795894e-2f));
+	y = FMA(y, r, P(1.6666665459e-1f));
+	y = FMA(y, r, P(5.0000001201e-1f));
+	y = FMA(y, r * r, r + P(1.0f));
+
+	return Select(underflow, P(0.0f), y * Pow2i(n));
+}
+
+// Same as LookUpTable2D::Sample() (linear filter, clamp addressing)
+template<typename P> void SampleOpticalDepthPacket(const SingleScatteringKernelArgs& inArgs, const P& inU, const P& inV, P& outX, P& outY)
+{
+	const P width(float(inArgs.mOpticalDepthWidth));
+	const P height(float(inArgs.mOpticalDepthHeight));
+	const P last_x(float(inArgs.mOpticalDepthWidth - 1));
+	const P last_y(float(inArgs.mOpticalDepthHeight - 1));
+
+	const P texel_x = inU * width - P(0.5f);
+	const P texel_y = inV * height - P(0.5f);
+	const P floor_x = Floor(texel_x);
+	const P floor_y = Floor(texel_y);
+	const P tx = texel_x - floor_x;
+	const P ty = texel_y - floor_y;
+
+	// Max(value, 0) comes first so that NaN is flushed to 0 and the gathers stay inside the table
+	const P x0 = Min(Max(floor_x, P(0.0f)), last_x);
+	const P x1 = Min(Max(floor_x + P(1.0f), P(0.0f)), last_x);
+	const P y0 = Min(Max(floor_y, P(0.0f)), last_y);
+	const P y1 = Min(Max(floor_y + P(1.0f), P(0.0f)), last_y);
+
+	P c00x, c00y, c10x, c10y, c01x, c01y, c11x, c11y;
+	GatherFloat2(inArgs.mOpticalDepth, inArgs.mOpticalDepthWidth, x0, y0, c00x, c00y);
+	GatherFloat2(inArgs.mOpticalDepth, inArgs.mOpticalDepthWidth, x1, y0, c10x, c10y);
+	GatherFloat2(inArgs.mOpticalDepth, inArgs.mOpticalDepthWidth, x0, y1, c01x, c01y);
+	GatherFloat2(inArgs.mOpticalDepth, inArgs.mOpticalDepthWidth, x1, y1, c11x, c11y);
+
+	const P c0x = FMA(c10x - c00x, tx, c00x);
+	const P c0y = FMA(c10y - c00y, tx, c00y);
+	const P c1x = FMA(c11x - c01x, tx, c01x);
+	const P c1y = FMA(c11y - c01y, tx, c01y);
+	outX = FMA(c1x - c0x, ty, c0x);
+	outY = FMA(c1y - c0y, ty, c0y);
+}
+
+// Same as AnalyticOpticalDepth() for both scale heights, inHeight >= 0
+template<typename P> P AnalyticOpticalDepthPacket(const P& inEarthRadius, const P& inHeight, const P& inRadius, const P& inPeriapsis, const P& inAbsCosZenith, const typename P::Mask& inBelow, float inScaleHeight)
+{
+	const P scale_height(inScaleHeight);
+	const P inv_scale_height(1.0f / inScaleHeight);
+	const P half_pi(0.5f * 3.14159265358979f);
+
+	// ChapmanUpper(x, |mu|)
+	const P x = inRadius * inv_scale_height;
+	const P y = inAbsCosZenith * Sqrt(x * P(0.5f));
+	const P erfcx = P(0.7978845608f) / FMA(P((1.0f - 0.339f) * 1.4142135624f), y, P(0.339f) * Sqrt(FMA(P(2.0f) * y, y, P(5.510f))));
+	const P upper = scale_height * ExpPacket(P(0.0f) - inHeight * inv_scale_height) * Sqrt(half_pi * x) * erfcx;
+
+	const P grazing = scale_height * P(2.0f) * ExpPacket((P(0.0f) - (inPeriapsis - inEarthRadius)) * inv_scale_height) * Sqrt(half_pi * inPeriapsis * inv_scale_height);
+	return Select(inBelow, grazing - upper, upper);
+}
+
+// Same as CalculateAnalyticOpticalDepthToTop()
+template<typename P> void AnalyticOpticalDepthToTopPacket(const SingleScatteringKernelArgs& inArgs, const P& inHeight, const P& inCosZenith, P& outX, P& outY)
+{
+	const P earth_radius(inArgs.mEarthRadius);
+	const P height = Max(inHeight, P(0.0f));
+	const P radius = height + earth_radius;
+	const P cos_horizon = P(0.0f) - Sqrt(height * (P(2.0f) * earth_radius + height)) / radius;
+	const typename P::Mask hits_ground = Less(inCosZenith, cos_horizon);
+	const typename P::Mask below = Less(inCosZenith, P(0.0f));
+	const P abs_cos_zenith = Max(inCosZenith, P(0.0f) - inCosZenith);
+	const P periapsis = radius * Sqrt(Max(P(1.0f) - inCosZenith * inCosZenith, P(0.0f)));
+
+	outX = Select(hits_ground, P(1e20f), AnalyticOpticalDepthPacket(earth_radius, height, radius, periapsis, abs_cos_zenith, below, inArgs.mRayleighScaleHeight));
+	outY = Select(hits_ground, P(1e20f), AnalyticOpticalDepthPacket(earth_radius, height, radius, periapsis, abs_cos_zenith, below, inArgs.mMieScaleHeight));
+}
+
+// SingleScattering() for the lanes [inFirstRay, inFirstRay + P::WIDTH)
+template<typename P> void SingleScatteringPacketT(const SingleScatteringKernelArgs& inArgs, const RayPacket& inRays, size_t inFirstRay, SingleScatteringPacketResult& outResult)
+{
+	const size_t lane = inFirstRay;
+
+	std::int32_t max_steps = 0;
+	float num_steps[P::WIDTH];
+	for (size_t i = 0; i < P::WIDTH; ++i)
+	{
+		const bool valid = (lane + i < inRays.mNumRays) && (inRays.mNumSteps[lane + i] > 0);
+		const std::int32_t steps = valid ? inRays.mNumSteps[lane + i] : 0;
+		num_steps[i] = valid ? float(steps) : -1.0f;	// -1 : the lane is never active
+		max_steps = (steps > max_steps) ? steps : max_steps;
+	}
+	const P steps = P::Load(num_steps);
+	const P inv_steps = P(1.0f) / Max(steps, P(1.0f));	// invalid lanes march a zero-length ray
+
+	P start[3], dr[3], light[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		start[c] = P::Load(&inRays.mStartPos[c][lane]);
+		dr[c] = (P::Load(&inRays.mEndPos[c][lane]) - start[c]) * inv_steps;
+		light[c] = P::Load(&inRays.mLightDir[c][lane]);
+		// Relative to the earth center
+		start[c] = start[c] - P(inArgs.mEarthCenter[c]);
+	}
+	const P length_dr = Sqrt(FMA(dr[0], dr[0], FMA(dr[1], dr[1], dr[2] * dr[2])));
+
+	const P neg_inv_scale_height_r(-1.0f / inArgs.mRayleighScaleHeight);
+	const P neg_inv_scale_height_m(-1.0f / inArgs.mMieScaleHeight);
+	const P inv_top_height(1.0f / inArgs.mAtmosphereTopHeight);
+	P beta_r[3], beta_m[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		beta_r[c] = P(-inArgs.mRayleighSctrCoeff[c]);
+		beta_m[c] = P(-inArgs.mMieExtinctionCoeff[c]);
+	}
+
+	P optdepth_from_cam_r(0.0f), optdepth_from_cam_m(0.0f);
+	P inscatter_r[3] = { P(0.0f), P(0.0f), P(0.0f) };
+	P inscatter_m[3] = { P(0.0f), P(0.0f), P(0.0f) };
+
+	for (std::int32_t i = 0; i <= max_steps; ++i)
+	{
+		// Lanes whose ray has already ended keep their value
+		const typename P::Mask active = Less(P(float(i) - 0.5f), steps);
+
+		const P t = P(float(i));
+		const P ex = FMA(dr[0], t, start[0]);
+		const P ey = FMA(dr[1], t, start[1]);
+		const P ez = FMA(dr[2], t, start[2]);
+		const P dist = Sqrt(FMA(ex, ex, FMA(ey, ey, ez * ez)));
+		const P height = dist - P(inArgs.mEarthRadius);
+
+		const P integrand_r = ExpPacket(height * neg_inv_scale_height_r) * length_dr;
+		const P integrand_m = ExpPacket(height * neg_inv_scale_height_m) * length_dr;
+
+		const P cos_light_zenith = FMA(ex, light[0], FMA(ey, light[1], ez * light[2])) / dist;
+		P optdepth_to_top_r, optdepth_to_top_m;
+		if (inArgs.mAnalyticOpticalDepth)
+			AnalyticOpticalDepthToTopPacket(inArgs, height, cos_light_zenith, optdepth_to_top_r, optdepth_to_top_m);
+		else
+			SampleOpticalDepthPacket(inArgs, height * inv_top_height, FMA(cos_light_zenith, P(0.5f), P(0.5f)), optdepth_to_top_r, optdepth_to_top_m);
+
+		// trans_from_cam * trans_to_top = exp(-beta * (optdepth_from_cam + optdepth_to_top))
+		const P total_r = optdepth_from_cam_r + optdepth_to_top_r;
+		const P total_m = optdepth_from_cam_m + optdepth_to_top_m;
+		for (int c = 0; c < 3; ++c)
+		{
+			const P trans = ExpPacket(FMA(beta_r[c], total_r, beta_m[c] * total_m));
+			inscatter_r[c] = Select(active, FMA(trans, integrand_r, inscatter_r[c]), inscatter_r[c]);
+			inscatter_m[c] = Select(active, FMA(trans, integrand_m, inscatter_m[c]), inscatter_m[c]);
+		}
+		optdepth_from_cam_r = Select(active, optdepth_from_cam_r + integrand_r, optdepth_from_cam_r);
+		optdepth_from_cam_m = Select(active, optdepth_from_cam_m + integrand_m, optdepth_from_cam_m);
+	}
+
+	for (int c = 0; c < 3; ++c)
+	{
+		const P transmittance = ExpPacket(FMA(beta_r[c], optdepth_from_cam_r, beta_m[c] * optdepth_from_cam_m));
+		Store(transmittance, &outResult.mTransmittance[c][lane]);
+		Store(inscatter_r[c] * P(inArgs.mRayleighSctrCoeff[c]), &outResult.mInscatterR[c][lane]);
+		Store(inscatter_m[c] * P(inArgs.mMieSctrCoeff[c]), &outResult.mInscatterM[c][lane]);
+	}
+}
+
+} // namespace detail
+
+} // namespace atmosphere
@@ -0,0 +1,292 @@
+#include "SkyRadianceBatch.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace atmosphere {
+
+namespace detail {
+
+static bool IsCompiledIn(SimdInstructionSet inInstructionSet)
+{
+	switch (inInstructionSet)
+	{
+	case SimdInstructionSet::AVX2:		return IsSkyRadianceBatchAVX2CompiledIn();
+	case SimdInstructionSet::AVX512:	return IsSkyRadianceBatchAVX512CompiledIn();
+	default:							return true;
+	}
+}
+
+static SkyRadianceKernelArgs GetKernelArgs(const SkyRadianceTables& inTables)
+{
+	const PrecomputedSctrParams& params = inTables.mParams;
+	SkyRadianceKernelArgs args;
+	SingleScatteringKernelArgs& atmosphere = args.mAtmosphere;
+	for (int c = 0; c < 3; ++c)
+	{
+		atmosphere.mRayleighSctrCoeff[c] = params.mRayleighSctrCoeff[c];
+		atmosphere.mMieSctrCoeff[c] = params.mMieSctrCoeff[c];
+		atmosphere.mMieExtinctionCoeff[c] = params.mMieSctrCoeff[c] * params.mMieAbsorption;
+		atmosphere.mEarthCenter[c] = EarthCenter()[c];
+		args.mRayleighRatio[c] = params.mRayleighSctrCoeff.x / params.mRayleighSctrCoeff[c];
+		args.mSunIlluminance[c] = inTables.mSunIlluminance[c];
+	}
+	atmosphere.mRayleighScaleHeight = params.mRayleighScaleHeight;
+	atmosphere.mMieScaleHeight = params.mMieScaleHeight;
+	atmosphere.mEarthRadius = EARTH_RADIUS;
+	atmosphere.mAtmosphereTopHeight = ATM_TOP_HEIGHT;
+	atmosphere.mAnalyticOpticalDepth = (inTables.mOpticalDepthMode == OpticalDepthMode::Analytic) ? 1 : 0;
+	atmosphere.mOpticalDepth = inTables.mOpticalDepth.IsValid() ? &inTables.mOpticalDepth.GetData()->x : nullptr;
+	atmosphere.mOpticalDepthWidth = std::int32_t(inTables.mOpticalDepth.GetWidth());
+	atmosphere.mOpticalDepthHeight = std::int32_t(inTables.mOpticalDepth.GetHeight());
+
+	args.mPackedInscatter = &inTables.mPackedInscatter.GetData()->x;
+	args.mLUTResolution[0] = std::int32_t(inTables.mPackedInscatter.GetWidth());
+	args.mLUTResolution[1] = std::int32_t(inTables.mPackedInscatter.GetHeight());
+	args.mLUTResolution[2] = std::int32_t(inTables.mPackedInscatter.GetDepth());
+	args.mMieAsymmetry = inTables.mMieAsymmetry;
+	args.mAtmosphereTopRadius = ATM_TOP_RADIUS;
+	args.mLUTHeightMargin = float(LUT_HEIGHT_MARGIN);
+	args.mLUTHeightRange = float(ATM_TOP_HEIGHT - 2.0 * LUT_HEIGHT_MARGIN);
+	args.mTanLightZenithScale = std::tan(1.26f * 1.1f);
+	return args;
+}
+
+static SkyIrradianceKernelArgs GetKernelArgs(const SkyIrradianceTables& inTables)
+{
+	SkyIrradianceKernelArgs args;
+	args.mIrradiance = &inTables.mIrradiance.GetData()->x;
+	args.mLUTResolution[0] = std::int32_t(inTables.mIrradiance.GetWidth());
+	args.mLUTResolution[1] = std::int32_t(inTables.mIrradiance.GetHeight());
+	for (int c = 0; c < 3; ++c)
+	{
+		args.mSunIlluminance[c] = inTables.mSunIlluminance[c];
+		args.mEarthCenter[c] = EarthCenter()[c];
+	}
+	args.mEarthRadius = EARTH_RADIUS;
+	args.mAtmosphereTopHeight = ATM_TOP_HEIGHT;
+	args.mLUTHeightMargin = float(LUT_HEIGHT_MARGIN);
+	args.mLUTHeightRange = float(ATM_TOP_HEIGHT - 2.0 * LUT_HEIGHT_MARGIN);
+	args.mTanLightZenithScale = std::tan(1.26f * 1.1f);
+	return args;
+}
+
+} // namespace detail
+
+void SkyRadiance(
+	const SkyRadianceTables& inTables,
+	const math::Float3& inPosition,
+	const math::Float3& inViewDir,
+	const math::Float3& inLightDir,
+	math::Float3& outRadiance,
+	math::Float3& outTransmittance)
+{
+	outRadiance = math::Float3(0.0f);
+	outTransmittance = math::Float3(1.0f);
+
+	// Same as AtmosphericScatteringPS.hlsl, relative to the earth center
+	const math::Float3 pos = inPosition - EarthCenter();
+	const math::Float4 distances = RayDoubleSphereIntersect(pos, inViewDir, math::Float2(EARTH_RADIUS, ATM_TOP_RADIUS));
+	if (!(distances.w > 0.0f))
+		return;
+	const math::Float3 start = (distances.z > 0.0f) ? pos + inViewDir * distances.z : pos;
+
+	const PrecomputedSctrParams& params = inTables.mParams;
+	math::Float3 inscatter_r, inscatter_m;
+	LookUpPrecomputedScatteringPacked(start + EarthCenter(), inViewDir, inLightDir, params.mRayleighSctrCoeff, inTables.mPackedInscatter, inscatter_r, inscatter_m);
+	const float mu = math::InnerProduct(inViewDir, inLightDir);
+	outRadiance = inTables.mSunIlluminance * (inscatter_r * RayleighPhase(mu) + inscatter_m * MiePhase(mu, inTables.mMieAsymmetry));
+
+	// Up to the top : optical depth from the start. Up to the ground : from the ground point back toward the start,
+	// minus from the start in the same direction.
+	const math::Float2 scale_heights(params.mRayleighScaleHeight, params.mMieScaleHeight);
+	const float dist = math::L2Norm(start);
+	const float height = dist - EARTH_RADIUS;
+	const float cos_view_zenith = math::InnerProduct(start, inViewDir) / dist;
+	math::Float2 optical_depth = GetOpticalDepthToTop(height, cos_view_zenith, scale_heights, inTables.mOpticalDepthMode, inTables.mOpticalDepth);
+	if (distances.x > 0.0f)
+	{
+		const math::Float3 ground = pos + inViewDir * distances.x;
+		const float ground_dist = math::L2Norm(ground);
+		const math::Float2 from_ground = GetOpticalDepthToTop(std::max(ground_dist - EARTH_RADIUS, 0.0f), -math::InnerProduct(ground, inViewDir) / ground_dist, scale_heights, inTables.mOpticalDepthMode, inTables.mOpticalDepth);
+		const math::Float2 back = GetOpticalDepthToTop(height, -cos_view_zenith, scale_heights, inTables.mOpticalDepthMode, inTables.mOpticalDepth);
+		optical_depth = math::Float2(std::max(from_ground.x - back.x, 0.0f), std::max(from_ground.y - back.y, 0.0f));
+	}
+	outTransmittance = Exp(-(params.mRayleighSctrCoeff * optical_depth.x + params.mMieSctrCoeff * (params.mMieAbsorption * optical_depth.y)));
+}
+
+void SkyRadianceBatch(
+	SimdInstructionSet inInstructionSet,
+	const SkyRadianceTables& inTables,
+	const SkyRadianceQueries& inQueries,
+	const SkyRadianceResults& outResults)
+{
+	const bool has_transmittance = outResults.mTransmittance[0] != nullptr;
+	SimdInstructionSet instruction_set = ResolveSimdInstructionSet(inInstructionSet);
+	if (!detail::IsCompiledIn(instruction_set))
+		instruction_set = SimdInstructionSet::Scalar;
+
+	if (instruction_set == SimdInstructionSet::Scalar)
+	{
+		for (size_t i = 0; i < inQueries.mNumQueries; ++i)
+		{
+			const math::Float3 pos(inQueries.mPosition[0][i], inQueries.mPosition[1][i], inQueries.mPosition[2][i]);
+			const math::Float3 view_dir(inQueries.mViewDir[0][i], inQueries.mViewDir[1][i], inQueries.mViewDir[2][i]);
+			const math::Float3 light_dir(inQueries.mLightDir[0][i], inQueries.mLightDir[1][i], inQueries.mLightDir[2][i]);
+			math::Float3 radiance, transmittance;
+			SkyRadiance(inTables, pos, view_dir, light_dir, radiance, transmittance);
+			for (int c = 0; c < 3; ++c)
+			{
+				outResults.mRadiance[c][i] = radiance[c];
+				if (has_transmittance)
+					outResults.mTransmittance[c][i] = transmittance[c];
+			}
+		}
+		return;
+	}
+
+	// Gather offsets are computed in float, texel indices must be exact
+	assert(inTables.mPackedInscatter.GetNumTexels() <= (size_t(1) << 24));
+	assert(inTables.mOpticalDepthMode == OpticalDepthMode::Analytic || inTables.mOpticalDepth.GetNumTexels() <= (size_t(1) << 24));
+	const detail::SkyRadianceKernelArgs args = detail::GetKernelArgs(inTables);
+	auto run_kernel = [&](const SkyRadianceQueries& inPacketQueries, const SkyRadianceResults& outPacketResults)
+	{
+		if (instruction_set == SimdInstructionSet::AVX512)
+			detail::SkyRadianceBatchAVX512(args, inPacketQueries, outPacketResults);
+		else
+			detail::SkyRadianceBatchAVX2(args, inPacketQueries, outPacketResults);
+	};
+
+	// Whole packets in place
+	SkyRadianceQueries queries = inQueries;
+	queries.mNumQueries = inQueries.mNumQueries - inQueries.mNumQueries % PACKET_MAX_RAYS;
+	if (queries.mNumQueries > 0)
+		run_kernel(queries, outResults);
+
+	// The remainder through a packet padded with its last query
+	const size_t num_remaining = inQueries.mNumQueries - queries.mNumQueries;
+	if (num_remaining == 0)
+		return;
+
+	alignas(64) float input[3][3][PACKET_MAX_RAYS];
+	alignas(64) float output[2][3][PACKET_MAX_RAYS];
+	SkyRadianceQueries packet_queries;
+	SkyRadianceResults packet_results;
+	packet_queries.mNumQueries = PACKET_MAX_RAYS;
+	for (int c = 0; c < 3; ++c)
+	{
+		const float* sources[3] = { inQueries.mPosition[c], inQueries.mViewDir[c], inQueries.mLightDir[c] };
+		for (int k = 0; k < 3; ++k)
+		{
+			for (size_t i = 0; i < PACKET_MAX_RAYS; ++i)
+				input[k][c][i] = sources[k][queries.mNumQueries + std::min(i, num_remaining - 1)];
+		}
+		packet_queries.mPosition[c] = input[0][c];
+		packet_queries.mViewDir[c] = input[1][c];
+		packet_queries.mLightDir[c] = input[2][c];
+		packet_results.mRadiance[c] = output[0][c];
+		packet_results.mTransmittance[c] = has_transmittance ? output[1][c] : nullptr;
+	}
+	run_kernel(packet_queries, packet_results);
+
+	for (int c = 0; c < 3; ++c)
+	{
+		std::copy(output[0][c], output[0][c] + num_remaining, outResults.mRadiance[c] + queries.mNumQueries);
+		if (has_transmittance)
+			std::copy(output[1][c], output[1][c] + num_remaining, outResults.mTransmittance[c] + queries.mNumQueries);
+	}
+}
+
+math::Float3 SkyIrradiance(
+	const SkyIrradianceTables& inTables,
+	const math::Float3& inPosition,
+	const math::Float3& inLightDir)
+{
+	const math::Float3 up = math::L2Normalize(inPosition - EarthCenter());
+	return SkyIrradiance(inTables, inPosition, up, inLightDir);
+}
+
+math::Float3 SkyIrradiance(
+	const SkyIrradianceTables& inTables,
+	const math::Float3& inPosition,
+	const math::Float3& inNormal,
+	const math::Float3& inLightDir)
+{
+	const math::Float3 pos = inPosition - EarthCenter();
+	const float dist = math::L2Norm(pos);
+	const math::Float3 up = pos * (1.0f / dist);
+	const math::Float2 uv = WorldCoordToSunlightLUTCoord(dist - EARTH_RADIUS, math::InnerProduct(up, inLightDir), LUTResolution(inTables.mIrradiance));
+	const math::Float4 irradiance = inTables.mIrradiance.Sample(uv);
+	const float visibility = Saturate(0.5f + 0.5f * math::InnerProduct(inNormal, up));
+	return inTables.mSunIlluminance * math::Float3(irradiance.x, irradiance.y, irradiance.z) * visibility;
+}
+
+void SkyIrradianceBatch(
+	SimdInstructionSet inInstructionSet,
+	const SkyIrradianceTables& inTables,
+	const SkyIrradianceQueries& inQueries,
+	float* const outIrradiance[3])
+{
+	const bool has_normal = inQueries.mNormal[0] != nullptr;
+	SimdInstructionSet instruction_set = ResolveSimdInstructionSet(inInstructionSet);
+	if (!detail::IsCompiledIn(instruction_set))
+		instruction_set = SimdInstructionSet::Scalar;
+
+	if (instruction_set == SimdInstructionSet::Scalar)
+	{
+		for (size_t i = 0; i < inQueries.mNumQueries; ++i)
+		{
+			const math::Float3 pos(inQueries.mPosition[0][i], inQueries.mPosition[1][i], inQueries.mPosition[2][i]);
+			const math::Float3 light_dir(inQueries.mLightDir[0][i], inQueries.mLightDir[1][i], inQueries.mLightDir[2][i]);
+			const math::Float3 irradiance = has_normal
+				? SkyIrradiance(inTables, pos, math::Float3(inQueries.mNormal[0][i], inQueries.mNormal[1][i], inQueries.mNormal[2][i]), light_dir)
+				: SkyIrradiance(inTables, pos, light_dir);
+			for (int c = 0; c < 3; ++c)
+				outIrradiance[c][i] = irradiance[c];
+		}
+		return;
+	}
+
+	assert(inTables.mIrradiance.GetNumTexels() <= (size_t(1) << 24));
+	const detail::SkyIrradianceKernelArgs args = detail::GetKernelArgs(inTables);
+	auto run_kernel = [&](const SkyIrradianceQueries& inPacketQueries, float* const outPacketIrradiance[3])
+	{
+		if (instruction_set == SimdInstructionSet::AVX512)
+			detail::SkyIrradianceBatchAVX512(args, inPacketQueries, outPacketIrradiance);
+		else
+			detail::SkyIrradianceBatchAVX2(args, inPacketQueries, outPacketIrradiance);
+	};
+
+	SkyIrradianceQueries queries = inQueries;
+	queries.mNumQueries = inQueries.mNumQueries - inQueries.mNumQueries % PACKET_MAX_RAYS;
+	if (queries.mNumQueries > 0)
+		run_kernel(queries, outIrradiance);
+
+	const size_t num_remaining = inQueries.mNumQueries - queries.mNumQueries;
+	if (num_remaining == 0)
+		return;
+
+	alignas(64) float input[3][3][PACKET_MAX_RAYS];
+	alignas(64) float output[3][PACKET_MAX_RAYS];
+	SkyIrradianceQueries packet_queries;
+	float* packet_irradiance[3];
+	packet_queries.mNumQueries = PACKET_MAX_RAYS;
+	for (int c = 0; c < 3; ++c)
+	{
+		const float* sources[3] = { inQueries.mPosition[c], inQueries.mNormal[c], inQueries.mLightDir[c] };
+		for (int k = 0; k < 3; ++k)
+		{
+			for (size_t i = 0; i < PACKET_MAX_RAYS && sources[k]; ++i)
+				input[k][c][i] = sources[k][queries.mNumQueries + std::min(i, num_remaining - 1)];
+		}
+		packet_queries.mPosition[c] = input[0][c];
+		packet_queries.mNormal[c] = has_normal ? input[1][c] : nullptr;
+		packet_queries.mLightDir[c] = input[2][c];
+		packet_irradiance[c] = output[c];
+	}
+	run_kernel(packet_queries, packet_irradiance);
+
+	for (int c = 0; c < 3; ++c)
+		std::copy(output[c], output[c] + num_remaining, outIrradiance[c] + queries.mNumQueries);
+}
+
+} // namespace atmosphere
@@ -0,0 +1,75 @@
+#pragma once
+#include <src/lib/math/Math.hpp>
+#include <shader/atmosphere/AtmosphereConstants.h>
+#include "AtmosphereExport.hpp"
+#include "AtmosphericScattering.hpp"
+#include "LookUpTable.hpp"
+#include "SingleScatteringPacket.hpp"
+#include "SkyRadianceBatchKernel.hpp"
+
+namespace atmosphere {
+
+//------------------------------------------------------
+//	Sky radiance queries on CPU
+//		- AtmosphericScatteringPS.hlsl for arbitrary (position, view direction, sun direction) tuples, e.g. for lighting
+//		  bakes or gameplay code : packed inscatter LUT, UnpackMieInscatter() and the phase functions.
+//		  The ground is not shaded, only the inscatter in front of it.
+//		- SkyRadianceBatch() takes structure-of-arrays queries, one query per SIMD lane with AVX2/AVX-512
+//		- Scalar evaluates SkyRadiance() query by query. The SIMD paths match it to ~1e-3 relative error, a little more
+//		  for the transmittance of rays grazing the ground where the ray - sphere intersection is ill-conditioned in float
+//		- SkyIrradiance() is the skylight on a surface : bilinear fetch of the irradiance table, scaled by the part of the
+//		  sky the normal sees, (1 + dot(normal, up)) / 2. The direct sunlight is not included.
+//------------------------------------------------------
+
+// The tables and the parameters the queries read. The views are not owned.
+struct SkyRadianceTables
+{
+	LookUpTableView3D<math::Float4>	mPackedInscatter;	// CpuPrecomputedAtmosphericScattering::GetPackedTotalInscatterTexture()
+	LookUpTableView2D<math::Float2>	mOpticalDepth;		// transmittance, not read with OpticalDepthMode::Analytic
+	OpticalDepthMode		mOpticalDepthMode = OpticalDepthMode::Table;
+	PrecomputedSctrParams	mParams;					// in the units of the kernels, CpuPrecomputedAtmosphericScattering::GetKernelParameters()
+	float					mMieAsymmetry = 0.76f;
+	math::Float3			mSunIlluminance = math::Float3(1e5f);	// extraterrestrial sunlight of AtmosphericScatteringPS.hlsl
+};
+
+struct SkyIrradianceTables
+{
+	LookUpTableView2D<math::Float4>	mIrradiance;		// CpuPrecomputedAtmosphericScattering::GetIrradianceTexture()
+	math::Float3			mSunIlluminance = math::Float3(1e5f);
+};
+
+// One query, the reference of SkyRadianceBatch()
+ATMOSPHERE_EXPORT void SkyRadiance(
+	const SkyRadianceTables& inTables,
+	const math::Float3& inPosition,
+	const math::Float3& inViewDir,
+	const math::Float3& inLightDir,
+	math::Float3& outRadiance,
+	math::Float3& outTransmittance);
+
+// outResults.[i] = SkyRadiance(inQueries.[i]) for i < inQueries.mNumQueries
+ATMOSPHERE_EXPORT void SkyRadianceBatch(
+	SimdInstructionSet inInstructionSet,
+	const SkyRadianceTables& inTables,
+	const SkyRadianceQueries& inQueries,
+	const SkyRadianceResults& outResults);
+
+// Surface facing up, and facing inNormal
+ATMOSPHERE_EXPORT math::Float3 SkyIrradiance(
+	const SkyIrradianceTables& inTables,
+	const math::Float3& inPosition,
+	const math::Float3& inLightDir);
+ATMOSPHERE_EXPORT math::Float3 SkyIrradiance(
+	const SkyIrradianceTables& inTables,
+	const math::Float3& inPosition,
+	const math::Float3& inNormal,
+	const math::Float3& inLightDir);
+
+// outIrradiance[c][i] = SkyIrradiance(inQueries.[i]).c for i < inQueries.mNumQueries
+ATMOSPHERE_EXPORT void SkyIrradianceBatch(
+	SimdInstructionSet inInstructionSet,
+	const SkyIrradianceTables& inTables,
+	const SkyIrradianceQueries& inQueries,
+	float* const outIrradiance[3]);
+
+} // namespace atmosphere
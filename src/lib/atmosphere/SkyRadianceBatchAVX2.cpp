@@ -0,0 +1,54 @@
+//------------------------------------------------------
+//	AVX2 + FMA instantiation of the SkyRadiance and SkyIrradiance packet kernels (8 queries per instruction)
+//		- Compiled with /arch:AVX2 (-mavx2 -mfma), see CMakeLists.txt
+//------------------------------------------------------
+#include "SkyRadianceBatchKernel.hpp"
+#include "SimdFloatAVX2.hpp"
+
+#if defined(__AVX2__)
+
+namespace atmosphere {
+namespace detail {
+
+bool IsSkyRadianceBatchAVX2CompiledIn()
+{
+	return true;
+}
+
+void SkyRadianceBatchAVX2(const SkyRadianceKernelArgs& inArgs, const SkyRadianceQueries& inQueries, const SkyRadianceResults& outResults)
+{
+	for (size_t first = 0; first < inQueries.mNumQueries; first += Avx2Float::WIDTH)
+		SkyRadiancePacketT<Avx2Float>(inArgs, inQueries, first, outResults);
+}
+
+void SkyIrradianceBatchAVX2(const SkyIrradianceKernelArgs& inArgs, const SkyIrradianceQueries& inQueries, float* const outIrradiance[3])
+{
+	for (size_t first = 0; first < inQueries.mNumQueries; first += Avx2Float::WIDTH)
+		SkyIrradiancePacketT<Avx2Float>(inArgs, inQueries, first, outIrradiance);
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#else
+
+namespace atmosphere {
+namespace detail {
+
+bool IsSkyRadianceBatchAVX2CompiledIn()
+{
+	return false;
+}
+
+void SkyRadianceBatchAVX2(const SkyRadianceKernelArgs&, const SkyRadianceQueries&, const SkyRadianceResults&)
+{
+}
+
+void SkyIrradianceBatchAVX2(const SkyIrradianceKernelArgs&, const SkyIrradianceQueries&, float* const[3])
+{
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#endif
@@ -0,0 +1,54 @@
+//------------------------------------------------------
+//	AVX-512F instantiation of the SkyRadiance and SkyIrradiance packet kernels (16 queries per instruction)
+//		- Compiled with /arch:AVX512 (-mavx512f), see CMakeLists.txt
+//------------------------------------------------------
+#include "SkyRadianceBatchKernel.hpp"
+#include "SimdFloatAVX512.hpp"
+
+#if defined(__AVX512F__)
+
+namespace atmosphere {
+namespace detail {
+
+bool IsSkyRadianceBatchAVX512CompiledIn()
+{
+	return true;
+}
+
+void SkyRadianceBatchAVX512(const SkyRadianceKernelArgs& inArgs, const SkyRadianceQueries& inQueries, const SkyRadianceResults& outResults)
+{
+	for (size_t first = 0; first < inQueries.mNumQueries; first += Avx512Float::WIDTH)
+		SkyRadiancePacketT<Avx512Float>(inArgs, inQueries, first, outResults);
+}
+
+void SkyIrradianceBatchAVX512(const SkyIrradianceKernelArgs& inArgs, const SkyIrradianceQueries& inQueries, float* const outIrradiance[3])
+{
+	for (size_t first = 0; first < inQueries.mNumQueries; first += Avx512Float::WIDTH)
+		SkyIrradiancePacketT<Avx512Float>(inArgs, inQueries, first, outIrradiance);
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#else
+
+namespace atmosphere {
+namespace detail {
+
+bool IsSkyRadianceBatchAVX512CompiledIn()
+{
+	return false;
+}
+
+void SkyRadianceBatchAVX512(const SkyRadianceKernelArgs&, const SkyRadianceQueries&, const SkyRadianceResults&)
+{
+}
+
+void SkyIrradianceBatchAVX512(const SkyIrradianceKernelArgs&, const SkyIrradianceQueries&, float* const[3])
+{
+}
+
+} // namespace detail
+} // namespace atmosphere
+
+#endif
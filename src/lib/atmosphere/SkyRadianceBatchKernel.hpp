@@ -0,0 +1,315 @@
+#pragma once
+//------------------------------------------------------
+//	Packet kernels of SkyRadiance() and SkyIrradiance()
+//		- Evaluates one query per SIMD lane : LUT coordinate, trilinear fetch of the packed inscatter, phase functions
+//		  and the transmittance of the view ray. Bilinear fetch of the irradiance table.
+//		- Same restrictions as SingleScatteringPacketKernel.hpp, this header is included by the translation units
+//		  compiled with /arch:AVX2, /arch:AVX512 (-mavx2, -mavx512f). Only plain types here.
+//------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include "SingleScatteringPacketKernel.hpp"
+
+namespace atmosphere {
+
+// Structure-of-arrays queries in the world space of the renderer, i.e. the ground is at y = 0 below the origin
+// (EARTH_CENTER). The directions are normalized.
+struct SkyRadianceQueries
+{
+	size_t			mNumQueries = 0;
+	const float*	mPosition[3] = {};		// [km]
+	const float*	mViewDir[3] = {};
+	const float*	mLightDir[3] = {};		// toward the sun
+};
+
+struct SkyRadianceResults
+{
+	float*	mRadiance[3] = {};			// sunlight scattered toward the position along -view dir
+	float*	mTransmittance[3] = {};		// along the view ray, up to the ground or the top of the atmosphere. null = skipped
+};
+
+struct SkyIrradianceQueries
+{
+	size_t			mNumQueries = 0;
+	const float*	mPosition[3] = {};		// [km]
+	const float*	mNormal[3] = {};		// of the lit surface, null = facing up
+	const float*	mLightDir[3] = {};		// toward the sun
+};
+
+namespace detail {
+
+struct SkyRadianceKernelArgs
+{
+	SingleScatteringKernelArgs	mAtmosphere;	// coefficients, scale heights and optical depth of the transmittance
+
+	const float*	mPackedInscatter;		// R32G32B32A32 texels, x + width * (y + height * z)
+	std::int32_t	mLUTResolution[3];
+	float			mRayleighRatio[3];		// beta_r.x / beta_r of UnpackMieInscatter()
+	float			mMieAsymmetry;
+	float			mSunIlluminance[3];
+	float			mAtmosphereTopRadius;
+	float			mLUTHeightMargin;
+	float			mLUTHeightRange;		// ATM_TOP_HEIGHT - 2 * LUT_HEIGHT_MARGIN
+	float			mTanLightZenithScale;	// tan(1.26 * 1.1) of WorldCoordToLUTCoord()
+};
+
+struct SkyIrradianceKernelArgs
+{
+	const float*	mIrradiance;			// R32G32B32A32 texels, x + width * y
+	std::int32_t	mLUTResolution[2];
+	float			mSunIlluminance[3];
+	float			mEarthCenter[3];
+	float			mEarthRadius;
+	float			mAtmosphereTopHeight;
+	float			mLUTHeightMargin;
+	float			mLUTHeightRange;		// ATM_TOP_HEIGHT - 2 * LUT_HEIGHT_MARGIN
+	float			mTanLightZenithScale;	// tan(1.26 * 1.1) of WorldCoordToSunlightLUTCoord()
+};
+
+// Implemented in SkyRadianceBatchAVX2.cpp / SkyRadianceBatchAVX512.cpp, inQueries.mNumQueries is a multiple of PACKET_MAX_RAYS
+bool IsSkyRadianceBatchAVX2CompiledIn();
+bool IsSkyRadianceBatchAVX512CompiledIn();
+void SkyRadianceBatchAVX2(const SkyRadianceKernelArgs& inArgs, const SkyRadianceQueries& inQueries, const SkyRadianceResults& outResults);
+void SkyRadianceBatchAVX512(const SkyRadianceKernelArgs& inArgs, const SkyRadianceQueries& inQueries, const SkyRadianceResults& outResults);
+void SkyIrradianceBatchAVX2(const SkyIrradianceKernelArgs& inArgs, const SkyIrradianceQueries& inQueries, float* const outIrradiance[3]);
+void SkyIrradianceBatchAVX512(const SkyIrradianceKernelArgs& inArgs, const SkyIrradianceQueries& inQueries, float* const outIrradiance[3]);
+
+//------------------------------------------------------
+//	Generic part of the kernel, P provides the operations of SingleScatteringPacketT() and GatherFloat4()
+//------------------------------------------------------
+
+// atan(x) with the range reduction and polynomial of cephes atanf, ~2 ulp
+template<typename P> P AtanPacket(const P& x)
+{
+	const P abs_x = Max(x, P(0.0f) - x);
+	const typename P::Mask large = Less(P(2.414213562373095f), abs_x);
+	const typename P::Mask medium = Less(P(0.4142135623730950f), abs_x);
+
+	P y = Select(large, P(1.5707963267948966f), Select(medium, P(0.7853981633974483f), P(0.0f)));
+	P r = Select(large, P(-1.0f) / abs_x, Select(medium, (abs_x - P(1.0f)) / (abs_x + P(1.0f)), abs_x));
+
+	const P z = r * r;
+	P p = P(8.05374449538e-2f);
+	p = FMA(p, z, P(-1.38776856032e-1f));
+	p = FMA(p, z, P(1.99777106478e-1f));
+	p = FMA(p, z, P(-3.33329491539e-1f));
+	y = y + FMA(p * z, r, r);
+
+	return Select(Less(x, P(0.0f)), P(0.0f) - y, y);
+}
+
+// Same as WorldCoordToLUTCoord()
+template<typename P> void WorldCoordToLUTCoordPacket(const SkyRadianceKernelArgs& inArgs, const P& inHeight, const P& inCosViewZenith, const P& inCosLightZenith, P outUVW[3])
+{
+	const P res_u(float(inArgs.mLUTResolution[0]));
+	const P res_v(float(inArgs.mLUTResolution[1]));
+	const P res_w(float(inArgs.mLUTResolution[2]));
+	const P earth_radius(inArgs.mAtmosphere.mEarthRadius);
+	const P margin(inArgs.mLUTHeightMargin);
+
+	const P height = Min(Max(inHeight, margin), P(inArgs.mAtmosphere.mAtmosphereTopHeight - inArgs.mLUTHeightMargin));
+	const P w = Sqrt(Min(Max((height - margin) / P(inArgs.mLUTHeightRange), P(0.0f)), P(1.0f)));
+
+	// ZenithAngle2TexCoord()
+	const P cos_horizon = P(0.0f) - Sqrt(height * (P(2.0f) * earth_radius + height)) / (earth_radius + height);
+	const typename P::Mask upper = Less(cos_horizon, inCosViewZenith);
+	const P t_upper = (inCosViewZenith - cos_horizon) / (P(1.0f) - cos_horizon);
+	const P t_lower = (cos_horizon - inCosViewZenith) / (cos_horizon + P(1.0f));
+	const P t = Sqrt(Sqrt(Min(Max(Select(upper, t_upper, t_lower), P(0.0f)), P(1.0f))));
+	const P offset = Select(upper, P(0.5f), P(0.0f));
+	outUVW[1] = offset + P(0.5f) / res_v + t * (res_v * P(0.5f) - P(1.0f)) / res_v;
+
+	// Bruneton's formula [Bruneton09]
+	const P u = (AtanPacket(Max(inCosLightZenith, P(-0.1975f)) * P(inArgs.mTanLightZenithScale)) / P(1.1f) + P(1.0f - 0.26f)) * P(0.5f);
+	outUVW[0] = FMA(u, res_u - P(1.0f), P(0.5f)) / res_u;
+	outUVW[2] = FMA(w, res_w - P(1.0f), P(0.5f)) / res_w;
+}
+
+// Same as LookUpTableView3D::Sample() (linear filter, clamp addressing)
+template<typename P> void SamplePackedInscatterPacket(const SkyRadianceKernelArgs& inArgs, const P inUVW[3], P outTexel[4])
+{
+	P i0[3], i1[3], t[3];
+	for (int d = 0; d < 3; ++d)
+	{
+		const P resolution(float(inArgs.mLUTResolution[d]));
+		const P last(float(inArgs.mLUTResolution[d] - 1));
+		const P texel = inUVW[d] * resolution - P(0.5f);
+		const P texel_floor = Floor(texel);
+		t[d] = texel - texel_floor;
+		// Max(value, 0) comes first so that NaN is flushed to 0 and the gathers stay inside the table
+		i0[d] = Min(Max(texel_floor, P(0.0f)), last);
+		i1[d] = Min(Max(texel_floor + P(1.0f), P(0.0f)), last);
+	}
+
+	const P width(float(inArgs.mLUTResolution[0]));
+	const P height(float(inArgs.mLUTResolution[1]));
+	P plane[2][4];
+	for (int z = 0; z < 2; ++z)
+	{
+		P row[2][4];
+		for (int y = 0; y < 2; ++y)
+		{
+			const P row_index = FMA(z ? i1[2] : i0[2], height, y ? i1[1] : i0[1]) * width;
+			P c0[4], c1[4];
+			GatherFloat4(inArgs.mPackedInscatter, row_index + i0[0], c0);
+			GatherFloat4(inArgs.mPackedInscatter, row_index + i1[0], c1);
+			for (int c = 0; c < 4; ++c)
+				row[y][c] = FMA(c1[c] - c0[c], t[0], c0[c]);
+		}
+		for (int c = 0; c < 4; ++c)
+			plane[z][c] = FMA(row[1][c] - row[0][c], t[1], row[0][c]);
+	}
+	for (int c = 0; c < 4; ++c)
+		outTexel[c] = FMA(plane[1][c] - plane[0][c], t[2], plane[0][c]);
+}
+
+// Optical depth to the top of the atmosphere, table or closed form (GetOpticalDepthToTop())
+template<typename P> void OpticalDepthToTopPacket(const SingleScatteringKernelArgs& inArgs, const P& inHeight, const P& inCosZenith, P& outX, P& outY)
+{
+	if (inArgs.mAnalyticOpticalDepth)
+		AnalyticOpticalDepthToTopPacket(inArgs, inHeight, inCosZenith, outX, outY);
+	else
+		SampleOpticalDepthPacket(inArgs, inHeight * P(1.0f / inArgs.mAtmosphereTopHeight), FMA(inCosZenith, P(0.5f), P(0.5f)), outX, outY);
+}
+
+// SkyRadiance() for the queries [inFirst, inFirst + P::WIDTH)
+template<typename P> void SkyRadiancePacketT(const SkyRadianceKernelArgs& inArgs, const SkyRadianceQueries& inQueries, size_t inFirst, const SkyRadianceResults& outResults)
+{
+	const SingleScatteringKernelArgs& atmosphere = inArgs.mAtmosphere;
+	const P earth_radius(atmosphere.mEarthRadius);
+
+	P pos[3], view[3], light[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		// Relative to the earth center
+		pos[c] = P::Load(inQueries.mPosition[c] + inFirst) - P(atmosphere.mEarthCenter[c]);
+		view[c] = P::Load(inQueries.mViewDir[c] + inFirst);
+		light[c] = P::Load(inQueries.mLightDir[c] + inFirst);
+	}
+
+	// RayDoubleSphereIntersect() with a normalized direction
+	const P b = P(2.0f) * FMA(pos[0], view[0], FMA(pos[1], view[1], pos[2] * view[2]));
+	const P origin2 = FMA(pos[0], pos[0], FMA(pos[1], pos[1], pos[2] * pos[2]));
+	const P d_top = b * b - P(4.0f) * (origin2 - P(inArgs.mAtmosphereTopRadius * inArgs.mAtmosphereTopRadius));
+	const P d_earth = b * b - P(4.0f) * (origin2 - earth_radius * earth_radius);
+	const P sqrt_d_top = Sqrt(Max(d_top, P(0.0f)));
+	const P near_top = (P(0.0f) - b - sqrt_d_top) * P(0.5f);
+	const P far_top = Select(Less(d_top, P(0.0f)), P(-1.0f), (sqrt_d_top - b) * P(0.5f));
+	const P near_earth = Select(Less(d_earth, P(0.0f)), P(-1.0f), (P(0.0f) - b - Sqrt(Max(d_earth, P(0.0f)))) * P(0.5f));
+	const typename P::Mask in_atmosphere = Less(P(0.0f), far_top);
+	const typename P::Mask hits_ground = Less(P(0.0f), near_earth);
+
+	// A position above the atmosphere starts at the top
+	const P start_distance = Max(near_top, P(0.0f));
+	P start[3];
+	for (int c = 0; c < 3; ++c)
+		start[c] = FMA(view[c], start_distance, pos[c]);
+	const P dist = Sqrt(FMA(start[0], start[0], FMA(start[1], start[1], start[2] * start[2])));
+	const P inv_dist = P(1.0f) / dist;
+	const P height = dist - earth_radius;
+	const P cos_view_zenith = FMA(start[0], view[0], FMA(start[1], view[1], start[2] * view[2])) * inv_dist;
+	const P cos_light_zenith = FMA(start[0], light[0], FMA(start[1], light[1], start[2] * light[2])) * inv_dist;
+
+	P uvw[3], packed[4];
+	WorldCoordToLUTCoordPacket(inArgs, height, cos_view_zenith, cos_light_zenith, uvw);
+	SamplePackedInscatterPacket(inArgs, uvw, packed);
+
+	// UnpackMieInscatter(), phase functions
+	const P mie_scale = packed[3] / Max(packed[0], P(1e-9f));
+	const P mu = FMA(view[0], light[0], FMA(view[1], light[1], view[2] * light[2]));
+	const P one_plus_mu2 = FMA(mu, mu, P(1.0f));
+	const float g = inArgs.mMieAsymmetry;
+	const P phase_r = P(3.0f / 4.0f * 1.0f / (4.0f * 3.14159265358979f)) * one_plus_mu2;
+	const P denom = Max(FMA(P(-2.0f * g), mu, P(1.0f + g * g)), P(0.0f) - FMA(P(-2.0f * g), mu, P(1.0f + g * g)));
+	const P phase_m = P((3.0f / 2.0f) / (4.0f * 3.14159265358979f) * (1.0f - g * g) / (2.0f + g * g)) * one_plus_mu2 / (denom * Sqrt(denom));
+	for (int c = 0; c < 3; ++c)
+	{
+		const P inscatter_m = packed[c] * mie_scale * P(inArgs.mRayleighRatio[c]);
+		const P radiance = P(inArgs.mSunIlluminance[c]) * FMA(packed[c], phase_r, inscatter_m * phase_m);
+		Store(Select(in_atmosphere, radiance, P(0.0f)), outResults.mRadiance[c] + inFirst);
+	}
+
+	if (!outResults.mTransmittance[0])
+		return;
+
+	// Up to the top : optical depth from the start. Up to the ground : from the ground point back toward the start,
+	// minus from the start in the same direction.
+	P ground[3];
+	for (int c = 0; c < 3; ++c)
+		ground[c] = FMA(view[c], near_earth, pos[c]);
+	const P ground_dist = Sqrt(FMA(ground[0], ground[0], FMA(ground[1], ground[1], ground[2] * ground[2])));
+	const P cos_ground_zenith = P(0.0f) - FMA(ground[0], view[0], FMA(ground[1], view[1], ground[2] * view[2])) / ground_dist;
+
+	P to_top_r, to_top_m, from_ground_r, from_ground_m, back_r, back_m;
+	OpticalDepthToTopPacket(atmosphere, height, cos_view_zenith, to_top_r, to_top_m);
+	OpticalDepthToTopPacket(atmosphere, Max(ground_dist - earth_radius, P(0.0f)), cos_ground_zenith, from_ground_r, from_ground_m);
+	OpticalDepthToTopPacket(atmosphere, height, P(0.0f) - cos_view_zenith, back_r, back_m);
+	const P optical_depth_r = Select(hits_ground, Max(from_ground_r - back_r, P(0.0f)), to_top_r);
+	const P optical_depth_m = Select(hits_ground, Max(from_ground_m - back_m, P(0.0f)), to_top_m);
+	for (int c = 0; c < 3; ++c)
+	{
+		const P transmittance = ExpPacket(P(0.0f) - FMA(P(atmosphere.mRayleighSctrCoeff[c]), optical_depth_r, P(atmosphere.mMieExtinctionCoeff[c]) * optical_depth_m));
+		Store(Select(in_atmosphere, transmittance, P(1.0f)), outResults.mTransmittance[c] + inFirst);
+	}
+}
+
+// SkyIrradiance() for the queries [inFirst, inFirst + P::WIDTH)
+template<typename P> void SkyIrradiancePacketT(const SkyIrradianceKernelArgs& inArgs, const SkyIrradianceQueries& inQueries, size_t inFirst, float* const outIrradiance[3])
+{
+	P up[3], light[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		up[c] = P::Load(inQueries.mPosition[c] + inFirst) - P(inArgs.mEarthCenter[c]);
+		light[c] = P::Load(inQueries.mLightDir[c] + inFirst);
+	}
+	const P dist = Sqrt(FMA(up[0], up[0], FMA(up[1], up[1], up[2] * up[2])));
+	const P inv_dist = P(1.0f) / dist;
+	for (int c = 0; c < 3; ++c)
+		up[c] = up[c] * inv_dist;
+	const P cos_light_zenith = FMA(up[0], light[0], FMA(up[1], light[1], up[2] * light[2]));
+
+	// WorldCoordToSunlightLUTCoord()
+	const P res_u(float(inArgs.mLUTResolution[0]));
+	const P res_v(float(inArgs.mLUTResolution[1]));
+	const P margin(inArgs.mLUTHeightMargin);
+	const P height = Min(Max(dist - P(inArgs.mEarthRadius), margin), P(inArgs.mAtmosphereTopHeight - inArgs.mLUTHeightMargin));
+	const P u = Sqrt(Min(Max((height - margin) / P(inArgs.mLUTHeightRange), P(0.0f)), P(1.0f)));
+	const P v = (AtanPacket(Max(cos_light_zenith, P(-0.1975f)) * P(inArgs.mTanLightZenithScale)) / P(1.1f) + P(1.0f - 0.26f)) * P(0.5f);
+
+	// Same as LookUpTableView2D::Sample(), the texel coordinate of (u * (res - 1) + 0.5) / res is u * (res - 1)
+	const P texel_x = u * (res_u - P(1.0f));
+	const P texel_y = v * (res_v - P(1.0f));
+	const P floor_x = Floor(texel_x);
+	const P floor_y = Floor(texel_y);
+	const P tx = texel_x - floor_x;
+	const P ty = texel_y - floor_y;
+	const P last_x(float(inArgs.mLUTResolution[0] - 1));
+	const P last_y(float(inArgs.mLUTResolution[1] - 1));
+	const P x0 = Min(Max(floor_x, P(0.0f)), last_x);
+	const P x1 = Min(Max(floor_x + P(1.0f), P(0.0f)), last_x);
+	const P y0 = Min(Max(floor_y, P(0.0f)), last_y) * res_u;
+	const P y1 = Min(Max(floor_y + P(1.0f), P(0.0f)), last_y) * res_u;
+	P c00[4], c10[4], c01[4], c11[4];
+	GatherFloat4(inArgs.mIrradiance, y0 + x0, c00);
+	GatherFloat4(inArgs.mIrradiance, y0 + x1, c10);
+	GatherFloat4(inArgs.mIrradiance, y1 + x0, c01);
+	GatherFloat4(inArgs.mIrradiance, y1 + x1, c11);
+
+	// Sky visible from a tilted surface, (1 + cos tilt) / 2 of the hemisphere
+	P visibility(1.0f);
+	if (inQueries.mNormal[0])
+	{
+		const P n_dot_up = FMA(P::Load(inQueries.mNormal[0] + inFirst), up[0], FMA(P::Load(inQueries.mNormal[1] + inFirst), up[1], P::Load(inQueries.mNormal[2] + inFirst) * up[2]));
+		visibility = Min(Max(FMA(n_dot_up, P(0.5f), P(0.5f)), P(0.0f)), P(1.0f));
+	}
+	for (int c = 0; c < 3; ++c)
+	{
+		const P row0 = FMA(c10[c] - c00[c], tx, c00[c]);
+		const P row1 = FMA(c11[c] - c01[c], tx, c01[c]);
+		Store(FMA(row1 - row0, ty, row0) * visibility * P(inArgs.mSunIlluminance[c]), outIrradiance[c] + inFirst);
+	}
+}
+
+} // namespace detail
+
+} // namespace atmosphere
@@ -0,0 +1,193 @@
+#include "SkyRenderer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+
+namespace atmosphere {
+
+namespace detail {
+
+// D3D11 cubemap faces : major axis, and the world directions of +u and +v (v goes down the face)
+static const math::Float3 sCubemapFaces[6][3] = {
+	{ math::Float3( 1.0f,  0.0f,  0.0f), math::Float3( 0.0f,  0.0f, -1.0f), math::Float3(0.0f, -1.0f,  0.0f) },
+	{ math::Float3(-1.0f,  0.0f,  0.0f), math::Float3( 0.0f,  0.0f,  1.0f), math::Float3(0.0f, -1.0f,  0.0f) },
+	{ math::Float3( 0.0f,  1.0f,  0.0f), math::Float3( 1.0f,  0.0f,  0.0f), math::Float3(0.0f,  0.0f,  1.0f) },
+	{ math::Float3( 0.0f, -1.0f,  0.0f), math::Float3( 1.0f,  0.0f,  0.0f), math::Float3(0.0f,  0.0f, -1.0f) },
+	{ math::Float3( 0.0f,  0.0f,  1.0f), math::Float3( 1.0f,  0.0f,  0.0f), math::Float3(0.0f, -1.0f,  0.0f) },
+	{ math::Float3( 0.0f,  0.0f, -1.0f), math::Float3(-1.0f,  0.0f,  0.0f), math::Float3(0.0f, -1.0f,  0.0f) },
+};
+
+} // namespace detail
+
+SkyRenderer::SkyRenderer(const Desc& inDesc)
+	: mDesc(inDesc)
+{
+	assert(mDesc.mTileSize > 0);
+	mScheduler = inDesc.mScheduler;
+	if (!mScheduler)
+	{
+		mOwnedScheduler = std::make_unique<etc::TaskScheduler>(inDesc.mNumThreads);
+		mScheduler = mOwnedScheduler.get();
+	}
+}
+
+SkyRenderer::~SkyRenderer()
+{
+}
+
+math::Float3 SkyRenderer::GetViewDir(const SkyView& inView, size_t x, size_t y, size_t inFace)
+{
+	const float width = float(inView.mWidth);
+	const float height = float((inView.mProjection == SkyProjection::Cubemap) ? inView.mWidth : inView.mHeight);
+	const float u = (float(x) + 0.5f) / width;
+	const float v = (float(y) + 0.5f) / height;
+
+	switch (inView.mProjection)
+	{
+	case SkyProjection::Equirectangular:
+	{
+		const float phi = 2.0f * math::PI<float> * u;
+		const float theta = math::PI<float> * v;
+		return math::Float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+	}
+	case SkyProjection::Cubemap:
+	{
+		const math::Float3* face = detail::sCubemapFaces[inFace];
+		return math::L2Normalize(face[0] + face[1] * (2.0f * u - 1.0f) + face[2] * (2.0f * v - 1.0f));
+	}
+	default:
+	{
+		// UVToViewDirection() of Util.hlsl, the clip position spans the height and keeps the aspect ratio
+		const math::Float3 dir = math::L2Normalize(math::Float3(
+			(2.0f * u - 1.0f) * (width / height) * inView.mFieldOfViewScale,
+			(1.0f - 2.0f * v) * inView.mFieldOfViewScale,
+			2.0f));
+		const math::Float3x3& rotation = inView.mCameraRotation;
+		return math::Float3(math::InnerProduct(rotation[0], dir), math::InnerProduct(rotation[1], dir), math::InnerProduct(rotation[2], dir));
+	}
+	}
+}
+
+void SkyRenderer::Render(const SkyRadianceTables& inTables, const SkyView& inView, SkyImage& outImage)
+{
+	const bool is_cubemap = (inView.mProjection == SkyProjection::Cubemap);
+	outImage.mWidth = inView.mWidth;
+	outImage.mHeight = is_cubemap ? inView.mWidth : inView.mHeight;
+	outImage.mNumFaces = is_cubemap ? 6 : 1;
+	outImage.mPixels.resize(outImage.mWidth * outImage.mHeight * outImage.mNumFaces);
+
+	const size_t tile_size = mDesc.mTileSize;
+	const size_t num_tiles_x = (outImage.mWidth + tile_size - 1) / tile_size;
+	const size_t num_tiles_y = (outImage.mHeight + tile_size - 1) / tile_size;
+	const size_t num_tiles_per_face = num_tiles_x * num_tiles_y;
+	const float exposure = std::exp2(inView.mExposureCompensation);
+
+	mScheduler->ParallelFor(num_tiles_per_face * outImage.mNumFaces, 1, [&](size_t inBegin, size_t inEnd)
+	{
+		// Structure-of-arrays queries of one tile
+		const size_t max_pixels = tile_size * tile_size;
+		std::vector<float> inputs(9 * max_pixels), outputs(3 * max_pixels);
+		for (size_t tile = inBegin; tile < inEnd; ++tile)
+		{
+			const size_t face = tile / num_tiles_per_face;
+			const size_t x0 = (tile % num_tiles_x) * tile_size;
+			const size_t y0 = ((tile % num_tiles_per_face) / num_tiles_x) * tile_size;
+			const size_t x1 = std::min(x0 + tile_size, outImage.mWidth);
+			const size_t y1 = std::min(y0 + tile_size, outImage.mHeight);
+			const size_t num_pixels = (x1 - x0) * (y1 - y0);
+
+			SkyRadianceQueries queries;
+			SkyRadianceResults results;
+			queries.mNumQueries = num_pixels;
+			for (int c = 0; c < 3; ++c)
+			{
+				queries.mPosition[c] = &inputs[(0 + c) * max_pixels];
+				queries.mViewDir[c] = &inputs[(3 + c) * max_pixels];
+				queries.mLightDir[c] = &inputs[(6 + c) * max_pixels];
+				results.mRadiance[c] = &outputs[c * max_pixels];
+			}
+			size_t i = 0;
+			for (size_t y = y0; y < y1; ++y)
+			{
+				for (size_t x = x0; x < x1; ++x, ++i)
+				{
+					const math::Float3 view_dir = GetViewDir(inView, x, y, face);
+					for (int c = 0; c < 3; ++c)
+					{
+						inputs[(0 + c) * max_pixels + i] = inView.mCameraPosition[c];
+						inputs[(3 + c) * max_pixels + i] = view_dir[c];
+						inputs[(6 + c) * max_pixels + i] = inView.mLightDir[c];
+					}
+				}
+			}
+			SkyRadianceBatch(mDesc.mInstructionSet, inTables, queries, results);
+
+			i = 0;
+			for (size_t y = y0; y < y1; ++y)
+			{
+				for (size_t x = x0; x < x1; ++x, ++i)
+				{
+					math::Float3 color = math::Float3(outputs[i], outputs[max_pixels + i], outputs[2 * max_pixels + i]) * exposure;
+					if (inView.mToneMap)
+					{
+						color = ACESFilm(color);
+						for (int c = 0; c < 3; ++c)
+							color[c] = std::pow(color[c], 1.0f / 2.2f);
+					}
+					outImage.At(x, y, face) = color;
+				}
+			}
+		}
+	});
+}
+
+math::Float3 ACESFilm(const math::Float3& inColor)
+{
+	const float a = 2.51f;
+	const float b = 0.03f;
+	const float c = 2.43f;
+	const float d = 0.59f;
+	const float e = 0.14f;
+	math::Float3 result;
+	for (int i = 0; i < 3; ++i)
+	{
+		const float x = inColor[i];
+		result[i] = Saturate((x * (a * x + b)) / (x * (c * x + d) + e));
+	}
+	return result;
+}
+
+bool WriteSkyImagePFM(const std::string& inPath, const SkyImage& inImage)
+{
+	static_assert(sizeof(math::Float3) == 3 * sizeof(float), "The rows are written as they are");
+	std::ofstream file(inPath, std::ios::binary);
+	if (!file)
+		return false;
+	const size_t height = inImage.mHeight * inImage.mNumFaces;
+	file << "PF\n" << inImage.mWidth << " " << height << "\n-1.0\n";
+	// The rows go from the bottom to the top
+	for (size_t row = height; row-- > 0; )
+		file.write(reinterpret_cast<const char*>(&inImage.mPixels[row * inImage.mWidth]), std::streamsize(inImage.mWidth * sizeof(math::Float3)));
+	return bool(file);
+}
+
+bool WriteSkyImagePPM(const std::string& inPath, const SkyImage& inImage)
+{
+	std::ofstream file(inPath, std::ios::binary);
+	if (!file)
+		return false;
+	const size_t height = inImage.mHeight * inImage.mNumFaces;
+	file << "P6\n" << inImage.mWidth << " " << height << "\n255\n";
+	std::vector<unsigned char> row(3 * inImage.mWidth);
+	for (size_t y = 0; y < height; ++y)
+	{
+		for (size_t x = 0; x < inImage.mWidth; ++x)
+			for (int c = 0; c < 3; ++c)
+				row[3 * x + c] = static_cast<unsigned char>(Saturate(inImage.mPixels[x + inImage.mWidth * y][c]) * 255.0f + 0.5f);
+		file.write(reinterpret_cast<const char*>(row.data()), std::streamsize(row.size()));
+	}
+	return bool(file);
+}
+
+} // namespace atmosphere
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <src/lib/etc/TaskScheduler.hpp>
+#include <src/lib/math/Math.hpp>
+#include "AtmosphereExport.hpp"
+#include "SkyRadianceBatch.hpp"
+
+namespace atmosphere {
+
+//--------------------------------------------------------------------------------------------
+// Headless sky renderer
+//		- AtmosphericScatteringPS.hlsl on CPU : camera ray, packed inscatter lookup, phase functions, exposure, ACESFilm
+//		  and gamma. The pixels of a tile go through SkyRadianceBatch() as one batch, the tiles run on a task scheduler.
+//		- Perspective frames with the camera of the shader, equirectangular panoramas and cubemaps at any resolution.
+//		  The panoramas and the cubemaps are aligned with the world axes (y up), only the camera position is used.
+//		- The ground is not shaded, as in the shader
+//--------------------------------------------------------------------------------------------
+enum class SkyProjection
+{
+	Perspective = 0,
+	Equirectangular,	// u : azimuth from +x toward +z, v : zenith angle from +y
+	Cubemap,			// D3D11 face order +x, -x, +y, -y, +z, -z, mWidth x mWidth per face
+};
+
+struct SkyView
+{
+	SkyProjection	mProjection = SkyProjection::Perspective;
+	size_t			mWidth = 1280;
+	size_t			mHeight = 720;		// ignored by the cubemaps
+	math::Float3	mCameraPosition = math::Float3(0.0f, 0.1f, 0.0f);	// [km], the ground is at y = 0
+	// Rows = GetParam(1..3) of the shader : world dir = (dot(row 0, dir), dot(row 1, dir), dot(row 2, dir))
+	math::Float3x3	mCameraRotation = math::Float3x3(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	float			mFieldOfViewScale = 1.4487501f;	// tan(PI / 3.25), the clip position is scaled by it and the camera dir is (clip, 2)
+	math::Float3	mLightDir = math::Float3(0.0f, 1.0f, 0.0f);		// toward the sun
+	float			mExposureCompensation = -13.5f;	// [EV]
+	bool			mToneMap = true;				// false = linear radiance times the exposure
+};
+
+// Row-major pixels, the faces of a cubemap one after the other
+struct SkyImage
+{
+	size_t	mWidth = 0;
+	size_t	mHeight = 0;
+	size_t	mNumFaces = 1;
+	std::vector<math::Float3>	mPixels;
+
+	math::Float3& At(size_t x, size_t y, size_t inFace = 0) { return mPixels[x + mWidth * (y + mHeight * inFace)]; }
+	const math::Float3& At(size_t x, size_t y, size_t inFace = 0) const { return mPixels[x + mWidth * (y + mHeight * inFace)]; }
+};
+
+struct ATMOSPHERE_EXPORT SkyRenderer
+{
+	struct Desc
+	{
+		std::uint32_t		mNumThreads = 0;	// 0 = std::thread::hardware_concurrency()
+		etc::TaskScheduler*	mScheduler = nullptr;	// optional pool shared with other systems
+		size_t				mTileSize = 32;		// pixels per side of a task
+		SimdInstructionSet	mInstructionSet = SimdInstructionSet::Auto;
+	};
+
+	explicit SkyRenderer(const Desc& inDesc);
+	~SkyRenderer();
+
+	void Render(const SkyRadianceTables& inTables, const SkyView& inView, SkyImage& outImage);
+
+	// Direction of the center of a pixel
+	static math::Float3 GetViewDir(const SkyView& inView, size_t x, size_t y, size_t inFace = 0);
+
+	etc::TaskScheduler& GetScheduler() const { return *mScheduler; }
+
+protected:
+	Desc	mDesc;
+	std::unique_ptr<etc::TaskScheduler>	mOwnedScheduler = nullptr;
+	etc::TaskScheduler*					mScheduler = nullptr;
+};
+
+// https://knarkowicz.wordpress.com/2016/01/06/aces-filmic-tone-mapping-curve/
+ATMOSPHERE_EXPORT math::Float3 ACESFilm(const math::Float3& inColor);
+
+// Portable float map (linear, little endian) and 8-bit portable pixmap (clamped to [0, 1]). The faces are stacked vertically.
+ATMOSPHERE_EXPORT bool WriteSkyImagePFM(const std::string& inPath, const SkyImage& inImage);
+ATMOSPHERE_EXPORT bool WriteSkyImagePPM(const std::string& inPath, const SkyImage& inImage);
+
+} // namespace atmosphere
@@ -0,0 +1,156 @@
+#include "SkySequence.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace atmosphere {
+
+namespace detail {
+
+using SequenceClock = std::chrono::steady_clock;
+
+static double ElapsedMs(SequenceClock::time_point inStart, SequenceClock::time_point inEnd)
+{
+	return std::chrono::duration<double, std::milli>(inEnd - inStart).count();
+}
+
+} // namespace detail
+
+math::Float3 GetSunDirection(const math::Float2& inSunAngle)
+{
+	const float theta = inSunAngle.x * math::PI<float> / 180.0f;
+	const float phi = inSunAngle.y * math::PI<float> / 180.0f;
+	return math::Float3(std::cos(phi) * std::sin(theta), std::cos(theta), std::sin(phi) * std::sin(theta));
+}
+
+std::vector<math::Float2> MakeDaySchedule(size_t inNumFrames, float inNoonZenith, float inHorizonZenith, float inAzimuthBegin, float inAzimuthEnd)
+{
+	std::vector<math::Float2> schedule(inNumFrames);
+	for (size_t i = 0; i < inNumFrames; ++i)
+	{
+		// t = 0 at sunrise, 1 at sunset, the zenith follows a half sine
+		const float t = (inNumFrames > 1) ? float(i) / float(inNumFrames - 1) : 0.5f;
+		const float zenith = inHorizonZenith + (inNoonZenith - inHorizonZenith) * std::sin(math::PI<float> * t);
+		schedule[i] = math::Float2(zenith, inAzimuthBegin + (inAzimuthEnd - inAzimuthBegin) * t);
+	}
+	return schedule;
+}
+
+bool RenderSkySequence(
+	SkyRenderer& inRenderer,
+	const SkyRadianceTables& inTables,
+	const SkySequenceDesc& inDesc,
+	const SkyFrameWriter& inWriter,
+	SkySequenceStats* outStats)
+{
+	using detail::SequenceClock;
+	using detail::ElapsedMs;
+	SkySequenceStats stats;
+	const auto time_start = SequenceClock::now();
+	SkyView view = inDesc.mView;
+	bool is_succeeded = true;
+
+	if (inDesc.mQueueDepth == 0)
+	{
+		SkyImage image;
+		for (size_t frame = 0; frame < inDesc.mSunAngles.size() && is_succeeded; ++frame)
+		{
+			view.mLightDir = GetSunDirection(inDesc.mSunAngles[frame]);
+			const auto render_start = SequenceClock::now();
+			inRenderer.Render(inTables, view, image);
+			const auto write_start = SequenceClock::now();
+			is_succeeded = inWriter(frame, image);
+			const auto write_end = SequenceClock::now();
+			stats.mRenderMs += ElapsedMs(render_start, write_start);
+			stats.mWriteMs += ElapsedMs(write_start, write_end);
+			stats.mNumFrames += is_succeeded ? 1 : 0;
+		}
+	}
+	else
+	{
+		// The images circulate between the free list and the queue, one more than the queue holds is being rendered
+		struct PendingFrame
+		{
+			size_t						mFrame;
+			std::unique_ptr<SkyImage>	mImage;
+		};
+		std::mutex						mutex;
+		std::condition_variable			condition;
+		std::deque<PendingFrame>		pending_frames;
+		std::vector<std::unique_ptr<SkyImage>>	free_images;
+		bool							is_done = false;
+		for (size_t i = 0; i < inDesc.mQueueDepth + 1; ++i)
+			free_images.push_back(std::make_unique<SkyImage>());
+
+		std::thread writer([&]()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true)
+			{
+				const auto wait_start = SequenceClock::now();
+				condition.wait(lock, [&]() { return !pending_frames.empty() || is_done; });
+				stats.mWriterStallMs += ElapsedMs(wait_start, SequenceClock::now());
+				if (pending_frames.empty())
+					break;
+				PendingFrame pending = std::move(pending_frames.front());
+				pending_frames.pop_front();
+				const bool is_writing = is_succeeded;
+				lock.unlock();
+
+				// After a failure the pending frames are only recycled
+				const auto write_start = SequenceClock::now();
+				const bool is_written = is_writing && inWriter(pending.mFrame, *pending.mImage);
+				stats.mWriteMs += ElapsedMs(write_start, SequenceClock::now());
+
+				lock.lock();
+				stats.mNumFrames += is_written ? 1 : 0;
+				is_succeeded = is_succeeded && (is_written || !is_writing);
+				free_images.push_back(std::move(pending.mImage));
+				condition.notify_all();
+			}
+		});
+
+		for (size_t frame = 0; frame < inDesc.mSunAngles.size(); ++frame)
+		{
+			std::unique_ptr<SkyImage> image;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				const auto wait_start = SequenceClock::now();
+				condition.wait(lock, [&]() { return !free_images.empty() || !is_succeeded; });
+				stats.mRenderStallMs += ElapsedMs(wait_start, SequenceClock::now());
+				if (!is_succeeded)
+					break;
+				image = std::move(free_images.back());
+				free_images.pop_back();
+			}
+
+			view.mLightDir = GetSunDirection(inDesc.mSunAngles[frame]);
+			const auto render_start = SequenceClock::now();
+			inRenderer.Render(inTables, view, *image);
+			stats.mRenderMs += ElapsedMs(render_start, SequenceClock::now());
+
+			std::lock_guard<std::mutex> lock(mutex);
+			pending_frames.push_back(PendingFrame{ frame, std::move(image) });
+			condition.notify_all();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			is_done = true;
+			condition.notify_all();
+		}
+		writer.join();
+	}
+
+	stats.mTotalMs = ElapsedMs(time_start, SequenceClock::now());
+	if (outStats)
+		*outStats = stats;
+	return is_succeeded;
+}
+
+} // namespace atmosphere
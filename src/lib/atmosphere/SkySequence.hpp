@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <src/lib/math/Math.hpp>
+#include "AtmosphereExport.hpp"
+#include "SkyRenderer.hpp"
+
+namespace atmosphere {
+
+//--------------------------------------------------------------------------------------------
+// Time-of-day sequences
+//		- Renders one frame per sun angle of a schedule with SkyRenderer. The look-up tables do not depend on the sun
+//		  direction, a sequence is baked once.
+//		- The frames are handed to a writer thread through a bounded queue : encoding and writing frame N overlaps
+//		  rendering frame N + 1. The renderer waits when mQueueDepth frames are pending, the images are recycled.
+//		- mQueueDepth = 0 renders and writes every frame in turn on the calling thread
+//--------------------------------------------------------------------------------------------
+
+// (zenith, azimuth) [deg] of the sun, as ui_light_angle of the viewer
+ATMOSPHERE_EXPORT math::Float3 GetSunDirection(const math::Float2& inSunAngle);
+
+// inNumFrames sun angles over a day : the zenith goes from inHorizonZenith to inNoonZenith and back while the azimuth
+// sweeps [inAzimuthBegin, inAzimuthEnd]
+ATMOSPHERE_EXPORT std::vector<math::Float2> MakeDaySchedule(size_t inNumFrames, float inNoonZenith = 20.0f, float inHorizonZenith = 95.0f, float inAzimuthBegin = 60.0f, float inAzimuthEnd = 300.0f);
+
+struct SkySequenceDesc
+{
+	SkyView						mView;			// every frame, mLightDir follows the schedule
+	std::vector<math::Float2>	mSunAngles;		// one frame per angle
+	size_t						mQueueDepth = 2;	// frames rendered ahead of the writer
+};
+
+struct SkySequenceStats
+{
+	size_t	mNumFrames = 0;			// frames written
+	double	mTotalMs = 0.0;
+	double	mRenderMs = 0.0;		// rendering, on the calling thread
+	double	mWriteMs = 0.0;			// in the writer callback
+	double	mRenderStallMs = 0.0;	// the renderer waits for a free slot of the queue
+	double	mWriterStallMs = 0.0;	// the writer waits for a frame
+
+	double GetFramesPerSecond() const { return (mTotalMs > 0.0) ? 1e3 * double(mNumFrames) / mTotalMs : 0.0; }
+};
+
+// Called in frame order, on the writer thread. Returns false to stop the sequence.
+using SkyFrameWriter = std::function<bool(size_t inFrame, const SkyImage& inImage)>;
+
+// Returns false when the writer failed, the frames after the failing one are not rendered
+ATMOSPHERE_EXPORT bool RenderSkySequence(
+	SkyRenderer& inRenderer,
+	const SkyRadianceTables& inTables,
+	const SkySequenceDesc& inDesc,
+	const SkyFrameWriter& inWriter,
+	SkySequenceStats* outStats = nullptr);
+
+} // namespace atmosphere
@@ -0,0 +1,11 @@
+#pragma once
+
+#if defined(_WIN32) && defined(BUILD_SHARED_LIBS)
+	#ifdef etc_EXPORTS
+		#define  ETC_EXPORT __declspec( dllexport )
+	#else
+		#define  ETC_EXPORT __declspec( dllimport )
+	#endif
+#else
+	#define	ETC_EXPORT
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace etc
+{
+	//------------------------------------------------------------------
+	//	64bit FNV-1a hash
+	//		- Stable across runs and platforms, usable as a key of files on disk
+	//------------------------------------------------------------------
+	struct Hash64
+	{
+		static constexpr std::uint64_t sOffsetBasis = 14695981039346656037ull;
+		static constexpr std::uint64_t sPrime = 1099511628211ull;
+
+		Hash64& Add(const void* inData, size_t inSize)
+		{
+			const std::uint8_t* bytes = static_cast<const std::uint8_t*>(inData);
+			for (size_t i = 0; i < inSize; ++i)
+			{
+				mValue ^= bytes[i];
+				mValue *= sPrime;
+			}
+			return *this;
+		}
+
+		// Trivially copyable values only, and beware of padding bytes
+		template<typename T> Hash64& Add(const T& inValue) { return Add(&inValue, sizeof(T)); }
+
+		std::uint64_t GetValue() const { return mValue; }
+
+	private:
+		std::uint64_t mValue = sOffsetBasis;
+	};
+
+} // etc
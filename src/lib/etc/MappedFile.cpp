@@ -0,0 +1,95 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace etc
+{
+#if defined(_WIN32)
+	std::unique_ptr<MappedFile> MappedFile::Open(const std::string& inPath)
+	{
+		HANDLE file = CreateFileA(inPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return nullptr;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!data)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		std::unique_ptr<MappedFile> mapped_file(new MappedFile());
+		mapped_file->mData = static_cast<const std::uint8_t*>(data);
+		mapped_file->mSize = static_cast<size_t>(size.QuadPart);
+		mapped_file->mFile = file;
+		mapped_file->mMapping = mapping;
+		return mapped_file;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (mData)
+			UnmapViewOfFile(mData);
+		if (mMapping)
+			CloseHandle(mMapping);
+		if (mFile)
+			CloseHandle(mFile);
+	}
+#else
+	std::unique_ptr<MappedFile> MappedFile::Open(const std::string& inPath)
+	{
+		const int fd = open(inPath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return nullptr;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			close(fd);
+			return nullptr;
+		}
+
+		void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // The mapping keeps the file alive
+		if (data == MAP_FAILED)
+			return nullptr;
+
+		std::unique_ptr<MappedFile> mapped_file(new MappedFile());
+		mapped_file->mData = static_cast<const std::uint8_t*>(data);
+		mapped_file->mSize = static_cast<size_t>(st.st_size);
+		return mapped_file;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (mData)
+			munmap(const_cast<std::uint8_t*>(mData), mSize);
+	}
+#endif
+
+} // etc
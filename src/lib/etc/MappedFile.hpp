@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "EtcExport.hpp"
+
+namespace etc
+{
+	//------------------------------------------------------------------
+	//	Read-only memory mapped file
+	//		- mmap() on POSIX, CreateFileMapping() on Windows
+	//		- Pages are loaded on demand, so opening a large file is cheap
+	//------------------------------------------------------------------
+	struct ETC_EXPORT MappedFile
+	{
+		// Returns nullptr when the file does not exist or cannot be mapped
+		static std::unique_ptr<MappedFile> Open(const std::string& inPath);
+
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const std::uint8_t* GetData() const { return mData; }
+		size_t GetSize() const { return mSize; }
+
+	protected:
+		MappedFile() = default;
+
+		const std::uint8_t*	mData = nullptr;
+		size_t				mSize = 0;
+#if defined(_WIN32)
+		void*				mFile = nullptr;
+		void*				mMapping = nullptr;
+#endif
+	};
+
+} // etc
@@ -0,0 +1,202 @@
+#include "TaskScheduler.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+namespace etc
+{
+	namespace
+	{
+		thread_local const TaskScheduler*	tCurrentScheduler = nullptr;
+		thread_local std::uint32_t			tCurrentWorkerIndex = 0;
+	}
+
+	TaskScheduler::TaskScheduler(std::uint32_t inNumThreads)
+	{
+		mNumThreads = inNumThreads;
+		if (mNumThreads == 0)
+			mNumThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		mQueues.reserve(mNumThreads);
+		for (std::uint32_t i = 0; i < mNumThreads; ++i)
+			mQueues.push_back(std::make_unique<WorkerQueue>());
+
+		// Queue 0 is served by the threads calling Wait(), the others by the workers
+		mWorkers.reserve(mNumThreads - 1);
+		for (std::uint32_t i = 1; i < mNumThreads; ++i)
+			mWorkers.emplace_back(&TaskScheduler::WorkerMain, this, i);
+	}
+
+	TaskScheduler::~TaskScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+			mQuit = true;
+		}
+		mSleepCondition.notify_all();
+		for (auto& worker : mWorkers)
+			worker.join();
+	}
+
+	std::uint32_t TaskScheduler::GetCurrentWorkerIndex() const
+	{
+		return (tCurrentScheduler == this) ? tCurrentWorkerIndex : 0;
+	}
+
+	void TaskScheduler::Submit(TaskGroup& inGroup, Task inTask)
+	{
+		inGroup.mNumPendingTasks.fetch_add(1, std::memory_order_relaxed);
+
+		// Workers push to their own queue, external threads spread the tasks over all queues
+		std::uint32_t queue_index = GetCurrentWorkerIndex();
+		if (tCurrentScheduler != this)
+			queue_index = mNextQueue.fetch_add(1, std::memory_order_relaxed) % mNumThreads;
+
+		{
+			WorkerQueue& queue = *mQueues[queue_index];
+			std::lock_guard<std::mutex> lock(queue.mMutex);
+			queue.mTasks.push_back(QueuedTask{ std::move(inTask), &inGroup });
+		}
+		mNumQueuedTasks.fetch_add(1, std::memory_order_release);
+
+		// Take the lock so that a worker cannot miss the notification between its check and its wait
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+		}
+		mSleepCondition.notify_one();
+		mWaitCondition.notify_one();	// when every worker is blocked in Wait(), one of them has to run it
+	}
+
+	bool TaskScheduler::TryPop(std::uint32_t inWorkerIndex, QueuedTask& outTask)
+	{
+		WorkerQueue& queue = *mQueues[inWorkerIndex];
+		std::lock_guard<std::mutex> lock(queue.mMutex);
+		if (queue.mTasks.empty())
+			return false;
+		outTask = std::move(queue.mTasks.back());
+		queue.mTasks.pop_back();
+		return true;
+	}
+
+	bool TaskScheduler::TrySteal(std::uint32_t inWorkerIndex, QueuedTask& outTask)
+	{
+		for (std::uint32_t i = 1; i < mNumThreads; ++i)
+		{
+			WorkerQueue& victim = *mQueues[(inWorkerIndex + i) % mNumThreads];
+			std::unique_lock<std::mutex> lock(victim.mMutex, std::try_to_lock);
+			if (!lock.owns_lock() || victim.mTasks.empty())
+				continue;
+			outTask = std::move(victim.mTasks.front());
+			victim.mTasks.pop_front();
+			mQueues[inWorkerIndex]->mNumStolenTasks.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	bool TaskScheduler::TryRunOne(std::uint32_t inWorkerIndex)
+	{
+		QueuedTask task;
+		if (!TryPop(inWorkerIndex, task) && !TrySteal(inWorkerIndex, task))
+			return false;
+		mNumQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+		mQueues[inWorkerIndex]->mNumExecutedTasks.fetch_add(1, std::memory_order_relaxed);
+		Execute(inWorkerIndex, task);
+		return true;
+	}
+
+	void TaskScheduler::Execute(std::uint32_t inWorkerIndex, QueuedTask& inTask)
+	{
+		const auto time_start = std::chrono::steady_clock::now();
+		inTask.mTask();
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - time_start);
+		mQueues[inWorkerIndex]->mBusyNanoseconds.fetch_add(std::uint64_t(elapsed.count()), std::memory_order_relaxed);
+		// The last task of a group wakes the threads blocked in Wait(). Do not touch the group after the decrement, its owner may already be gone.
+		if (inTask.mGroup->mNumPendingTasks.fetch_sub(1, std::memory_order_release) == 1)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mSleepMutex);
+			}
+			mWaitCondition.notify_all();
+		}
+	}
+
+	void TaskScheduler::WorkerMain(std::uint32_t inWorkerIndex)
+	{
+		tCurrentScheduler = this;
+		tCurrentWorkerIndex = inWorkerIndex;
+
+		while (true)
+		{
+			if (TryRunOne(inWorkerIndex))
+				continue;
+
+			std::unique_lock<std::mutex> lock(mSleepMutex);
+			mSleepCondition.wait(lock, [this] { return mQuit || mNumQueuedTasks.load(std::memory_order_acquire) > 0; });
+			if (mQuit)
+				break;
+		}
+
+		tCurrentScheduler = nullptr;
+	}
+
+	void TaskScheduler::Wait(TaskGroup& inGroup)
+	{
+		const std::uint32_t worker_index = GetCurrentWorkerIndex();
+		while (!inGroup.IsDone())
+		{
+			// Help instead of blocking
+			if (TryRunOne(worker_index))
+				continue;
+
+			// Nothing to run : sleep until a task is queued or the group is done.
+			// A separate condition from the idle workers, so that the end of a group does not wake all of them.
+			std::unique_lock<std::mutex> lock(mSleepMutex);
+			mWaitCondition.wait(lock, [this, &inGroup] { return inGroup.IsDone() || mNumQueuedTasks.load(std::memory_order_acquire) > 0; });
+		}
+	}
+
+	void TaskScheduler::ParallelFor(size_t inCount, size_t inGrainSize, const std::function<void(size_t, size_t)>& inFunc)
+	{
+		const size_t grain_size = std::max<size_t>(inGrainSize, 1);
+		if (mNumThreads <= 1 || inCount <= grain_size)
+		{
+			const auto time_start = std::chrono::steady_clock::now();
+			inFunc(0, inCount);
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - time_start);
+			mQueues[GetCurrentWorkerIndex()]->mBusyNanoseconds.fetch_add(std::uint64_t(elapsed.count()), std::memory_order_relaxed);
+			return;
+		}
+
+		TaskGroup group;
+		for (size_t begin = 0; begin < inCount; begin += grain_size)
+		{
+			const size_t end = std::min(begin + grain_size, inCount);
+			Submit(group, [&inFunc, begin, end] { inFunc(begin, end); });
+		}
+		Wait(group);
+	}
+
+	std::vector<TaskScheduler::Stats> TaskScheduler::GetStats() const
+	{
+		std::vector<Stats> stats(mNumThreads);
+		for (std::uint32_t i = 0; i < mNumThreads; ++i)
+		{
+			stats[i].mNumExecutedTasks = mQueues[i]->mNumExecutedTasks.load(std::memory_order_relaxed);
+			stats[i].mNumStolenTasks = mQueues[i]->mNumStolenTasks.load(std::memory_order_relaxed);
+			stats[i].mBusyNanoseconds = mQueues[i]->mBusyNanoseconds.load(std::memory_order_relaxed);
+		}
+		return stats;
+	}
+
+	void TaskScheduler::ResetStats()
+	{
+		for (auto& queue : mQueues)
+		{
+			queue->mNumExecutedTasks = 0;
+			queue->mNumStolenTasks = 0;
+			queue->mBusyNanoseconds = 0;
+		}
+	}
+
+} // etc
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "EtcExport.hpp"
+
+namespace etc
+{
+	//------------------------------------------------------------------
+	//	Work-stealing task scheduler
+	//		- Every worker owns a deque. It pops its own tasks from the back (LIFO, cache friendly)
+	//		  and steals from the front of the other deques (FIFO, largest chunks first) when it runs dry.
+	//		- The thread waiting for a TaskGroup executes tasks as well, so nested submission is safe.
+	//------------------------------------------------------------------
+	struct TaskGroup
+	{
+		TaskGroup() = default;
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		bool IsDone() const { return mNumPendingTasks.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend struct TaskScheduler;
+		std::atomic<std::uint32_t>	mNumPendingTasks{ 0 };
+	};
+
+	struct ETC_EXPORT TaskScheduler
+	{
+		using Task = std::function<void()>;
+
+		// inNumThreads = 0 : std::thread::hardware_concurrency(). The calling thread counts as one of them.
+		explicit TaskScheduler(std::uint32_t inNumThreads = 0);
+		~TaskScheduler();
+
+		TaskScheduler(const TaskScheduler&) = delete;
+		TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+		void Submit(TaskGroup& inGroup, Task inTask);
+		void Wait(TaskGroup& inGroup);
+
+		// Splits [0, inCount) into chunks of inGrainSize and runs inFunc(begin, end) on each of them. Blocks until all chunks are done.
+		void ParallelFor(size_t inCount, size_t inGrainSize, const std::function<void(size_t, size_t)>& inFunc);
+
+		std::uint32_t GetNumThreads() const { return mNumThreads; }
+
+		// Per-worker counters, useful to check load balance
+		struct Stats
+		{
+			std::uint64_t	mNumExecutedTasks = 0;
+			std::uint64_t	mNumStolenTasks = 0;
+			std::uint64_t	mBusyNanoseconds = 0;	// time spent in the tasks and the inline ParallelFor calls, nested work counts at every level
+		};
+		std::vector<Stats> GetStats() const;
+		void ResetStats();
+
+	protected:
+		struct QueuedTask
+		{
+			Task		mTask;
+			TaskGroup*	mGroup;
+		};
+
+		struct alignas(64) WorkerQueue
+		{
+			std::mutex				mMutex;
+			std::deque<QueuedTask>	mTasks;
+			std::atomic<std::uint64_t>	mNumExecutedTasks{ 0 };
+			std::atomic<std::uint64_t>	mNumStolenTasks{ 0 };
+			std::atomic<std::uint64_t>	mBusyNanoseconds{ 0 };
+		};
+
+		void WorkerMain(std::uint32_t inWorkerIndex);
+		bool TryPop(std::uint32_t inWorkerIndex, QueuedTask& outTask);
+		bool TrySteal(std::uint32_t inWorkerIndex, QueuedTask& outTask);
+		bool TryRunOne(std::uint32_t inWorkerIndex);
+		void Execute(std::uint32_t inWorkerIndex, QueuedTask& inTask);
+		std::uint32_t GetCurrentWorkerIndex() const;
+
+		std::uint32_t								mNumThreads = 1;
+		std::vector<std::unique_ptr<WorkerQueue>>	mQueues;	// [0] belongs to the external (submitting) threads
+		std::vector<std::thread>					mWorkers;
+		std::atomic<std::uint32_t>					mNextQueue{ 0 };
+
+		std::mutex					mSleepMutex;
+		std::condition_variable		mSleepCondition;	// idle workers
+		std::condition_variable		mWaitCondition;		// threads in Wait() with nothing to run
+		std::atomic<std::uint32_t>	mNumQueuedTasks{ 0 };
+		std::atomic<bool>			mQuit{ false };
+	};
+
+} // etc
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+
+namespace etc
+{
+	//------------------------------------------------------------------
+	//	Texel formats of the textures and of the look-up tables on disk
+	//		- No graphics API here, so that the portable libraries can use it. The gpu library maps it to DXGI_FORMAT.
+	//		- The values are stored in files (LookUpTableFileTableHeader::mFormat), append new formats only
+	//------------------------------------------------------------------
+	enum struct TextureFormat
+	{
+		R32,
+		R32G32,
+		R32G32B32,
+		R32G32B32A32,
+		R16G16_FLOAT,
+		R16G16B16A16_FLOAT,
+		R9G9B9E5,			// shared exponent RGB, no alpha. Sample only, not a render target.
+	};
+
+	// [bytes]
+	inline size_t GetTexelSize(TextureFormat inFormat)
+	{
+		switch (inFormat)
+		{
+		case TextureFormat::R32:			return 4;
+		case TextureFormat::R32G32:			return 8;
+		case TextureFormat::R32G32B32:		return 12;
+		case TextureFormat::R32G32B32A32:	return 16;
+		case TextureFormat::R16G16_FLOAT:	return 4;
+		case TextureFormat::R16G16B16A16_FLOAT:	return 8;
+		case TextureFormat::R9G9B9E5:		return 4;
+		}
+		return 0;
+	}
+
+} // etc
@@ -14,6 +14,12 @@ DXGI_FORMAT GetDXGIFormat(TextureFormat inFormat)
 		return DXGI_FORMAT_R32G32B32_FLOAT;
 	case TextureFormat::R32G32B32A32:
 		return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case TextureFormat::R16G16_FLOAT:
+		return DXGI_FORMAT_R16G16_FLOAT;
+	case TextureFormat::R16G16B16A16_FLOAT:
+		return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case TextureFormat::R9G9B9E5:
+		return DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
 	default:
 		assert(false);
 	};
@@ -42,7 +42,7 @@ struct ID3D11ShaderResourceView;
 
 template<typename T> struct ScreenUpdaterBase
 {
-	static const size_t sMaxNumResourceTextures = 2;
+	static const size_t sMaxNumResourceTextures = 4;	// e.g. an order and the totals of MultipleScatteringPS.hlsl
 
 	ScreenUpdaterBase(const ScreenCreationContext<T>& inContext);
 	virtual ~ScreenUpdaterBase() = default;
@@ -1,14 +1,17 @@
 #pragma once
 #include "GPUExports.hpp"
 #include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <src/lib/etc/TextureFormat.hpp>
 
-enum struct TextureFormat
+using etc::TextureFormat;
+using etc::GetTexelSize;
+
+inline bool IsRenderTargetFormat(TextureFormat inFormat)
 {
-	R32,
-	R32G32,
-	R32G32B32,
-	R32G32B32A32,
-};
+	return inFormat != TextureFormat::R9G9B9E5;
+}
 
 enum struct TextureFlags : std::uint8_t
 {
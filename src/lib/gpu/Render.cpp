@@ -214,6 +214,25 @@ BlendState::BlendState(Device& inDevice, const BlendStateDesc& inDesc)
 		assert(false);
 	}
 
+	// Independent blend : the first targets overwrite, the others blend as RenderTarget[0]
+	if (inDesc.mFirstBlendedTarget > 0)
+	{
+		assert(inDesc.mFirstBlendedTarget < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT);
+		blend_desc.IndependentBlendEnable = TRUE;
+		const D3D11_RENDER_TARGET_BLEND_DESC blended = blend_desc.RenderTarget[0];
+		for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+		{
+			blend_desc.RenderTarget[i] = blended;
+			if (i >= inDesc.mFirstBlendedTarget)
+				continue;
+			blend_desc.RenderTarget[i].BlendEnable = FALSE;
+			blend_desc.RenderTarget[i].SrcBlend = D3D11_BLEND_ONE;
+			blend_desc.RenderTarget[i].DestBlend = D3D11_BLEND_ZERO;
+			blend_desc.RenderTarget[i].SrcBlendAlpha = D3D11_BLEND_ONE;
+			blend_desc.RenderTarget[i].DestBlendAlpha = D3D11_BLEND_ZERO;
+		}
+	}
+
 	ID3D11BlendState* bs = nullptr;
 	HRESULT result = d3d_device.CreateBlendState(&blend_desc, &bs);
 	assert(SUCCEEDED(result));
@@ -225,6 +244,73 @@ BlendState::~BlendState() {}
 
 //==========================================================================
 
+GpuTimer::GpuTimer(Device& inDevice, std::uint32_t inMaxNumMarks)
+{
+	ID3D11Device& d3d_device = inDevice.GetD3D11Device();
+
+	D3D11_QUERY_DESC query_desc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+	ID3D11Query* query = nullptr;
+	HRESULT result = d3d_device.CreateQuery(&query_desc, &query);
+	assert(SUCCEEDED(result));
+	mDisjointQuery = detail::unique_iunknown_ptr<ID3D11Query>(query);
+
+	query_desc.Query = D3D11_QUERY_TIMESTAMP;
+	for (std::uint32_t i = 0; i < inMaxNumMarks; ++i)
+	{
+		query = nullptr;
+		result = d3d_device.CreateQuery(&query_desc, &query);
+		assert(SUCCEEDED(result));
+		mTimestampQueries.emplace_back(query);
+	}
+}
+
+GpuTimer::~GpuTimer() {}
+
+void GpuTimer::Begin(Device& inDevice)
+{
+	inDevice.GetD3D11DeviceContext().Begin(mDisjointQuery.get());
+	mNumMarks = 0;
+	Mark(inDevice);
+}
+
+void GpuTimer::Mark(Device& inDevice)
+{
+	if (mNumMarks >= mTimestampQueries.size())
+		return;
+	inDevice.GetD3D11DeviceContext().End(mTimestampQueries[mNumMarks++].get());
+}
+
+void GpuTimer::End(Device& inDevice)
+{
+	inDevice.GetD3D11DeviceContext().End(mDisjointQuery.get());
+}
+
+bool GpuTimer::Resolve(Device& inDevice, std::vector<double>& outIntervalsMs)
+{
+	ID3D11DeviceContext& context = inDevice.GetD3D11DeviceContext();
+	outIntervalsMs.clear();
+
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = {};
+	while (context.GetData(mDisjointQuery.get(), &disjoint, sizeof(disjoint), 0) == S_FALSE)
+		;
+	if (disjoint.Disjoint || disjoint.Frequency == 0)
+		return false;
+
+	std::uint64_t previous = 0;
+	for (std::uint32_t i = 0; i < mNumMarks; ++i)
+	{
+		std::uint64_t timestamp = 0;
+		while (context.GetData(mTimestampQueries[i].get(), &timestamp, sizeof(timestamp), 0) == S_FALSE)
+			;
+		if (i > 0)
+			outIntervalsMs.push_back(1e3 * double(timestamp - previous) / double(disjoint.Frequency));
+		previous = timestamp;
+	}
+	return true;
+}
+
+//==========================================================================
+
 Sampler::Sampler(Device& inDevice, const SamplerDesc& inDesc)
 {
 	ID3D11Device&	d3d_device = inDevice.GetD3D11Device();
@@ -286,7 +372,7 @@ Texture2D::Texture2D(Device& inDevice, const TextureDesc& inDesc)
 	desc.Format = GetDXGIFormat(inDesc.mFormat);
 	desc.SampleDesc.Count = 1;
 	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	desc.BindFlags = IsRenderTargetFormat(inDesc.mFormat) ? D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE : D3D11_BIND_SHADER_RESOURCE;
 	desc.CPUAccessFlags = 0;
 	desc.MiscFlags = 0;
 
@@ -297,15 +383,18 @@ Texture2D::Texture2D(Device& inDevice, const TextureDesc& inDesc)
 	mUniquePtr = detail::unique_iunknown_ptr<ID3D11Texture2D>(texture);
 
 	// Create render target view.
-	D3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc;
-	renderTargetViewDesc.Format = desc.Format;
-	renderTargetViewDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-	renderTargetViewDesc.Texture2D.MipSlice = 0;
+	if (IsRenderTargetFormat(inDesc.mFormat))
+	{
+		D3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc;
+		renderTargetViewDesc.Format = desc.Format;
+		renderTargetViewDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+		renderTargetViewDesc.Texture2D.MipSlice = 0;
 
-	ID3D11RenderTargetView* rtv;
-	result = d3d_device.CreateRenderTargetView(texture, &renderTargetViewDesc, &rtv);
-	assert(SUCCEEDED(result));
-	mRenderTargetViews.push_back(detail::unique_iunknown_ptr<ID3D11RenderTargetView>(rtv));
+		ID3D11RenderTargetView* rtv;
+		result = d3d_device.CreateRenderTargetView(texture, &renderTargetViewDesc, &rtv);
+		assert(SUCCEEDED(result));
+		mRenderTargetViews.push_back(detail::unique_iunknown_ptr<ID3D11RenderTargetView>(rtv));
+	}
 
 	// Create the shader resource view
 	D3D11_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc;
@@ -342,7 +431,7 @@ Texture3D::Texture3D(Device& inDevice, const TextureDesc& inDesc)
 	desc.MipLevels = 1;
 	desc.Format = GetDXGIFormat(inDesc.mFormat);
 	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	desc.BindFlags = IsRenderTargetFormat(inDesc.mFormat) ? D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE : D3D11_BIND_SHADER_RESOURCE;
 	desc.CPUAccessFlags = 0;
 	desc.MiscFlags = 0;
 
@@ -352,8 +441,8 @@ Texture3D::Texture3D(Device& inDevice, const TextureDesc& inDesc)
 	assert(SUCCEEDED(result));
 	mUniquePtr = detail::unique_iunknown_ptr<ID3D11Texture3D>(texture);
 
-	// Create render target views
-	for (size_t depth = 0; depth < desc.Depth; ++depth)
+	// Create render target views, none for a sample only format (filled with UploadTexture)
+	for (size_t depth = 0; IsRenderTargetFormat(inDesc.mFormat) && depth < desc.Depth; ++depth)
 	{
 		D3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc;
 		renderTargetViewDesc.Format = desc.Format;
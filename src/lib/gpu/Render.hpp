@@ -35,6 +35,7 @@ struct ID3D11Texture2D;
 struct ID3D11Texture3D;
 struct ID3D11RenderTargetView;
 struct ID3D11ShaderResourceView;
+struct ID3D11Query;
 
 struct GPU_EXPORT Device
 {
@@ -114,7 +115,8 @@ enum struct BlendType
 
 struct GPU_EXPORT BlendStateDesc
 {
-	BlendType	mBlendType = BlendType::NONE;
+	BlendType		mBlendType = BlendType::NONE;
+	std::uint32_t	mFirstBlendedTarget = 0;	// the render targets before it are written without blending
 };
 
 struct GPU_EXPORT BlendState
@@ -128,6 +130,27 @@ protected:
 
 //=============================================================
 
+// Intervals between timestamps on the GPU timeline (D3D11_QUERY_TIMESTAMP inside a D3D11_QUERY_TIMESTAMP_DISJOINT)
+struct GPU_EXPORT GpuTimer
+{
+	GpuTimer(Device& inDevice, std::uint32_t inMaxNumMarks = 64);
+	~GpuTimer();
+	// Starts a measurement with a first timestamp
+	void Begin(Device& inDevice);
+	// Timestamp after the commands issued so far, ignored beyond inMaxNumMarks
+	void Mark(Device& inDevice);
+	void End(Device& inDevice);
+	// Waits for the GPU, outIntervalsMs[i] is the time between mark i and i + 1 (Begin() is mark 0).
+	// Returns false when the clock was disjoint, e.g. a frequency change, the intervals are unreliable then.
+	bool Resolve(Device& inDevice, std::vector<double>& outIntervalsMs);
+protected:
+	detail::unique_iunknown_ptr<ID3D11Query>				mDisjointQuery = nullptr;
+	std::vector<detail::unique_iunknown_ptr<ID3D11Query>>	mTimestampQueries;
+	std::uint32_t	mNumMarks = 0;
+};
+
+//=============================================================
+
 
 struct Texture
 {
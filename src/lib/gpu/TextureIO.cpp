@@ -1,39 +1,48 @@
 #include "TextureIO.hpp"
 #include <d3d11.h>
 #include <cassert>
+#include <cstring>
 
 Image::Image(const ImageMetaData& inDesc)
 	: mDesc(inDesc)
 {
-	size_t mipLevels = inDesc.mipLevels;
+	assert(inDesc.mipLevels == 1); // ToDo
+	assert(inDesc.width > 0 && inDesc.height > 0 && inDesc.depth > 0);
 
-	size_t dimension = 1;
-	dimension += inDesc.height	> 1 ? 1 : 0;
-	dimension += inDesc.depth	> 1 ? 1 : 0;
-
-	assert(mipLevels == 1); // ToDo
-	switch (dimension)
-	{
-	case 1:
-		assert(false); // ToDo
-		break;
+	mRowPitch = inDesc.width * GetTexelSize(inDesc.format);
+	mSlicePitch = mRowPitch * inDesc.height;
+	mPixels.resize(mSlicePitch * inDesc.depth);
+}
 
-	case 2:
-		mWidth = inDesc.width;
-		mHeight = inDesc.height;
-		break;
+//==========================================================
 
-	case 3:
-		assert(false); // ToDo
-		break;
+namespace
+{
+	// Copies the mapped rows of a staging resource into the tightly packed pixels of outImage
+	void ReadStagingResource(const Device& inDevice, ID3D11Resource* inStagingResource, Image& outImage)
+	{
+		ID3D11DeviceContext& d3d_context = inDevice.GetD3D11DeviceContext();
 
-	default:
-		assert(false);
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = d3d_context.Map(inStagingResource, 0, D3D11_MAP_READ, 0, &mapped);
+		assert(SUCCEEDED(hr));
+		if (FAILED(hr))
+			return;
+
+		const ImageMetaData& meta_data = outImage.GetMetaData();
+		const size_t row_size = outImage.GetRowPitch();
+		for (size_t z = 0; z < meta_data.depth; ++z)
+		{
+			const std::uint8_t* src_slice = static_cast<const std::uint8_t*>(mapped.pData) + z * mapped.DepthPitch;
+			std::uint8_t* dst_slice = outImage.GetPixels() + z * outImage.GetSlicePitch();
+			for (size_t y = 0; y < meta_data.height; ++y)
+				std::memcpy(dst_slice + y * row_size, src_slice + y * mapped.RowPitch, row_size);
+		}
+
+		d3d_context.Unmap(inStagingResource, 0);
 	}
 }
 
-//==========================================================
-
 std::unique_ptr<Image> CaptureTexture(const Device& inDevice, const Texture2D& inTexture2D)
 {
 	HRESULT hr;
@@ -49,11 +58,13 @@ std::unique_ptr<Image> CaptureTexture(const Device& inDevice, const Texture2D& i
 	{
 		// detail::unique_iunknown_ptr<ID3D11Texture2D> staging_texture = nullptr;
 		assert(false); // todo
+		return nullptr;
 	}
 	else if ((desc.Usage == D3D11_USAGE_STAGING) && (desc.CPUAccessFlags & D3D11_CPU_ACCESS_READ))
 	{
 		// Handle case where the source is already a staging texture we can use directly
 		assert(false); // todo
+		return nullptr;
 	}
 	else
 	{
@@ -62,9 +73,10 @@ std::unique_ptr<Image> CaptureTexture(const Device& inDevice, const Texture2D& i
 		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 		desc.Usage = D3D11_USAGE_STAGING;
 
-		ID3D11Texture2D* raw_staging_texture = staging_texture.get();
+		ID3D11Texture2D* raw_staging_texture = nullptr;
 		hr = inDevice.GetD3D11Device().CreateTexture2D(&desc, 0, &raw_staging_texture);
 		assert(SUCCEEDED(hr));
+		staging_texture = detail::unique_iunknown_ptr<ID3D11Texture2D>(raw_staging_texture);
 		assert(staging_texture);
 
 		inDevice.GetD3D11DeviceContext().CopyResource(raw_staging_texture, src_texture);
@@ -81,8 +93,59 @@ std::unique_ptr<Image> CaptureTexture(const Device& inDevice, const Texture2D& i
 		meta_data.flagSet.set(static_cast<std::uint8_t>(TextureFlags::CUBEMAP));
 
 	std::unique_ptr<Image> outImage = std::make_unique<Image>(meta_data);
+	ReadStagingResource(inDevice, staging_texture.get(), *outImage);
+	return outImage;
+}
+
+std::unique_ptr<Image> CaptureTexture(const Device& inDevice, const Texture3D& inTexture3D)
+{
+	HRESULT hr;
+
+	ID3D11Texture3D* src_texture = inTexture3D.Get();
+	assert(src_texture);
+
+	D3D11_TEXTURE3D_DESC desc;
+	src_texture->GetDesc(&desc);
+
+	desc.BindFlags = 0;
+	desc.MiscFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc.Usage = D3D11_USAGE_STAGING;
 
-	// (Under construction)
+	ID3D11Texture3D* raw_staging_texture = nullptr;
+	hr = inDevice.GetD3D11Device().CreateTexture3D(&desc, 0, &raw_staging_texture);
+	assert(SUCCEEDED(hr));
+	detail::unique_iunknown_ptr<ID3D11Texture3D> staging_texture(raw_staging_texture);
+	if (!staging_texture)
+		return nullptr;
 
-	return nullptr;
-}
\ No newline at end of file
+	inDevice.GetD3D11DeviceContext().CopyResource(raw_staging_texture, src_texture);
+
+	ImageMetaData meta_data;
+	meta_data.width = desc.Width;
+	meta_data.height = desc.Height;
+	meta_data.depth = desc.Depth;
+	meta_data.mipLevels = desc.MipLevels;
+	meta_data.flagSet = static_cast<std::uint8_t>(TextureFlags::NONE);
+	meta_data.format = inTexture3D.GetTextureDesc().mFormat;
+
+	std::unique_ptr<Image> outImage = std::make_unique<Image>(meta_data);
+	ReadStagingResource(inDevice, staging_texture.get(), *outImage);
+	return outImage;
+}
+
+//==========================================================
+
+void UploadTexture(const Device& inDevice, const Texture2D& inTexture2D, const void* inTexels)
+{
+	const TextureDesc& desc = inTexture2D.GetTextureDesc();
+	const UINT row_pitch = static_cast<UINT>(desc.mWidth * GetTexelSize(desc.mFormat));
+	inDevice.GetD3D11DeviceContext().UpdateSubresource(inTexture2D.Get(), 0, nullptr, inTexels, row_pitch, row_pitch * static_cast<UINT>(desc.mHeight));
+}
+
+void UploadTexture(const Device& inDevice, const Texture3D& inTexture3D, const void* inTexels)
+{
+	const TextureDesc& desc = inTexture3D.GetTextureDesc();
+	const UINT row_pitch = static_cast<UINT>(desc.mWidth * GetTexelSize(desc.mFormat));
+	inDevice.GetD3D11DeviceContext().UpdateSubresource(inTexture3D.Get(), 0, nullptr, inTexels, row_pitch, row_pitch * static_cast<UINT>(desc.mHeight));
+}
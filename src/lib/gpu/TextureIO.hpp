@@ -21,16 +21,28 @@ struct ImageMetaData
 	TextureFlagSet	flagSet;
 };
 
-struct Image
+// Tightly packed pixels of the top mip level, (x, y, z) at x * texel size + y * row pitch + z * slice pitch
+struct GPU_EXPORT Image
 {
 	Image(const ImageMetaData& inDesc);
+
+	const ImageMetaData& GetMetaData() const { return mDesc; }
+	size_t GetRowPitch() const { return mRowPitch; }
+	size_t GetSlicePitch() const { return mSlicePitch; }
+	size_t GetPixelsSize() const { return mPixels.size(); }
+	std::uint8_t* GetPixels() { return mPixels.data(); }
+	const std::uint8_t* GetPixels() const { return mPixels.data(); }
 private:
-	const ImageMetaData&	mDesc;
-	size_t					mWidth;
-	size_t					mHeight;
-	size_t					mRowPitch;
-	size_t					mSlicePitch;
-	uint8_t*				mPixels;
+	ImageMetaData				mDesc;
+	size_t						mRowPitch;
+	size_t						mSlicePitch;
+	std::vector<std::uint8_t>	mPixels;
 };
 
-std::unique_ptr<Image> CaptureTexture(const Device& inDevice, const Texture2D& inTexture2D);
\ No newline at end of file
+// Reads a texture back to the CPU (blocks until the GPU has finished the texture)
+GPU_EXPORT std::unique_ptr<Image> CaptureTexture(const Device& inDevice, const Texture2D& inTexture2D);
+GPU_EXPORT std::unique_ptr<Image> CaptureTexture(const Device& inDevice, const Texture3D& inTexture3D);
+
+// Overwrites the whole texture with tightly packed texels in the format of the texture
+GPU_EXPORT void UploadTexture(const Device& inDevice, const Texture2D& inTexture2D, const void* inTexels);
+GPU_EXPORT void UploadTexture(const Device& inDevice, const Texture3D& inTexture3D, const void* inTexels);
@@ -1,5 +1,7 @@
 #pragma once
 #include <cassert>
+#include <cmath>
+#include <limits>
 
 namespace math {
 
@@ -12,8 +14,8 @@ template<typename T> struct Vector2
 	T x, y;
 	T& operator[](size_t _i) { return (&x)[_i]; }
 	constexpr T const& operator[](size_t _i) const { return (&x)[_i]; }
-	T& at(size_t _i) { assert(_i < 2); return (&x)[_i] }
-	constexpr T const& at(size_t _i) const { assert(_i < 2); return (&x)[_i] }
+	T& at(size_t _i) { assert(_i < 2); return (&x)[_i]; }
+	constexpr T const& at(size_t _i) const { assert(_i < 2); return (&x)[_i]; }
 
 	constexpr Vector2() = default;
 	constexpr Vector2(Vector2 const& _v) : x(_v.x), y(_v.y) {}
@@ -21,6 +23,21 @@ template<typename T> struct Vector2
 	constexpr explicit Vector2(T _x, T _y) : x(_x), y(_y) {}
 };
 
+template<typename T> constexpr Vector2<T> operator+(const Vector2<T>& a, const Vector2<T>& b)
+{
+	return Vector2<T>(a[0] + b[0], a[1] + b[1]);
+}
+
+template<typename T> constexpr Vector2<T> operator*(const Vector2<T>& v, T const s)
+{
+	return Vector2<T>(v[0] * s, v[1] * s);
+}
+
+template<typename T> constexpr Vector2<T> operator*(T const s, const Vector2<T>& v)
+{
+	return Vector2<T>(s * v[0], s * v[1]);
+}
+
 template<typename T> struct Vector4
 {
 	T x, y, z, w;
@@ -35,6 +52,21 @@ template<typename T> struct Vector4
 	constexpr explicit Vector4(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w) {}
 };
 
+template<typename T> constexpr Vector4<T> operator+(const Vector4<T>& a, const Vector4<T>& b)
+{
+	return Vector4<T>(a[0] + b[0], a[1] + b[1], a[2] + b[2], a[3] + b[3]);
+}
+
+template<typename T> constexpr Vector4<T> operator*(const Vector4<T>& v, T const s)
+{
+	return Vector4<T>(v[0] * s, v[1] * s, v[2] * s, v[3] * s);
+}
+
+template<typename T> constexpr Vector4<T> operator*(T const s, const Vector4<T>& v)
+{
+	return Vector4<T>(s * v[0], s * v[1], s * v[2], s * v[3]);
+}
+
 //=====================================================
 
 template<typename T> struct Vector3
@@ -61,6 +93,11 @@ template<typename T> constexpr Vector3<T> operator+(const Vector3<T>& a, const V
 	return Vector3<T>(a[0] + b[0], a[1] + b[1], a[2] + b[2]);
 }
 
+template<typename T> constexpr Vector3<T> operator-(const Vector3<T>& a, const Vector3<T>& b)
+{
+	return Vector3<T>(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+}
+
 template<typename T> constexpr Vector3<T> operator*(const Vector3<T>& v, T const s)
 {
 	return Vector3<T>(v[0] * s, v[1] * s, v[2] * s);
@@ -88,6 +125,18 @@ template<typename T> constexpr Vector3<T> operator/(const Vector3<T>& a, const V
 	return Vector3(a[0] / b[0], a[1] / b[1], a[2] / b[2]);
 }
 
+template<typename T> Vector3<T>& operator+=(Vector3<T>& a, const Vector3<T>& b)
+{
+	a[0] += b[0]; a[1] += b[1]; a[2] += b[2];
+	return a;
+}
+
+template<typename T> Vector3<T>& operator*=(Vector3<T>& a, const Vector3<T>& b)
+{
+	a[0] *= b[0]; a[1] *= b[1]; a[2] *= b[2];
+	return a;
+}
+
 template<typename T> constexpr bool NearlyEqual(T a, T b, T epsilon = std::numeric_limits<T>::epsilon())
 {
 	return std::abs(a - b) < epsilon;
@@ -133,7 +182,7 @@ template<typename T> struct Matrix3x3
 	Vector3<T>& operator[](size_t _i) { return (&x)[_i]; }
 	constexpr Vector3<T> const& operator[](size_t _i) const { return (&x)[_i]; }
 	Vector3<T>& at(size_t _i) { assert(_i < 3); return (&x)[_i]; }
-	constexpr Vector3<T> const& at(size_t _i) const { assert(_i < 3); (&x)[_i]; }
+	constexpr Vector3<T> const& at(size_t _i) const { assert(_i < 3); return (&x)[_i]; }
 };
 
 template<typename T> constexpr T Determinant(const Matrix3x3<T>& m)
@@ -197,6 +246,8 @@ using Int3		= Vector3<int>;
 using Float3	= Vector3<float>;
 using Double3	= Vector3<double>;
 
+using Float4	= Vector4<float>;
+
 using Float3x3	= Matrix3x3<float>;
 
 } // namespace math
\ No newline at end of file
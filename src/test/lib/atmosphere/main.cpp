@@ -0,0 +1,1049 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include <src/lib/atmosphere/AdaptiveLookUpTable.hpp>
+#include <src/lib/atmosphere/AsyncPrecomputedAtmosphericScattering.hpp>
+#include <src/lib/atmosphere/AtmosphericScattering.hpp>
+#include <src/lib/atmosphere/CpuPrecomputedAtmosphericScattering.hpp>
+#include <src/lib/atmosphere/LookUpTableAtlas.hpp>
+#include <src/lib/atmosphere/LookUpTableEncoding.hpp>
+#include <src/lib/atmosphere/LookUpTableFile.hpp>
+#include <src/lib/atmosphere/PathTracedSky.hpp>
+#include <src/lib/atmosphere/SingleScatteringPacket.hpp>
+#include <src/lib/atmosphere/SkyRadianceBatch.hpp>
+#include <src/lib/atmosphere/SkyRenderer.hpp>
+#include <src/lib/atmosphere/SkySequence.hpp>
+
+int main()
+{
+	using namespace atmosphere;
+
+	// Texel centers of a look-up table are sampled exactly
+	{
+		LookUpTable3D<math::Float4> table(4, 3, 2);
+		for (size_t z = 0; z < 2; ++z)
+			for (size_t y = 0; y < 3; ++y)
+				for (size_t x = 0; x < 4; ++x)
+					table.At(x, y, z) = math::Float4(float(x + 10 * y + 100 * z));
+		const math::Float4 c = table.Sample(math::Float3(2.5f / 4.0f, 1.5f / 3.0f, 1.5f / 2.0f));
+		assert(math::NearlyEqual(c.x, 112.0f, 1e-4f));
+		const math::Float4 mid = table.Sample(math::Float3(2.0f / 4.0f, 1.5f / 3.0f, 0.5f / 2.0f));
+		assert(math::NearlyEqual(mid.x, 11.5f, 1e-4f));
+	}
+
+	// A 4d table in the depth of a 3d table is sampled quadrilinearly, the slices do not bleed into each other
+	{
+		LookUpTable3D<math::Float4> slices(3, 2, 2 * 3);
+		for (size_t q = 0; q < 3; ++q)
+			for (size_t z = 0; z < 2; ++z)
+				for (size_t y = 0; y < 2; ++y)
+					for (size_t x = 0; x < 3; ++x)
+						slices.At(x, y, q * 2 + z) = math::Float4(float(x + 10 * y + 100 * z + 1000 * q));
+		const LookUpTableView4D<math::Float4> table(slices, 3);
+		assert(table.GetDepth() == 2 && table.GetNumSlices() == 3 && table.At(2, 1, 0, 1).x == 1012.0f);
+		const math::Float4 c = table.Sample(math::Float4(1.5f / 3.0f, 0.5f / 2.0f, 1.5f / 2.0f, 2.5f / 3.0f));
+		assert(math::NearlyEqual(c.x, 2101.0f, 1e-3f));
+		const math::Float4 mid = table.Sample(math::Float4(1.0f / 3.0f, 0.5f / 2.0f, 0.5f / 2.0f, 1.0f / 3.0f));
+		assert(math::NearlyEqual(mid.x, 500.5f, 1e-3f));
+		const math::Float4 edge = table.Sample(math::Float4(0.5f / 3.0f, 0.5f / 2.0f, 1.0f, 0.5f / 3.0f));
+		assert(math::NearlyEqual(edge.x, 100.0f, 1e-3f));
+	}
+
+	// Tiled layouts hold the same texels and sample bit-identically to the linear table
+	{
+		LookUpTable3D<math::Float4> table(5, 6, 7);	// not a multiple of the brick size
+		for (size_t i = 0; i < table.GetNumTexels(); ++i)
+			table.GetData()[i] = math::Float4(float(i), float(i % 7), 0.5f * float(i), 1.0f);
+		for (LookUpTableLayout layout : { LookUpTableLayout::Linear, LookUpTableLayout::Morton, LookUpTableLayout::Brick })
+		{
+			const TiledLookUpTable3D<math::Float4> tiled(table, layout);
+			assert(tiled.GetMemorySize() == ((layout == LookUpTableLayout::Linear) ? 5 * 6 * 7 : 8 * 8 * 8) * sizeof(math::Float4));
+			for (size_t z = 0; z < 7; ++z)
+				for (size_t y = 0; y < 6; ++y)
+					for (size_t x = 0; x < 5; ++x)
+						assert(tiled.At(x, y, z).x == table.At(x, y, z).x);
+			for (int i = 0; i < 100; ++i)
+			{
+				const math::Float3 uvw(Frac(0.37f * float(i)), Frac(0.71f * float(i)), Frac(0.13f * float(i)) * 1.2f - 0.1f);
+				const math::Float4 expected = table.Sample(uvw);
+				const math::Float4 texel = tiled.Sample(uvw);
+				assert(std::memcmp(&expected, &texel, sizeof(math::Float4)) == 0);
+			}
+		}
+	}
+
+	// Half conversion rounds to nearest even like F16C, RGB9E5 and half tables stay within their precision
+	{
+		assert(FloatToHalf(1.0f) == 0x3c00 && HalfToFloat(0x3c00) == 1.0f);
+		assert(FloatToHalf(-2.0f) == 0xc000);
+		assert(FloatToHalf(65504.0f) == 0x7bff && FloatToHalf(65520.0f) == 0x7c00);
+		assert(FloatToHalf(1.0f + 1.0f / 2048.0f) == 0x3c00);		// tie, rounds to even
+		assert(FloatToHalf(1.0f + 3.0f / 2048.0f) == 0x3c02);
+		assert(FloatToHalf(5.9604645e-8f) == 0x0001 && HalfToFloat(0x0001) == 5.9604645e-8f);
+		assert(FloatToHalf(1e-9f) == 0x0000);
+		assert(std::isinf(HalfToFloat(FloatToHalf(1e10f))) && std::isnan(HalfToFloat(FloatToHalf(NAN))));
+
+		std::vector<float> values;
+		for (std::uint32_t i = 0; i < 70000; ++i)
+		{
+			const float value = std::ldexp(1.0f + float(i % 4096) / 4096.0f, int(i % 50) - 30);
+			values.push_back((i & 1) ? -value : value);
+		}
+		std::vector<std::uint16_t> scalar(values.size()), simd(values.size());
+		FloatToHalf(SimdInstructionSet::Scalar, values.data(), scalar.data(), values.size());
+		FloatToHalf(SimdInstructionSet::Auto, values.data(), simd.data(), values.size());
+		assert(scalar == simd);
+		std::vector<float> scalar_back(values.size()), simd_back(values.size());
+		HalfToFloat(SimdInstructionSet::Scalar, scalar.data(), scalar_back.data(), values.size());
+		HalfToFloat(SimdInstructionSet::Auto, simd.data(), simd_back.data(), values.size());
+		assert(std::memcmp(scalar_back.data(), simd_back.data(), values.size() * sizeof(float)) == 0);
+		for (size_t count : { size_t(5), values.size() - 3 })	// the tail of less than 8 values
+		{
+			std::vector<std::uint16_t> tail(count + 1, 0xffff);
+			FloatToHalf(SimdInstructionSet::Auto, values.data(), tail.data(), count);
+			assert(std::equal(tail.begin(), tail.begin() + count, scalar.begin()) && tail[count] == 0xffff);
+			std::vector<float> tail_back(count + 1, -1.0f);
+			HalfToFloat(SimdInstructionSet::Auto, scalar.data(), tail_back.data(), count);
+			assert(std::memcmp(tail_back.data(), scalar_back.data(), count * sizeof(float)) == 0 && tail_back[count] == -1.0f);
+		}
+		for (std::uint32_t h = 0; h < 0x7c00; ++h)
+			assert(FloatToHalf(HalfToFloat(std::uint16_t(h))) == h);
+
+		const math::Float3 exact = RGB9E5ToFloat(FloatToRGB9E5(math::Float3(1.0f, 0.5f, 0.0f)));
+		assert(exact.x == 1.0f && exact.y == 0.5f && exact.z == 0.0f);
+		assert(FloatToRGB9E5(math::Float3(-1.0f, 0.0f, 0.0f)) == 0);
+
+		LookUpTable3D<math::Float4> table(12, 16, 8);
+		for (size_t i = 0; i < table.GetNumTexels(); ++i)
+		{
+			const float value = 1e-1f * std::exp(-0.01f * float(i % 500));	// normal halves down to the alpha
+			table.GetData()[i] = math::Float4(value, 0.8f * value, 0.5f * value, 0.1f * value);
+		}
+		const EncodedLookUpTable half = EncodeLookUpTable(table, TextureFormat::R16G16B16A16_FLOAT);
+		assert(half.GetMemorySize() == table.GetNumTexels() * 8);
+		const LookUpTableEncodingError half_error = MeasureEncodingError(table, half);
+		assert(half_error.mNumChannels > 0 && half_error.mMaxRelativeError <= 1.0 / 2048.0);
+		const EncodedLookUpTable rgb9e5 = EncodeLookUpTable(table, TextureFormat::R9G9B9E5);
+		assert(rgb9e5.GetMemorySize() == table.GetNumTexels() * 4);
+		const LookUpTableEncodingError rgb9e5_error = MeasureEncodingError(table, rgb9e5);
+		assert(rgb9e5_error.mMaxRelativeError <= 2.0 / 512.0);	// the dimmest channel is half the brightest
+		LookUpTable3D<math::Float4> decoded(1, 1, 1);
+		DecodeLookUpTable(half, decoded);
+		assert(decoded.GetWidth() == 12 && decoded.GetDepth() == 8);
+		assert(std::abs(decoded.At(3, 4, 5).y - table.At(3, 4, 5).y) <= 1e-3f * table.At(3, 4, 5).y);
+	}
+
+	// LookUpTableFile rejects files of another major version and truncated files
+	{
+		const std::string path = (std::filesystem::temp_directory_path() / "atmosphere_test.lut").string();
+		const math::Float2 texels[3] = { math::Float2(1.0f, 2.0f), math::Float2(3.0f, 4.0f), math::Float2(5.0f, 6.0f) };
+		LookUpTableFile::Table table;
+		table.mId = 7;
+		table.mFormat = TextureFormat::R32G32;
+		table.mWidth = 3;
+		table.mHeight = 1;
+		table.mTexels = texels;
+		const bool is_written = LookUpTableFile::Write(path, 0x1234, 4, { table });
+		assert(is_written);
+		{
+			std::unique_ptr<LookUpTableFile> file = LookUpTableFile::Open(path);
+			assert(file && file->GetParameterHash() == 0x1234 && file->GetTables().size() == 1);
+			assert(file->GetView2D(7).At(2, 0).y == 6.0f && !file->FindTable(0));
+			assert(file->GetHeader().mFileSize == std::filesystem::file_size(path));
+		}
+
+		const std::uint32_t major_version = LookUpTableFileHeader::sMajorVersion + 1;
+		{
+			std::fstream stream(path, std::ios::binary | std::ios::in | std::ios::out);
+			stream.seekp(offsetof(LookUpTableFileHeader, mMajorVersion));
+			stream.write(reinterpret_cast<const char*>(&major_version), sizeof(major_version));
+		}
+		assert(!LookUpTableFile::Open(path));
+		std::filesystem::resize_file(path, sizeof(LookUpTableFileHeader) + 8);
+		assert(!LookUpTableFile::Open(path));
+		std::filesystem::remove(path);
+	}
+
+	// LUT parametrization round trip
+	//	(view zenith is not invertible next to the horizon, check that it stays on the correct side instead)
+	for (size_t z = 0; z < TEX4D_W; ++z)
+	{
+		for (size_t y = 0; y < TEX4D_V; ++y)
+		{
+			for (size_t x = 0; x < TEX4D_U; ++x)
+			{
+				const math::Float3 uvw((x + 0.5f) / TEX4D_U, (y + 0.5f) / TEX4D_V, (z + 0.5f) / TEX4D_W);
+				float height, cos_view_zenith, cos_light_zenith;
+				LUTCoordToWorldCoord(uvw, height, cos_view_zenith, cos_light_zenith);
+				const math::Float3 uvw2 = WorldCoordToLUTCoord(height, cos_view_zenith, cos_light_zenith);
+				assert(math::NearlyEqual(uvw.x, uvw2.x, 1e-3f));
+				assert(math::NearlyEqual(uvw.z, uvw2.z, 1e-3f));
+				assert((y < TEX4D_V / 2) == (cos_view_zenith < GetCosHorizonAngle(height)));
+				assert((y < TEX4D_V / 2) == (uvw2.y < 0.5f));
+			}
+		}
+	}
+
+	// Spherical Fibonacci directions are unit vectors and integrate the phase functions to 1 for any view direction
+	for (int num_samples : { 16, 64 })
+	{
+		math::Float3 mean(0.0f);
+		for (int i = 0; i < num_samples; ++i)
+		{
+			const math::Float3 dir = SphericalFibonacci(i, num_samples);
+			assert(math::NearlyEqual(math::L2Norm(dir), 1.0f, 1e-5f));
+			mean += dir / float(num_samples);
+		}
+		assert(math::L2Norm(mean) < 2.0f / float(num_samples));
+
+		for (float cos_view_zenith : { 1.0f, 0.3f, 0.0f, -0.7f })
+		{
+			const math::Float3 view_dir = ComputeViewDir(cos_view_zenith);
+			float rayleigh = 0.0f, mie = 0.0f;
+			for (int i = 0; i < num_samples; ++i)
+			{
+				const float mu = math::InnerProduct(view_dir, SphericalFibonacci(i, num_samples));
+				rayleigh += RayleighPhase(mu) * 4.0f * math::PI<float> / float(num_samples);
+				mie += CornetteShanksPhaseFunc(mu, 0.0f) * 4.0f * math::PI<float> / float(num_samples);
+			}
+			assert(math::NearlyEqual(rayleigh, 1.0f, 2e-2f) && math::NearlyEqual(mie, 1.0f, 2e-2f));
+		}
+	}
+
+	// The Fibonacci gather of the engine weighs every texel with the phase of its own view direction (GatherInscatterPS.hlsl),
+	// which depends on the height through the horizon angle
+	{
+		using Engine = CpuPrecomputedAtmosphericScattering;
+		Engine::Desc desc;
+		desc.mOpticalDepthWidth = 64;
+		desc.mOpticalDepthHeight = 64;
+		desc.mInscatterWidth = 6;
+		desc.mInscatterHeight = 32;
+		desc.mInscatterDepth = 8;
+		desc.mGatherQuadrature = GatherQuadrature::SphericalFibonacci;
+		desc.mNumGatherSamples = 32;
+		Engine engine(desc);
+		engine.SetNumScattering(2);	// the gather of the single scattering
+		engine.GeneratePrecomputedTexture();
+		const Engine::View3D single_r = engine.GetSingleScatteringTexture(Engine::RAYLEIGH);
+		const Engine::View3D single_m = engine.GetSingleScatteringTexture(Engine::MIE);
+		const Engine::View3D gathered_r = engine.GetInscatterGatherTexture(Engine::RAYLEIGH);
+		const Engine::View3D gathered_m = engine.GetInscatterGatherTexture(Engine::MIE);
+		const math::Float3 resolution(float(desc.mInscatterWidth), float(desc.mInscatterHeight), float(desc.mInscatterDepth));
+		for (size_t z : { size_t(0), desc.mInscatterDepth / 2, desc.mInscatterDepth - 1 })
+		{
+			for (size_t y = 0; y < desc.mInscatterHeight; ++y)
+			{
+				for (size_t x = 0; x < desc.mInscatterWidth; ++x)
+				{
+					const math::Float3 uvw((x + 0.5f) / resolution.x, (y + 0.5f) / resolution.y, (z + 0.5f) / resolution.z);
+					float height, cos_view_zenith, cos_sun_zenith;
+					LUTCoordToWorldCoord(uvw, height, cos_view_zenith, cos_sun_zenith, resolution);
+					const math::Float3 start_pos(0.0f, height, 0.0f);
+					const math::Float3 view_dir = ComputeViewDir(cos_view_zenith);
+					const math::Float3 light_dir = ComputeLightDir(view_dir, cos_sun_zenith);
+					math::Float3 expected_r(0.0f), expected_m(0.0f);
+					for (int i = 0; i < int(desc.mNumGatherSamples); ++i)
+					{
+						const math::Float3 dir = SphericalFibonacci(i, int(desc.mNumGatherSamples));
+						const float mu = math::InnerProduct(view_dir, dir);
+						math::Float3 inscatter_r, inscatter_m;
+						LookUpPrecomputedScatteringSeparated(start_pos, dir, light_dir, single_r, single_m, inscatter_r, inscatter_m);
+						expected_r += inscatter_r * RayleighPhase(mu) * 4.0f * math::PI<float> / float(desc.mNumGatherSamples);
+						expected_m += inscatter_m * CornetteShanksPhaseFunc(mu, 0.0f) * 4.0f * math::PI<float> / float(desc.mNumGatherSamples);
+					}
+					const math::Float4& texel_r = gathered_r.At(x, y, z);
+					const math::Float4& texel_m = gathered_m.At(x, y, z);
+					for (int c = 0; c < 3; ++c)
+					{
+						assert(math::NearlyEqual(texel_r[c], expected_r[c], 1e-4f * expected_r[c] + 1e-9f));
+						assert(math::NearlyEqual(texel_m[c], expected_m[c], 1e-4f * expected_m[c] + 1e-9f));
+					}
+				}
+			}
+		}
+	}
+
+	// CPU precomputation is deterministic regardless of the number of threads
+	{
+		const std::string cache_directory = (std::filesystem::temp_directory_path() / "atmosphere_test_cache").string();
+		std::filesystem::remove_all(cache_directory);
+
+		CpuPrecomputedAtmosphericScattering::Desc desc;
+		desc.mOpticalDepthWidth = 64;
+		desc.mOpticalDepthHeight = 64;
+		desc.mNumThreads = 1;
+		desc.mCacheDirectory = cache_directory;
+		CpuPrecomputedAtmosphericScattering single_thread(desc);
+		desc.mCacheDirectory.clear();
+		desc.mNumThreads = 3;
+		desc.mTileWidth = 5;	// tiles that do not divide the table
+		desc.mTileHeight = 7;
+		desc.mTileDepth = 3;
+		CpuPrecomputedAtmosphericScattering multi_thread(desc);
+		single_thread.SetNumScattering(1);
+		multi_thread.SetNumScattering(1);
+		single_thread.GeneratePrecomputedTexture();
+		multi_thread.GeneratePrecomputedTexture();
+		assert(!single_thread.IsLoadedFromCache());
+		assert(single_thread.GetNumScatteringComputed() == 1 && single_thread.GetScatteringIncrements().empty());
+
+		const auto& a = single_thread.GetPackedTotalInscatterTexture();
+		const auto& b = multi_thread.GetPackedTotalInscatterTexture();
+		const auto& a_optical_depth = single_thread.GetOpticalDepthTexture();
+		assert(std::memcmp(a.GetData(), b.GetData(), a.GetNumTexels() * sizeof(math::Float4)) == 0);
+
+		for (size_t i = 0; i < a.GetNumTexels(); ++i)
+		{
+			const math::Float4& texel = a.GetData()[i];
+			for (size_t c = 0; c < 4; ++c)
+				assert(std::isfinite(texel[c]) && texel[c] >= 0.0f);
+
+			// The packed table is the packing of the totals
+			const math::Float4& total_r = single_thread.GetTotalInscatterTexture(CpuPrecomputedAtmosphericScattering::RAYLEIGH).GetData()[i];
+			const math::Float4& total_m = single_thread.GetTotalInscatterTexture(CpuPrecomputedAtmosphericScattering::MIE).GetData()[i];
+			const math::Float4 packed = PackInscatter(math::Float3(total_r.x, total_r.y, total_r.z), math::Float3(total_m.x, total_m.y, total_m.z));
+			assert(std::memcmp(&packed, &texel, sizeof(math::Float4)) == 0);
+		}
+
+		// A second run with the same parameters is served by the on-disk cache
+		{
+			desc.mCacheDirectory = cache_directory;
+			CpuPrecomputedAtmosphericScattering cached(desc);
+			cached.SetNumScattering(1);
+			cached.GeneratePrecomputedTexture();
+			assert(cached.IsLoadedFromCache());
+			assert(cached.GetNumScatteringComputed() == 1);
+			const auto& c = cached.GetPackedTotalInscatterTexture();
+			assert(std::memcmp(a.GetData(), c.GetData(), a.GetNumTexels() * sizeof(math::Float4)) == 0);
+			const auto& od = cached.GetOpticalDepthTexture();
+			assert(std::memcmp(a_optical_depth.GetData(), od.GetData(), od.GetNumTexels() * sizeof(math::Float2)) == 0);
+			assert(!cached.GetSingleScatteringTexture(CpuPrecomputedAtmosphericScattering::RAYLEIGH).IsValid());	// nothing was computed
+
+			// The cache entry is a LookUpTableFile, sampled in place from the mapping
+			std::unique_ptr<LookUpTableFile> file = LookUpTableFile::Open(LookUpTableCache(cache_directory).GetPath(cached.GetCacheKey()));
+			assert(file && file->GetNumScattering() == 1 && file->GetParameterHash() == cached.GetCacheKey());
+			for (const LookUpTableFile::Table& table : file->GetTables())
+				assert(reinterpret_cast<std::uintptr_t>(table.mTexels) % LookUpTableFile::sAlignment == 0);
+			const LookUpTableView3D<math::Float4> packed = file->GetView3D(LookUpTableCache::PACK_INSCATTER);
+			const math::Float3 uvw(0.3f, 0.7f, 0.4f);
+			const math::Float4 mapped_texel = packed.Sample(uvw);
+			const math::Float4 texel = a.Sample(uvw);
+			assert(packed.IsValid() && std::memcmp(&mapped_texel, &texel, sizeof(math::Float4)) == 0);
+			assert(!file->GetView3D(LookUpTableCache::OPTICAL_DEPTH).IsValid());	// wrong format
+			assert(file->GetView2D(LookUpTableCache::OPTICAL_DEPTH).GetWidth() == desc.mOpticalDepthWidth);
+
+			// Writers of the same key each have their own temporary file, the entry is always a whole one
+			{
+				const LookUpTableCache cache(cache_directory);
+				const std::vector<LookUpTableFile::Table> tables(file->GetTables());
+				std::atomic<int> num_stored{ 0 };
+				std::vector<std::thread> writers;
+				for (int w = 0; w < 4; ++w)
+				{
+					writers.emplace_back([&]()
+					{
+						for (int i = 0; i < 4; ++i)
+							num_stored += cache.Store(cached.GetCacheKey(), 1, tables) ? 1 : 0;
+					});
+				}
+				for (std::thread& writer : writers)
+					writer.join();
+				assert(num_stored > 0);
+				std::unique_ptr<LookUpTableFile> stored = cache.Load(cached.GetCacheKey());
+				assert(stored && std::memcmp(stored->GetView3D(LookUpTableCache::PACK_INSCATTER).GetData(), a.GetData(), a.GetNumTexels() * sizeof(math::Float4)) == 0);
+				for (const auto& entry : std::filesystem::directory_iterator(cache_directory))
+					assert(entry.path().extension() != ".tmp");
+			}
+
+			// A bake that runs a stage after the hit starts from copies of the mapped tables, the stages they hold are not run again
+			cached.GetParam().mMieSctrCoeff = math::Float3(25.0f, 25.0f, 25.0f);
+			cached.GeneratePrecomputedTexture();
+			assert(!cached.IsLoadedFromCache() && cached.GetNumStageExecutions(CpuPrecomputedAtmosphericScattering::BUF_OPTICAL_DEPTH) == 0);
+			assert(std::memcmp(a_optical_depth.GetData(), cached.GetOpticalDepthTexture().GetData(), a_optical_depth.GetNumTexels() * sizeof(math::Float2)) == 0);
+			multi_thread.GetParam() = cached.GetParam();
+			multi_thread.GeneratePrecomputedTexture();
+			const auto& mie_changed = multi_thread.GetPackedTotalInscatterTexture();
+			assert(std::memcmp(mie_changed.GetData(), cached.GetPackedTotalInscatterTexture().GetData(), mie_changed.GetNumTexels() * sizeof(math::Float4)) == 0);
+			cached.GetParam() = single_thread.GetParam();
+
+			// Any change of the inputs is a miss
+			cached.SetNumScattering(2);
+			assert(cached.GetCacheKey() != single_thread.GetCacheKey());
+			cached.SetNumScattering(1);
+			cached.GetParam().mMieScaleHeight += 0.1f;
+			assert(cached.GetCacheKey() != single_thread.GetCacheKey());
+			CpuPrecomputedAtmosphericScattering::Desc converging_desc = desc;
+			converging_desc.mConvergenceThreshold = 1e-3f;
+			CpuPrecomputedAtmosphericScattering converging(converging_desc);
+			converging.SetNumScattering(1);
+			assert(converging.GetCacheKey() != single_thread.GetCacheKey());
+			std::filesystem::remove_all(cache_directory);
+		}
+
+		// The 4d table follows the azimuth of a low sun where the 3d table cannot, and goes through the cache
+		{
+			using Engine = CpuPrecomputedAtmosphericScattering;
+			Engine::Desc desc_4d = desc;
+			desc_4d.mInscatter4dSlices = 4;
+			Engine with_azimuth(desc_4d);
+			with_azimuth.SetNumScattering(1);
+			with_azimuth.GeneratePrecomputedTexture();
+			assert(with_azimuth.HasInscatter4d() && with_azimuth.GetNumStageExecutions(Engine::BUF_INSCATTER_4D) == 1);
+			assert(with_azimuth.GetCacheKey() != single_thread.GetCacheKey());
+			assert(std::memcmp(a.GetData(), with_azimuth.GetPackedTotalInscatterTexture().GetData(), a.GetNumTexels() * sizeof(math::Float4)) == 0);
+			const LookUpTableView4D<math::Float4> packed_4d = with_azimuth.GetPackedInscatter4dTexture();
+			assert(packed_4d.GetNumSlices() == 4 && packed_4d.GetDepth() == desc.mInscatterDepth);
+
+			// Along the horizon with the sun on the horizon, toward, across and away from it
+			const PrecomputedSctrParams params_4d = with_azimuth.GetKernelParameters();
+			const math::Float3 position(0.0f, 1.0f, 0.0f);
+			const math::Float3 view_dir = ComputeViewDir(0.05f);
+			const math::Float4 distances = RayDoubleSphereIntersect(position - EarthCenter(), view_dir, math::Float2(EARTH_RADIUS, ATM_TOP_RADIUS));
+			double error_3d = 0.0, error_4d = 0.0;
+			for (float azimuth : { 0.0f, 1.0f, 2.0f, 3.0f })
+			{
+				for (float cos_sun_zenith : { 0.02f, 0.1f })
+				{
+					const math::Float3 light_dir = ComputeLightDir4D(cos_sun_zenith, std::cos(azimuth));
+					math::Float3 reference_r, reference_m, transmittance, inscatter_r, inscatter_m;
+					SingleScattering(position, position + view_dir * distances.w, light_dir, params_4d, with_azimuth.GetOpticalDepthTexture(), with_azimuth.GetOpticalDepthMode(),
+						reference_r, reference_m, transmittance, INSCATTER_INTEGRAL_STEPS);
+					LookUpPrecomputedScatteringPacked(position, view_dir, light_dir, params_4d.mRayleighSctrCoeff, a, inscatter_r, inscatter_m);
+					for (int c = 0; c < 3; ++c)
+						error_3d += std::abs(inscatter_r[c] - reference_r[c]) / reference_r[c];
+					LookUpPrecomputedScatteringPacked4D(position, view_dir, light_dir, params_4d.mRayleighSctrCoeff, packed_4d, inscatter_r, inscatter_m);
+					for (int c = 0; c < 3; ++c)
+						error_4d += std::abs(inscatter_r[c] - reference_r[c]) / reference_r[c];
+				}
+			}
+			assert(error_4d < 0.5 * error_3d);
+
+			Engine cached_4d(desc_4d);
+			cached_4d.SetNumScattering(1);
+			cached_4d.GeneratePrecomputedTexture();
+			assert(cached_4d.IsLoadedFromCache());
+			assert(std::memcmp(packed_4d.GetData(), cached_4d.GetPackedInscatter4dTexture().GetData(), packed_4d.GetNumTexels() * sizeof(math::Float4)) == 0);
+			std::filesystem::remove_all(cache_directory);
+
+			// The slices are reduced to fit in the memory bound
+			desc_4d.mInscatter4dSlices = 16;
+			desc_4d.mMaxInscatter4dBytes = 3 * desc.mInscatterWidth * desc.mInscatterHeight * desc.mInscatterDepth * sizeof(math::Float4);
+			assert(Engine(desc_4d).GetInscatter4dResolution().w == 3.0f);
+		}
+
+		// The adaptive table reaches its maximum error with fewer texels than the table it is built from
+		{
+			const AdaptiveAxis axis({ 0.0f, 0.1f, 0.15f, 0.7f, 1.0f });
+			const detail::LinearTap tap = axis.Locate(0.4f);
+			assert(tap.i0 == 2 && tap.i1 == 3 && math::NearlyEqual(tap.t, 0.25f / 0.55f, 1e-5f));
+			assert(axis.Locate(0.1f).i0 == 1 && axis.Locate(0.1f).t == 0.0f);
+			assert(axis.Locate(2.0f).i0 == 3 && axis.Locate(2.0f).t == 1.0f && axis.Locate(-1.0f).i0 == 0 && axis.Locate(-1.0f).t == 0.0f);
+
+			// Every knot of the resolution of the reference is the reference, through the same warps
+			const AdaptiveInscatterTable full = MakeUniformInscatterTable(a, a.GetWidth(), a.GetHeight(), a.GetDepth());
+			assert(full.GetNumTexels() == a.GetNumTexels() && MeasureAdaptiveInscatterError(full, a).mMaxRelativeError < 1e-4);
+			const PrecomputedSctrParams params = single_thread.GetKernelParameters();
+			for (float cos_view_zenith : { -0.5f, -0.1f, 0.02f, 0.7f })
+			{
+				const math::Float3 position(0.0f, 3.0f, 0.0f), view_dir = ComputeViewDir(cos_view_zenith), light_dir = ComputeLightDir4D(0.3f, 0.5f);
+				math::Float3 inscatter_r, inscatter_m, expected_r, expected_m;
+				full.LookUp(position, view_dir, light_dir, params.mRayleighSctrCoeff, inscatter_r, inscatter_m);
+				LookUpPrecomputedScatteringPacked(position, view_dir, light_dir, params.mRayleighSctrCoeff, a, expected_r, expected_m);
+				for (int c = 0; c < 3; ++c)
+					assert(math::NearlyEqual(inscatter_r[c], expected_r[c], 1e-3f * expected_r[c] + 1e-6f));
+			}
+
+			AdaptiveInscatterSettings settings;
+			settings.mMaxRelativeError = 0.05f;
+			AdaptiveInscatterError built;
+			const AdaptiveInscatterTable adaptive = BuildAdaptiveInscatterTable(a, settings, &built);
+			const AdaptiveInscatterError measured = MeasureAdaptiveInscatterError(adaptive, a);
+			assert(built.mMaxRelativeError <= settings.mMaxRelativeError && std::abs(measured.mMaxRelativeError - built.mMaxRelativeError) < 1e-4);
+			assert(adaptive.GetNumTexels() < a.GetNumTexels());
+			for (size_t s = 0; s < adaptive.GetNumSlices(); ++s)
+				assert(adaptive.GetSliceAxis(s, AdaptiveInscatterTable::HEIGHT).GetNumKnots() <= a.GetDepth());
+
+			// A uniform table of half the view zenith resolution is not far from it in texels, and far from it in error
+			const AdaptiveInscatterTable uniform = MakeUniformInscatterTable(a, a.GetWidth(), a.GetHeight() / 2, a.GetDepth());
+			assert(uniform.GetNumTexels() > adaptive.GetNumTexels() / 2 && MeasureAdaptiveInscatterError(uniform, a).mMaxRelativeError > 10.0 * settings.mMaxRelativeError);
+
+			// The budget stops the refinement
+			settings.mMaxTexels = adaptive.GetNumTexels() / 2;
+			const AdaptiveInscatterTable bounded = BuildAdaptiveInscatterTable(a, settings, &built);
+			assert(bounded.GetNumTexels() <= settings.mMaxTexels && built.mMaxRelativeError > settings.mMaxRelativeError);
+		}
+
+		// A cancelled bake reports it, a background bake only delivers the latest request
+		{
+			desc.mCacheDirectory.clear();
+			const std::atomic<bool> cancel{ true };
+			CpuPrecomputedAtmosphericScattering cancelled(desc);
+			cancelled.SetNumScattering(1);
+			const bool is_finished = cancelled.GeneratePrecomputedTexture(&cancel);
+			assert(!is_finished);
+
+			AsyncPrecomputedAtmosphericScattering background(desc);
+			PrecomputedSctrParams stale_params = single_thread.GetParam();
+			stale_params.mMieScaleHeight += 0.1f;
+			background.Request(stale_params, 1);
+			const std::uint64_t id = background.Request(single_thread.GetParam(), 1);
+			background.Wait();
+			assert(!background.IsBusy() && background.GetNumCancelled() == 1);
+			std::uint64_t result_id = 0;
+			std::unique_ptr<AsyncPrecomputedAtmosphericScattering::Result> result = background.TakeResult(&result_id);
+			assert(result && result_id == id && !background.TakeResult());
+			assert(result->mParams.mMieScaleHeight == single_thread.GetParam().mMieScaleHeight && result->mNumScattering == 1);
+			assert(std::memcmp(a.GetData(), result->mPackInscatter.GetData(), a.GetNumTexels() * sizeof(math::Float4)) == 0);
+
+			// The worker keeps its engine, a request that keeps the scale heights does not compute the optical depth again
+			PrecomputedSctrParams absorbing_params = single_thread.GetParam();
+			absorbing_params.mMieAbsorption *= 1.5f;
+			background.Request(absorbing_params, 1);
+			background.Wait();
+			result = background.TakeResult();
+			using Engine = CpuPrecomputedAtmosphericScattering;
+			assert(result && result->mTimings.GetStageTotal(Engine::BUF_OPTICAL_DEPTH).mNumTexels == 0);
+			assert(result->mTimings.GetStageTotal(Engine::BUF_SINGLE_SCATTERING).mNumTexels > 0);
+			assert(std::memcmp(a_optical_depth.GetData(), result->mOpticalDepth.GetData(), a_optical_depth.GetNumTexels() * sizeof(math::Float2)) == 0);
+		}
+
+		// Only the stages whose inputs changed run again
+		{
+			using Engine = CpuPrecomputedAtmosphericScattering;
+			Engine incremental(desc);
+			incremental.SetNumScattering(1);
+			incremental.GeneratePrecomputedTexture();
+			assert(incremental.GetNumStageExecutions(Engine::BUF_OPTICAL_DEPTH) == 1 && incremental.GetNumStageExecutions(Engine::BUF_PACK_INSCATTER) == 1);
+			incremental.GeneratePrecomputedTexture();
+			for (int stage = 0; stage < Engine::NUM_BUFFERS; ++stage)
+				assert(incremental.GetNumStageExecutions(Engine::BufferType(stage)) == 0);
+
+			const float mie_absorption = incremental.GetParam().mMieAbsorption;
+			incremental.GetParam().mMieAbsorption = 1.5f * mie_absorption;
+			incremental.GeneratePrecomputedTexture();
+			assert(incremental.GetNumStageExecutions(Engine::BUF_OPTICAL_DEPTH) == 0);
+			assert(incremental.GetNumStageExecutions(Engine::BUF_SINGLE_SCATTERING) == 1 && incremental.GetNumStageExecutions(Engine::BUF_PACK_INSCATTER) == 1);
+			assert(std::memcmp(a.GetData(), incremental.GetPackedTotalInscatterTexture().GetData(), a.GetNumTexels() * sizeof(math::Float4)) != 0);
+
+			incremental.GetParam().mMieAbsorption = mie_absorption;
+			incremental.GeneratePrecomputedTexture();
+			assert(std::memcmp(a.GetData(), incremental.GetPackedTotalInscatterTexture().GetData(), a.GetNumTexels() * sizeof(math::Float4)) == 0);
+		}
+
+		// An atlas reproduces its grid points, and blends in between
+		{
+			LookUpTableAtlas::Desc atlas_desc;
+			atlas_desc.mEngineDesc = desc;
+			atlas_desc.mBaseParams = single_thread.GetParam();
+			atlas_desc.mNumScattering = 1;
+			LookUpTableAtlas::Axis axis;
+			axis.mParameter = AtlasParameter::MieAbsorption;
+			axis.mMin = atlas_desc.mBaseParams.mMieAbsorption;
+			axis.mMax = 2.0f * axis.mMin;
+			axis.mNumPoints = 2;
+			atlas_desc.mAxes.push_back(axis);
+			LookUpTableAtlas atlas(atlas_desc);
+			const bool is_built = atlas.Build();
+			assert(is_built && atlas.GetNumPoints() == 2);
+			assert(atlas.GetMemorySize() == desc.mOpticalDepthWidth * desc.mOpticalDepthHeight * sizeof(math::Float2) + 2 * 3 * a.GetNumTexels() * sizeof(math::Float4));
+
+			PrecomputedSctrParams params = atlas_desc.mBaseParams;
+			assert(atlas.Contains(params));
+			std::unique_ptr<LookUpTableAtlas::Tables> tables = atlas.Blend(params);
+			const auto& od = single_thread.GetOpticalDepthTexture();
+			assert(std::memcmp(od.GetData(), tables->mOpticalDepth.GetData(), od.GetNumTexels() * sizeof(math::Float2)) == 0);
+
+			// Halfway : the geometric mean of the grid points, texel by texel
+			params.mMieAbsorption = 1.5f * axis.mMin;
+			assert(atlas.Contains(params));
+			std::unique_ptr<LookUpTableAtlas::Tables> halfway = atlas.Blend(params);
+			params.mMieAbsorption = axis.mMax;
+			std::unique_ptr<LookUpTableAtlas::Tables> upper = atlas.Blend(params);
+			for (size_t i = 0; i < a.GetNumTexels(); ++i)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					const double lower = a.GetData()[i][c];
+					const double upper_texel = upper->mPackInscatter.GetData()[i][c];
+					if (lower < 1e-20 || upper_texel < 1e-20)
+						continue;	// the blend floors the log
+					assert(std::abs(tables->mPackInscatter.GetData()[i][c] - lower) <= 1e-5 * lower);
+					const double expected = std::sqrt(lower * upper_texel);
+					assert(std::abs(halfway->mPackInscatter.GetData()[i][c] - expected) <= 1e-5 * expected);
+				}
+			}
+
+			params.mMieScaleHeight += 0.1f;	// not an axis
+			assert(!atlas.Contains(params));
+			params = atlas_desc.mBaseParams;
+			params.mMieAbsorption = 3.0f * axis.mMin;	// out of range
+			assert(!atlas.Contains(params));
+		}
+
+		// The inscatter resolution is a property of the desc : the tables, the cache key and the LUT coordinates follow it
+		{
+			CpuPrecomputedAtmosphericScattering::Desc coarse_desc = desc;
+			coarse_desc.mInscatterWidth = 6;
+			coarse_desc.mInscatterHeight = 16;
+			coarse_desc.mInscatterDepth = 4;
+			CpuPrecomputedAtmosphericScattering coarse(coarse_desc);
+			coarse.SetNumScattering(1);
+			assert(coarse.GetCacheKey() != single_thread.GetCacheKey());
+			coarse.GeneratePrecomputedTexture();
+			const auto& coarse_packed = coarse.GetPackedTotalInscatterTexture();
+			assert(coarse_packed.GetWidth() == 6 && coarse_packed.GetHeight() == 16 && coarse_packed.GetDepth() == 4);
+			for (size_t i = 0; i < coarse_packed.GetNumTexels(); ++i)
+				for (size_t c = 0; c < 4; ++c)
+					assert(std::isfinite(coarse_packed.GetData()[i][c]) && coarse_packed.GetData()[i][c] >= 0.0f);
+
+			const math::Float3 resolution = coarse.GetInscatterResolution();
+			const math::Float3 uvw((2 + 0.5f) / 6.0f, (11 + 0.5f) / 16.0f, (1 + 0.5f) / 4.0f);
+			float height, cos_view_zenith, cos_light_zenith;
+			LUTCoordToWorldCoord(uvw, height, cos_view_zenith, cos_light_zenith, resolution);
+			const math::Float3 uvw2 = WorldCoordToLUTCoord(height, cos_view_zenith, cos_light_zenith, resolution);
+			assert(math::NearlyEqual(uvw.x, uvw2.x, 1e-3f) && math::NearlyEqual(uvw.z, uvw2.z, 1e-3f) && uvw2.y > 0.5f);
+
+			// The 2nd order resumes the loop and is added to the totals in place
+			coarse.SetNumScattering(2);
+			coarse.GeneratePrecomputedTexture();
+			assert(coarse.GetNumStageExecutions(CpuPrecomputedAtmosphericScattering::BUF_SINGLE_SCATTERING) == 0);
+			assert(coarse.GetNumStageExecutions(CpuPrecomputedAtmosphericScattering::BUF_ACCUMULATE_INSCATTER) == 1);
+			for (auto index : { CpuPrecomputedAtmosphericScattering::RAYLEIGH, CpuPrecomputedAtmosphericScattering::MIE })
+			{
+				for (size_t i = 0; i < coarse_packed.GetNumTexels(); ++i)
+				{
+					const math::Float4 expected = coarse.GetSingleScatteringTexture(index).GetData()[i] + coarse.GetMultipleScatteringTexture(index).GetData()[i];
+					assert(std::memcmp(&expected, &coarse.GetTotalInscatterTexture(index).GetData()[i], sizeof(math::Float4)) == 0);
+				}
+			}
+
+			// The timings cover the stages that ran, once per order in the loop
+			const BakeTimings& timings = coarse.GetBakeTimings();
+			assert(timings.mNumScattering == 2 && timings.mTotalMs > 0.0);
+			for (auto stage : { CpuPrecomputedAtmosphericScattering::BUF_GATHER_INSCATTER, CpuPrecomputedAtmosphericScattering::BUF_MULTIPLE_SCATTERING,
+				CpuPrecomputedAtmosphericScattering::BUF_ACCUMULATE_INSCATTER, CpuPrecomputedAtmosphericScattering::BUF_PACK_INSCATTER })
+			{
+				const BakeStageTiming total = timings.GetStageTotal(stage);
+				assert(total.mNumTexels == 6 * 16 * 4 && total.mNumSamples >= total.mNumTexels && total.mWallMs >= 0.0);
+			}
+			assert(timings.GetStageTotal(CpuPrecomputedAtmosphericScattering::BUF_SINGLE_SCATTERING).mNumTexels == 0);
+			assert(timings.GetStageTotal(CpuPrecomputedAtmosphericScattering::BUF_MULTIPLE_SCATTERING).mNumSamples == coarse.GetIntegrationStats().mNumSamples);
+			const std::string json = ToJson(timings);
+			assert(json.find("\"gather_inscatter\"") != std::string::npos && json.find("\"samples_per_s\"") != std::string::npos);
+
+			// The sky irradiance of the orders adds up to the irradiance of the totals, it is brighter at noon than at sunset
+			const auto& irradiance = coarse.GetIrradianceTexture();
+			assert(irradiance.GetWidth() == IRRADIANCE_U && irradiance.GetHeight() == IRRADIANCE_V);
+			assert(coarse.GetNumStageExecutions(CpuPrecomputedAtmosphericScattering::BUF_IRRADIANCE) == 1);
+			for (size_t i = 0; i < irradiance.GetNumTexels(); ++i)
+				for (size_t c = 0; c < 3; ++c)
+					assert(std::isfinite(irradiance.GetData()[i][c]) && irradiance.GetData()[i][c] >= 0.0f);
+			for (size_t y : { size_t(3), size_t(IRRADIANCE_V / 2), size_t(IRRADIANCE_V - 1) })
+			{
+				const math::Float2 uv(0.5f / IRRADIANCE_U, (float(y) + 0.5f) / IRRADIANCE_V);
+				float irradiance_height, cos_sun_zenith;
+				SunlightLUTCoordToWorldCoord(uv, irradiance_height, cos_sun_zenith);
+				const math::Float3 expected = IntegrateSkyIrradiance(irradiance_height, cos_sun_zenith,
+					coarse.GetTotalInscatterTexture(CpuPrecomputedAtmosphericScattering::RAYLEIGH), coarse.GetTotalInscatterTexture(CpuPrecomputedAtmosphericScattering::MIE));
+				for (int c = 0; c < 3; ++c)
+					assert(std::abs(irradiance.At(0, y)[c] - expected[c]) <= 1e-4f * expected[c] + 1e-9f);
+			}
+			const math::Float2 noon = WorldCoordToSunlightLUTCoord(0.1f, 1.0f);
+			const math::Float2 sunset = WorldCoordToSunlightLUTCoord(0.1f, 0.0f);
+			assert(irradiance.Sample(noon).z > irradiance.Sample(sunset).z);
+
+			SkyIrradianceTables sky_irradiance;
+			sky_irradiance.mIrradiance = irradiance;
+			const math::Float3 ground(1.0f, 0.1f, 2.0f);
+			const math::Float3 sun_dir = math::L2Normalize(math::Float3(0.3f, 0.6f, 0.1f));
+			const math::Float3 up = math::L2Normalize(ground - EarthCenter());
+			const math::Float4 texel = irradiance.Sample(WorldCoordToSunlightLUTCoord(0.1f, math::InnerProduct(up, sun_dir)));
+			const math::Float3 facing_up = SkyIrradiance(sky_irradiance, ground, sun_dir);
+			for (int c = 0; c < 3; ++c)
+				assert(math::NearlyEqual(facing_up[c], texel[c] * sky_irradiance.mSunIlluminance[c], 1e-4f * facing_up[c]));
+			assert(SkyIrradiance(sky_irradiance, ground, -up, sun_dir).x == 0.0f);
+
+			// Batched irradiance matches the scalar lookup, with and without normals, including a partial packet
+			const size_t num_irradiance_queries = 21;
+			std::vector<float> irradiance_inputs(9 * num_irradiance_queries), irradiance_outputs(6 * num_irradiance_queries);
+			SkyIrradianceQueries irradiance_queries;
+			irradiance_queries.mNumQueries = num_irradiance_queries;
+			float* irradiance_reference[3];
+			float* irradiance_result[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				irradiance_queries.mPosition[c] = &irradiance_inputs[(0 + c) * num_irradiance_queries];
+				irradiance_queries.mNormal[c] = &irradiance_inputs[(3 + c) * num_irradiance_queries];
+				irradiance_queries.mLightDir[c] = &irradiance_inputs[(6 + c) * num_irradiance_queries];
+				irradiance_reference[c] = &irradiance_outputs[(0 + c) * num_irradiance_queries];
+				irradiance_result[c] = &irradiance_outputs[(3 + c) * num_irradiance_queries];
+			}
+			for (size_t i = 0; i < num_irradiance_queries; ++i)
+			{
+				const math::Float3 pos(0.5f * float(i), 0.01f + 3.0f * float(i), -0.2f * float(i));
+				const math::Float3 normal = math::L2Normalize(math::Float3(std::cos(0.9f * float(i)), 0.5f - 0.05f * float(i), std::sin(0.9f * float(i))));
+				const math::Float3 light_dir = math::L2Normalize(math::Float3(0.4f, 1.0f - 0.1f * float(i), -0.3f));
+				for (int c = 0; c < 3; ++c)
+				{
+					irradiance_inputs[(0 + c) * num_irradiance_queries + i] = pos[c];
+					irradiance_inputs[(3 + c) * num_irradiance_queries + i] = normal[c];
+					irradiance_inputs[(6 + c) * num_irradiance_queries + i] = light_dir[c];
+				}
+			}
+			for (bool has_normal : { true, false })
+			{
+				for (int c = 0; c < 3; ++c)
+					irradiance_queries.mNormal[c] = has_normal ? &irradiance_inputs[(3 + c) * num_irradiance_queries] : nullptr;
+				SkyIrradianceBatch(SimdInstructionSet::Scalar, sky_irradiance, irradiance_queries, irradiance_reference);
+				for (SimdInstructionSet instruction_set : { SimdInstructionSet::AVX2, SimdInstructionSet::AVX512 })
+				{
+					if (!IsSimdInstructionSetSupported(instruction_set))
+						continue;
+					SkyIrradianceBatch(instruction_set, sky_irradiance, irradiance_queries, irradiance_result);
+					for (size_t i = 0; i < num_irradiance_queries; ++i)
+						for (int c = 0; c < 3; ++c)
+							assert(std::abs(irradiance_result[c][i] - irradiance_reference[c][i]) <= 1e-3f * irradiance_reference[c][i] + 1e-6f);
+				}
+			}
+		}
+
+		// SIMD packet kernels match the scalar SingleScattering(), including partial packets and rays that end early
+		const PrecomputedSctrParams params = single_thread.GetKernelParameters();
+		RayPacket rays;
+		rays.mNumRays = 13;
+		for (size_t i = 0; i < rays.mNumRays; ++i)
+		{
+			const float cos_view_zenith = -0.3f + 0.1f * float(i);
+			const math::Float3 start_pos(0.0f, 0.5f + float(i), 0.0f);
+			const math::Float3 view_dir = ComputeViewDir(cos_view_zenith);
+			const math::Float3 light_dir = ComputeLightDir(view_dir, 0.8f - 0.12f * float(i));
+			const math::Float4 distances = RayDoubleSphereIntersect(start_pos - EarthCenter(), view_dir, math::Float2(EARTH_RADIUS, ATM_TOP_RADIUS));
+			const float ray_distance = (distances.x > 0) ? std::min(distances.x, distances.w) : distances.w;
+			const math::Float3 end_pos = start_pos + view_dir * ray_distance;
+			for (int c = 0; c < 3; ++c)
+			{
+				rays.mStartPos[c][i] = start_pos[c];
+				rays.mEndPos[c][i] = end_pos[c];
+				rays.mLightDir[c][i] = light_dir[c];
+			}
+			rays.mNumSteps[i] = (i % 3 == 0) ? 64 : 512;
+		}
+
+		for (OpticalDepthMode optical_depth_mode : { OpticalDepthMode::Table, OpticalDepthMode::Analytic })
+		{
+			SingleScatteringPacketResult reference;
+			SingleScatteringPacket(SimdInstructionSet::Scalar, params, a_optical_depth, optical_depth_mode, rays, reference);
+			for (SimdInstructionSet instruction_set : { SimdInstructionSet::AVX2, SimdInstructionSet::AVX512 })
+			{
+				if (!IsSimdInstructionSetSupported(instruction_set))
+					continue;
+				SingleScatteringPacketResult result;
+				SingleScatteringPacket(instruction_set, params, a_optical_depth, optical_depth_mode, rays, result);
+				for (size_t i = 0; i < rays.mNumRays; ++i)
+				{
+					for (int c = 0; c < 3; ++c)
+					{
+						assert(std::abs(result.mInscatterR[c][i] - reference.mInscatterR[c][i]) <= 1e-4f * reference.mInscatterR[c][i] + 1e-7f);
+						assert(std::abs(result.mInscatterM[c][i] - reference.mInscatterM[c][i]) <= 1e-4f * reference.mInscatterM[c][i] + 1e-7f);
+						assert(std::abs(result.mTransmittance[c][i] - reference.mTransmittance[c][i]) <= 1e-4f * reference.mTransmittance[c][i] + 1e-7f);
+					}
+				}
+			}
+		}
+
+		// Batched sky radiance queries match the scalar SkyRadiance(), including a partial packet,
+		// rays that hit the ground and positions above the atmosphere
+		{
+			SkyRadianceTables sky;
+			sky.mPackedInscatter = a;
+			sky.mOpticalDepth = a_optical_depth;
+			sky.mParams = params;
+
+			const size_t num_queries = 37;
+			std::vector<float> inputs(9 * num_queries), outputs(12 * num_queries);
+			SkyRadianceQueries queries;
+			SkyRadianceResults reference, result;
+			queries.mNumQueries = num_queries;
+			for (int c = 0; c < 3; ++c)
+			{
+				queries.mPosition[c] = &inputs[(0 + c) * num_queries];
+				queries.mViewDir[c] = &inputs[(3 + c) * num_queries];
+				queries.mLightDir[c] = &inputs[(6 + c) * num_queries];
+				reference.mRadiance[c] = &outputs[(0 + c) * num_queries];
+				reference.mTransmittance[c] = &outputs[(3 + c) * num_queries];
+				result.mRadiance[c] = &outputs[(6 + c) * num_queries];
+				result.mTransmittance[c] = &outputs[(9 + c) * num_queries];
+			}
+			for (size_t i = 0; i < num_queries; ++i)
+			{
+				const math::Float3 pos(0.3f * float(i), (i % 5 == 4) ? 300.0f : 0.05f + 2.0f * float(i), 0.0f);
+				const float cos_view_zenith = -0.9f + 0.05f * float(i);
+				const float azimuth = 0.7f * float(i);
+				const float sin_view_zenith = std::sqrt(1.0f - cos_view_zenith * cos_view_zenith);
+				const math::Float3 view_dir(sin_view_zenith * std::cos(azimuth), cos_view_zenith, sin_view_zenith * std::sin(azimuth));
+				const math::Float3 light_dir = math::L2Normalize(math::Float3(0.5f, 1.0f - 0.06f * float(i), 0.2f));
+				for (int c = 0; c < 3; ++c)
+				{
+					inputs[(0 + c) * num_queries + i] = pos[c];
+					inputs[(3 + c) * num_queries + i] = view_dir[c];
+					inputs[(6 + c) * num_queries + i] = light_dir[c];
+				}
+			}
+
+			SkyRadianceBatch(SimdInstructionSet::Scalar, sky, queries, reference);
+			for (size_t i = 0; i < num_queries; ++i)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					assert(std::isfinite(reference.mRadiance[c][i]) && reference.mRadiance[c][i] >= 0.0f);
+					assert(reference.mTransmittance[c][i] >= 0.0f && reference.mTransmittance[c][i] <= 1.0f);
+				}
+			}
+			assert(reference.mRadiance[0][24] == 0.0f && reference.mTransmittance[0][24] == 1.0f);	// above the atmosphere, looking away
+
+			for (SimdInstructionSet instruction_set : { SimdInstructionSet::AVX2, SimdInstructionSet::AVX512 })
+			{
+				if (!IsSimdInstructionSetSupported(instruction_set))
+					continue;
+				SkyRadianceBatch(instruction_set, sky, queries, result);
+				for (size_t i = 0; i < num_queries; ++i)
+				{
+					for (int c = 0; c < 3; ++c)
+					{
+						assert(std::abs(result.mRadiance[c][i] - reference.mRadiance[c][i]) <= 1e-3f * reference.mRadiance[c][i] + 1e-6f);
+						assert(std::abs(result.mTransmittance[c][i] - reference.mTransmittance[c][i]) <= 1e-3f * reference.mTransmittance[c][i] + 1e-6f);
+					}
+				}
+			}
+
+			// The renderer shades every pixel with SkyRadiance() along the direction of its center, whatever the tiling
+			SkyRenderer::Desc renderer_desc;
+			renderer_desc.mNumThreads = 2;
+			renderer_desc.mTileSize = 5;
+			renderer_desc.mInstructionSet = SimdInstructionSet::Scalar;
+			SkyRenderer renderer(renderer_desc);
+			SkyView view;
+			view.mWidth = 23;
+			view.mHeight = 11;
+			view.mLightDir = math::L2Normalize(math::Float3(0.3f, 0.4f, 0.8f));
+			view.mExposureCompensation = 0.0f;
+			view.mToneMap = false;
+			for (SkyProjection projection : { SkyProjection::Perspective, SkyProjection::Equirectangular, SkyProjection::Cubemap })
+			{
+				view.mProjection = projection;
+				SkyImage image;
+				renderer.Render(sky, view, image);
+				assert(image.mNumFaces == ((projection == SkyProjection::Cubemap) ? 6u : 1u));
+				assert(image.mPixels.size() == image.mWidth * image.mHeight * image.mNumFaces);
+				for (size_t face = 0; face < image.mNumFaces; ++face)
+				{
+					for (size_t y = 0; y < image.mHeight; y += 3)
+					{
+						for (size_t x = 0; x < image.mWidth; x += 4)
+						{
+							const math::Float3 view_dir = SkyRenderer::GetViewDir(view, x, y, face);
+							assert(math::NearlyEqual(math::L2Norm(view_dir), 1.0f, 1e-5f));
+							math::Float3 radiance, transmittance;
+							SkyRadiance(sky, view.mCameraPosition, view_dir, view.mLightDir, radiance, transmittance);
+							for (int c = 0; c < 3; ++c)
+								assert(math::NearlyEqual(image.At(x, y, face)[c], radiance[c], 1e-5f * radiance[c]));
+						}
+					}
+				}
+			}
+			// The center of the frame looks along the 3rd column of the camera rotation (mul() of the shader), the panoramas and the cubemaps are aligned with the world
+			view.mWidth = 2;
+			view.mHeight = 2;
+			view.mProjection = SkyProjection::Perspective;
+			view.mCameraRotation = math::Float3x3(0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f);
+			const math::Float3 center = SkyRenderer::GetViewDir(view, 0, 0) + SkyRenderer::GetViewDir(view, 1, 1);
+			assert(center.y > 0.0f && std::abs(center.x) < 1e-6f && std::abs(center.z) < 1e-6f);
+			view.mProjection = SkyProjection::Cubemap;
+			assert(SkyRenderer::GetViewDir(view, 0, 0, 2).y > 0.5f && SkyRenderer::GetViewDir(view, 1, 1, 5).z < -0.5f);
+			view.mProjection = SkyProjection::Equirectangular;
+			assert(SkyRenderer::GetViewDir(view, 0, 0).y > 0.5f && SkyRenderer::GetViewDir(view, 0, 1).y < -0.5f);
+
+			// A time-of-day sequence writes the frames in order whether the writer is pipelined or not, and stops at a failing writer
+			SkySequenceDesc sequence;
+			sequence.mView = view;
+			sequence.mView.mProjection = SkyProjection::Perspective;
+			sequence.mView.mWidth = 8;
+			sequence.mView.mHeight = 4;
+			sequence.mSunAngles = MakeDaySchedule(7);
+			assert(math::NearlyEqual(sequence.mSunAngles.front().x, 95.0f, 1e-4f) && math::NearlyEqual(sequence.mSunAngles[3].x, 20.0f, 1e-4f));
+			std::vector<SkyImage> serial_frames;
+			for (size_t queue_depth : { size_t(0), size_t(1), size_t(3) })
+			{
+				sequence.mQueueDepth = queue_depth;
+				std::vector<SkyImage> frames;
+				SkySequenceStats stats;
+				const bool is_succeeded = RenderSkySequence(renderer, sky, sequence, [&frames](size_t inFrame, const SkyImage& inImage)
+				{
+					assert(inFrame == frames.size());
+					frames.push_back(inImage);
+					return true;
+				}, &stats);
+				assert(is_succeeded && stats.mNumFrames == 7 && frames.size() == 7 && stats.GetFramesPerSecond() > 0.0);
+				if (queue_depth == 0)
+				{
+					serial_frames = frames;
+					SkyView frame_view = sequence.mView;
+					frame_view.mLightDir = GetSunDirection(sequence.mSunAngles[5]);
+					SkyImage expected;
+					renderer.Render(sky, frame_view, expected);
+					assert(std::memcmp(expected.mPixels.data(), frames[5].mPixels.data(), expected.mPixels.size() * sizeof(math::Float3)) == 0);
+				}
+				for (size_t frame = 0; frame < frames.size(); ++frame)
+					assert(std::memcmp(serial_frames[frame].mPixels.data(), frames[frame].mPixels.data(), frames[frame].mPixels.size() * sizeof(math::Float3)) == 0);
+
+				SkySequenceStats failed_stats;
+				const bool is_completed = RenderSkySequence(renderer, sky, sequence, [](size_t inFrame, const SkyImage&) { return inFrame < 2; }, &failed_stats);
+				assert(!is_completed && failed_stats.mNumFrames == 2);
+			}
+
+			// The path-traced reference does not depend on the threads nor on how the samples are split between the passes,
+			// and its noise goes down with the samples
+			PathTracerSettings tracer_settings;
+			tracer_settings.mParams = params;
+			tracer_settings.mMieAsymmetry = sky.mMieAsymmetry;
+			tracer_settings.mSunIlluminance = sky.mSunIlluminance;
+			tracer_settings.mMaxBounces = 1;	// the tables hold the single scattering
+			SkyView reference_view;
+			reference_view.mProjection = SkyProjection::Equirectangular;
+			reference_view.mWidth = 8;
+			reference_view.mHeight = 4;
+			reference_view.mLightDir = GetSunDirection(math::Float2(60.0f, 120.0f));
+			reference_view.mExposureCompensation = 0.0f;
+			reference_view.mToneMap = false;
+			PathTracedSky::Desc tracer_desc;
+			tracer_desc.mNumThreads = 1;
+			PathTracedSky serial_tracer(tracer_desc, tracer_settings, reference_view);
+			tracer_desc.mNumThreads = 3;
+			tracer_desc.mTileSize = 3;
+			PathTracedSky tracer(tracer_desc, tracer_settings, reference_view);
+			serial_tracer.Refine(16);
+			tracer.Refine(4);
+			tracer.Refine(12);
+			assert(tracer.GetNumSamples() == 16);
+			SkyImage serial_image, traced, coarse_error, fine_error;
+			serial_tracer.GetImage(serial_image);
+			tracer.GetImage(traced);
+			assert(std::memcmp(serial_image.mPixels.data(), traced.mPixels.data(), traced.mPixels.size() * sizeof(math::Float3)) == 0);
+			tracer.GetStandardError(coarse_error);
+			tracer.Refine(240);
+			tracer.GetImage(traced);
+			tracer.GetStandardError(fine_error);
+			const SkyImageError coarse_noise = CompareSkyImages(traced, coarse_error);
+			const SkyImageError fine_noise = CompareSkyImages(traced, fine_error);
+			assert(fine_noise.mMeanRelativeBias < coarse_noise.mMeanRelativeBias);
+
+			// The single scattering of the tables agrees with the reference over the sky, the upper half of the panorama
+			SkyImage lut;
+			renderer.Render(sky, reference_view, lut);
+			auto upper_half = [](const SkyImage& inImage)
+			{
+				SkyImage half = inImage;
+				half.mHeight /= 2;
+				half.mPixels.resize(half.mWidth * half.mHeight);
+				return half;
+			};
+			SkyImage error_map;
+			const SkyImageError lut_error = CompareSkyImages(upper_half(traced), upper_half(lut), &error_map);
+			assert(lut_error.mMeanRelativeError < 0.12 && std::abs(lut_error.mMeanRelativeBias) < 0.06);
+			assert(lut_error.mNumChannels == 3 * 8 * 2 && error_map.mPixels.size() == 8 * 2);
+
+			// The error of an image against itself, and of one 10% too bright
+			assert(CompareSkyImages(traced, traced).mMaxRelativeError == 0.0);
+			SkyImage brighter = traced;
+			for (math::Float3& pixel : brighter.mPixels)
+				pixel = pixel * 1.1f;
+			const SkyImageError brighter_error = CompareSkyImages(traced, brighter);
+			assert(std::abs(brighter_error.mMeanRelativeBias - 0.1) < 1e-5 && std::abs(brighter_error.mMeanRelativeError - 0.1) < 1e-5);
+
+			// From above the atmosphere looking away, nothing
+			assert(TraceSkyPath(tracer_settings, math::Float3(0.0f, 300.0f, 0.0f), math::Float3(0.0f, 1.0f, 0.0f), reference_view.mLightDir, 0, 0).x == 0.0f);
+		}
+
+		// Adaptive steps agree with a fine uniform integration, with fewer samples than INSCATTER_INTEGRAL_STEPS
+		for (size_t i = 0; i < rays.mNumRays; ++i)
+		{
+			const math::Float3 start_pos(rays.mStartPos[0][i], rays.mStartPos[1][i], rays.mStartPos[2][i]);
+			const math::Float3 end_pos(rays.mEndPos[0][i], rays.mEndPos[1][i], rays.mEndPos[2][i]);
+			const math::Float3 light_dir(rays.mLightDir[0][i], rays.mLightDir[1][i], rays.mLightDir[2][i]);
+
+			math::Float3 fine_r, fine_m, fine_t;
+			SingleScattering(start_pos, end_pos, light_dir, params, a_optical_depth, OpticalDepthMode::Analytic, fine_r, fine_m, fine_t, 16384);
+
+			AdaptiveIntegrationSettings settings;
+			settings.mTolerance = 1e-5f;
+			math::Float3 tight_r, tight_m, tight_t;
+			SingleScatteringAdaptive(start_pos, end_pos, light_dir, params, a_optical_depth, OpticalDepthMode::Analytic, settings, tight_r, tight_m, tight_t);
+
+			settings.mTolerance = 1e-2f;
+			math::Float3 loose_r, loose_m, loose_t;
+			const int num_samples = SingleScatteringAdaptive(start_pos, end_pos, light_dir, params, a_optical_depth, OpticalDepthMode::Analytic, settings, loose_r, loose_m, loose_t);
+			assert(num_samples < INSCATTER_INTEGRAL_STEPS + 1);
+
+			for (int c = 0; c < 3; ++c)
+			{
+				assert(std::abs(tight_r[c] - fine_r[c]) <= 1e-2f * fine_r[c] + 1e-7f);
+				assert(std::abs(tight_m[c] - fine_m[c]) <= 1e-2f * fine_m[c] + 1e-7f);
+				assert(std::abs(tight_t[c] - fine_t[c]) <= 1e-2f * fine_t[c] + 1e-7f);
+				assert(std::abs(loose_r[c] - tight_r[c]) <= 2e-2f * tight_r[c] + 1e-7f);
+				assert(std::abs(loose_m[c] - tight_m[c]) <= 2e-2f * tight_m[c] + 1e-7f);
+				assert(std::abs(loose_t[c] - tight_t[c]) <= 2e-2f * tight_t[c] + 1e-7f);
+			}
+		}
+	}
+
+	// Analytic optical depth matches a fine numeric integration within 0.5%, above and below the horizontal
+	{
+		auto integrate = [](double inHeight, double inCosZenith, double inScaleHeight)
+		{
+			const double r = EARTH_RADIUS + inHeight;
+			const double top = ATM_TOP_RADIUS;
+			const double length = -r * inCosZenith + std::sqrt(r * r * inCosZenith * inCosZenith - (r * r - top * top));
+			const int num_steps = 20000;
+			const double dt = length / num_steps;
+			double sum = 0.0;
+			for (int i = 0; i <= num_steps; ++i)
+			{
+				const double t = dt * i;
+				const double radius = std::sqrt(r * r + t * t + 2.0 * r * t * inCosZenith);
+				sum += ((i == 0 || i == num_steps) ? 0.5 : 1.0) * std::exp(-(radius - EARTH_RADIUS) / inScaleHeight);
+			}
+			return sum * dt;
+		};
+
+		const math::Float2 scale_heights(7.997f, 3.0f);
+		for (float height : { 0.01f, 2.0f, 15.0f, 50.0f })
+		{
+			for (float cos_zenith : { 1.0f, 0.5f, 0.1f, 0.0f, -0.05f, -0.12f, -0.5f })
+			{
+				const math::Float2 analytic = CalculateAnalyticOpticalDepthToTop(height, cos_zenith, scale_heights);
+				if (cos_zenith < GetCosHorizonAngle(height))
+				{
+					assert(analytic.x >= 1e20f);	// hits the ground
+					continue;
+				}
+				for (int i = 0; i < 2; ++i)
+				{
+					const double reference = integrate(height, cos_zenith, scale_heights[i]);
+					assert(std::abs(analytic[i] - reference) <= 5e-3 * reference);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include <src/lib/etc/TaskScheduler.hpp>
+
+int main()
+{
+	// Every index of a parallel for is visited exactly once
+	{
+		etc::TaskScheduler scheduler(4);
+		std::vector<std::atomic<int>> visited(1000);
+		scheduler.ParallelFor(visited.size(), 7, [&](size_t inBegin, size_t inEnd)
+		{
+			for (size_t i = inBegin; i < inEnd; ++i)
+				visited[i].fetch_add(1);
+		});
+		for (const auto& v : visited)
+			assert(v.load() == 1);
+
+		std::uint64_t num_tasks = 0;
+		for (const auto& stats : scheduler.GetStats())
+			num_tasks += stats.mNumExecutedTasks;
+		assert(num_tasks == (1000 + 6) / 7);
+	}
+
+	// Tasks can submit and wait for nested tasks without dead-locking
+	{
+		etc::TaskScheduler scheduler(3);
+		std::atomic<int> sum{ 0 };
+		etc::TaskGroup outer;
+		for (int i = 0; i < 16; ++i)
+		{
+			scheduler.Submit(outer, [&]
+			{
+				etc::TaskGroup inner;
+				for (int j = 0; j < 16; ++j)
+					scheduler.Submit(inner, [&] { sum.fetch_add(1); });
+				scheduler.Wait(inner);
+			});
+		}
+		scheduler.Wait(outer);
+		assert(outer.IsDone());
+		assert(sum.load() == 16 * 16);
+	}
+
+	// A thread waiting with nothing to run sleeps instead of spinning
+	{
+		etc::TaskScheduler scheduler(2);
+		etc::TaskGroup group;
+		std::atomic<bool> is_started{ false };
+		scheduler.Submit(group, [&]
+		{
+			is_started = true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		});
+		// Let the worker take it, so that this thread has nothing to help with
+		while (!is_started)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		const std::clock_t cpu_start = std::clock();
+		scheduler.Wait(group);
+		const double cpu_seconds = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+		assert(group.IsDone());
+		assert(cpu_seconds < 0.1);
+	}
+
+	return 0;
+}